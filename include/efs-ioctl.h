@@ -0,0 +1,103 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __EFS_IOCTL_H__
+#define __EFS_IOCTL_H__
+
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Control operations on open echofs files. Unlike the requests in efs-api.h, 
+ * these are served synchronously by the filesystem itself and don't need a 
+ * connection to the API socket:
+ *
+ *   ioctl(fd, EFS_IOC_PIN);                     keep the file's data resident
+ *   ioctl(fd, EFS_IOC_UNPIN);
+ *   ioctl(fd, EFS_IOC_FLUSH);                   start writing the file back to its 
+ *                                               origin (check with EFS_IOC_GET_STATS)
+ *   ioctl(fd, EFS_IOC_GET_STATS, &stats);       struct efs_file_stats
+ *   ioctl(fd, EFS_IOC_SET_ACCESS, &pattern);    uint32_t (EFS_ACCESS_*)
+ *   ioctl(fd, EFS_IOC_SEAL);                    the file won't be modified: serve reads
+ *   ioctl(fd, EFS_IOC_UNSEAL);                  without locking (writes unseal it)
+ *
+ * All of them return 0 on success and -1 (with errno set) on error.
+ */
+
+#define EFS_IOC_MAGIC 0xEF
+
+/* expected access pattern (same as the user.efs.access extended attribute) */
+#define EFS_ACCESS_NORMAL       0
+#define EFS_ACCESS_SEQUENTIAL   1
+#define EFS_ACCESS_RANDOM       2
+#define EFS_ACCESS_STRIDED      3
+
+/* state of the last flush requested */
+#define EFS_FLUSH_NONE          0
+#define EFS_FLUSH_PENDING       1
+#define EFS_FLUSH_DONE          2
+#define EFS_FLUSH_FAILED        3
+
+/* file flags */
+#define EFS_FILE_PINNED         0x1
+#define EFS_FILE_SEALED         0x2
+
+struct efs_file_stats {
+    uint64_t efs_reads;         /* Read requests served */
+    uint64_t efs_writes;        /* Write requests served */
+    uint64_t efs_bytes_read;    /* Bytes read */
+    uint64_t efs_bytes_written; /* Bytes written */
+    uint64_t efs_size;          /* File size */
+    uint64_t efs_resident;      /* Bytes of backend storage used by the file */
+    uint32_t efs_flags;         /* EFS_FILE_* */
+    uint32_t efs_flush_state;   /* EFS_FLUSH_* */
+    int32_t  efs_flush_error;   /* errno of the last failed flush */
+    uint32_t __reserved;
+};
+
+#define EFS_IOC_PIN             _IO(EFS_IOC_MAGIC, 1)
+#define EFS_IOC_UNPIN           _IO(EFS_IOC_MAGIC, 2)
+#define EFS_IOC_FLUSH           _IO(EFS_IOC_MAGIC, 3)
+#define EFS_IOC_GET_STATS       _IOR(EFS_IOC_MAGIC, 4, struct efs_file_stats)
+#define EFS_IOC_SET_ACCESS      _IOW(EFS_IOC_MAGIC, 5, uint32_t)
+#define EFS_IOC_SEAL            _IO(EFS_IOC_MAGIC, 6)
+#define EFS_IOC_UNSEAL          _IO(EFS_IOC_MAGIC, 7)
+
+#ifdef __cplusplus
+}; // extern "C"
+#endif
+
+#endif /* __EFS_IOCTL_H__ */
@@ -0,0 +1,232 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+
+#include "affinity.h"
+
+namespace efsng {
+
+bool parse_cpu_list(const std::string& str, cpu_list& cpus) {
+
+    cpus.clear();
+
+    std::string::size_type pos = 0;
+
+    while(pos < str.size()) {
+
+        auto end = str.find(',', pos);
+
+        if(end == std::string::npos) {
+            end = str.size();
+        }
+
+        std::string range = str.substr(pos, end - pos);
+        pos = end + 1;
+
+        /* tolerate the trailing newline found in sysfs files */
+        while(!range.empty() && (range.back() == '\n' || range.back() == ' ')) {
+            range.pop_back();
+        }
+
+        if(range.empty()) {
+            continue;
+        }
+
+        char* endp = nullptr;
+        long first = std::strtol(range.c_str(), &endp, 10);
+        long last = first;
+
+        if(endp == range.c_str() || first < 0) {
+            return false;
+        }
+
+        if(*endp == '-') {
+            const char* startp = endp + 1;
+            last = std::strtol(startp, &endp, 10);
+
+            if(endp == startp || last < first) {
+                return false;
+            }
+        }
+
+        if(*endp != '\0') {
+            return false;
+        }
+
+        for(long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+    return true;
+}
+
+cpu_list allowed_cpus() {
+
+    cpu_list cpus;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if(CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    return cpus;
+}
+
+std::vector<cpu_list> numa_nodes() {
+
+    std::vector<std::pair<int, cpu_list>> found;
+    const std::string sysfs_dir = "/sys/devices/system/node";
+
+    DIR* dirp = ::opendir(sysfs_dir.c_str());
+
+    if(dirp == NULL) {
+        return {};
+    }
+
+    struct dirent* dentry;
+
+    while((dentry = ::readdir(dirp)) != NULL) {
+
+        if(std::strncmp(dentry->d_name, "node", 4) != 0) {
+            continue;
+        }
+
+        char* endp = nullptr;
+        long id = std::strtol(dentry->d_name + 4, &endp, 10);
+
+        if(endp == dentry->d_name + 4 || *endp != '\0') {
+            continue;
+        }
+
+        std::ifstream is(sysfs_dir + "/" + dentry->d_name + "/cpulist");
+        std::string line;
+        cpu_list cpus;
+
+        if(std::getline(is, line) && parse_cpu_list(line, cpus) && !cpus.empty()) {
+            found.emplace_back(id, cpus);
+        }
+    }
+
+    ::closedir(dirp);
+
+    std::sort(found.begin(), found.end());
+
+    std::vector<cpu_list> nodes;
+
+    for(auto& kv : found) {
+        nodes.push_back(std::move(kv.second));
+    }
+
+    return nodes;
+}
+
+std::vector<cpu_list> plan_worker_cpus(const std::string& mode, unsigned nworkers, 
+                                       const cpu_list& allowed, const std::vector<cpu_list>& nodes) {
+
+    std::vector<cpu_list> plan(nworkers);
+
+    if(allowed.empty()) {
+        return plan;
+    }
+
+    if(mode == "cpu") {
+        for(unsigned i = 0; i < nworkers; ++i) {
+            plan[i].push_back(allowed[i % allowed.size()]);
+        }
+    }
+    else if(mode == "node") {
+
+        /* only consider the CPUs we are allowed to use in each node */
+        std::vector<cpu_list> groups;
+
+        for(const auto& node : nodes) {
+            cpu_list group;
+
+            for(int cpu : node) {
+                if(std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                    group.push_back(cpu);
+                }
+            }
+
+            if(!group.empty()) {
+                groups.push_back(std::move(group));
+            }
+        }
+
+        if(groups.empty()) {
+            groups.push_back(allowed);
+        }
+
+        for(unsigned i = 0; i < nworkers; ++i) {
+            plan[i] = groups[i % groups.size()];
+        }
+    }
+
+    return plan;
+}
+
+bool pin_current_thread(const cpu_list& cpus) {
+
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    for(int cpu : cpus) {
+        if(cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+} // namespace efsng
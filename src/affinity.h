@@ -0,0 +1,68 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#ifndef __EFS_AFFINITY_H__
+#define __EFS_AFFINITY_H__
+
+#include <string>
+#include <vector>
+
+namespace efsng {
+
+using cpu_list = std::vector<int>;
+
+/* parse a Linux CPU list (e.g. "0-3,8,10-11") such as the ones found in 
+ * /sys/devices/system/node/nodeN/cpulist */
+bool parse_cpu_list(const std::string& str, cpu_list& cpus);
+
+/* CPUs the calling process is allowed to run on */
+cpu_list allowed_cpus();
+
+/* CPUs in each NUMA node of the machine (empty if this information is not available) */
+std::vector<cpu_list> numa_nodes();
+
+/* decide where each of 'nworkers' threads should run according to 'mode': 
+ *   - "cpu": each worker gets one CPU from 'allowed' (round-robin)
+ *   - "node": each worker gets all the CPUs in 'allowed' from one NUMA node (round-robin)
+ *   - "none": workers are not pinned
+ * an empty list means that the corresponding worker should not be pinned */
+std::vector<cpu_list> plan_worker_cpus(const std::string& mode, unsigned nworkers, 
+                                       const cpu_list& allowed, const std::vector<cpu_list>& nodes);
+
+/* restrict the calling thread to 'cpus' */
+bool pin_current_thread(const cpu_list& cpus);
+
+} // namespace efsng
+
+#endif /* __EFS_AFFINITY_H__ */
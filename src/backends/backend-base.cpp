@@ -31,11 +31,17 @@
 */ 
 
 
+#include <linux/falloc.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <boost/filesystem.hpp>
 
 namespace bfs = boost::filesystem;
 
 #include "backend-base.h"
+#include "copy-engine.h"
 #include "utils.h"
 #include "dram/dram.h"
 #include "nvram-nvml/nvram-nvml.h"
@@ -43,7 +49,311 @@ namespace bfs = boost::filesystem;
 
 namespace efsng {
 
-backend::backend_ptr backend::create_from_options(const config::backend_options& opts) {
+const off_t backend::dir::s_first_offset;
+const off_t backend::dir::s_max_offset;
+
+/* shared source for zero-filled regions (i.e. file gaps) */
+static char s_zeroes[64*1024];
+
+backend::data_view::data_view() 
+    : m_bufvec(NULL),
+      m_size(0) { }
+
+backend::data_view::~data_view() {
+
+    for(auto mem : m_owned) {
+        free(mem);
+    }
+
+    free(m_bufvec);
+}
+
+void backend::data_view::add(void* mem, size_t size, bool owned) {
+
+    struct fuse_buf buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.mem = mem;
+    buf.size = size;
+
+    m_bufs.push_back(buf);
+    m_size += size;
+
+    if(owned) {
+        m_owned.push_back(mem);
+    }
+}
+
+void backend::data_view::add_zeroes(size_t size) {
+
+    while(size != 0) {
+        size_t n = std::min(size, sizeof(s_zeroes));
+        add(s_zeroes, n);
+        size -= n;
+    }
+}
+
+void backend::data_view::add_fd(int fd, off_t pos, size_t size) {
+
+    struct fuse_buf buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.flags = (fuse_buf_flags) (FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+    buf.fd = fd;
+    buf.pos = pos;
+    buf.size = size;
+
+    m_bufs.push_back(buf);
+    m_size += size;
+}
+
+struct fuse_bufvec* backend::data_view::bufvec() {
+
+    if(m_bufvec != NULL) {
+        /* consumers (e.g. fuse_buf_copy()) advance the bufvec as they go */
+        m_bufvec->idx = 0;
+        m_bufvec->off = 0;
+        return m_bufvec;
+    }
+
+    /* struct fuse_bufvec already includes room for one fuse_buf */
+    size_t count = std::max(m_bufs.size(), (size_t) 1);
+
+    m_bufvec = (struct fuse_bufvec*) 
+        malloc(sizeof(struct fuse_bufvec) + (count - 1) * sizeof(struct fuse_buf));
+
+    if(m_bufvec == NULL) {
+        throw std::bad_alloc();
+    }
+
+    *m_bufvec = FUSE_BUFVEC_INIT(0);
+    m_bufvec->count = m_bufs.size();
+
+    if(!m_bufs.empty()) {
+        memcpy(m_bufvec->buf, m_bufs.data(), m_bufs.size() * sizeof(struct fuse_buf));
+    }
+
+    return m_bufvec;
+}
+
+ssize_t backend::data_view::copy_to(void* buffer, size_t size) {
+
+    char* dst = static_cast<char*>(buffer);
+    size_t copied = 0;
+
+    for(const auto& buf : m_bufs) {
+
+        size_t n = std::min(buf.size, size - copied);
+
+        if(n == 0) {
+            break;
+        }
+
+        if(buf.flags & FUSE_BUF_IS_FD) {
+            struct fuse_bufvec src = FUSE_BUFVEC_INIT(n);
+            struct fuse_bufvec dstv = FUSE_BUFVEC_INIT(n);
+
+            src.buf[0] = buf;
+            src.buf[0].size = n;
+            dstv.buf[0].mem = dst + copied;
+
+            ssize_t rv = fuse_buf_copy(&dstv, &src, (fuse_buf_copy_flags) 0);
+
+            if(rv < 0) {
+                return copied != 0 ? copied : rv;
+            }
+
+            copied += rv;
+
+            // the file was truncated under us
+            if((size_t) rv < n) {
+                break;
+            }
+
+            continue;
+        }
+
+        // (gaps need not be read)
+        if(buf.mem == s_zeroes) {
+            memset(dst + copied, 0, n);
+        }
+        else {
+            copy_memory(dst + copied, buf.mem, n, memory_kind::dram);
+        }
+
+        copied += n;
+    }
+
+    return copied;
+}
+
+ssize_t backend::data_view::release(struct fuse_bufvec** bufp) {
+
+    struct fuse_bufvec* dst = (struct fuse_bufvec*) malloc(sizeof(struct fuse_bufvec));
+
+    if(dst == NULL) {
+        return -ENOMEM;
+    }
+
+    *dst = FUSE_BUFVEC_INIT(m_size);
+
+    if(posix_memalign(&dst->buf[0].mem, 512, m_size) != 0) {
+        free(dst);
+        return -ENOMEM;
+    }
+
+    ssize_t rv = copy_to(dst->buf[0].mem, m_size);
+
+    if(rv < 0) {
+        free(dst->buf[0].mem);
+        free(dst);
+        return rv;
+    }
+
+    dst->idx = 0;
+    dst->off = 0;
+    dst->buf[0].size = rv;
+    *bufp = dst;
+
+    return 0;
+}
+
+ssize_t backend::file::map_data(off_t offset, size_t size, data_view_ptr& view, cursor* cur) {
+
+    (void) cur;
+
+    struct fuse_bufvec buf = FUSE_BUFVEC_INIT(size);
+
+    buf.buf[0].mem = NULL;
+
+    ssize_t rv = get_data(offset, size, &buf);
+
+    if(rv < 0) {
+        return rv;
+    }
+
+    view.reset(new data_view());
+
+    if(buf.buf[0].mem != NULL) {
+        view->add(buf.buf[0].mem, buf.buf[0].size, /*owned=*/true);
+    }
+
+    return rv;
+}
+
+ssize_t backend::file::fallocate(int mode, off_t offset, size_t size) {
+
+    const bool keep_size = (mode & FALLOC_FL_KEEP_SIZE) != 0;
+
+    mode &= ~FALLOC_FL_KEEP_SIZE;
+
+    switch(mode) {
+        case 0:
+            return allocate(offset, size, keep_size);
+
+        case FALLOC_FL_PUNCH_HOLE:
+            // the kernel already checks this, but just in case
+            if(!keep_size) {
+                return -EOPNOTSUPP;
+            }
+
+            return punch_hole(offset, size);
+
+        case FALLOC_FL_ZERO_RANGE:
+            return zero_range(offset, size, keep_size);
+
+        default:
+            return -EOPNOTSUPP;
+    }
+}
+
+ssize_t backend::file::copy_range(file& src, off_t src_offset, off_t offset, size_t size) {
+
+    // map_data() keeps the source range locked while put_data() locks the destination
+    if(&src == this && src_offset < (off_t) (offset + size) && offset < (off_t) (src_offset + size)) {
+        return -EINVAL;
+    }
+
+    // copy in chunks so that backends that can't map their data don't buffer the whole range
+    const size_t chunk_size = 16*1024*1024;
+    size_t total = 0;
+
+    while(total < size) {
+
+        data_view_ptr view;
+        ssize_t rv = src.map_data(src_offset + total, std::min(chunk_size, size - total), view);
+
+        if(rv < 0) {
+            return total != 0 ? (ssize_t) total : rv;
+        }
+
+        // EOF
+        if(view == nullptr || view->size() == 0) {
+            break;
+        }
+
+        rv = put_data(offset + total, view->size(), view->bufvec());
+
+        if(rv <= 0) {
+            return total != 0 ? (ssize_t) total : rv;
+        }
+
+        total += rv;
+    }
+
+    return total;
+}
+
+int backend::file::set_hint(const char* name, const char* value, size_t size, int flags) {
+
+    int rv = m_hints.set(name, value, size, flags);
+
+    if(rv == 0) {
+        hints_changed();
+    }
+
+    return rv;
+}
+
+int backend::file::remove_hint(const char* name) {
+
+    int rv = m_hints.remove(name);
+
+    if(rv == 0) {
+        hints_changed();
+    }
+
+    return rv;
+}
+
+backend::file::flush_state backend::file::get_flush_state(int* error) const {
+
+    if(error != nullptr) {
+        *error = m_flush_error;
+    }
+
+    return m_flush_state;
+}
+
+bool backend::file::begin_flush() {
+
+    flush_state state = m_flush_state;
+
+    do {
+        if(state == flush_state::pending) {
+            return false;
+        }
+    } while(!m_flush_state.compare_exchange_weak(state, flush_state::pending));
+
+    return true;
+}
+
+void backend::file::end_flush(int error) {
+    m_flush_error = error;
+    m_flush_state = (error == 0 ? flush_state::done : flush_state::failed);
+}
+
+backend::backend_ptr backend::create_from_options(const config::backend_options& opts, size_t transfer_size) {
 
     const std::string id = opts.m_id;
     const std::string type = opts.m_type;
@@ -70,7 +380,20 @@ backend::backend_ptr backend::create_from_options(const config::backend_options&
             }
         }
 
-        return std::make_unique<nvml::nvml_backend>(opts.m_capacity, daxfs, opts.m_root_dir, ssize);
+        bool splice_reads = false;
+
+        if(opts.m_extra_options.count("read-mode") != 0) {
+            const std::string& mode = opts.m_extra_options.at("read-mode");
+
+            if(mode != "mmap" && mode != "splice") {
+                throw std::runtime_error("Invalid argument in option 'read-mode' of backend '" + id + "'");
+            }
+
+            splice_reads = (mode == "splice");
+        }
+
+        return std::make_unique<nvml::nvml_backend>(opts.m_capacity, daxfs, opts.m_root_dir, ssize, splice_reads, 
+                                                    transfer_size);
     }
     else if (type == "NVRAM-DEVDAX") {
 
@@ -34,11 +34,16 @@
 #ifndef __DATA_STORE_H__
 #define __DATA_STORE_H__
 
+#include <atomic>
+#include <cerrno>
 #include <cstdint>
 #include <string>
 
 #include <unordered_map>
 #include <list>
+#include <memory>
+#include <vector>
+#include <functional>
 #include <unordered_set>
 
 /* C includes */
@@ -51,6 +56,7 @@
 #include <range_lock.h>
 #include <posix-file.h>
 #include "errors.h"
+#include "file-hints.h"
 
 namespace efsng {
 
@@ -97,6 +103,51 @@ public:
         size_t            m_size;
     };
 
+    /**
+     * A read-only view of a range of file data, described as a fuse_bufvec 
+     * with one entry per contiguous region. Entries may point straight into 
+     * backend memory: backends keep the range locked (and hence mapped) 
+     * until the view is destroyed, so it must outlive any use of the bufvec
+     * (e.g. it must be kept alive until fuse_reply_data() returns). Entries 
+     * may also reference a file descriptor so that data can be spliced.
+     */
+    class data_view {
+
+public:
+        data_view();
+        virtual ~data_view();
+
+        /*! Append a region of 'size' bytes at 'mem' (free()'d with the view if 'owned') */
+        void add(void* mem, size_t size, bool owned = false);
+        /*! Append a region of 'size' zero bytes */
+        void add_zeroes(size_t size);
+        /*! Append a region of 'size' bytes found at offset 'pos' of file descriptor 'fd' */
+        void add_fd(int fd, off_t pos, size_t size);
+
+        struct fuse_bufvec* bufvec();
+
+        /*! Copy up to 'size' bytes of the view into 'buffer' (see copy_memory()). 
+         * Returns the number of bytes copied or -errno */
+        ssize_t copy_to(void* buffer, size_t size);
+
+        /*! Return in 'bufp' a bufvec that no longer depends on the view and that
+         * can be released with fuse_free_buf(), i.e. a copy of the data in a new 
+         * buffer (descriptors in the view may be closed once it is destroyed) */
+        ssize_t release(struct fuse_bufvec** bufp);
+        size_t size() const { return m_size; }
+
+private:
+        data_view(const data_view&) = delete;
+        data_view& operator=(const data_view&) = delete;
+
+        std::vector<struct fuse_buf> m_bufs;   /*!< Regions in the view */
+        std::vector<void*>           m_owned;  /*!< Buffers released along with the view */
+        struct fuse_bufvec*          m_bufvec; /*!< bufvec describing m_bufs (built lazily) */
+        size_t                       m_size;   /*!< Total size of the view */
+    };
+
+    using data_view_ptr = std::unique_ptr<data_view>;
+
     class file {
 
 public:
@@ -107,16 +158,103 @@ public:
             persistent
         };
 
+        /* opaque per-handle state that backends may use to resume a data 
+         * lookup where the previous operation through the same handle ended */
+        struct cursor {
+            virtual ~cursor() {}
+        };
+
+        using cursor_ptr = std::unique_ptr<cursor>;
+
+        /* I/O statistics, updated by the front ends as requests are served */
+        struct io_stats {
+            io_stats() : m_reads(0), m_writes(0), m_bytes_read(0), m_bytes_written(0) {}
+
+            std::atomic<uint64_t> m_reads;
+            std::atomic<uint64_t> m_writes;
+            std::atomic<uint64_t> m_bytes_read;
+            std::atomic<uint64_t> m_bytes_written;
+        };
+
+        /* state of the last write-back of the file to its origin */
+        enum class flush_state {
+            none,
+            pending,
+            done,
+            failed
+        };
+
+        file() : m_pinned(false), m_flush_state(flush_state::none), m_flush_error(0), m_warmed(false) {}
+
         virtual void stat(struct stat& buf) const = 0;
         virtual ssize_t get_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) = 0;
-        virtual ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) = 0;
+        /* the default implementation wraps a copy of the data returned by get_data() */
+        virtual ssize_t map_data(off_t offset, size_t size, data_view_ptr& view, cursor* cur = nullptr);
+        virtual ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur = nullptr) = 0;
+        /* backends that don't benefit from cursors return a null one */
+        virtual cursor_ptr new_cursor() const { return cursor_ptr(); }
         virtual ssize_t append_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) = 0;
-        virtual ssize_t allocate(off_t offset, size_t size) = 0;
-        virtual void truncate(off_t offset) = 0;
+        virtual ssize_t allocate(off_t offset, size_t size, bool keep_size = false) = 0;
+        /* make [offset, offset+size) read back as zeroes, returning the storage of whatever 
+         * lies entirely within the range. The file size is not changed */
+        virtual ssize_t punch_hole(off_t offset, size_t size) { (void) offset; (void) size; return -EOPNOTSUPP; }
+        /* same as punch_hole(), but the file is extended up to offset+size unless 'keep_size' is set */
+        virtual ssize_t zero_range(off_t offset, size_t size, bool keep_size) { 
+            (void) offset; (void) size; (void) keep_size; return -EOPNOTSUPP; 
+        }
+        /* fallocate(2) on top of the above: 'mode' may combine FALLOC_FL_KEEP_SIZE with 
+         * either FALLOC_FL_PUNCH_HOLE or FALLOC_FL_ZERO_RANGE. Returns 0 or -errno */
+        ssize_t fallocate(int mode, off_t offset, size_t size);
+        /* copy_file_range(2): copy up to 'size' bytes at 'src_offset' of 'src' (which may belong 
+         * to another backend) to 'offset' of this file. Returns the number of bytes copied or 
+         * -errno. The default implementation copies data through map_data() and put_data() */
+        virtual ssize_t copy_range(file& src, off_t src_offset, off_t offset, size_t size);
+        /* performance hints, managed through "user.efs.*" extended attributes (see file-hints.h).
+         * Modifying them returns 0 or -errno, reading them the attribute size or -errno */
+        const file_hints& hints() const { return m_hints; }
+        int set_hint(const char* name, const char* value, size_t size, int flags);
+        ssize_t get_hint(const char* name, char* value, size_t size) const { return m_hints.get(name, value, size); }
+        ssize_t list_hints(char* list, size_t size) const { return m_hints.list(list, size); }
+        int remove_hint(const char* name);
+        /* statistics and control state (see efs-ioctl.h) */
+        const io_stats& stats() const { return m_stats; }
+        void record_read(size_t bytes) { ++m_stats.m_reads; m_stats.m_bytes_read += bytes; }
+        void record_write(size_t bytes) { ++m_stats.m_writes; m_stats.m_bytes_written += bytes; }
+        /* bytes of backend storage currently used by the file */
+        virtual uint64_t resident_bytes() const { struct stat st; stat(st); return st.st_blocks * 512; }
+        /* keep the file's data resident (e.g. by locking it in memory). Returns 0 or -errno */
+        virtual int pin(bool pinned) { m_pinned = pinned; return 0; }
+        bool is_pinned() const { return m_pinned; }
+        /* whether reads are currently served from a frozen layout of the file (see the 
+         * user.efs.sealed hint). Backends that don't support it never report it */
+        virtual bool is_sealed() const { return false; }
+        /* make the data written so far durable (and also the file's metadata, unless 
+         * 'data_only'). Returns 0 or -errno */
+        virtual int sync(bool data_only) { (void) data_only; return 0; }
+        flush_state get_flush_state(int* error = nullptr) const;
+        /* returns false if a flush is already pending */
+        bool begin_flush();
+        void end_flush(int error);
+        /* returns false if the file's contents were already pushed into the kernel page cache */
+        bool begin_warmup() { return !m_warmed.exchange(true); }
+        /* change the size of the file to 'offset'. Returns 0 or -errno */
+        virtual int truncate(off_t offset) = 0;
         virtual void save_attributes(struct stat & stbuf) = 0;
 	virtual int unload(const std::string dump_path) = 0;
 	virtual void change_type(file::type type) = 0;
         virtual ~file(){}
+
+protected:
+        /* called after a hint is set or removed so that backends can act on it right away
+         * (e.g. by preallocating storage), rather than the next time they need it */
+        virtual void hints_changed() { }
+
+        file_hints m_hints;
+        io_stats m_stats;
+        std::atomic<bool> m_pinned;
+        std::atomic<flush_state> m_flush_state;
+        std::atomic<int> m_flush_error; /*!< errno of the last failed flush */
+        std::atomic<bool> m_warmed;
     };
 
     using file_ptr = std::shared_ptr<file>;
@@ -144,10 +282,21 @@ public:
         persistent
     };
 
-    virtual void list_files(std::list <std::string> & m_f) const = 0;
+    /* readdir offsets: 1 and 2 are used by "." and "..", entries get increasing offsets 
+     * from s_first_offset on that are never reused, so that listings can be resumed
+     * from any offset even if entries are added or removed in between. Offsets at or 
+     * above s_max_offset are never handed out by backends and are free for the front 
+     * ends to use (e.g. for symbolic links) */
+    static const off_t s_first_offset = 3;
+    static const off_t s_max_offset = (off_t) 1 << 62;
+
+    using list_callback = std::function<bool(const std::string&, off_t)>;
+
+    /* call 'fn' with the name and offset of each entry placed after 'offset' until it returns false */
+    virtual void list_files(off_t offset, const list_callback& fn) const = 0;
     virtual void add_file(const std::string file) = 0;
     virtual void remove_file(const std::string file) = 0;
-    virtual bool find (const std::string fname, std::unordered_set < std::string >::iterator & it) const = 0;
+    virtual bool find (const std::string fname) const = 0;
     virtual unsigned int num_links() const = 0;
     virtual void stat(struct stat& stbuf) const = 0;
     virtual void save_attributes(struct stat & stbuf) = 0;
@@ -157,25 +306,59 @@ public:
 
     using dir_ptr = std::shared_ptr<dir>;
 
+    /* space and namespace usage counters, kept up to date by each backend as
+     * files and directories are created/removed so that statfs() never needs 
+     * to walk the namespace */
+    struct usage {
+        usage() : m_bytes(0), m_files(0), m_dirs(0) {}
+
+        std::atomic<uint64_t> m_bytes;
+        std::atomic<uint64_t> m_files;
+        std::atomic<uint64_t> m_dirs;
+    };
+
+    /* runs a task in the background (see set_executor()) */
+    using executor_fn = std::function<void(std::function<void()>)>;
+
 protected:
     backend() {}
 
+    /* run 'task' through the executor, or right away if none was set */
+    void defer(std::function<void()> task) const {
+        if(m_executor) {
+            m_executor(std::move(task));
+        }
+        else {
+            task();
+        }
+    }
+
+    usage m_usage;
+    executor_fn m_executor;
+
 public:
     virtual ~backend() {}
 
+    /* work that requests don't need to wait for (e.g. preparing the storage of 
+     * newly created files) is handed to 'fn' rather than done by the caller */
+    void set_executor(executor_fn fn) { m_executor = std::move(fn); }
+
 public:
 
     using backend_ptr = std::unique_ptr<backend>;
 
     static Type name_to_type(const std::string& name); // probably deprecated
 
-    static backend_ptr create_from_options(const config::backend_options& opts);
+    static backend_ptr create_from_options(const config::backend_options& opts, size_t transfer_size = 0);
 
     virtual std::string name() const = 0;
     virtual uint64_t capacity() const = 0;
+    const usage& get_usage() const { return m_usage; }
     virtual error_code load(const bfs::path& pathname, backend::file::type type) = 0;
     virtual error_code unload(const bfs::path& pathname, const bfs::path & mntpathname) = 0;
     virtual bool exists(const char* pathname) const = 0;
+    /* pass the entries in 'path' placed after 'offset' to 'filler' (with their attributes 
+     * and offsets, see backend::dir) until it returns non-zero */
     virtual int do_readdir (const char * path, void * buffer, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi) const = 0;
     virtual int do_stat (const char * path, struct stat& stbuf) const = 0;
     virtual int do_create(const char* pathname, mode_t mode, std::shared_ptr < backend::file> & file) = 0;
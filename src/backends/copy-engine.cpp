@@ -0,0 +1,220 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#include <libpmem.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "copy-engine.h"
+
+namespace {
+
+/* sizes from which copies use streaming stores, indexed by memory_kind (see 
+ * tests/benchmarks/bench-copy-engine). On pmem, regular stores must read each 
+ * destination line before writing it and flush it afterwards, which soon costs 
+ * more than a fence. Elsewhere streaming only pays off once the copy would 
+ * evict a good part of the caches, and data read back soon (e.g. buffers for 
+ * FUSE replies) is better off staying in them for longer */
+const size_t s_nt_threshold[] = {
+    16*1024,        // pmem
+    256*1024,       // dax
+    4*1024*1024     // dram
+};
+
+/* regular copies to pmem flush each chunk right after writing it, while its 
+ * lines are still in the closest caches */
+const size_t s_flush_chunk = 4*1024;
+
+/* streaming stores are issued in whole cache lines */
+const size_t s_line_size = 64;
+
+/* copy 'size' bytes (a multiple of s_line_size) to 'dst' (aligned to s_line_size) 
+ * with streaming stores. They are weakly ordered: callers must fence afterwards */
+using stream_fn = void (*)(char* dst, const char* src, size_t size);
+
+struct stream_kernel {
+    const char* m_name;
+    stream_fn   m_fn;   /*!< nullptr if not available */
+};
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx512f")))
+void stream_avx512(char* dst, const char* src, size_t size) {
+
+    for(; size >= 4 * s_line_size; size -= 4 * s_line_size, dst += 4 * s_line_size, src += 4 * s_line_size) {
+        __m512i a = _mm512_loadu_si512((const void*) src);
+        __m512i b = _mm512_loadu_si512((const void*) (src + 64));
+        __m512i c = _mm512_loadu_si512((const void*) (src + 128));
+        __m512i d = _mm512_loadu_si512((const void*) (src + 192));
+        _mm512_stream_si512((__m512i*) dst, a);
+        _mm512_stream_si512((__m512i*) (dst + 64), b);
+        _mm512_stream_si512((__m512i*) (dst + 128), c);
+        _mm512_stream_si512((__m512i*) (dst + 192), d);
+    }
+
+    for(; size != 0; size -= s_line_size, dst += s_line_size, src += s_line_size) {
+        _mm512_stream_si512((__m512i*) dst, _mm512_loadu_si512((const void*) src));
+    }
+}
+
+__attribute__((target("avx2")))
+void stream_avx2(char* dst, const char* src, size_t size) {
+
+    for(; size >= 2 * s_line_size; size -= 2 * s_line_size, dst += 2 * s_line_size, src += 2 * s_line_size) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) src);
+        __m256i b = _mm256_loadu_si256((const __m256i*) (src + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (src + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*) (src + 96));
+        _mm256_stream_si256((__m256i*) dst, a);
+        _mm256_stream_si256((__m256i*) (dst + 32), b);
+        _mm256_stream_si256((__m256i*) (dst + 64), c);
+        _mm256_stream_si256((__m256i*) (dst + 96), d);
+    }
+
+    if(size != 0) {
+        _mm256_stream_si256((__m256i*) dst, _mm256_loadu_si256((const __m256i*) src));
+        _mm256_stream_si256((__m256i*) (dst + 32), _mm256_loadu_si256((const __m256i*) (src + 32)));
+    }
+}
+
+void stream_sse2(char* dst, const char* src, size_t size) {
+
+    for(; size != 0; size -= s_line_size, dst += s_line_size, src += s_line_size) {
+        __m128i a = _mm_loadu_si128((const __m128i*) src);
+        __m128i b = _mm_loadu_si128((const __m128i*) (src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*) (src + 48));
+        _mm_stream_si128((__m128i*) dst, a);
+        _mm_stream_si128((__m128i*) (dst + 16), b);
+        _mm_stream_si128((__m128i*) (dst + 32), c);
+        _mm_stream_si128((__m128i*) (dst + 48), d);
+    }
+}
+
+#endif /* __x86_64__ */
+
+/* pick the widest kernel that the CPU supports (only once) */
+const stream_kernel& select_kernel() {
+
+    static const stream_kernel kernel = []() -> stream_kernel {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+
+        if(__builtin_cpu_supports("avx512f")) {
+            return {"avx512", stream_avx512};
+        }
+
+        if(__builtin_cpu_supports("avx2")) {
+            return {"avx2", stream_avx2};
+        }
+
+        return {"sse2", stream_sse2};
+#else
+        return {"none", nullptr};
+#endif
+    }();
+
+    return kernel;
+}
+
+} // anonymous namespace
+
+namespace efsng {
+
+copy_mode copy_strategy(size_t size, memory_kind kind) {
+    return size >= s_nt_threshold[static_cast<int>(kind)] ? copy_mode::non_temporal : copy_mode::temporal;
+}
+
+const char* copy_kernel() {
+    return select_kernel().m_name;
+}
+
+void copy_memory(void* dst, const void* src, size_t size, memory_kind kind) {
+    copy_memory(dst, src, size, kind, copy_strategy(size, kind));
+}
+
+void copy_memory(void* dst, const void* src, size_t size, memory_kind kind, copy_mode mode) {
+
+    char* d = static_cast<char*>(dst);
+    const char* s = static_cast<const char*>(src);
+    const stream_kernel& kernel = select_kernel();
+
+    if(mode == copy_mode::non_temporal && kernel.m_fn != nullptr && size >= s_line_size) {
+
+        // the unaligned edges go through the caches
+        size_t head = std::min(size, (s_line_size - ((uintptr_t) d & (s_line_size - 1))) & (s_line_size - 1));
+        size_t body = (size - head) & ~(s_line_size - 1);
+        size_t tail = size - head - body;
+
+        memcpy(d, s, head);
+        kernel.m_fn(d + head, s + head, body);
+        memcpy(d + head + body, s + head + body, tail);
+
+        if(kind == memory_kind::pmem) {
+            if(head != 0) {
+                pmem_flush(d, head);
+            }
+
+            if(tail != 0) {
+                pmem_flush(d + head + body, tail);
+            }
+        }
+
+#if defined(__x86_64__)
+        // make the streaming stores visible (and, on pmem, send them on their 
+        // way to the persistence domain) before anyone relies on them
+        _mm_sfence();
+#endif
+        return;
+    }
+
+    if(kind != memory_kind::pmem) {
+        memcpy(d, s, size);
+        return;
+    }
+
+    for(size_t off = 0; off < size; off += s_flush_chunk) {
+        size_t n = std::min(s_flush_chunk, size - off);
+        memcpy(d + off, s + off, n);
+        pmem_flush(d + off, n);
+    }
+}
+
+} // namespace efsng
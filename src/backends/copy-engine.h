@@ -0,0 +1,75 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#ifndef __COPY_ENGINE_H__
+#define __COPY_ENGINE_H__
+
+#include <cstddef>
+
+namespace efsng {
+
+/* kind of memory that data is copied to */
+enum class memory_kind {
+    pmem,   /*!< persistent memory: data must be flushed out of CPU caches to persist */
+    dax,    /*!< DAX mappings that need no flushing (DRAM-backed, or pmem on eADR platforms) */
+    dram    /*!< ordinary memory (anonymous or page cache), e.g. buffers for FUSE replies */
+};
+
+/* how data is stored by a copy */
+enum class copy_mode {
+    temporal,       /*!< regular stores, through CPU caches */
+    non_temporal    /*!< streaming stores that bypass CPU caches */
+};
+
+/* copy 'size' bytes from 'src' to 'dst' (they must not overlap), storing them in 
+ * the way that suits 'size' and 'kind' best (see copy_strategy()). Copies to pmem 
+ * are flushed but not drained: pmem_drain() makes them persistent */
+void copy_memory(void* dst, const void* src, size_t size, memory_kind kind);
+
+/* same, but forcing 'mode' (e.g. for benchmarks) */
+void copy_memory(void* dst, const void* src, size_t size, memory_kind kind, copy_mode mode);
+
+/* the mode that copy_memory() uses for 'size' bytes of 'kind': small copies use regular 
+ * stores (and pmem ones flush the lines they wrote), which spares them the fence that 
+ * streaming stores need. Large ones use streaming stores so that they don't evict 
+ * everything else from the caches (and, on pmem, don't read the destination first) */
+copy_mode copy_strategy(size_t size, memory_kind kind);
+
+/* instruction set of the streaming kernel selected for this CPU 
+ * ("avx512", "avx2", "sse2" or "none" if only regular stores are available) */
+const char* copy_kernel();
+
+} // namespace efsng
+
+#endif /* __COPY_ENGINE_H__ */
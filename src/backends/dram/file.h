@@ -76,10 +76,11 @@ struct file : public backend::file {
         return 0; 
     }
 
-    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) override { 
+    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur) override { 
         (void) offset;
         (void) size;
         (void) fuse_buffer;
+        (void) cur;
         return 0; 
     }
 
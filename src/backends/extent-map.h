@@ -0,0 +1,437 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __EXTENT_MAP_H__
+#define __EXTENT_MAP_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+namespace efsng {
+
+/*! Index of the extents [start, end) that make up a file, each one mapped to a 
+ * 'Value' (e.g. the segment storing it). Extents never overlap: mapping a range 
+ * trims or splits whatever was there before. Unmapped ranges map to nothing.
+ *
+ * Extents are kept as compact records in a sorted array, so lookups are a binary 
+ * search over contiguous memory and appending (what growing files do) is O(1). 
+ * Besides, files that are written sequentially end up being made of extents 
+ * of the same size (segment::s_segment_size): the longest run of such extents at 
+ * the end of the array is tracked, and offsets that fall in it are found by 
+ * direct indexing instead. Mapping ranges in the middle of the file (e.g. when 
+ * filling a gap) moves the extents after them, which only happens once per gap.
+ *
+ * The range of offsets modified since the last call to forget_changes() is 
+ * recorded, so that copies made for lock-free readers (see extent_snapshot) 
+ * can be refreshed without copying everything else.
+ *
+ * Not thread-safe: callers serialize access (e.g. with their allocation mutex).
+ * Iterators are invalidated by any modification.
+ */
+template <typename Value>
+class extent_map {
+
+public:
+    struct extent {
+        off_t   m_start;
+        off_t   m_end;
+        Value   m_value;
+    };
+
+    using const_iterator = typename std::vector<extent>::const_iterator;
+
+    extent_map()
+        : m_uniform_first(0),
+          m_uniform_size(0),
+          m_changed_start(0),
+          m_changed_end(0) { }
+
+    const extent& operator[](size_t index) const { return m_extents[index]; }
+    const_iterator begin() const { return m_extents.begin(); }
+    const_iterator end() const { return m_extents.end(); }
+    size_t size() const { return m_extents.size(); }
+    bool empty() const { return m_extents.empty(); }
+
+    /*! End of the last extent (0 if empty) */
+    off_t end_offset() const { 
+        return m_extents.empty() ? 0 : m_extents.back().m_end;
+    }
+
+    /*! Extent containing 'offset', or end() if it's not mapped */
+    const_iterator find(off_t offset) const {
+
+        if(m_uniform_first < m_extents.size()) {
+            off_t base = m_extents[m_uniform_first].m_start;
+
+            if(offset >= base) {
+                size_t index = m_uniform_first + (offset - base) / m_uniform_size;
+                return index < m_extents.size() ? m_extents.begin() + index : m_extents.end();
+            }
+        }
+
+        auto limit = m_extents.begin() + std::min(m_uniform_first, m_extents.size());
+        auto it = first_ending_after(m_extents.begin(), limit, offset);
+
+        if(it == limit || it->m_start > offset) {
+            return m_extents.end();
+        }
+
+        return it;
+    }
+
+    /*! Position of the extent containing 'offset', or size() if it's not mapped */
+    size_t index_of(off_t offset) const {
+        return find(offset) - m_extents.begin();
+    }
+
+    /*! Value mapped to 'offset' (a default-constructed Value if none) */
+    Value lookup(off_t offset) const {
+        auto it = find(offset);
+        return it != m_extents.end() ? it->m_value : Value();
+    }
+
+    /*! Map [start, end) to 'value' */
+    void assign(off_t start, off_t end, const Value& value) {
+
+        if(start >= end) {
+            return;
+        }
+
+        if(m_extents.empty() || start >= m_extents.back().m_end) {
+            m_extents.push_back(extent{start, end, value});
+            extend_uniform_run();
+            note_change(start, end);
+            return;
+        }
+
+        replace(start, end, &value);
+    }
+
+    /*! Unmap [start, end) */
+    void erase(off_t start, off_t end) {
+
+        if(start >= end) {
+            return;
+        }
+
+        replace(start, end, nullptr);
+    }
+
+    void clear() {
+
+        if(!m_extents.empty()) {
+            note_change(m_extents.front().m_start, m_extents.back().m_end);
+        }
+
+        m_extents.clear();
+        m_uniform_first = 0;
+        m_uniform_size = 0;
+    }
+
+    /*! Range [first, second) covering every extent modified (before or after 
+     * the change) since the last call to forget_changes(). Empty if none was */
+    std::pair<off_t, off_t> changed_range() const {
+        return std::make_pair(m_changed_start, m_changed_end);
+    }
+
+    void forget_changes() {
+        m_changed_start = m_changed_end = 0;
+    }
+
+private:
+    using iterator = typename std::vector<extent>::iterator;
+
+    template <typename Iterator>
+    static Iterator first_ending_after(Iterator first, Iterator last, off_t offset) {
+        return std::upper_bound(first, last, offset, 
+                                [](off_t off, const extent& e) { return off < e.m_end; });
+    }
+
+    /* replace whatever overlaps [start, end) with 'value' (or nothing if nullptr), 
+     * keeping the parts of the extents at both edges that lie outside the range */
+    void replace(off_t start, off_t end, const Value* value) {
+
+        iterator first = first_ending_after(m_extents.begin(), m_extents.end(), start);
+        iterator last = std::lower_bound(first, m_extents.end(), end, 
+                                         [](const extent& e, off_t off) { return e.m_start < off; });
+
+        if(first != last) {
+            note_change(first->m_start, std::prev(last)->m_end);
+        }
+
+        note_change(start, end);
+
+        extent pieces[3];
+        size_t count = 0;
+
+        if(first != last && first->m_start < start) {
+            pieces[count++] = extent{first->m_start, start, first->m_value};
+        }
+
+        if(value != nullptr) {
+            pieces[count++] = extent{start, end, *value};
+        }
+
+        if(first != last && std::prev(last)->m_end > end) {
+            pieces[count++] = extent{end, std::prev(last)->m_end, std::prev(last)->m_value};
+        }
+
+        size_t index = first - m_extents.begin();
+        size_t replaced = last - first;
+        size_t common = std::min(replaced, count);
+
+        for(size_t i = 0; i < common; ++i) {
+            m_extents[index + i] = std::move(pieces[i]);
+        }
+
+        if(count > replaced) {
+            m_extents.insert(m_extents.begin() + index + replaced, 
+                             std::make_move_iterator(pieces + replaced), 
+                             std::make_move_iterator(pieces + count));
+        }
+        else if(count < replaced) {
+            m_extents.erase(m_extents.begin() + index + count, m_extents.begin() + index + replaced);
+        }
+
+        // extents in the uniform run were only moved around if the change happened before it
+        if(index + replaced <= m_uniform_first && m_uniform_first < m_extents.size() + replaced - count) {
+            m_uniform_first = m_uniform_first + count - replaced;
+        }
+        else {
+            find_uniform_run();
+        }
+    }
+
+    void note_change(off_t start, off_t end) {
+
+        if(m_changed_start >= m_changed_end) {
+            m_changed_start = start;
+            m_changed_end = end;
+            return;
+        }
+
+        m_changed_start = std::min(m_changed_start, start);
+        m_changed_end = std::max(m_changed_end, end);
+    }
+
+    static bool continues(const extent& prev, const extent& e, off_t size) {
+        return e.m_start == prev.m_end && e.m_end - e.m_start == size;
+    }
+
+    /* the last extent was just appended: check whether it extends the uniform run */
+    void extend_uniform_run() {
+
+        const size_t n = m_extents.size();
+
+        if(n >= 2 && m_uniform_first < n - 1 && continues(m_extents[n - 2], m_extents[n - 1], m_uniform_size)) {
+            return;
+        }
+
+        m_uniform_first = n - 1;
+        m_uniform_size = m_extents.back().m_end - m_extents.back().m_start;
+    }
+
+    void find_uniform_run() {
+
+        if(m_extents.empty()) {
+            m_uniform_first = 0;
+            m_uniform_size = 0;
+            return;
+        }
+
+        size_t first = m_extents.size() - 1;
+        m_uniform_size = m_extents[first].m_end - m_extents[first].m_start;
+
+        while(first != 0 && continues(m_extents[first - 1], m_extents[first], m_uniform_size) && 
+              m_extents[first - 1].m_end - m_extents[first - 1].m_start == m_uniform_size) {
+            --first;
+        }
+
+        m_uniform_first = first;
+    }
+
+    std::vector<extent>     m_extents;          /*!< Extents sorted by offset */
+    size_t                  m_uniform_first;    /*!< First extent of the uniform run at the end */
+    off_t                   m_uniform_size;     /*!< Size of each extent in the uniform run */
+    off_t                   m_changed_start;    /*!< Start of the range changed since forget_changes() */
+    off_t                   m_changed_end;      /*!< End of the range changed since forget_changes() */
+}; // class extent_map
+
+
+/*! Immutable copy of an extent_map, for readers that don't take the lock its 
+ * writers use (see nvml::file::publish_segments()). 
+ *
+ * Extents are stored in chunks of up to ChunkSize that are shared with the 
+ * snapshot a new one is derived from: only the chunks overlapping the range 
+ * changed in between (and partially filled chunks next to it) are copied, 
+ * besides the array of chunk pointers. Deriving a snapshot thus costs 
+ * O(ChunkSize + size() / ChunkSize) after an append or an update of a few 
+ * extents, instead of the O(size()) of a full copy, which matters for files 
+ * made of many extents that are modified (and published) a little at a time. 
+ * Partially filled chunks are never next to each other, so there are at most 
+ * 2 * size() / ChunkSize + 1 of them.
+ *
+ * Finding an offset is a binary search over the chunks and then inside one; 
+ * indexing is O(log(size() / ChunkSize)).
+ */
+template <typename Value, size_t ChunkSize = 128>
+class extent_snapshot {
+
+public:
+    using extent = typename extent_map<Value>::extent;
+
+    extent_snapshot()
+        : m_size(0) { }
+
+    /*! Copy of 'map' */
+    explicit extent_snapshot(const extent_map<Value>& map)
+        : m_size(0) {
+        add_chunks(map.begin(), map.end());
+    }
+
+    /*! Copy of 'map' that shares what it can with 'base', an earlier copy 
+     * that only differs from it in 'changed' (see extent_map::changed_range()) */
+    extent_snapshot(const extent_map<Value>& map, const extent_snapshot& base, 
+                    std::pair<off_t, off_t> changed)
+        : m_size(0) {
+
+        const auto& chunks = base.m_chunks;
+
+        if(changed.first >= changed.second) {
+            m_chunks = chunks;
+            m_first = base.m_first;
+            m_size = base.m_size;
+            return;
+        }
+
+        // chunks that end before the change and those that start after it are kept
+        auto first = std::upper_bound(chunks.begin(), chunks.end(), changed.first, 
+                                      [](off_t off, const chunk_ptr& c) { return off < c->back().m_end; });
+        auto last = std::lower_bound(first, chunks.end(), changed.second, 
+                                     [](const chunk_ptr& c, off_t off) { return c->front().m_start < off; });
+
+        // unless they are partially filled and can be merged with what is rebuilt
+        if(first != chunks.begin() && (*std::prev(first))->size() < ChunkSize) {
+            --first;
+        }
+
+        if(last != chunks.end() && (*last)->size() < ChunkSize) {
+            ++last;
+        }
+
+        off_t start = changed.first;
+        off_t end = changed.second;
+
+        if(first != last) {
+            start = std::min(start, (*first)->front().m_start);
+            end = std::max(end, (*std::prev(last))->back().m_end);
+        }
+
+        m_chunks.reserve(chunks.size() + 1);
+        m_first.reserve(chunks.size() + 1);
+
+        for(auto it = chunks.begin(); it != first; ++it) {
+            add_chunk(*it);
+        }
+
+        add_chunks(std::upper_bound(map.begin(), map.end(), start, 
+                                    [](off_t off, const extent& e) { return off < e.m_end; }), 
+                   std::lower_bound(map.begin(), map.end(), end, 
+                                    [](const extent& e, off_t off) { return e.m_start < off; }));
+
+        for(auto it = last; it != chunks.end(); ++it) {
+            add_chunk(*it);
+        }
+    }
+
+    const extent& operator[](size_t index) const {
+        size_t c = std::upper_bound(m_first.begin(), m_first.end(), index) - m_first.begin() - 1;
+        return (*m_chunks[c])[index - m_first[c]];
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /*! Position of the extent containing 'offset', or size() if it's not mapped */
+    size_t index_of(off_t offset) const {
+
+        auto c = std::upper_bound(m_chunks.begin(), m_chunks.end(), offset, 
+                                  [](off_t off, const chunk_ptr& c) { return off < c->back().m_end; });
+
+        if(c == m_chunks.end()) {
+            return m_size;
+        }
+
+        auto it = std::upper_bound((*c)->begin(), (*c)->end(), offset, 
+                                   [](off_t off, const extent& e) { return off < e.m_end; });
+
+        if(it->m_start > offset) {
+            return m_size;
+        }
+
+        return m_first[c - m_chunks.begin()] + (it - (*c)->begin());
+    }
+
+private:
+    using chunk = std::vector<extent>;
+    using chunk_ptr = std::shared_ptr<const chunk>;
+
+    template <typename Iterator>
+    void add_chunks(Iterator first, Iterator last) {
+
+        while(first != last) {
+            size_t count = std::min((size_t) (last - first), ChunkSize);
+            add_chunk(std::make_shared<chunk>(first, first + count));
+            first += count;
+        }
+    }
+
+    void add_chunk(const chunk_ptr& c) {
+        m_chunks.push_back(c);
+        m_first.push_back(m_size);
+        m_size += c->size();
+    }
+
+    std::vector<chunk_ptr>  m_chunks;   /*!< Non-empty chunks of extents, sorted by offset */
+    std::vector<size_t>     m_first;    /*!< Position of the first extent of each chunk */
+    size_t                  m_size;     /*!< Number of extents */
+}; // class extent_snapshot
+
+} // namespace efsng
+
+#endif /* __EXTENT_MAP_H__ */
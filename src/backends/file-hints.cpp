@@ -0,0 +1,342 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include <sys/xattr.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "file-hints.h"
+
+namespace {
+
+const char* const s_names[] = {
+    "expected_size",
+    "access",
+    "tier",
+    "consistency",
+    "sealed"
+};
+
+const char* const s_patterns[] = {
+    "normal",
+    "sequential",
+    "random",
+    "strided"
+};
+
+const char* const s_levels[] = {
+    "relaxed",
+    "strict"
+};
+
+const char* const s_bools[] = {
+    "false",
+    "true"
+};
+
+/* find 'value' in 'table', returning its index or -1 */
+template <size_t N>
+int find(const char* const (&table)[N], const std::string& value) {
+    for(size_t i = 0; i < N; ++i) {
+        if(value == table[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* parse sizes such as "4096", "512M" or "64G" (binary multiples) */
+bool parse_size(const std::string& str, uint64_t& size) {
+
+    if(str.empty() || !isdigit(str[0])) {
+        return false;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long long n = strtoull(str.c_str(), &end, 10);
+
+    if(errno != 0) {
+        return false;
+    }
+
+    unsigned shift = 0;
+
+    switch(*end) {
+        case '\0':              break;
+        case 'k': case 'K':     shift = 10; ++end; break;
+        case 'm': case 'M':     shift = 20; ++end; break;
+        case 'g': case 'G':     shift = 30; ++end; break;
+        case 't': case 'T':     shift = 40; ++end; break;
+        default:                return false;
+    }
+
+    if(*end != '\0' || (shift != 0 && n > (UINT64_MAX >> shift))) {
+        return false;
+    }
+
+    size = (uint64_t) n << shift;
+    return true;
+}
+
+} // anonymous namespace
+
+namespace efsng {
+
+const char* const file_hints::xattr_prefix = "user.efs.";
+
+file_hints::file_hints()
+    : m_set(0),
+      m_expected_size(0),
+      m_access(access_pattern::normal),
+      m_consistency(consistency_level::relaxed),
+      m_sealed(false) { }
+
+bool file_hints::is_hint(const char* name) {
+    return strncmp(name, xattr_prefix, strlen(xattr_prefix)) == 0;
+}
+
+/* map an attribute name to its hint, or -1 if unknown */
+int file_hints::lookup(const char* name) {
+
+    if(!is_hint(name)) {
+        return -1;
+    }
+
+    int idx = find(s_names, name + strlen(xattr_prefix));
+
+    return idx < 0 ? -1 : 1 << idx;
+}
+
+std::string file_hints::tier() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tier;
+}
+
+bool file_hints::unseal() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sealed.exchange(false);
+}
+
+// precondition: 
+// - m_mutex locked
+std::string file_hints::to_string(unsigned h) const {
+
+    switch(h) {
+        case expected_size_hint:
+            return std::to_string(m_expected_size);
+        case access_hint:
+            return s_patterns[static_cast<int>(m_access.load())];
+        case tier_hint:
+            return m_tier;
+        case consistency_hint:
+            return s_levels[static_cast<int>(m_consistency.load())];
+        case sealed_hint:
+            return s_bools[m_sealed];
+        default:
+            return "";
+    }
+}
+
+int file_hints::set(const char* name, const char* value, size_t size, int flags) {
+
+    int h = lookup(name);
+
+    if(h < 0) {
+        return -EOPNOTSUPP;
+    }
+
+    std::string str(value, size);
+
+    // values set with setfattr(1) may carry a trailing NUL
+    if(!str.empty() && str.back() == '\0') {
+        str.pop_back();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if((flags & XATTR_CREATE) && (m_set & h)) {
+        return -EEXIST;
+    }
+
+    if((flags & XATTR_REPLACE) && !(m_set & h)) {
+        return -ENODATA;
+    }
+
+    switch(h) {
+        case expected_size_hint:
+        {
+            uint64_t n;
+
+            if(!parse_size(str, n)) {
+                return -EINVAL;
+            }
+
+            m_expected_size = n;
+            break;
+        }
+
+        case access_hint:
+        {
+            int idx = find(s_patterns, str);
+
+            if(idx < 0) {
+                return -EINVAL;
+            }
+
+            m_access = static_cast<access_pattern>(idx);
+            break;
+        }
+
+        case tier_hint:
+            if(str.empty() || str.find('\0') != std::string::npos) {
+                return -EINVAL;
+            }
+
+            m_tier = str;
+            break;
+
+        case consistency_hint:
+        {
+            int idx = find(s_levels, str);
+
+            if(idx < 0) {
+                return -EINVAL;
+            }
+
+            m_consistency = static_cast<consistency_level>(idx);
+            break;
+        }
+
+        case sealed_hint:
+        {
+            int idx = find(s_bools, str);
+
+            if(idx < 0) {
+                return -EINVAL;
+            }
+
+            m_sealed = (idx != 0);
+            break;
+        }
+    }
+
+    m_set |= h;
+
+    return 0;
+}
+
+ssize_t file_hints::get(const char* name, char* value, size_t size) const {
+
+    int h = lookup(name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(h < 0 || !(m_set & h)) {
+        return -ENODATA;
+    }
+
+    std::string str = to_string(h);
+
+    // size == 0 means that the caller only wants to know the size needed
+    if(size != 0) {
+        if(str.size() > size) {
+            return -ERANGE;
+        }
+
+        memcpy(value, str.data(), str.size());
+    }
+
+    return str.size();
+}
+
+ssize_t file_hints::list(char* list, size_t size) const {
+
+    std::string names;
+    unsigned set = m_set;
+
+    for(unsigned i = 0; i < s_num_hints; ++i) {
+        if(set & (1 << i)) {
+            names += xattr_prefix;
+            names += s_names[i];
+            names += '\0';
+        }
+    }
+
+    if(size != 0) {
+        if(names.size() > size) {
+            return -ERANGE;
+        }
+
+        memcpy(list, names.data(), names.size());
+    }
+
+    return names.size();
+}
+
+int file_hints::remove(const char* name) {
+
+    int h = lookup(name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(h < 0 || !(m_set & h)) {
+        return -ENODATA;
+    }
+
+    switch(h) {
+        case expected_size_hint:
+            m_expected_size = 0;
+            break;
+        case access_hint:
+            m_access = access_pattern::normal;
+            break;
+        case tier_hint:
+            m_tier.clear();
+            break;
+        case consistency_hint:
+            m_consistency = consistency_level::relaxed;
+            break;
+        case sealed_hint:
+            m_sealed = false;
+            break;
+    }
+
+    m_set &= ~h;
+
+    return 0;
+}
+
+} // namespace efsng
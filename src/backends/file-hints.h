@@ -0,0 +1,126 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __FILE_HINTS_H__
+#define __FILE_HINTS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+namespace efsng {
+
+/*! Performance hints attached to a file by applications or job scripts through 
+ * extended attributes in the "user.efs." namespace (e.g. with setfattr(1)):
+ *
+ *   user.efs.expected_size: expected final size of the file (e.g. "64G"), so that 
+ *                           storage can be allocated upfront
+ *   user.efs.access:        "sequential", "random", "strided" or "normal" 
+ *   user.efs.tier:          name of the preferred storage tier
+ *   user.efs.consistency:   "relaxed" (default) or "strict" (i.e. each write is 
+ *                           persistent by the time it completes)
+ *   user.efs.sealed:        "true" if the file won't be modified anymore (e.g. staged 
+ *                           inputs), so that backends can serve reads from a frozen 
+ *                           layout without any locking. Writes clear it
+ *
+ * Hints are advisory: backends are free to ignore them. They can be read and 
+ * modified concurrently, and reading them is cheap enough for the data paths.
+ */
+class file_hints {
+
+public:
+    enum class access_pattern {
+        normal,
+        sequential,
+        random,
+        strided
+    };
+
+    enum class consistency_level {
+        relaxed,
+        strict
+    };
+
+    static const char* const xattr_prefix; /*!< "user.efs." */
+
+    file_hints();
+
+    /*! Check whether 'name' is an extended attribute in the hints namespace */
+    static bool is_hint(const char* name);
+
+    /* extended attribute interface: these return the same values as 
+     * their system call counterparts, but with -errno on error */
+    int set(const char* name, const char* value, size_t size, int flags);
+    ssize_t get(const char* name, char* value, size_t size) const;
+    ssize_t list(char* list, size_t size) const;
+    int remove(const char* name);
+
+    /* accessors (unset hints return their defaults) */
+    uint64_t expected_size() const { return m_expected_size; }
+    access_pattern access() const { return m_access; }
+    consistency_level consistency() const { return m_consistency; }
+    std::string tier() const;
+    bool sealed() const { return m_sealed; }
+
+    /*! Clear the sealed hint (i.e. the file was written to), keeping it set to "false" 
+     * if it was set. Returns whether the file was sealed */
+    bool unseal();
+
+private:
+    enum hint : unsigned {
+        expected_size_hint  = 1 << 0,
+        access_hint         = 1 << 1,
+        tier_hint           = 1 << 2,
+        consistency_hint    = 1 << 3,
+        sealed_hint         = 1 << 4,
+    };
+
+    static const unsigned s_num_hints = 5;
+
+    static int lookup(const char* name);
+    std::string to_string(unsigned h) const;
+
+    std::atomic<unsigned>           m_set;           /*!< Hints explicitly set */
+    std::atomic<uint64_t>           m_expected_size; /*!< Expected final size (0 if unknown) */
+    std::atomic<access_pattern>     m_access;        /*!< Expected access pattern */
+    std::atomic<consistency_level>  m_consistency;   /*!< Consistency level requested */
+    std::atomic<bool>               m_sealed;        /*!< File won't be modified */
+    mutable std::mutex              m_mutex;         /*!< Serializes modifications (and protects m_tier) */
+    std::string                     m_tier;          /*!< Preferred tier */
+}; // class file_hints
+
+} // namespace efsng
+
+#endif /* __FILE_HINTS_H__ */
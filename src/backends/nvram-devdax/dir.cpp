@@ -47,12 +47,14 @@ namespace nvml_dev {
 /* class implementation                                                                                               */
 /**********************************************************************************************************************/
 dir::dir() 
-    : backend::dir() {
+    : backend::dir(),
+      m_next_offset(s_first_offset) {
 }
 
 dir::dir(const bfs::path& pathname, const ino_t inode, const bfs::path & path_original, dir::type type, bool populate) 
     : m_pathname(pathname),
-     m_type(type) {
+     m_type(type),
+     m_next_offset(s_first_offset) {
 
     if (populate) {
         posix::file fd(path_original);
@@ -79,7 +81,10 @@ dir::~dir() {
 }
 
 void dir::add_file (const std::string file) {
-        m_files.insert( file );
+        if (m_offsets.count(file) == 0) {
+            m_offsets.emplace(file, m_next_offset);
+            m_files.emplace(m_next_offset++, file);
+        }
         m_attributes_mutex.lock();
         m_attributes.st_nlink += 1;
         m_attributes.st_mtime = m_attributes.st_ctime = time (NULL);
@@ -90,7 +95,11 @@ void dir::add_file (const std::string file) {
 void dir::remove_file (const std::string file) {
   //  auto it = std::find(m_files.begin(), m_files.end(), file );
   //  if (it != m_files.end()) {
-        m_files.erase ( file );
+        auto it = m_offsets.find(file);
+        if (it != m_offsets.end()) {
+            m_files.erase(it->second);
+            m_offsets.erase(it);
+        }
         m_attributes_mutex.lock();
         m_attributes.st_nlink -= 1;
         m_attributes.st_mtime = m_attributes.st_ctime = time (NULL);
@@ -98,17 +107,16 @@ void dir::remove_file (const std::string file) {
    // }
 }
 
-void dir::list_files(std::list <std::string> & m_f) const {
-    for (const auto li : m_files){
-        m_f.push_back(li);
+void dir::list_files(off_t offset, const list_callback& fn) const {
+    for (auto it = m_files.upper_bound(offset); it != m_files.end(); ++it) {
+        if (!fn(it->second, it->first)) {
+            break;
+        }
     }
 }
 
-bool dir::find (const std::string fname,std::unordered_set < std::string >::iterator &it) const {
-    // We should better do a map but for now...
-
-    it =  m_files.find(fname);
-    return (it != m_files.end());
+bool dir::find (const std::string fname) const {
+    return m_offsets.count(fname) != 0;
 }
 
 unsigned int dir::num_links() const {
@@ -40,7 +40,8 @@
 #include "backend-base.h"
 #include "file.h"
 #include <fuse.h>
-#include <unordered_set>
+#include <map>
+#include <unordered_map>
 
 namespace bfs = boost::filesystem;
 
@@ -55,11 +56,11 @@ struct dir : public backend::dir {
   
     dir();
     dir(const bfs::path& pathname, const ino_t inode, const bfs::path & path_original, dir::type type=dir::type::persistent, bool populate=true);
-    void list_files(std::list <std::string> & m_files) const;
+    void list_files(off_t offset, const list_callback& fn) const;
     ~dir();
     void add_file (const std::string fname);
     void remove_file (const std::string fname);
-    bool find (const std::string fname, std::unordered_set < std::string >::iterator & it) const;
+    bool find (const std::string fname) const;
     unsigned int num_links () const;
     void stat(struct stat& stbuf) const;
     void save_attributes(struct stat & stbuf) override;    /* Saves attributes of the directory */
@@ -70,7 +71,11 @@ private:
        for the standard ls and a pointer to the file for the ls -ltrh optimization */
     bfs::path m_pathname;
     dir::type m_type;
-    mutable std::unordered_set < std::string > m_files; // TODO : Mutex
+    std::map < off_t, std::string > m_files; // TODO : Mutex
+    /* offset of each entry in m_files */
+    std::unordered_map < std::string, off_t > m_offsets;
+    /* offset for the next entry added */
+    off_t m_next_offset;
 
     mutable boost::shared_mutex m_attributes_mutex;
     struct stat m_attributes; /*!< Dir attributes */
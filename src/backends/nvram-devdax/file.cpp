@@ -33,6 +33,7 @@
 
 #include <libpmem.h>
 #include <fstream>
+#include <iostream>
 
 #include "fuse_buf_copy_pmem.h"
 #include <nvram-devdax/file.h>
@@ -41,15 +42,15 @@
 
 #if defined(__EFS_DEBUG__) && defined(__PRINT_TREE__)
 namespace {
-void print_tree(const efsng::nvml_dev::segment_tree& tree) {
+void print_tree(const efsng::nvml_dev::segment_map& tree) {
 
     std::cerr << "tree {\n";
 
     for(auto it = tree.begin(); it != tree.end(); ++it) {
 
-        const auto& sptr = it->second;
+        const auto& sptr = it->m_value;
 
-        std::cerr << it->first << " -> ";
+        std::cerr << it->m_start << " -> ";
 
         if(sptr != nullptr) {
             std::cerr << *sptr << "\n";
@@ -73,7 +74,6 @@ namespace nvml_dev {
 file::file() 
     : backend::file(),
       m_segment_size(4096),
-      m_segments(0, std::numeric_limits<off_t>::max(), segment_ptr()),
       m_initialized(false)    {
 }
 
@@ -83,7 +83,6 @@ file::file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t in
       m_alloc_offset(0),
       m_used_offset(0),
       m_segment_size(4096),
-      m_segments(0, std::numeric_limits<off_t>::max(), segment_ptr()),
       m_initialized(false) {
 
       m_pool_subdir = pool_base;
@@ -113,8 +112,6 @@ file::file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t in
 
         save_attributes(stbuf);
         m_initialized = true;
-    } else {
-        m_segments.build_tree();
     }
 }
 
@@ -230,11 +227,9 @@ segment_ptr file::create_segment(off_t base_offset, size_t size, bool is_gap) {
 void file::append_segments(const segment_list& segments) {
 
     for(const auto sptr : segments) {
-        m_segments.insert_back(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
+        m_segments.assign(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
     }
 
-    m_segments.build_tree();
-
 #if defined(__EFS_DEBUG__) && defined(__PRINT_TREE__)
     print_tree(m_segments);
 #endif
@@ -244,11 +239,9 @@ void file::append_segments(const segment_list& segments) {
 void file::insert_segments(const segment_list& segments) {
 
     for(const auto sptr : segments) {
-        m_segments.insert_front(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
+        m_segments.assign(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
     }
 
-    m_segments.build_tree();
-
 #if defined(__EFS_DEBUG__) && defined(__PRINT_TREE__)
     print_tree(m_segments);
 #endif
@@ -265,17 +258,14 @@ void file::fetch_storage(off_t offset, size_t size, file_region_list& regions) {
     }
 
     assert(offset <= (off_t) (offset + size));
-    assert(m_segments.is_tree_valid());
 
     // the append may affect several already existing segments: add them to *regions*
     if(offset < m_alloc_offset) {
         lookup_segments(offset, m_alloc_offset, regions);
     }
 
-    // the last (valid) physical segment should start at *m_alloc_offset*
-    // and contain a *nullptr*
-    assert((*++m_segments.rbegin()).first == m_alloc_offset);
-    assert((*++m_segments.rbegin()).second == nullptr);
+    // segments should cover the file up to *m_alloc_offset*
+    assert(m_segments.end_offset() == m_alloc_offset);
     m_segment_size = std::min (m_segment_size*2, nvml_dev::segment::s_segment_size);
     off_t new_segment_offset = (offset <= m_alloc_offset ?  m_alloc_offset : 
             efsng::align(offset, m_segment_size));
@@ -311,7 +301,6 @@ void file::lookup_segments(off_t range_start, off_t range_end, file_region_list&
 
     assert(range_start >= 0);
     assert(range_start <= range_end);
-    assert(m_segments.is_tree_valid());
 
     lookup_helper(range_start, range_end, /*alloc_gaps_as_needed=*/true, regions);
 
@@ -321,7 +310,6 @@ void file::lookup_data(off_t range_start, off_t range_end, file_region_list& reg
 
     assert(range_start >= 0);
     assert(range_start <= range_end);
-    assert(m_segments.is_tree_valid());
 
     if(range_end > m_used_offset) {
         range_end = m_used_offset;
@@ -339,39 +327,30 @@ void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_
         return;
     }
 
-    segment_ptr sptr;
-    auto res = m_segments.search_tree(range_start, sptr);
-
-    // range_start must exist, since the segment tree covers from 0 to 
-    // std::numeric_limits<off_t>::max(). Also, if a non-allocated offset 
-    // is accessed, the associated segment will be nullptr
-    assert(res.second == true);
-
-    segment_tree::const_iterator& it = res.first;
+    // offsets beyond the allocated part of the file are not found
+    size_t pos = m_segments.find(range_start) - m_segments.begin();
 
-    do {
-        const auto& s = it->second;
-
-        // out of allocated file
-        if(s == nullptr) {
-            return;
-        }
+    // (the map may change while we walk it, so segments are tracked by position and 
+    // the one at hand is only kept alive by the map itself)
+    while(pos < m_segments.size()) {
+        segment* s = m_segments[pos].m_value.get();
 
         off_t s_start = s->m_offset;
         off_t s_end = s_start + s->m_size;
         off_t op_delta = range_start - s_start;
 
-        // this should be guaranteed by search_tree
+        // this should be guaranteed by find()
         assert(op_delta != (off_t) s->m_size);
 
         ssize_t op_size = std::min({(ssize_t) req_size,
                                     (ssize_t) s->m_size - op_delta});
 
         if(alloc_gaps_as_needed && s->m_is_gap) {
-            off_t seg_offset = efsng::align(range_start, segment::s_segment_size);
-            size_t seg_size = (range_start + req_size < s->m_offset + s->m_size) ?
-                efsng::xalign(range_start + req_size, segment::s_segment_size) - seg_offset :
-                s->m_offset + s->m_size - seg_offset;
+            // gaps left by punch_hole() need not be aligned to s_segment_size: 
+            // never allocate beyond the gap itself
+            off_t seg_offset = std::max(efsng::align(range_start, segment::s_segment_size), s_start);
+            size_t seg_size = std::min(efsng::xalign(range_start + req_size, segment::s_segment_size), s_end) - 
+                              seg_offset;
 
             segment_list sl;
 
@@ -398,6 +377,9 @@ void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_
             }
 
             insert_segments(sl);
+
+            // s now covers [seg_offset, seg_offset + seg_size) (which includes range_start)
+            pos = m_segments.find(range_start) - m_segments.begin();
         }
 
         data_ptr_t s_addr = s->m_is_gap ? 
@@ -412,8 +394,12 @@ void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_
 
         range_start = s_end;
         req_size -= op_size;
-        ++it;
-    } while(true);
+
+        // the next segment must start right where this one ends
+        if(++pos < m_segments.size() && m_segments[pos].m_start != s_end) {
+            return;
+        }
+    }
 }
 
 
@@ -426,11 +412,28 @@ bfs::path file::generate_pool_subdir(const bfs::path& pool_base, const bfs::path
 }
 
 
-ssize_t file::get_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+/* a view that keeps its file range read-locked while alive, which prevents 
+ * truncate() from unmapping the segments that it points into */
+class file::pinned_view : public backend::data_view {
+
+public:
+    pinned_view(file* parent, off_t start, off_t end)
+        : m_parent(parent),
+          m_rl(parent->lock_range(start, end, efsng::operation::read)) { }
+
+    ~pinned_view() {
+        m_parent->unlock_range(m_rl);
+    }
+
+private:
+    file* m_parent;
+    lock_manager::range_lock m_rl;
+};
+
+ssize_t file::map_data(off_t start_offset, size_t size, backend::data_view_ptr& view, cursor* cur) {
+
+    (void) cur; // devdax files don't keep per-handle cursors
 
-    size_t n = 0;
-    ssize_t rv = 0;
-    void* buffer = NULL;
     off_t end_offset = start_offset + size;
 
     assert(start_offset < end_offset);
@@ -442,7 +445,7 @@ ssize_t file::get_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse
     }
    
 //XXX if posix_consistency:
-    auto rl = lock_range(start_offset, end_offset, efsng::operation::read);
+    std::unique_ptr<pinned_view> pv(new pinned_view(this, start_offset, end_offset));
 
     m_alloc_mutex.lock_shared();
 
@@ -450,76 +453,79 @@ ssize_t file::get_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse
 
     m_alloc_mutex.unlock_shared();
 
-    if(regions.count() == 0) {
-        fuse_buffer->buf[0].flags = (fuse_buf_flags) (~FUSE_BUF_IS_FD);
-        fuse_buffer->buf[0].mem = NULL;
-        fuse_buffer->buf[0].size = 0;
-
-        rv = 0;
-        goto unlock_and_return;
-    }
-
- #ifndef __TEST_FUSE_READBUF_PATCH__
-    /* the FUSE interface forces us to allocate a buffer using malloc() and 
-    * memcpy() the requested data in order to return it back to the user. meh */
-    buffer = (void*) malloc(regions.total_size());
-
-    if(posix_memalign(&buffer, 512, regions.total_size()) != 0) {
-        rv = -ENOMEM;
-        goto unlock_and_return;
-    }
-
-    if(buffer == NULL) {
-        rv = -ENOMEM;
-        goto unlock_and_return;
-    }
-#endif // __TEST_FUSE_READBUF_PATCH__
-
     for(const auto& r : regions) {
         efsng::data_ptr_t data = r.m_address;
         size_t size = r.m_size;
 
         if(data != NULL) {
-#ifndef __TEST_FUSE_READBUF_PATCH__
-            memcpy((void*) ((uintptr_t)buffer + n), (void*) data, size);
-#else
-            buffer = data;
-#endif // __TEST_FUSE_READBUF_PATCH__
+            pv->add(data, size);
 
             LOGGER_TRACE("nvml_read:{}:{}:{}:{}", 
                     fuse_get_context()->pid, syscall(__NR_gettid), 
                     data, size);
         }
         else {
-            memset((void*) ((uintptr_t)buffer + n), 0, size);
+            pv->add_zeroes(size);
 
             LOGGER_TRACE("nvml_read:{}:{}:0x0:{}", 
                     fuse_get_context()->pid, syscall(__NR_gettid), 
                     size);
         }
+    }
+
+    assert(pv->size() == regions.total_size());
+
+    view = std::move(pv);
+
+    return 0;
+}
+
+ssize_t file::get_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer) {
 
-        n += size;
+    size_t n = 0;
+    void* buffer = NULL;
+    backend::data_view_ptr view;
+
+    ssize_t rv = map_data(start_offset, size, view);
+
+    if(rv < 0) {
+        return rv;
     }
 
-    assert(n == regions.total_size());
+    fuse_buffer->buf[0].flags = (fuse_buf_flags) 0;
+    fuse_buffer->buf[0].mem = NULL;
+    fuse_buffer->buf[0].size = 0;
 
-    fuse_buffer->buf[0].flags = (fuse_buf_flags) (~FUSE_BUF_IS_FD);
-    fuse_buffer->buf[0].mem = buffer;
-    fuse_buffer->buf[0].size = regions.total_size();
+    if(view->size() == 0) {
+        return 0;
+    }
 
+    /* callers of get_data() (e.g. the high-level FUSE API) free() the buffers
+     * they get back, so we can't hand them our mappings: copy the data */
+    if(posix_memalign(&buffer, 512, view->size()) != 0) {
+        return -ENOMEM;
+    }
 
-unlock_and_return:
-//XXX if posix_consistency:
-    unlock_range(rl);
+    const struct fuse_bufvec* src = view->bufvec();
+
+    for(size_t i = 0; i < src->count; ++i) {
+        memcpy((void*) ((uintptr_t)buffer + n), src->buf[i].mem, src->buf[i].size);
+        n += src->buf[i].size;
+    }
+
+    fuse_buffer->buf[0].mem = buffer;
+    fuse_buffer->buf[0].size = n;
 
-    return rv;
+    return 0;
 }
 
 #ifdef __TEST_STATIC_BUFFER__
 char global_buffer[8*1024*1024];
 #endif // __TEST_STATIC_BUFFER__
 
-ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur) {
+
+    (void) cur; // devdax files don't keep per-handle cursors
 
 #ifdef __TEST_SINGLE_BUFFER_WRITES__
 
@@ -618,7 +624,7 @@ ssize_t file::append_data(off_t start_offset, size_t size, struct fuse_bufvec* f
     return 0;
 }
 
-ssize_t file::allocate(off_t start_offset, size_t size){
+ssize_t file::allocate(off_t start_offset, size_t size, bool keep_size){
      
     
     if (!m_initialized){
@@ -632,7 +638,9 @@ ssize_t file::allocate(off_t start_offset, size_t size){
         // this will allocate any additional segments required
         fetch_storage(start_offset, size, regions);
     }
-    update_size(start_offset+size);
+    if(!keep_size) {
+        update_size(start_offset+size);
+    }
     m_alloc_mutex.lock();
     m_attributes.st_ctime = time(NULL);
     m_alloc_mutex.unlock();
@@ -643,15 +651,97 @@ ssize_t file::allocate(off_t start_offset, size_t size){
     return 0;
 }
 
+ssize_t file::punch_hole(off_t start_offset, size_t size) {
+
+    if(size == 0) {
+        return 0;
+    }
+
+    off_t end_offset = start_offset + size;
+
+    // as in truncate(), segments may be released: keep writers out while we do it
+    m_dealloc_mutex.lock();
+    auto rl = lock_range(start_offset, end_offset, efsng::operation::write);
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+        // nothing is allocated beyond m_alloc_offset
+        end_offset = std::min(end_offset, m_alloc_offset);
+
+        for(off_t offset = start_offset; offset < end_offset; ) {
+
+            segment_ptr sptr = m_segments.lookup(offset);
+
+            if(sptr == nullptr) {
+                break;
+            }
+
+            off_t s_start = sptr->m_offset;
+            off_t s_end = s_start + sptr->m_size;
+
+            if(!sptr->m_is_gap) {
+                // segments entirely in the hole go back to the device pool, 
+                // the ones at its edges keep their storage
+                if(start_offset <= s_start && s_end <= end_offset) {
+                    sptr->deallocate();
+                }
+                else {
+                    sptr->zero_fill(offset - s_start, std::min(s_end, end_offset) - offset);
+                }
+            }
+
+            offset = s_end;
+        }
+
+        m_attributes.st_ctime = time(NULL);
+    }
+
+    unlock_range(rl);
+    m_dealloc_mutex.unlock();
+
+    return 0;
+}
+
+ssize_t file::zero_range(off_t start_offset, size_t size, bool keep_size) {
+
+    ssize_t rv = punch_hole(start_offset, size);
+
+    if(rv != 0 || keep_size) {
+        return rv;
+    }
+
+    off_t end_offset = start_offset + size;
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+        // reads stop at the first unallocated offset: describe the extension as 
+        // a gap so that it reads back as zeroes without taking up any storage
+        if(end_offset > m_alloc_offset) {
+            off_t gap_end = efsng::xalign(end_offset - 1, NVML_TRANSFER_SIZE);
+            append_segments({create_segment(m_alloc_offset, gap_end - m_alloc_offset, /*is_gap=*/true)});
+            m_alloc_offset = gap_end;
+        }
+    }
+
+    update_size(end_offset);
+
+    return 0;
+}
 
 void file::change_type(file::type type){
     m_type = type;
 }
 
-void file::truncate(off_t end_offset) {
+int file::truncate(off_t end_offset) {
 
     if ((unsigned)end_offset > (unsigned)size() ) { 
-        allocate( 0, end_offset);
+        ssize_t rv = allocate( 0, end_offset);
+
+        if(rv < 0) {
+            return rv;
+        }
     }
     else {
     
@@ -663,7 +753,7 @@ void file::truncate(off_t end_offset) {
          bool cut = false;
          for(auto it = m_segments.begin(); it != m_segments.end(); ++it) {
 
-            const auto& sptr = it->second;
+            const auto& sptr = it->m_value;
 
             if(sptr != nullptr) {
                 //std::cerr << *sptr << "\n";
@@ -677,9 +767,8 @@ void file::truncate(off_t end_offset) {
                         }
                         else {
                            // std::cout << " DROP SEGMENT " << size - end_offset << std::endl;
-                            pmem_unmap(sptr->m_pool.m_data, sptr->m_pool.m_length);
-                            sptr->m_pool.m_data = NULL;
-                            sptr->m_is_gap = 1;
+                            // (segments are carved out of the device mapping: give them back rather than unmapping them)
+                            sptr->deallocate();
                         }
                 }
             }
@@ -696,6 +785,8 @@ void file::truncate(off_t end_offset) {
     unlock_range(rl);
         m_dealloc_mutex.unlock();
     }
+
+    return 0;
 }
 
 
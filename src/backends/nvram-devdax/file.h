@@ -38,7 +38,7 @@
 
 #include <efs-common.h>
 #include <nvram-devdax/segment.h>
-#include <mdds/flat_segment_tree.hpp>
+#include <extent-map.h>
 #include <range_lock.h>
 #include "backend-base.h"
 #include <fuse.h>
@@ -50,7 +50,7 @@ namespace efsng {
 namespace nvml_dev {
 
 using segment_ptr = std::shared_ptr<segment>;
-using segment_tree = mdds::flat_segment_tree<off_t, segment_ptr>;
+using segment_map = extent_map<segment_ptr>;
 using segment_list = std::vector<segment_ptr>;
 
 /* a contiguous file region */
@@ -100,15 +100,20 @@ struct file : public backend::file {
     void stat(struct stat& stbuf) const override;
 
     ssize_t get_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer);
-    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer);
+    ssize_t map_data(off_t offset, size_t size, backend::data_view_ptr& view, cursor* cur = nullptr) override;
+    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur = nullptr) override;
     ssize_t append_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer);
-    void truncate(off_t offset) override;
-    ssize_t allocate (off_t offset, size_t size) override;
+    int truncate(off_t offset) override;
+    ssize_t allocate (off_t offset, size_t size, bool keep_size = false) override;
+    ssize_t punch_hole(off_t offset, size_t size) override;
+    ssize_t zero_range(off_t offset, size_t size, bool keep_size) override;
     void save_attributes(struct stat& stbuf) override;
     int unload (const std::string dump_path) override;
     void change_type (file::type type) override;
 private:
 
+    class pinned_view;
+
     size_t size() const;
     void update_size(size_t size);
     
@@ -138,7 +143,7 @@ private:
     
     uint64_t m_segment_size; /*!< Last segment size used */
     
-    segment_tree                m_segments;
+    segment_map                 m_segments;
     std::atomic<bool> m_initialized; /*!< segments initialized ? */
     mutable boost::shared_mutex m_initialized_mutex;
     mutable boost::shared_mutex m_alloc_mutex; /*!< Mutex to synchronize reader/writer access to the tree */
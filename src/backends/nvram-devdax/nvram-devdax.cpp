@@ -68,7 +68,8 @@ namespace nvml_dev {
 nvml_devdax_backend::nvml_devdax_backend(uint64_t capacity, bfs::path daxfs_mount, bfs::path root_dir, int64_t segment_size)
     : m_capacity(capacity),
       m_daxfs_mount_point(daxfs_mount),
-      m_root_dir(root_dir) {
+      m_root_dir(root_dir),
+      i_inode(1) {
     // Insert the root dir into the map
 
     if(segment_size != -1) {
@@ -77,6 +78,7 @@ nvml_devdax_backend::nvml_devdax_backend(uint64_t capacity, bfs::path daxfs_moun
 
     std::lock_guard<std::mutex> lock(m_dirs_mutex);
     m_dirs.emplace("/", std::make_unique<nvml_dev::dir>("/",new_inode(), m_root_dir));
+    m_usage.m_dirs = m_dirs.size();
 }
 
 nvml_devdax_backend::~nvml_devdax_backend(){
@@ -126,6 +128,7 @@ error_code nvml_devdax_backend::load(const bfs::path& pathname, backend::file::t
      * the contents of the pathname) */
      auto it = m_files.emplace(path_wo_root, 
                               std::make_unique<nvml_dev::file>(m_daxfs_mount_point, pathname, new_inode(), type));
+     m_usage.m_files = m_files.size();
   
 
     // Iterate the path to fill the info
@@ -149,6 +152,7 @@ error_code nvml_devdax_backend::load(const bfs::path& pathname, backend::file::t
         //td::cout << "IMPORTING " << buildPath << " d_it==m_dirs.end() " << (bool)(d_it==m_dirs.end()) << std::endl;
         if (d_it == m_dirs.end()){
             m_dirs.emplace(buildPath, std::make_unique<nvml_dev::dir>(buildPath,new_inode(), m_root_dir.string()+buildPath));
+            m_usage.m_dirs = m_dirs.size();
             // Add to the parent
             parent = m_dirs.find(buildPath.substr(0,buildPath.rfind(m_path[i])));
             parent->second.get()->add_file(m_path[i]);
@@ -247,31 +251,69 @@ bool nvml_devdax_backend::exists(const char* pathname) const {
     return it != m_files.end();
 }
 
-// TODO: Error control
 int nvml_devdax_backend::do_readdir (const char * path, void * buffer, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi) const {
-    (void) offset;
     (void) fi;
-    LOGGER_DEBUG("Inside backend readdir for {}", path);
+    LOGGER_DEBUG("Inside backend readdir for {} (offset {})", path, offset);
+
+    /* pass each entry to the filler along with its attributes, so that 
+     * listing a directory does not need a stat() for every entry */
+    auto fill = [&](const char* name, const struct stat* stbuf, off_t off) -> bool {
     #if FUSE_USE_VERSION < 30
-	filler(buffer, ".", NULL, 0);
-	filler(buffer, "..", NULL, 0);
+        return filler(buffer, name, stbuf, off) == 0;
     #else
-	filler(buffer,".", NULL,0,(fuse_fill_dir_flags)0);
-	filler(buffer,"..", NULL,0,(fuse_fill_dir_flags)0);
+        return filler(buffer, name, stbuf, off, FUSE_FILL_DIR_PLUS) == 0;
     #endif
-    std::list <std::string> ls = find_s(path);
-    
-    for (auto &file : ls) {    
-        if (file.length() > 0 and file[file.length()-1]=='/') { 
+    };
+
+    // same locking order as do_stat()
+    std::lock_guard<std::mutex> lock(m_files_mutex);
+    std::lock_guard<std::mutex> lock_dir(m_dirs_mutex);
+
+    // Only the root path is send with /. We add the slash at the end if not.
+    std::string dir_path = path;
+    if (dir_path.length() == 0 or dir_path.back() != '/') 
+        dir_path.push_back('/');
+
+    auto d_it = m_dirs.find(dir_path);
+    if (d_it == m_dirs.end()) {
+        return -ENOENT;
+    }
+
+    struct stat stbuf;
+    d_it->second->stat(stbuf);
+
+    if (offset < 1 and !fill(".", &stbuf, 1)) {
+        return 0;
+    }
+
+    if (offset < 2 and !fill("..", NULL, 2)) {
+        return 0;
+    }
+
+    d_it->second->list_files(offset, [&](const std::string& entry, off_t off) -> bool {
+        std::string name = entry;
+        if (name.length() > 0 and name.back() == '/') { 
             // We remove the last slash
-            file.pop_back();
+            name.pop_back();
         }
-	#if FUSE_USE_VERSION < 30
-		filler(buffer, file.c_str(), NULL, 0);
-	#else
-		filler(buffer, file.c_str(), NULL, 0, (fuse_fill_dir_flags)0);
-	#endif
-    }
+
+        std::string child = dir_path + name;
+
+        auto file = m_files.find(child);
+        if (file != m_files.end()) {
+            file->second->stat(stbuf);
+            return fill(name.c_str(), &stbuf, off);
+        }
+
+        auto dir = m_dirs.find(child + "/");
+        if (dir != m_dirs.end()) {
+            dir->second->stat(stbuf);
+            return fill(name.c_str(), &stbuf, off);
+        }
+
+        return fill(name.c_str(), NULL, off);
+    });
+
     return 0;
 }
 
@@ -349,6 +391,7 @@ int nvml_devdax_backend::do_create(const char* pathname, mode_t mode, std::share
      * the contents of the pathname) */
     auto it = m_files.emplace(path_wo_root, 
                               std::make_unique<nvml_dev::file>(m_daxfs_mount_point, pathname, 0 ,file::type::temporary,false));
+    m_usage.m_files = m_files.size();
 
     stbuf.st_ino = new_inode();
     auto& file_ptr = (*(it.first)).second;
@@ -370,6 +413,7 @@ int nvml_devdax_backend::do_unlink(const char * pathname) {
     if (file != m_files.end()) {
         //const auto& file_ptr = file->second;
         m_files.erase(file);
+        m_usage.m_files = m_files.size();
     } 
     else { 
         LOGGER_DEBUG("do_unlink not found file {}",pathname); 
@@ -408,6 +452,7 @@ int nvml_devdax_backend::do_renamedir(std::string opath, std::string npath)
         dir->second.get()->save_attributes(stbuf);
         std::swap(m_dirs[npath], dir->second);
         m_dirs.erase(dir);
+        m_usage.m_dirs = m_dirs.size();
 
     }
 
@@ -451,6 +496,7 @@ int nvml_devdax_backend::do_rename(const char * oldpath, const char * newpath) {
         if (file != m_files.end()) {
         const auto& file_ptr = file->second;
         m_files.erase(file);
+        m_usage.m_files = m_files.size();
         }
         std::string path_wo_root_slash = path.substr(0,path.rfind('/')+1);
         if (path_wo_root_slash.size() == 0 or path_wo_root_slash.back() != '/')    path_wo_root_slash.push_back('/');
@@ -478,6 +524,7 @@ int nvml_devdax_backend::do_rename(const char * oldpath, const char * newpath) {
     // remove old file
 
     m_files.erase(file); // Check: pointer should not be deleted...
+    m_usage.m_files = m_files.size();
     
     // Now we should update directory
 
@@ -515,6 +562,7 @@ int nvml_devdax_backend::do_mkdir(const char * pathname, mode_t mode) {
 
 
         auto it = m_dirs.emplace(path_wo_root, std::make_unique<nvml_dev::dir>(path_wo_root, new_inode(), m_root_dir.string() + path_wo_root,dir::type::temporary,false));
+        m_usage.m_dirs = m_dirs.size();
 
         struct stat stbuf;
         it.first->second.get()->stat(stbuf);
@@ -565,6 +613,7 @@ int nvml_devdax_backend::do_rmdir(const char * pathname) {
         }
 
         m_dirs.erase(dir); 
+        m_usage.m_dirs = m_dirs.size();
         
 
         path_wo_root.pop_back();
@@ -658,29 +707,6 @@ backend::iterator nvml_devdax_backend::find(const char* path) {
     return m_files.find(path);
 }
 
-std::list <std::string> nvml_devdax_backend::find_s(const std::string path) const {
-    std::string result;
-
-    std::list <std::string> l_files;
-    std::lock_guard<std::mutex> lock(m_dirs_mutex);
-
-    // Only the root path is send with /. We add the slash at the end if not.
-    std::string tmp_path = path;
-    std::size_t slash = tmp_path.rfind("/");
-    if (slash != tmp_path.length()-1) 
-        tmp_path.push_back('/');
-
-    auto d_it = m_dirs.find(tmp_path);
-    LOGGER_DEBUG("FIND_S {}",tmp_path);
-    if (d_it != m_dirs.end()) {
-        // Search the path and insert it on the dir structure
-        // TODO: The dir structure will have a list with pointers to the nvml_dev::file so we reduce one indirection.
-        d_it->second.get()->list_files(l_files);  // Store the substr
-    }
-
-    return l_files;
-}
-
 void nvml_devdax_backend::do_change_type(const char * path, backend::file::type  type){
 	auto file = m_files.find(remove_root(path));
 	if ( file != m_files.end() ){
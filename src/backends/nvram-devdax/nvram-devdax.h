@@ -106,10 +106,9 @@ private:
     mutable std::mutex m_dirs_mutex;
     std::unordered_map<std::string, dir_ptr> m_dirs;
     
+    /* next inode number to hand out (the root dir gets 1, i.e. FUSE_ROOT_ID) */
     mutable std::atomic<ino_t> i_inode;
 
-    std::list <std::string> find_s(const std::string path) const;
-
     // Utils
     std::string remove_root (std::string path) const;
     int do_renamedir(std::string opath, std::string npath);
@@ -72,13 +72,22 @@ int big_pool::init (const bfs::path & subdir, size_t length) {
     std::lock_guard<std::mutex> lock_allocate(m_allocate_mutex);
     m_size_of_segment = segment::s_segment_size;
     m_fd = open(subdir.c_str(), O_RDWR);
-    std::cerr << " FD Result for open " << m_fd << std::endl;
+
+    if(m_fd == -1) {
+        LOGGER_ERROR("Error opening DAX device {}: {}", subdir, strerror(errno));
+    }
+
      //  std::min(length / NVML_MAPPINGS, s_segment_size); // 4 KB is the minimum:
     m_NVML_MAPPINGS = length / m_size_of_segment;
     m_address = mmap(NULL,m_length, PROT_READ|PROT_WRITE, MAP_SHARED,
               m_fd, 0);
 
-    std::cerr << "MMAP result " << m_address << " - " << errno << " - " << strerror (errno) << std::endl;
+    if(m_address == MAP_FAILED) {
+        LOGGER_ERROR("Error mapping DAX device {}: {}", subdir, strerror(errno));
+    }
+    else {
+        LOGGER_DEBUG("Mapped {} bytes of DAX device {} at {}", m_length, subdir, m_address);
+    }
 
     m_init = true;
 	return 0;
@@ -231,8 +240,11 @@ void segment::allocate(off_t offset, size_t size) {
     m_pool.allocate(size);
 }
 
+/* turn the segment back into a gap, returning its blocks to the device pool */
 void segment::deallocate(){
     m_pool.deallocate();
+    m_is_gap = true;
+    m_bytes = 0;
 }
 
 void segment::sync_all() {
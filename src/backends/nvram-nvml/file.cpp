@@ -32,7 +32,10 @@
 
 
 #include <libpmem.h>
+#include <sys/mman.h>
 #include <fstream>
+#include <iostream>
+#include <mutex>
 
 #include "fuse_buf_copy_pmem.h"
 #include <nvram-nvml/file.h>
@@ -41,15 +44,15 @@
 
 #if defined(__EFS_DEBUG__) && defined(__PRINT_TREE__)
 namespace {
-void print_tree(const efsng::nvml::segment_tree& tree) {
+void print_tree(const efsng::nvml::segment_map& tree) {
 
     std::cerr << "tree {\n";
 
     for(auto it = tree.begin(); it != tree.end(); ++it) {
 
-        const auto& sptr = it->second;
+        const auto& sptr = it->m_value;
 
-        std::cerr << it->first << " -> ";
+        std::cerr << it->m_start << " -> ";
 
         if(sptr != nullptr) {
             std::cerr << *sptr << "\n";
@@ -67,23 +70,69 @@ void print_tree(const efsng::nvml::segment_tree& tree) {
 namespace efsng {
 namespace nvml {
 
+/* how data has to be copied into the region 'r' (see copy_memory()) */
+static memory_kind region_kind(const file_region& r) {
+    return !r.m_is_pmem ? memory_kind::dram : 
+           segment::s_auto_flush ? memory_kind::dax : memory_kind::pmem;
+}
+
+/* remembers where the last lookup made through a file handle ended, so that 
+ * sequential accesses can skip searching the segment tree */
+struct file::segment_cursor : public backend::file::cursor {
+
+    segment_cursor() 
+        : m_valid(false),
+          m_version(0),
+          m_index(0) { }
+
+    std::mutex                      m_mutex;    /*!< Cursors may be shared by concurrent operations */
+    bool                            m_valid;    /*!< m_index refers to a segment */
+    uint64_t                        m_version;  /*!< Version of the map that m_index belongs to */
+    size_t                          m_index;    /*!< Position in the map of the last segment accessed */
+};
+
+/* the extents of a sealed file, frozen into a flat array that reads can search 
+ * without taking any lock or looking at the segment map (see update_seal()) */
+struct file::sealed_layout {
+
+    struct extent {
+        off_t       m_start;
+        off_t       m_end;
+        data_ptr_t  m_address;  /*!< Data of the extent (NULL for gaps) */
+        pool*       m_pool;     /*!< Pool backing the extent (NULL for gaps) */
+    };
+
+    std::vector<extent>     m_extents;  /*!< Sorted and contiguous, from offset 0 up to m_size */
+    off_t                   m_size;     /*!< Size of the file when it was sealed */
+    segment_list            m_segments; /*!< Keep the extents' storage around while readers may use it */
+};
+
 /**********************************************************************************************************************/
 /* class implementation                                                                                               */
 /**********************************************************************************************************************/
 file::file() 
     : backend::file(),
+      m_allocated(nullptr),
+      m_splice_reads(false),
       m_segment_size(4096),
-      m_segments(0, std::numeric_limits<off_t>::max(), segment_ptr()),
+      m_tree_version(0),
+      m_published(new segment_version()),
+      m_sealed(nullptr),
       m_initialized(false)    {
 }
 
-file::file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t inode, file::type type,  bool populate) 
+file::file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t inode, file::type type,  bool populate,
+           std::atomic<uint64_t>* allocated, bool splice_reads) 
     : m_pathname(pathname),
       m_type(type),
+      m_allocated(allocated),
+      m_splice_reads(splice_reads),
       m_alloc_offset(0),
       m_used_offset(0),
       m_segment_size(4096),
-      m_segments(0, std::numeric_limits<off_t>::max(), segment_ptr()),
+      m_tree_version(0),
+      m_published(new segment_version()),
+      m_sealed(nullptr),
       m_initialized(false) {
 
       m_pool_subdir = generate_pool_subdir(pool_base, pathname);
@@ -94,23 +143,7 @@ file::file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t in
         boost::unique_lock<boost::shared_mutex> lock(m_initialized_mutex);
        
          /* generate a subdir to store all pools for this file */
-
-        /* if the pool subdir already exists delete it, since we can't trust it */
-        /* TODO: we may need to change this in the future */
-        if(bfs::exists(m_pool_subdir)) {
-            try {
-                remove_all(m_pool_subdir);
-            }
-            catch(const bfs::filesystem_error& e) {
-                throw std::runtime_error(
-                        logger::build_message("Error removing stale pool subdir: ", m_pool_subdir, " (", e.what(), ")"));
-            }
-        }
-
-        if(::mkdir(m_pool_subdir.c_str(), S_IRWXU) != 0) {
-            throw std::runtime_error(
-                    logger::build_message("Error creating pool subdir: ", m_pool_subdir, " (", strerror(errno), ")"));
-        }
+        create_pool_subdir();
 
 
         posix::file fd(pathname);
@@ -118,24 +151,31 @@ file::file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t in
         fd.stat(stbuf);
         stbuf.st_ino = inode;
         off_t seg_offset = 0;
-        size_t seg_size = efsng::xalign(stbuf.st_size, m_segment_size);      // Preloaded file
+        size_t seg_size = efsng::xalign(stbuf.st_size, std::max(m_segment_size, segment::s_alignment));      // Preloaded file
 
         auto sptr = create_segment(seg_offset, seg_size, /*is_gap=*/false);
 
         append_segments({sptr});
+        publish_segments();
 
         m_alloc_offset = sptr->m_size;
         m_used_offset = sptr->fill_from(fd);
 
         save_attributes(stbuf);
         m_initialized = true;
-    } else {
-        m_segments.build_tree();
     }
 }
 
 file::~file() {
  //   std::cerr << "a nvml::file " << m_pathname.string() <<  " instance died...\n" ;
+
+    // readers may still be using its segments (e.g. through a data_view)
+    epoch_manager::global().retire(std::shared_ptr<const void>(m_published.load()));
+
+    if(m_sealed.load() != nullptr) {
+        epoch_manager::global().retire(std::shared_ptr<const void>(m_sealed.load()));
+    }
+
      if(bfs::exists(m_pool_subdir)) {
         try {
              remove_all(m_pool_subdir);
@@ -195,6 +235,7 @@ void file::update_size(size_t size) {
 
     // another thread may have completed a write beyond ours
     if(m_attributes.st_size < (off_t) size) {
+        unseal();
         m_used_offset = size;
         m_attributes.st_size = size;
         m_attributes.st_blocks = size/512;
@@ -210,13 +251,10 @@ int file::unload (const std::string name){
     file_region_list regions;
     std::ofstream output(name, std::ios::binary);
     auto rl = lock_range(0, size(), efsng::operation::read);
-
-    m_alloc_mutex.lock_shared();
+    auto guard = epoch_manager::global().enter();
 
     lookup_data(0, size(), regions);
 
-    m_alloc_mutex.unlock_shared();
-
     if(regions.count() == 0) {
         goto unlock_and_return_unload;
     }
@@ -231,8 +269,14 @@ int file::unload (const std::string name){
         if(data != NULL) {
             output.write((const char*)data, size);
         }
-        else { //TODO ask Alberto
-            output.write((const char*)0, size);
+        else {
+            // gaps read as zeroes
+            static const char zeroes[NVML_TRANSFER_SIZE] = {0};
+
+            for(size_t n; size != 0; size -= n) {
+                n = std::min(size, sizeof(zeroes));
+                output.write(zeroes, n);
+            }
         }
     }
 
@@ -241,12 +285,12 @@ int file::unload (const std::string name){
     unlock_range(rl);
     output.close();
 
-    return 0;
+    return output ? 0 : -EIO;
 }
 
 segment_ptr file::create_segment(off_t base_offset, size_t size, bool is_gap) {
 
-    segment_ptr sptr(new segment(m_pool_subdir, base_offset, size, is_gap));
+    segment_ptr sptr(new segment(m_pool_subdir, base_offset, size, is_gap, m_allocated));
 //    sptr->zero_fill(0, sptr->m_size);
 
     return sptr;
@@ -254,11 +298,11 @@ segment_ptr file::create_segment(off_t base_offset, size_t size, bool is_gap) {
 
 void file::append_segments(const segment_list& segments) {
 
-    for(const auto sptr : segments) {
-        m_segments.insert_back(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
+    for(const auto& sptr : segments) {
+        m_segments.assign(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
     }
 
-    m_segments.build_tree();
+    ++m_tree_version;
 
 #if defined(__EFS_DEBUG__) && defined(__PRINT_TREE__)
     print_tree(m_segments);
@@ -268,11 +312,11 @@ void file::append_segments(const segment_list& segments) {
 
 void file::insert_segments(const segment_list& segments) {
 
-    for(const auto sptr : segments) {
-        m_segments.insert_front(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
+    for(const auto& sptr : segments) {
+        m_segments.assign(sptr->m_offset, sptr->m_offset + sptr->m_size, sptr);
     }
 
-    m_segments.build_tree();
+    ++m_tree_version;
 
 #if defined(__EFS_DEBUG__) && defined(__PRINT_TREE__)
     print_tree(m_segments);
@@ -280,32 +324,166 @@ void file::insert_segments(const segment_list& segments) {
 
 }
 
+/* give writers a private copy of a segment that shares its storage with others 
+ * (see copy_range()), leaving the segment itself alone since readers may be using it */
 // precondition: 
 // - m_alloc_mutex locked
-void file::fetch_storage(off_t offset, size_t size, file_region_list& regions) {
+segment_ptr file::unshare_segment(const segment_ptr& sptr) {
+
+    if(sptr->m_is_gap || !sptr->is_shared()) {
+        return sptr;
+    }
+
+    segment_ptr copy(new segment(*sptr));
+    copy->unshare();
+
+    // (pmem copies are persisted as they are made)
+    if(!copy->is_pmem()) {
+        mark_dirty(copy->m_offset, copy->m_offset + copy->m_size);
+    }
+
+    m_segments.assign(copy->m_offset, copy->m_offset + copy->m_size, copy);
+    ++m_tree_version;
+
+    return copy;
+}
+
+/* make the changes to m_segments visible to readers. Readers don't take any lock: 
+ * they walk the version published last, so it can't be modified. A snapshot of 
+ * m_segments replaces it instead, and it is retired until no reader can be 
+ * using it (along with any segment only it refers to). The snapshot shares the 
+ * chunks of extents that weren't modified with the previous one, so publishing 
+ * an append or a gap allocation copies O(segment_snapshot chunk size) extents 
+ * plus one pointer per chunk rather than the whole map (see extent_snapshot and 
+ * tests/benchmarks/bench-segment-publish.cpp) */
+// precondition: 
+// - m_alloc_mutex locked
+void file::publish_segments() {
+
+    const segment_version* current = m_published.load();
+
+    if(current->m_version == m_tree_version) {
+        return;
+    }
+
+    m_published = new segment_version{
+        segment_snapshot(m_segments, current->m_segments, m_segments.changed_range()), m_tree_version};
+    m_segments.forget_changes();
+    epoch_manager::global().retire(std::shared_ptr<const void>(current));
+}
+
+/* seal (or unseal) the file as requested by its hints. Files that won't be modified 
+ * (e.g. staged inputs) can have their extents frozen so that reads go straight to 
+ * them, skipping the segment map, cursors and size checks. Everything that modifies 
+ * the file calls unseal() while holding m_alloc_mutex, so a layout can't be built 
+ * in the middle of a change and any layout found by a reader is current */
+void file::update_seal() {
+
+    boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+    if(!m_hints.sealed()) {
+        unseal();
+        return;
+    }
+
+    if(m_sealed.load() != nullptr) {
+        return;
+    }
+
+    std::unique_ptr<sealed_layout> layout(new sealed_layout());
+    off_t offset = 0;
+
+    // (reads stop at the first offset not covered by a segment)
+    for(auto it = m_segments.begin(); it != m_segments.end() && offset < m_used_offset; ++it) {
+
+        const auto& sptr = it->m_value;
+
+        if(sptr == nullptr || it->m_start != offset) {
+            break;
+        }
+
+        off_t end = std::min(it->m_end, m_used_offset.load());
+
+        layout->m_extents.push_back({offset, end, 
+                                     sptr->m_is_gap ? NULL : sptr->data(), 
+                                     sptr->m_is_gap ? NULL : sptr->m_pool.get()});
+        layout->m_segments.push_back(sptr);
+        offset = end;
+    }
+
+    layout->m_size = offset;
+    m_sealed = layout.release();
+
+    LOGGER_DEBUG("File {} sealed ({} bytes in {} extents)", m_pathname.string(), 
+                 m_sealed.load()->m_size, m_sealed.load()->m_extents.size());
+}
+
+/* drop the layout of a sealed file before it is modified. Readers may still be 
+ * using it, so it is retired rather than deleted */
+// precondition: 
+// - m_alloc_mutex locked
+void file::unseal() {
+
+    const sealed_layout* layout = m_sealed.load();
+
+    if(layout == nullptr) {
+        return;
+    }
+
+    m_sealed = nullptr;
+    m_hints.unseal();
+    epoch_manager::global().retire(std::shared_ptr<const void>(layout));
+
+    LOGGER_DEBUG("File {} unsealed", m_pathname.string());
+}
+
+bool file::is_sealed() const {
+    return m_sealed.load() != nullptr;
+}
+
+// precondition: 
+// - m_alloc_mutex locked
+void file::fetch_storage(off_t offset, size_t size, file_region_list& regions, segment_cursor* cur) {
 
     if(offset + (off_t) size <= m_alloc_offset) {
-        lookup_segments(offset, offset + size, regions);
+        lookup_segments(offset, offset + size, regions, cur);
         return;
     }
 
     assert(offset <= (off_t) (offset + size));
-    assert(m_segments.is_tree_valid());
 
     // the append may affect several already existing segments: add them to *regions*
     if(offset < m_alloc_offset) {
         lookup_segments(offset, m_alloc_offset, regions);
     }
 
-    // the last (valid) physical segment should start at *m_alloc_offset*
-    // and contain a *nullptr*
-    assert((*++m_segments.rbegin()).first == m_alloc_offset);
-    assert((*++m_segments.rbegin()).second == nullptr);
-    m_segment_size = std::min (m_segment_size*2, segment::s_segment_size);
+    // segments should cover the file up to *m_alloc_offset*
+    assert(m_segments.end_offset() == m_alloc_offset);
+
+    // segments are a multiple of the FUSE transfer size so that m_alloc_offset stays aligned 
+    // to it and requests don't straddle the boundary between two segments. They usually
+    // double in size as the file grows, unless a hint tells us how it will be written
+    switch(m_hints.access()) {
+        // sequential writers will fill whatever we give them
+        case file_hints::access_pattern::sequential:
+            m_segment_size = segment::s_segment_size;
+            break;
+        // random writers may leave most of a large segment unused
+        case file_hints::access_pattern::random:
+            m_segment_size = std::min(std::max(m_segment_size, segment::s_alignment), segment::s_segment_size);
+            break;
+        default:
+            m_segment_size = std::min (std::max(m_segment_size*2, segment::s_alignment), segment::s_segment_size);
+            break;
+    }
+
     off_t new_segment_offset = (offset <= m_alloc_offset ?  m_alloc_offset : 
             efsng::align(offset, m_segment_size));
     size_t gap_size = new_segment_offset - m_alloc_offset;
-    size_t new_segment_size = efsng::xalign(offset + size, m_segment_size) - new_segment_offset;
+
+    // if we know how large the file will become, allocate everything at once
+    off_t new_segment_end = std::max(offset + (off_t) size, (off_t) m_hints.expected_size());
+    size_t new_segment_size = efsng::xalign(new_segment_end, m_segment_size) - new_segment_offset;
 
     segment_list sl;
 
@@ -327,36 +505,52 @@ void file::fetch_storage(off_t offset, size_t size, file_region_list& regions) {
     data_ptr_t s_addr = (data_ptr_t) ((uintptr_t) sptr->data() + op_delta);
 
     regions.emplace_back(s_addr, offset + size - new_segment_offset, 
-            /*is_gap=*/false, /*is_pmem=*/sptr->is_pmem());
+            /*is_gap=*/false, /*is_pmem=*/sptr->is_pmem(), sptr->m_pool.get(), op_delta);
 
     m_alloc_offset = new_segment_offset + new_segment_size;
 }
 
-void file::lookup_segments(off_t range_start, off_t range_end, file_region_list& regions) {
+void file::lookup_segments(off_t range_start, off_t range_end, file_region_list& regions, segment_cursor* cur) {
 
     assert(range_start >= 0);
     assert(range_start <= range_end);
-    assert(m_segments.is_tree_valid());
 
-    lookup_helper(range_start, range_end, /*alloc_gaps_as_needed=*/true, regions);
+    lookup_helper(m_segments, m_tree_version, range_start, range_end, /*alloc_gaps_as_needed=*/true, 
+                  regions, cur);
 
 }
 
-void file::lookup_data(off_t range_start, off_t range_end, file_region_list& regions) const {
+// precondition: 
+// - caller inside an epoch for as long as it uses *regions* (see epoch_manager)
+void file::lookup_data(off_t range_start, off_t range_end, file_region_list& regions, segment_cursor* cur) const {
 
     assert(range_start >= 0);
     assert(range_start <= range_end);
-    assert(m_segments.is_tree_valid());
 
+    // (writers publish new segments before moving m_used_offset past them, 
+    // so it has to be read before the segment map)
     if(range_end > m_used_offset) {
         range_end = m_used_offset;
     }
 
-    const_cast<file*>(this)->lookup_helper(range_start, range_end, /*alloc_gaps_as_needed=*/false, regions);
+    if(range_start >= range_end) {
+        return;
+    }
+
+    // writers work on m_segments itself, readers on the last version published
+    const segment_version* published = m_published.load();
+
+    const_cast<file*>(this)->lookup_helper(published->m_segments, published->m_version, range_start, range_end, 
+                                           /*alloc_gaps_as_needed=*/false, regions, cur);
 
 }
 
-void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_needed, file_region_list& regions) {
+// precondition: 
+// - m_alloc_mutex locked if alloc_gaps_as_needed (and segments is m_segments), 
+//   inside an epoch otherwise (and segments is the version published as *version*)
+template <typename Segments>
+void file::lookup_helper(const Segments& segments, uint64_t version, off_t range_start, off_t range_end, 
+                         bool alloc_gaps_as_needed, file_region_list& regions, segment_cursor* cur) {
 
     size_t req_size = range_end - range_start;
 
@@ -364,45 +558,62 @@ void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_
         return;
     }
 
-    segment_ptr sptr;
-    auto res = m_segments.search_tree(range_start, sptr);
+    auto covers = [&](size_t pos) -> bool {
+        return pos < segments.size() && 
+               segments[pos].m_start <= range_start && range_start < segments[pos].m_end;
+    };
 
-    // range_start must exist, since the segment tree covers from 0 to 
-    // std::numeric_limits<off_t>::max(). Also, if a non-allocated offset 
-    // is accessed, the associated segment will be nullptr
-    assert(res.second == true);
+    size_t pos = 0;
+    size_t last = 0;
+    bool found = false;
+    bool visited = false;
+    std::unique_lock<std::mutex> cursor_lock;
 
-    segment_tree::const_iterator& it = res.first;
+    // sequential accesses through a handle land either on the segment where 
+    // the previous lookup ended or on the one right after it: try those before 
+    // searching the map (if someone else is using the cursor, don't wait)
+    if(cur != nullptr) {
+        cursor_lock = std::unique_lock<std::mutex>(cur->m_mutex, std::try_to_lock);
 
-    do {
-        const auto& s = it->second;
+        if(cursor_lock.owns_lock() && cur->m_valid && cur->m_version == version) {
+            pos = cur->m_index;
 
-        // out of allocated file
-        if(s == nullptr) {
-            return;
+            if(!(found = covers(pos))) {
+                found = covers(++pos);
+            }
         }
+    }
+
+    if(!found) {
+        // offsets beyond the allocated part of the file are not found
+        pos = segments.index_of(range_start);
+    }
+
+    // (writers may change the map while walking it, so segments are tracked by 
+    // position and the one at hand is only kept alive by the map itself)
+    while(pos < segments.size()) {
+        segment* s = segments[pos].m_value.get();
 
         off_t s_start = s->m_offset;
         off_t s_end = s_start + s->m_size;
         off_t op_delta = range_start - s_start;
 
-        // this should be guaranteed by search_tree
+        // this should be guaranteed by find()
         assert(op_delta != (off_t) s->m_size);
 
         ssize_t op_size = std::min({(ssize_t) req_size,
                                     (ssize_t) s->m_size - op_delta});
 
         if(alloc_gaps_as_needed && s->m_is_gap) {
-            off_t seg_offset = efsng::align(range_start, segment::s_segment_size);
-            size_t seg_size = (range_start + req_size < s->m_offset + s->m_size) ?
-                efsng::xalign(range_start + req_size, segment::s_segment_size) - seg_offset :
-                s->m_offset + s->m_size - seg_offset;
+            // gaps left by punch_hole() need not be aligned to s_segment_size: 
+            // never allocate beyond the gap itself
+            off_t seg_offset = std::max(efsng::align(range_start, segment::s_segment_size), s_start);
+            size_t seg_size = std::min(efsng::xalign(range_start + req_size, segment::s_segment_size), s_end) - 
+                              seg_offset;
 
             segment_list sl;
 
-            s->allocate(seg_offset, seg_size);
-            
-
+            // readers may be looking at the gap: replace it rather than modifying it
             off_t start_gap_offset = s_start;
             size_t start_gap_size = seg_offset - s_start;
 
@@ -411,8 +622,11 @@ void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_
                 sl.push_back(sptr);
             }
 
+            auto sptr = create_segment(seg_offset, seg_size, /*is_gap=*/false);
+            sl.push_back(sptr);
+
             // update op_delta since we have modified things
-            op_delta = range_start - (start_gap_offset + start_gap_size);
+            op_delta = range_start - seg_offset;
 
             off_t end_gap_offset = seg_offset + seg_size;
             size_t end_gap_size = s_end - (seg_offset + seg_size);
@@ -423,145 +637,272 @@ void file::lookup_helper(off_t range_start, off_t range_end, bool alloc_gaps_as_
             }
 
             insert_segments(sl);
+
+            // the new segment covers [seg_offset, seg_offset + seg_size) (which includes range_start)
+            s = sptr.get();
+            pos = m_segments.index_of(range_start);
+        }
+        else if(alloc_gaps_as_needed) {
+            // data is about to be modified: stop sharing it (see copy_range())
+            s = unshare_segment(m_segments[pos].m_value).get();
         }
 
         data_ptr_t s_addr = s->m_is_gap ? 
                             NULL :
                             (data_ptr_t) ((uintptr_t)s->data() + op_delta);
 
-        regions.emplace_back(s_addr, op_size, s->m_is_gap, s->is_pmem());
+        regions.emplace_back(s_addr, op_size, s->m_is_gap, s->is_pmem(), 
+                             s->m_is_gap ? NULL : s->m_pool.get(), op_delta);
+
+        last = pos;
+        visited = true;
 
         if(s_end >= range_end) {
-            return;
+            break;
         }
 
         range_start = s_end;
         req_size -= op_size;
-        ++it;
-    } while(true);
+
+        // the next segment must start right where this one ends
+        if(++pos < segments.size() && segments[pos].m_start != s_end) {
+            break;
+        }
+    }
+
+    if(cursor_lock.owns_lock()) {
+        // positions don't survive changes to the map (e.g. allocated gaps)
+        uint64_t current = alloc_gaps_as_needed ? m_tree_version : version;
+
+        cur->m_valid = visited && (current == version);
+        cur->m_version = current;
+        cur->m_index = last;
+    }
 }
 
 
 bfs::path file::generate_pool_subdir(const bfs::path& pool_base, const bfs::path& pathname) const {
 
+    /* the sequence number keeps a file that is being created from sharing its subdir 
+     * with one of the same name that was unlinked but is still alive (e.g. open) */
+    static std::atomic<uint64_t> sequence(0);
+
     std::stringstream ss;
-    ss << std::hex << std::hash<std::string>()(pathname.string());
+    ss << std::hex << std::hash<std::string>()(pathname.string()) << "-" << sequence++;
 
     return pool_base / bfs::path(ss.str());
 }
 
+void file::create_pool_subdir() {
 
-ssize_t file::get_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+    /* if the pool subdir already exists delete it, since we can't trust it */
+    /* TODO: we may need to change this in the future */
+    if(bfs::exists(m_pool_subdir)) {
+        try {
+            remove_all(m_pool_subdir);
+        }
+        catch(const bfs::filesystem_error& e) {
+            throw std::runtime_error(
+                    logger::build_message("Error removing stale pool subdir: ", m_pool_subdir, " (", e.what(), ")"));
+        }
+    }
 
-    size_t n = 0;
-    ssize_t rv = 0;
-    void* buffer = NULL;
-    off_t end_offset = start_offset + size;
+    if(::mkdir(m_pool_subdir.c_str(), S_IRWXU) != 0) {
+        throw std::runtime_error(
+                logger::build_message("Error creating pool subdir: ", m_pool_subdir, " (", strerror(errno), ")"));
+    }
+}
 
-    assert(start_offset < end_offset);
+void file::prepare_storage() {
 
-    file_region_list regions;
+    if(m_initialized) {
+        return;
+    }
 
-    if (!m_initialized){
-         
-        /* if the pool subdir already exists delete it, since we can't trust it */
-        /* TODO: we may need to change this in the future */
-        if(bfs::exists(m_pool_subdir)) {
-            try {
-                remove_all(m_pool_subdir);
-            }
-            catch(const bfs::filesystem_error& e) {
-                throw std::runtime_error(
-                        logger::build_message("Error removing stale pool subdir: ", m_pool_subdir, " (", e.what(), ")"));
-            }
-        }
+    boost::unique_lock<boost::shared_mutex> lock(m_initialized_mutex);
 
-        if(::mkdir(m_pool_subdir.c_str(), S_IRWXU) != 0) {
-            throw std::runtime_error(
-                    logger::build_message("Error creating pool subdir: ", m_pool_subdir, " (", strerror(errno), ")"));
-        }
-        m_initialized = true;
+    if(m_initialized) {
+        return;
     }
-   
-//XXX if posix_consistency:
-    auto rl = lock_range(start_offset, end_offset, efsng::operation::read);
 
-    m_alloc_mutex.lock_shared();
+    create_pool_subdir();
+    m_initialized = true;
+}
 
-    lookup_data(start_offset, end_offset, regions);
 
-    m_alloc_mutex.unlock_shared();
+backend::file::cursor_ptr file::new_cursor() const {
+    return cursor_ptr(new segment_cursor());
+}
 
-    if(regions.count() == 0) {
-        fuse_buffer->buf[0].flags = (fuse_buf_flags) (~FUSE_BUF_IS_FD);
-        fuse_buffer->buf[0].mem = NULL;
-        fuse_buffer->buf[0].size = 0;
+/* a view that stays inside an epoch while alive, which keeps the segments that 
+ * it points into from being released (e.g. by truncate() or punch_hole()) */
+class file::pinned_view : public backend::data_view {
+
+public:
+    pinned_view(epoch_manager::guard&& guard)
+        : m_guard(std::move(guard)) { }
+
+private:
+    epoch_manager::guard m_guard;
+};
 
-        rv = 0;
-        goto unlock_and_return;
+ssize_t file::map_data(off_t start_offset, size_t size, backend::data_view_ptr& view, cursor* cur) {
+
+    off_t end_offset = start_offset + size;
+
+    assert(start_offset < end_offset);
+
+    // no locks here: concurrent readers of a file shouldn't contend for anything
+    std::unique_ptr<pinned_view> pv(new pinned_view(epoch_manager::global().enter()));
+
+    // (the layout must be read inside the epoch, which keeps it alive)
+    if(const sealed_layout* layout = m_sealed.load()) {
+        map_sealed(*layout, start_offset, end_offset, *pv);
+        view = std::move(pv);
+        return 0;
     }
 
-#ifndef __TEST_FUSE_READBUF_PATCH__
-    /* the FUSE interface forces us to allocate a buffer using malloc() and 
-    * memcpy() the requested data in order to return it back to the user. meh */
-    buffer = (void*) malloc(regions.total_size());
+    file_region_list regions;
+
+    prepare_storage();
+
+    const auto access = m_hints.access();
+
+    // cursors only pay off for sequential accesses
+    if(access == file_hints::access_pattern::random || access == file_hints::access_pattern::strided) {
+        cur = nullptr;
+    }
+
+    file_region_list ahead;
 
-    if(posix_memalign(&buffer, 512, regions.total_size()) != 0) {
-        rv = -ENOMEM;
-        goto unlock_and_return;
+    lookup_data(start_offset, end_offset, regions, static_cast<segment_cursor*>(cur));
+
+    // sequential readers will ask for the next range next: have it faulted in meanwhile
+    if(access == file_hints::access_pattern::sequential) {
+        lookup_data(end_offset, end_offset + size, ahead);
     }
 
-    if(buffer == NULL) {
-        rv = -ENOMEM;
-        goto unlock_and_return;
+    for(const auto& r : ahead) {
+        if(r.m_address != NULL) {
+            uintptr_t page_mask = ~((uintptr_t) sysconf(_SC_PAGESIZE) - 1);
+            uintptr_t addr = (uintptr_t) r.m_address & page_mask;
+            ::madvise((void*) addr, (uintptr_t) r.m_address + r.m_size - addr, MADV_WILLNEED);
+        }
     }
-#endif // __TEST_FUSE_READBUF_PATCH__
 
     for(const auto& r : regions) {
         efsng::data_ptr_t data = r.m_address;
         size_t size = r.m_size;
 
-        if(data != NULL) {
-#ifndef __TEST_FUSE_READBUF_PATCH__
-            memcpy((void*) ((uintptr_t)buffer + n), (void*) data, size);
-#else
-            buffer = data;
-#endif // __TEST_FUSE_READBUF_PATCH__
+        // pool files are opened on demand, and only as long as descriptors 
+        // are available (see pool::fd())
+        int fd = (data != NULL && m_splice_reads && r.m_pool != NULL) ? r.m_pool->fd() : -1;
+
+        if(fd != -1) {
+            pv->add_fd(fd, r.m_fd_offset, size);
+        }
+        else if(data != NULL) {
+            pv->add(data, size);
 
             LOGGER_TRACE("nvml_read:{}:{}:{}:{}", 
                     fuse_get_context()->pid, syscall(__NR_gettid), 
                     data, size);
         }
         else {
-            memset((void*) ((uintptr_t)buffer + n), 0, size);
+            pv->add_zeroes(size);
 
             LOGGER_TRACE("nvml_read:{}:{}:0x0:{}", 
                     fuse_get_context()->pid, syscall(__NR_gettid), 
                     size);
         }
+    }
 
-        n += size;
+    assert(pv->size() == regions.total_size());
+
+    view = std::move(pv);
+
+    return 0;
+}
+
+/* add [start, end) of a sealed file to 'pv' */
+void file::map_sealed(const sealed_layout& layout, off_t start, off_t end, pinned_view& pv) const {
+
+    end = std::min(end, layout.m_size);
+
+    if(start >= end) {
+        return;
     }
 
-    assert(n == regions.total_size());
+    // first extent ending beyond 'start' (sealed files usually have very few)
+    auto it = std::upper_bound(layout.m_extents.begin(), layout.m_extents.end(), start, 
+                               [](off_t offset, const sealed_layout::extent& e) {
+                                    return offset < e.m_end;
+                               });
 
-    fuse_buffer->buf[0].flags = (fuse_buf_flags) (~FUSE_BUF_IS_FD);
-    fuse_buffer->buf[0].mem = buffer;
-    fuse_buffer->buf[0].size = regions.total_size();
+    for(; start < end; ++it) {
 
+        assert(it != layout.m_extents.end() && it->m_start <= start);
 
-unlock_and_return:
-//XXX if posix_consistency:
-    unlock_range(rl);
+        size_t n = std::min(it->m_end, end) - start;
+        off_t delta = start - it->m_start;
 
-    return rv;
+        if(it->m_address == NULL) {
+            pv.add_zeroes(n);
+        }
+        else if(m_splice_reads && it->m_pool->fd() != -1) {
+            pv.add_fd(it->m_pool->fd(), delta, n);
+        }
+        else {
+            pv.add((data_ptr_t) ((uintptr_t) it->m_address + delta), n);
+        }
+
+        start += n;
+    }
+}
+
+ssize_t file::get_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+
+    void* buffer = NULL;
+    backend::data_view_ptr view;
+
+    ssize_t rv = map_data(start_offset, size, view);
+
+    if(rv < 0) {
+        return rv;
+    }
+
+    fuse_buffer->buf[0].flags = (fuse_buf_flags) 0;
+    fuse_buffer->buf[0].mem = NULL;
+    fuse_buffer->buf[0].size = 0;
+
+    if(view->size() == 0) {
+        return 0;
+    }
+
+    /* callers of get_data() (e.g. the high-level FUSE API) free() the buffers
+     * they get back, so we can't hand them our mappings: copy the data */
+    if(posix_memalign(&buffer, 512, view->size()) != 0) {
+        return -ENOMEM;
+    }
+
+    rv = view->copy_to(buffer, view->size());
+
+    if(rv < 0) {
+        free(buffer);
+        return rv;
+    }
+
+    fuse_buffer->buf[0].mem = buffer;
+    fuse_buffer->buf[0].size = rv;
+
+    return 0;
 }
 
 #ifdef __TEST_STATIC_BUFFER__
 char global_buffer[8*1024*1024];
 #endif // __TEST_STATIC_BUFFER__
 
-ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur) {
 
 #ifdef __TEST_SINGLE_BUFFER_WRITES__
 
@@ -584,6 +925,8 @@ ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse
 
 #else
 
+    prepare_storage();
+
     // a truncate() call while writing data is a problem: allocated segments
     // that we believe exist may be removed before writing data to them. To avoid 
     // this, all writers (i.e. data adders) try to get a shared_lock on m_dealloc_mutex 
@@ -591,51 +934,45 @@ ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse
     // Thus, all writers can put data into a file's segments concurrently, without having 
     // to worry about them vanishing
     m_dealloc_mutex.lock_shared();
-    if (!m_initialized){
-        boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
-      
-        /* if the pool subdir already exists delete it, since we can't trust it */
-        /* TODO: we may need to change this in the future */
-        if(bfs::exists(m_pool_subdir)) {
-            try {
-                remove_all(m_pool_subdir);
-            }
-            catch(const bfs::filesystem_error& e) {
-                throw std::runtime_error(
-                        logger::build_message("Error removing stale pool subdir: ", m_pool_subdir, " (", e.what(), ")"));
-            }
-        }
-        if(::mkdir(m_pool_subdir.c_str(), S_IRWXU) != 0) {
-            throw std::runtime_error(
-                    logger::build_message("Error creating pool subdir (pd): ", m_pool_subdir, " (", strerror(errno), ")"));
-        }
-        m_initialized = true;
-    }
-    
 
     off_t end_offset = start_offset + size;
 
     file_region_list regions;
 
+    // lock only the affected range rather than the whole file, so that 
+    // non-overlapping threads can write data without having to block. 
+    // The range must be locked before looking up its segments: shared 
+    // segments (see copy_range()) are only guaranteed to stay unshared
+    // while no one else can read the range
+    auto rl = lock_range(start_offset, end_offset, efsng::operation::write);
+
     // get segments affected by the write operation
     {
         boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
 
+        unseal();
+
         // this will allocate any additional segments required
-        fetch_storage(start_offset, size, regions);
+        fetch_storage(start_offset, size, regions, static_cast<segment_cursor*>(cur));
+        publish_segments();
 
         // lock released here
     }
 
     // by this point, the file has enough storage in NVRAM for the data
     // (and even more than that if another thread enlarged it further after 
-    // we released the lock). Now we can lock only the affected ranges 
-    // rather than the whole file, so that non-overlapping threads can 
-    // write data without having to block
-    auto rl = lock_range(start_offset, end_offset, efsng::operation::write);
+    // we released the lock)
 
     ssize_t n = 0;
-    bool needs_sync = false;
+    off_t offset = start_offset;
+
+    // data copied into pmem from memory is flushed on its way there (see
+    // fuse_buf_copy_pmem()), anything else has to be flushed by sync()
+    bool from_fd = false;
+
+    for(size_t i = fuse_buffer->idx; i < fuse_buffer->count; ++i) {
+        from_fd |= (fuse_buffer->buf[i].flags & FUSE_BUF_IS_FD) != 0;
+    }
 
     for(const auto& r : regions) {
         //XXX not all regions need data to be written to them!
@@ -650,21 +987,26 @@ ssize_t file::put_data(off_t start_offset, size_t size, struct fuse_bufvec* fuse
 
         // copy user data from received in *fuse_buffer* to dst
         // (fuse_buf_copy tracks how much data has been copied)
-        if(r.m_is_pmem) {
-            n += fuse_buf_copy_pmem(&dst, fuse_buffer, FUSE_BUF_SPLICE_MOVE);
-        }
-        else {
-            n += fuse_buf_copy(&dst, fuse_buffer, FUSE_BUF_SPLICE_MOVE);
+        ssize_t copied = fuse_buf_copy_pmem(&dst, fuse_buffer, FUSE_BUF_SPLICE_MOVE, region_kind(r));
+
+        if(copied > 0 && !(r.m_is_pmem && (segment::s_auto_flush || !from_fd))) {
+            mark_dirty(offset, offset + copied);
         }
 
-        needs_sync |= r.m_is_pmem;
+        n += copied;
+        offset += r.m_size;
     }
 
-//XXX FIXME this should be done only if fsync() is called!
-//    // ensure data is persistent
-//    if(needs_sync) {
-//        segment::sync_all();
-//    }
+    // data only needs to be durable once fsync() is called, unless the file 
+    // asked for each write to be
+    if(m_hints.consistency() == file_hints::consistency_level::strict) {
+
+        int rv = sync(/*data_only=*/true);
+
+        if(rv < 0) {
+            n = rv;
+        }
+    }
 
     // update cached attributes
     update_size(end_offset);
@@ -685,38 +1027,22 @@ ssize_t file::append_data(off_t start_offset, size_t size, struct fuse_bufvec* f
     return 0;
 }
 
-ssize_t file::allocate(off_t start_offset, size_t size){
-     
-    
-    if (!m_initialized){
-      
-        /* if the pool subdir already exists delete it, since we can't trust it */
-        /* TODO: we may need to change this in the future */
-        if(bfs::exists(m_pool_subdir)) {
-            try {
-                remove_all(m_pool_subdir);
-            }
-            catch(const bfs::filesystem_error& e) {
-                throw std::runtime_error(
-                        logger::build_message("Error removing stale pool subdir: ", m_pool_subdir, " (", e.what(), ")"));
-            }
-        }
+ssize_t file::allocate(off_t start_offset, size_t size, bool keep_size){
 
-        if(::mkdir(m_pool_subdir.c_str(), S_IRWXU) != 0) {
-            throw std::runtime_error(
-                    logger::build_message("Error creating pool subdir: ", m_pool_subdir, " (", strerror(errno), ")"));
-        }
-        m_initialized = true;
-    }
+    prepare_storage();
 
     file_region_list regions;
     m_dealloc_mutex.lock_shared();
     {
         boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+        unseal();
         // this will allocate any additional segments required
         fetch_storage(start_offset, size, regions);
+        publish_segments();
+    }
+    if(!keep_size) {
+        update_size(start_offset+size);
     }
-    update_size(start_offset+size);
     m_alloc_mutex.lock();
     m_attributes.st_ctime = time(NULL);
     m_alloc_mutex.unlock();
@@ -727,27 +1053,479 @@ ssize_t file::allocate(off_t start_offset, size_t size){
     return 0;
 }
 
+ssize_t file::punch_hole(off_t start_offset, size_t size) {
+
+    if(size == 0) {
+        return 0;
+    }
+
+    off_t end_offset = start_offset + size;
+
+    // as in truncate(), segments may be unmapped: keep writers out while we do it
+    m_dealloc_mutex.lock();
+    auto rl = lock_range(start_offset, end_offset, efsng::operation::write);
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+        unseal();
+
+        // nothing is allocated beyond m_alloc_offset
+        end_offset = std::min(end_offset, m_alloc_offset);
+
+        for(off_t offset = start_offset; offset < end_offset; ) {
+
+            segment_ptr sptr = m_segments.lookup(offset);
+
+            if(sptr == nullptr) {
+                break;
+            }
+
+            off_t s_start = sptr->m_offset;
+            off_t s_end = s_start + sptr->m_size;
+
+            if(!sptr->m_is_gap) {
+                // segments entirely in the hole are replaced by gaps (their storage goes 
+                // back to the pool once no reader uses them), the ones at its edges keep it
+                if(start_offset <= s_start && s_end <= end_offset) {
+                    m_segments.assign(s_start, s_end, create_segment(s_start, sptr->m_size, /*is_gap=*/true));
+                }
+                else {
+                    unshare_segment(sptr)->zero_fill(offset - s_start, std::min(s_end, end_offset) - offset);
+                }
+            }
+
+            offset = s_end;
+        }
+
+        ++m_tree_version;
+        publish_segments();
+        m_attributes.st_ctime = time(NULL);
+    }
+
+    // (zeroes are only persisted as they are written on pmem)
+    mark_dirty(start_offset, end_offset);
+
+    unlock_range(rl);
+    m_dealloc_mutex.unlock();
+
+    return 0;
+}
+
+ssize_t file::zero_range(off_t start_offset, size_t size, bool keep_size) {
+
+    ssize_t rv = punch_hole(start_offset, size);
+
+    if(rv != 0 || keep_size) {
+        return rv;
+    }
+
+    off_t end_offset = start_offset + size;
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+        unseal();
+
+        // reads stop at the first unallocated offset: describe the extension as 
+        // a gap so that it reads back as zeroes without taking up any storage
+        if(end_offset > m_alloc_offset) {
+            off_t gap_end = efsng::xalign(end_offset - 1, segment::s_alignment);
+            append_segments({create_segment(m_alloc_offset, gap_end - m_alloc_offset, /*is_gap=*/true)});
+            publish_segments();
+            m_alloc_offset = gap_end;
+        }
+    }
+
+    update_size(end_offset);
+
+    return 0;
+}
+
+ssize_t file::copy_range(backend::file& src_file, off_t src_offset, off_t dst_offset, size_t size) {
+
+    auto src = dynamic_cast<file*>(&src_file);
+
+    // storage can only be shared with files in the same backend (usage is accounted per backend)
+    if(src == nullptr || src->m_allocated != m_allocated) {
+        return backend::file::copy_range(src_file, src_offset, dst_offset, size);
+    }
+
+    off_t src_eof = src->size();
+
+    if(size == 0 || src_offset >= src_eof) {
+        return 0;
+    }
+
+    size = std::min(size, (size_t) (src_eof - src_offset));
+
+    off_t src_end = src_offset + size;
+    off_t dst_end = dst_offset + size;
+    off_t delta = dst_offset - src_offset;
+
+    if(src == this && src_offset < dst_end && dst_offset < src_end) {
+        return -EINVAL;
+    }
+
+    prepare_storage();
+
+    m_dealloc_mutex.lock_shared();
+
+    // lock both ranges always in the same order so that copies running 
+    // in opposite directions can't deadlock
+    const bool src_first = (src <= this);
+    auto rl0 = src_first ? src->lock_range(src_offset, src_end, efsng::operation::read) :
+                           lock_range(dst_offset, dst_end, efsng::operation::write);
+    auto rl1 = src_first ? lock_range(dst_offset, dst_end, efsng::operation::write) :
+                           src->lock_range(src_offset, src_end, efsng::operation::read);
+
+    // a piece of the source range that lies within a single segment
+    struct extent {
+        off_t                   m_offset;   /*!< Offset in the source file */
+        size_t                  m_size;     /*!< Size of the piece */
+        std::shared_ptr<pool>   m_pool;     /*!< Storage of the segment (nullptr for gaps) */
+        off_t                   m_delta;    /*!< Offset of the piece in m_pool */
+        size_t                  m_shareable;/*!< Size of the segment if it can be shared as a whole, 0 otherwise */
+    };
+
+    std::vector<extent> extents;
+
+    // take a snapshot of the source segments: once the lock is released, writers
+    // outside of the range may reshape the segments, but the pools themselves 
+    // stay alive (and unmodified, since the range is locked) while we hold them
+    {
+        boost::shared_lock<boost::shared_mutex> lock(src->m_alloc_mutex);
+
+        for(off_t offset = src_offset; offset < src_end; ) {
+
+            segment_ptr sptr = src->m_segments.lookup(offset);
+
+            // nothing allocated beyond this point: it reads as zeroes
+            if(sptr == nullptr) {
+                extents.push_back({offset, (size_t) (src_end - offset), nullptr, 0, 0});
+                break;
+            }
+
+            off_t s_start = sptr->m_offset;
+            off_t s_end = s_start + sptr->m_size;
+            off_t end = std::min(s_end, src_end);
+
+            // whole segments can be shared, and so can the last one if the range reaches EOF
+            bool whole = (offset == s_start) && (end == s_end || src_end == src_eof);
+
+            if(sptr->m_is_gap) {
+                extents.push_back({offset, (size_t) (end - offset), nullptr, 0, 0});
+            }
+            else {
+                extents.push_back({offset, (size_t) (end - offset), sptr->m_pool, offset - s_start, 
+                                   whole ? sptr->m_size : 0});
+            }
+
+            offset = end;
+        }
+    }
+
+    std::vector<std::pair<const extent*, file_region_list>> copies;
+    size_t shared_bytes = 0;
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+        unseal();
+
+        for(const auto& e : extents) {
+
+            off_t d_start = e.m_offset + delta;
+
+            // segments can only be added beyond the allocated part of the file: 
+            // anything else is copied into whatever storage is already there
+            if(d_start >= m_alloc_offset && (e.m_pool == nullptr || e.m_shareable != 0)) {
+
+                segment_list sl;
+
+                if(d_start > m_alloc_offset) {
+                    sl.push_back(create_segment(m_alloc_offset, d_start - m_alloc_offset, /*is_gap=*/true));
+                }
+
+                segment_ptr sptr;
+
+                if(e.m_pool != nullptr) {
+                    sptr = create_segment(d_start, e.m_shareable, /*is_gap=*/true);
+                    sptr->share(e.m_pool);
+                    shared_bytes += e.m_size;
+                }
+                else {
+                    off_t gap_end = efsng::xalign(d_start + e.m_size - 1, segment::s_alignment);
+                    sptr = create_segment(d_start, gap_end - d_start, /*is_gap=*/true);
+                }
+
+                sl.push_back(sptr);
+                append_segments(sl);
+                m_alloc_offset = sptr->m_offset + sptr->m_size;
+                continue;
+            }
+
+            file_region_list regions;
+            fetch_storage(d_start, e.m_size, regions);
+            copies.emplace_back(&e, std::move(regions));
+        }
+
+        ++m_tree_version;
+        publish_segments();
+    }
+
+    // copy whatever couldn't be shared (e.g. unaligned edges) the way put_data() 
+    // does, draining the copies to pmem once they are all done
+    bool drain = false;
+
+    for(const auto& c : copies) {
+
+        const extent& e = *c.first;
+        char* from = e.m_pool != nullptr ? (char*) e.m_pool->m_data + e.m_delta : NULL;
+        size_t pending = e.m_size;
+
+        // (regions may extend beyond the extent, e.g. up to the end of a newly allocated segment)
+        for(const auto& r : c.second) {
+
+            size_t n = std::min(r.m_size, pending);
+
+            if(n == 0) {
+                break;
+            }
+
+            if(from == NULL) {
+                if(r.m_is_pmem) {
+                    pmem_memset_persist(r.m_address, 0, n);
+                }
+                else {
+                    memset(r.m_address, 0, n);
+                }
+            }
+            else {
+                memory_kind kind = region_kind(r);
+
+                copy_memory(r.m_address, from, n, kind);
+                drain |= (kind == memory_kind::pmem);
+                from += n;
+            }
+
+            pending -= n;
+        }
+    }
+
+    if(drain) {
+        pmem_drain();
+    }
+
+    // shared storage and copies out of pmem need flushing on sync()
+    mark_dirty(dst_offset, dst_end);
+
+    update_size(dst_end);
+
+    LOGGER_DEBUG("copy_range({}, {}, {}, {}): {} bytes shared, {} bytes copied", 
+                 src->m_pathname.string(), src_offset, dst_offset, size, shared_bytes, size - shared_bytes);
+
+    (src_first ? src : this)->unlock_range(rl0);
+    (src_first ? this : src)->unlock_range(rl1);
+    m_dealloc_mutex.unlock_shared();
+
+    return size;
+}
+
+void file::mark_dirty(off_t start, off_t end) {
+    std::lock_guard<std::mutex> lock(m_dirty_mutex);
+    m_dirty.add(start, end);
+}
+
+/* make the data written so far durable. Writes remember the ranges that they
+ * left in CPU caches or in the page cache (see put_data()), so only those are 
+ * flushed: with pmem_flush() if the storage is pmem, with msync() otherwise.
+ * File attributes only live in memory, so there is nothing else to sync */
+int file::sync(bool data_only) {
+
+    (void) data_only;
+
+    // a sync can't return before the ones that took the ranges before it are done
+    std::lock_guard<std::mutex> sync_lock(m_sync_mutex);
+
+    range_set dirty;
+
+    {
+        std::lock_guard<std::mutex> lock(m_dirty_mutex);
+        dirty.swap(m_dirty);
+    }
+
+    // a piece of a dirty range within a single segment
+    struct piece {
+        segment_ptr m_segment;  /*!< Keeps the segment's storage alive while we flush it */
+        off_t       m_delta;    /*!< Offset of the piece in the segment */
+        size_t      m_size;
+    };
+
+    std::vector<piece> pieces;
+
+    {
+        boost::shared_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+        for(const auto& r : dirty) {
+            for(off_t offset = r.first; offset < r.second; ) {
+
+                auto it = m_segments.find(offset);
+
+                // truncated since it was written
+                if(it == m_segments.end()) {
+                    break;
+                }
+
+                off_t end = std::min(it->m_end, r.second);
+
+                if(!it->m_value->m_is_gap) {
+                    pieces.push_back({it->m_value, offset - it->m_value->m_offset, (size_t) (end - offset)});
+                }
+
+                offset = end;
+            }
+        }
+    }
+
+    int error = 0;
+
+    for(const auto& p : pieces) {
+
+        void* addr = (void*) ((uintptr_t) p.m_segment->data() + p.m_delta);
+
+        if(p.m_segment->is_pmem()) {
+            if(!segment::s_auto_flush) {
+                pmem_flush(addr, p.m_size);
+            }
+        }
+        else if(pmem_msync(addr, p.m_size) != 0) {
+            error = errno;
+        }
+    }
+
+    // (this also waits for the flushes issued by the writes themselves)
+    segment::sync_all();
+
+    if(error != 0) {
+        LOGGER_ERROR("Error syncing {}: {}", m_pathname.string(), strerror(error));
+
+        // so that the next sync tries again
+        std::lock_guard<std::mutex> lock(m_dirty_mutex);
+        m_dirty.merge(dirty);
+
+        return -error;
+    }
+
+    return 0;
+}
+
+uint64_t file::resident_bytes() const {
+
+    uint64_t bytes = 0;
+
+    boost::shared_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+    for(auto it = m_segments.begin(); it != m_segments.end(); ++it) {
+        const auto& sptr = it->m_value;
+
+        if(sptr != nullptr && !sptr->m_is_gap) {
+            bytes += sptr->m_size;
+        }
+    }
+
+    return bytes;
+}
+
+/* lock (or unlock) the storage currently allocated to the file in memory, so that pool 
+ * files that are not on real persistent memory don't get their pages evicted */
+int file::pin(bool pinned) {
+
+    boost::shared_lock<boost::shared_mutex> lock(m_alloc_mutex);
+
+    for(auto it = m_segments.begin(); it != m_segments.end(); ++it) {
+        const auto& sptr = it->m_value;
+
+        if(sptr == nullptr || sptr->m_is_gap || sptr->is_pmem()) {
+            continue;
+        }
+
+        if(pinned && ::mlock(sptr->data(), sptr->m_size) != 0) {
+            int error = errno;
+
+            // undo whatever we did
+            for(auto jt = m_segments.begin(); jt != it; ++jt) {
+                if(jt->m_value != nullptr && !jt->m_value->m_is_gap && !jt->m_value->is_pmem()) {
+                    ::munlock(jt->m_value->data(), jt->m_value->m_size);
+                }
+            }
+
+            return -error;
+        }
+
+        if(!pinned) {
+            ::munlock(sptr->data(), sptr->m_size);
+        }
+    }
+
+    m_pinned = pinned;
+
+    return 0;
+}
+
+/* preallocate storage as soon as the file's expected size is known, and 
+ * seal or unseal the file as requested */
+void file::hints_changed() {
+
+    uint64_t expected_size = m_hints.expected_size();
+    off_t alloc_offset;
+
+    {
+        boost::shared_lock<boost::shared_mutex> lock(m_alloc_mutex);
+        alloc_offset = m_alloc_offset;
+    }
+
+    // hints are advisory: failing to honor them is not an error
+    if((off_t) expected_size > alloc_offset && !m_hints.sealed()) {
+        try {
+            allocate(alloc_offset, expected_size - alloc_offset, /*keep_size=*/true);
+        }
+        catch(const std::exception& e) {
+            LOGGER_WARN("Unable to preallocate {} bytes for {}: {}", expected_size, m_pathname.string(), e.what());
+        }
+    }
+
+    update_seal();
+}
 
 void file::change_type(file::type type){
 	m_type = type;
 }
 
-void file::truncate(off_t end_offset) {
+int file::truncate(off_t end_offset) {
 
     if ((unsigned)end_offset > (unsigned)size() ) { 
-        allocate( 0, end_offset);
+        ssize_t rv = allocate( 0, end_offset);
+
+        if(rv < 0) {
+            return rv;
+        }
     }
     else {
 	
       m_dealloc_mutex.lock();
       auto rl = lock_range(end_offset, size(), efsng::operation::write);
       // Traverse tree, update m_bytes of the last active segment, deallocate pmemblocks, set gap as 1
+      m_alloc_mutex.lock();
+
+         unseal();
 
+         segment_list dropped;
          ssize_t size = 0;
          bool cut = false;
          for(auto it = m_segments.begin(); it != m_segments.end(); ++it) {
 
-            const auto& sptr = it->second;
+            const auto& sptr = it->m_value;
 
             if(sptr != nullptr) {
                 //std::cerr << *sptr << "\n";
@@ -761,9 +1539,7 @@ void file::truncate(off_t end_offset) {
                         }
                         else {
                            // std::cout << " DROP SEGMENT " << size - end_offset << std::endl;
-                            pmem_unmap(sptr->m_pool.m_data, sptr->m_pool.m_length);
-                            sptr->m_pool.m_data = NULL;
-                            sptr->m_is_gap = 1;
+                            dropped.push_back(sptr);
                         }
                 }
             }
@@ -771,15 +1547,29 @@ void file::truncate(off_t end_offset) {
         }
 
         //We cannot call update size, as it is a truncate
-        m_alloc_mutex.lock();
         m_used_offset = end_offset;
         m_attributes.st_size = end_offset;
         m_attributes.st_blocks = end_offset/512;
         m_attributes.st_ctime = time(NULL);
+
+        // readers may still be using the dropped segments: replace them with gaps and 
+        // let them go once they are done
+        for(const auto& sptr : dropped) {
+            m_segments.assign(sptr->m_offset, sptr->m_offset + sptr->m_size, 
+                              create_segment(sptr->m_offset, sptr->m_size, /*is_gap=*/true));
+        }
+
+        if(!dropped.empty()) {
+            ++m_tree_version;
+            publish_segments();
+        }
+
         m_alloc_mutex.unlock();
 	unlock_range(rl);
         m_dealloc_mutex.unlock();
     }
+
+    return 0;
 }
 
 
@@ -38,33 +38,49 @@
 
 #include <efs-common.h>
 #include <nvram-nvml/segment.h>
-#include <mdds/flat_segment_tree.hpp>
+#include <extent-map.h>
+#include <range-set.h>
+#include <epoch.h>
 #include <range_lock.h>
 #include "backend-base.h"
 #include <fuse.h>
 #include <atomic>
+#include <mutex>
 
 namespace bfs = boost::filesystem;
 
 namespace efsng {
 namespace nvml {
 
+struct pool;
+
 using segment_ptr = std::shared_ptr<segment>;
-using segment_tree = mdds::flat_segment_tree<off_t, segment_ptr>;
+using segment_map = extent_map<segment_ptr>;
+using segment_snapshot = extent_snapshot<segment_ptr>;
 using segment_list = std::vector<segment_ptr>;
 
+/* a version of a file's segment map published for lock-free readers (never modified) */
+struct segment_version {
+    segment_snapshot    m_segments;
+    uint64_t            m_version;  /*!< Value of file::m_tree_version when it was published */
+};
+
 /* a contiguous file region */
 struct file_region {
-    file_region(data_ptr_t address, size_t size, bool is_gap, bool is_pmem)
+    file_region(data_ptr_t address, size_t size, bool is_gap, bool is_pmem, pool* pool, off_t fd_offset)
         : m_address(address),
           m_size(size),
           m_is_gap(is_gap),
-          m_is_pmem(is_pmem) { }
+          m_is_pmem(is_pmem),
+          m_pool(pool),
+          m_fd_offset(fd_offset) { }
 
     data_ptr_t m_address;
     size_t m_size;
     bool m_is_gap;
     bool m_is_pmem;
+    pool* m_pool;       /*!< Pool backing the region (NULL if none), for splicing from its file */
+    off_t m_fd_offset;  /*!< Offset of the region within the pool file */
 };
 
 struct file_region_list : public std::vector<file_region> {
@@ -82,8 +98,9 @@ struct file_region_list : public std::vector<file_region> {
         return m_size;
     }
 
-    void emplace_back(data_ptr_t address, size_t size, bool is_gap, bool is_pmem) {
-        this->std::vector<file_region>::emplace_back(address, size, is_gap, is_pmem);
+    void emplace_back(data_ptr_t address, size_t size, bool is_gap, bool is_pmem, 
+                      pool* pool = NULL, off_t fd_offset = 0) {
+        this->std::vector<file_region>::emplace_back(address, size, is_gap, is_pmem, pool, fd_offset);
         m_size += size;
     }
 
@@ -94,50 +111,91 @@ struct file_region_list : public std::vector<file_region> {
 struct file : public backend::file {
 
     file();
-    file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t inode, file::type type=file::type::persistent, bool populate=true);
+    file(const bfs::path& pool_base, const bfs::path& pathname, const ino_t inode, file::type type=file::type::persistent, bool populate=true,
+         std::atomic<uint64_t>* allocated = nullptr, bool splice_reads = false);
     ~file();
     void stat(struct stat& stbuf) const override;
 
     ssize_t get_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer);
-    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer);
+    ssize_t map_data(off_t offset, size_t size, backend::data_view_ptr& view, cursor* cur = nullptr) override;
+    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur = nullptr) override;
+    cursor_ptr new_cursor() const override;
     ssize_t append_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer);
-    void truncate(off_t offset) override;
-    ssize_t allocate (off_t offset, size_t size) override;
+    int truncate(off_t offset) override;
+    ssize_t allocate (off_t offset, size_t size, bool keep_size = false) override;
+    ssize_t punch_hole(off_t offset, size_t size) override;
+    ssize_t zero_range(off_t offset, size_t size, bool keep_size) override;
+    ssize_t copy_range(backend::file& src, off_t src_offset, off_t offset, size_t size) override;
+    uint64_t resident_bytes() const override;
+    int pin(bool pinned) override;
+    bool is_sealed() const override;
+    int sync(bool data_only) override;
     void save_attributes(struct stat& stbuf) override;
     int unload (const std::string dump_path) override;
     void change_type (file::type type) override;
+
+    /* create the subdir on the DAX filesystem where the file's pools live, if not 
+     * done yet. Files created empty don't have it, so that creating them doesn't 
+     * have to wait for the DAX filesystem: it's prepared either in the background 
+     * right after creation (see nvml_backend::do_create()) or by the first operation 
+     * that needs storage, whichever comes first */
+    void prepare_storage();
+
+protected:
+    void hints_changed() override;
+
 private:
 
+    class pinned_view;
+    struct segment_cursor;
+    struct sealed_layout;
+
     size_t size() const;
     void update_size(size_t size);
     
 
-    void fetch_storage(off_t offset, size_t size, file_region_list& regions);
+    void fetch_storage(off_t offset, size_t size, file_region_list& regions, segment_cursor* cur = nullptr);
     lock_manager::range_lock lock_range(off_t start, off_t end, operation op);
     void unlock_range(lock_manager::range_lock& rl);
 
-    void lookup_data(off_t start, off_t end, file_region_list& regions) const;
-    void lookup_segments(off_t start, off_t end, file_region_list& regions);
-    void lookup_helper(off_t start, off_t end, bool alloc_gaps_as_needed, file_region_list& regions);
+    void lookup_data(off_t start, off_t end, file_region_list& regions, segment_cursor* cur = nullptr) const;
+    void lookup_segments(off_t start, off_t end, file_region_list& regions, segment_cursor* cur = nullptr);
+    template <typename Segments>
+    void lookup_helper(const Segments& segments, uint64_t version, off_t start, off_t end, 
+                       bool alloc_gaps_as_needed, file_region_list& regions, segment_cursor* cur);
 
     void append_segments(const segment_list& segments);
     void insert_segments(const segment_list& segments);
+    segment_ptr unshare_segment(const segment_ptr& sptr);
+    void publish_segments();
+
+    void update_seal();
+    void unseal();
+    void map_sealed(const sealed_layout& layout, off_t start, off_t end, pinned_view& pv) const;
+
+    void mark_dirty(off_t start, off_t end);
 
     bfs::path generate_pool_subdir(const bfs::path& pool_base, const bfs::path& pathname) const;
+    void create_pool_subdir();
     segment_ptr create_segment(off_t offset, size_t min_size, bool is_gap);
 
     bfs::path m_pathname;
     file::type m_type;
     bfs::path m_pool_subdir;
+    std::atomic<uint64_t>* m_allocated; /*!< Backend counter updated as segments are mapped/unmapped */
+    bool m_splice_reads; /*!< Serve reads by splicing from pool files (set by the backend) */
 
     struct stat m_attributes; /*!< File attributes */
 
     off_t m_alloc_offset; /*!< Maximum allocated offset */
-    off_t m_used_offset; /*!< Maximum used offset, i.e. eof */
+    std::atomic<off_t> m_used_offset; /*!< Maximum used offset, i.e. eof */
 
     uint64_t m_segment_size; /*!< Last segment size used */
 
-    segment_tree                m_segments;
+    segment_map                 m_segments;     /*!< Segments as seen by writers (protected by m_alloc_mutex) */
+    uint64_t                    m_tree_version; /*!< Bumped on every change to m_segments (protected by m_alloc_mutex) */
+    std::atomic<const segment_version*> m_published; /*!< Last version of m_segments made visible to readers */
+    std::atomic<const sealed_layout*> m_sealed; /*!< Frozen layout of a sealed file (nullptr if not sealed) */
     std::atomic<bool> m_initialized; /*!< segments initialized ? */
     mutable boost::shared_mutex m_initialized_mutex;
     mutable boost::shared_mutex m_alloc_mutex; /*!< Mutex to synchronize reader/writer access to the tree */
@@ -145,6 +203,10 @@ private:
 
     mutable lock_manager m_range_mutex;    /*!< Mutex in charge of handling range locks */
 
+    std::mutex m_dirty_mutex;   /*!< Protects m_dirty */
+    range_set m_dirty;          /*!< Ranges written but not flushed yet (see sync()) */
+    std::mutex m_sync_mutex;    /*!< Serializes sync() calls */
+
 };
 
 } // namespace nvml
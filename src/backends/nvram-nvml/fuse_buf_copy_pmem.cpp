@@ -32,9 +32,10 @@
 
 
 /* This code implements fuse_buf_copy_pmem, a function identical to 
- * fuse_buf_copy but that relies on NVM-aware functions pmem_memcpy_* and 
- * pmem_memmove_* from the NVML library rather than the standard 
- * memcpy and memmove.
+ * fuse_buf_copy but that copies between memory buffers with copy_memory() 
+ * (see copy-engine.h), which picks the stores and the flushes that suit the 
+ * destination, rather than the standard memcpy. Overlapping buffers rely on 
+ * pmem_memmove_* from the NVML library.
  *
  * The code is taken verbatim from FUSE's lib/buffer.c (v2.9.2.) with 
  * minor changes to conform to C++ and avoid compiler warnings.
@@ -48,6 +49,9 @@
 #include <assert.h>
 
 #include <libpmem.h>
+#include <string.h>
+
+#include "fuse_buf_copy_pmem.h"
 
 size_t fuse_buf_size(const struct fuse_bufvec *bufv)
 {
@@ -255,7 +259,8 @@ static ssize_t fuse_buf_splice(const struct fuse_buf *dst, size_t dst_off,
 
 static ssize_t fuse_buf_copy_one(const struct fuse_buf *dst, size_t dst_off,
 				 const struct fuse_buf *src, size_t src_off,
-				 size_t len, enum fuse_buf_copy_flags flags)
+				 size_t len, enum fuse_buf_copy_flags flags,
+				 efsng::memory_kind kind)
 {
 	int src_is_fd = src->flags & FUSE_BUF_IS_FD;
 	int dst_is_fd = dst->flags & FUSE_BUF_IS_FD;
@@ -266,9 +271,11 @@ static ssize_t fuse_buf_copy_one(const struct fuse_buf *dst, size_t dst_off,
 
 		if (dstmem != srcmem) {
 			if ((char*) dstmem + len <= srcmem || (char*) srcmem + len <= dstmem)
-			    pmem_memcpy_nodrain(dstmem, srcmem, len);
-			else
+				efsng::copy_memory(dstmem, srcmem, len, kind);
+			else if (kind == efsng::memory_kind::pmem)
 				pmem_memmove_nodrain(dstmem, srcmem, len);
+			else
+				memmove(dstmem, srcmem, len);
 		}
 
 		return len;
@@ -308,7 +315,7 @@ static int fuse_bufvec_advance(struct fuse_bufvec *bufv, size_t len)
 }
 
 ssize_t fuse_buf_copy_pmem(struct fuse_bufvec *dstv, struct fuse_bufvec *srcv,
-		      enum fuse_buf_copy_flags flags)
+		      enum fuse_buf_copy_flags flags, efsng::memory_kind kind)
 {
 	size_t copied = 0;
 
@@ -330,7 +337,7 @@ ssize_t fuse_buf_copy_pmem(struct fuse_bufvec *dstv, struct fuse_bufvec *srcv,
 		dst_len = dst->size - dstv->off;
 		len = min_size(src_len, dst_len);
 
-		res = fuse_buf_copy_one(dst, dstv->off, src, srcv->off, len, flags);
+		res = fuse_buf_copy_one(dst, dstv->off, src, srcv->off, len, flags, kind);
 		if (res < 0) {
 			if (!copied)
 				return res;
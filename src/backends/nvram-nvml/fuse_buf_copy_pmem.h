@@ -32,6 +32,9 @@
 
 
 #include <fuse.h>
+#include <copy-engine.h>
 
+/* 'kind' is the kind of memory that memory buffers in 'dstv' belong to */
 ssize_t fuse_buf_copy_pmem(struct fuse_bufvec *dstv, struct fuse_bufvec *srcv,
-		                   enum fuse_buf_copy_flags flags);
+		                   enum fuse_buf_copy_flags flags, 
+		                   efsng::memory_kind kind = efsng::memory_kind::pmem);
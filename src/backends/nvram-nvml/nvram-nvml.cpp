@@ -31,6 +31,10 @@
 */ 
 
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
 /* C includes */
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -61,19 +65,42 @@
 namespace efsng {
 namespace nvml {
 
-nvml_backend::nvml_backend(uint64_t capacity, bfs::path daxfs_mount, bfs::path root_dir, int64_t segment_size)
+nvml_backend::nvml_backend(uint64_t capacity, bfs::path daxfs_mount, bfs::path root_dir, int64_t segment_size, 
+                           bool splice_reads, size_t transfer_size)
     : m_capacity(capacity),
       m_daxfs_mount_point(daxfs_mount),
-      m_root_dir(root_dir) {
+      m_root_dir(root_dir),
+      m_splice_reads(splice_reads),
+      i_inode(1) {
 
     if(segment_size != -1) {
         segment::s_segment_size = (size_t) segment_size;
     }
 
+#ifdef HAVE_PMEM_HAS_AUTO_FLUSH
+    segment::s_auto_flush = (pmem_has_auto_flush() == 1);
+
+    if(segment::s_auto_flush) {
+        LOGGER_INFO("Platform flushes CPU caches on power failure: pmem writes need no flushing");
+    }
+#endif /* HAVE_PMEM_HAS_AUTO_FLUSH */
+
+    if(transfer_size != 0) {
+        // use the largest power of 2 that fits in a FUSE request (and in a segment)
+        size_t alignment = NVML_TRANSFER_SIZE;
+
+        while(alignment * 2 <= transfer_size && alignment * 2 <= segment::s_segment_size) {
+            alignment *= 2;
+        }
+
+        segment::s_alignment = alignment;
+    }
+
     // Insert the root dir into the map
 
     std::lock_guard<std::mutex> lock(m_dirs_mutex);
     m_dirs.emplace("/", std::make_unique<nvml::dir>("/",new_inode(), m_root_dir));
+    m_usage.m_dirs = m_dirs.size();
 }
 
 nvml_backend::~nvml_backend(){
@@ -122,7 +149,9 @@ error_code nvml_backend::load(const bfs::path& pathname, backend::file::type typ
     /* create a new file into m_files (the constructor will fill it with
      * the contents of the pathname) */
      auto it = m_files.emplace(path_wo_root, 
-                              std::make_unique<nvml::file>(m_daxfs_mount_point, pathname, new_inode(), type));
+                              std::make_unique<nvml::file>(m_daxfs_mount_point, pathname, new_inode(), type, true, 
+                                                           &m_usage.m_bytes, m_splice_reads));
+     m_usage.m_files = m_files.size();
   
 
     // Iterate the path to fill the info
@@ -146,6 +175,7 @@ error_code nvml_backend::load(const bfs::path& pathname, backend::file::type typ
         //td::cout << "IMPORTING " << buildPath << " d_it==m_dirs.end() " << (bool)(d_it==m_dirs.end()) << std::endl;
         if (d_it == m_dirs.end()){
             m_dirs.emplace(buildPath, std::make_unique<nvml::dir>(buildPath,new_inode(), m_root_dir.string()+buildPath));
+            m_usage.m_dirs = m_dirs.size();
             // Add to the parent
             parent = m_dirs.find(buildPath.substr(0,buildPath.rfind(m_path[i])));
             parent->second.get()->add_file(m_path[i]);
@@ -244,31 +274,69 @@ bool nvml_backend::exists(const char* pathname) const {
     return it != m_files.end();
 }
 
-// TODO: Error control
 int nvml_backend::do_readdir (const char * path, void * buffer, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi) const {
-    (void) offset;
     (void) fi;
-    LOGGER_DEBUG("Inside backend readdir for {}", path);
+    LOGGER_DEBUG("Inside backend readdir for {} (offset {})", path, offset);
+
+    /* pass each entry to the filler along with its attributes, so that 
+     * listing a directory does not need a stat() for every entry */
+    auto fill = [&](const char* name, const struct stat* stbuf, off_t off) -> bool {
     #if FUSE_USE_VERSION < 30
-	filler(buffer, ".", NULL, 0);
-	filler(buffer, "..", NULL, 0);
+        return filler(buffer, name, stbuf, off) == 0;
     #else
-	filler(buffer,".", NULL,0,(fuse_fill_dir_flags)0);
-	filler(buffer,"..", NULL,0,(fuse_fill_dir_flags)0);
+        return filler(buffer, name, stbuf, off, FUSE_FILL_DIR_PLUS) == 0;
     #endif
-    std::list <std::string> ls = find_s(path);
-    
-    for (auto &file : ls) {    
-        if (file.length() > 0 and file[file.length()-1]=='/') { 
+    };
+
+    // same locking order as do_stat()
+    std::lock_guard<std::mutex> lock(m_files_mutex);
+    std::lock_guard<std::mutex> lock_dir(m_dirs_mutex);
+
+    // Only the root path is send with /. We add the slash at the end if not.
+    std::string dir_path = path;
+    if (dir_path.length() == 0 or dir_path.back() != '/') 
+        dir_path.push_back('/');
+
+    auto d_it = m_dirs.find(dir_path);
+    if (d_it == m_dirs.end()) {
+        return -ENOENT;
+    }
+
+    struct stat stbuf;
+    d_it->second->stat(stbuf);
+
+    if (offset < 1 and !fill(".", &stbuf, 1)) {
+        return 0;
+    }
+
+    if (offset < 2 and !fill("..", NULL, 2)) {
+        return 0;
+    }
+
+    d_it->second->list_files(offset, [&](const std::string& entry, off_t off) -> bool {
+        std::string name = entry;
+        if (name.length() > 0 and name.back() == '/') { 
             // We remove the last slash
-            file.pop_back();
+            name.pop_back();
         }
-	#if FUSE_USE_VERSION < 30
-		filler(buffer, file.c_str(), NULL, 0);
-	#else
-		filler(buffer, file.c_str(), NULL, 0, (fuse_fill_dir_flags)0);
-	#endif
-    }
+
+        std::string child = dir_path + name;
+
+        auto file = m_files.find(child);
+        if (file != m_files.end()) {
+            file->second->stat(stbuf);
+            return fill(name.c_str(), &stbuf, off);
+        }
+
+        auto dir = m_dirs.find(child + "/");
+        if (dir != m_dirs.end()) {
+            dir->second->stat(stbuf);
+            return fill(name.c_str(), &stbuf, off);
+        }
+
+        return fill(name.c_str(), NULL, off);
+    });
+
     return 0;
 }
 
@@ -280,7 +348,7 @@ int nvml_backend::do_stat (const char * path, struct stat& stbuf) const {
     {
         std::lock_guard<std::mutex> lock(m_files_mutex); // Avoid deadlock on create
         
-        auto file = m_files.count(path) > 0 ? m_files.find(path) : m_files.end();
+        auto file = m_files.find(path);
         if (file != m_files.end()) {
             const auto& file_ptr = file->second;
             file_ptr->stat(stbuf);
@@ -291,8 +359,7 @@ int nvml_backend::do_stat (const char * path, struct stat& stbuf) const {
             std::string path_wo_root_slash = path;
             if (path_wo_root_slash.length()>1) path_wo_root_slash.push_back('/');
             std::lock_guard<std::mutex> lock_dir(m_dirs_mutex);
-            auto dir = m_dirs.count(path_wo_root_slash) > 0 ? m_dirs.find(path_wo_root_slash) : m_dirs.end();
-//            auto dir = m_dirs.find(path_wo_root_slash);
+            auto dir = m_dirs.find(path_wo_root_slash);
             if (dir != m_dirs.end()) {
                 //Fill directory entry
                 dir->second.get()->stat(stbuf);
@@ -320,7 +387,7 @@ int nvml_backend::do_create(const char* pathname, mode_t mode, std::shared_ptr <
     stbuf.st_size = 0;
     stbuf.st_blocks = 0;
 
-    std::lock_guard<std::mutex> lock(m_files_mutex);
+    std::unique_lock<std::mutex> lock(m_files_mutex);
     if(m_files.count(path_wo_root) != 0) {
         return -1;
     }
@@ -345,13 +412,37 @@ int nvml_backend::do_create(const char* pathname, mode_t mode, std::shared_ptr <
     /* create a new file into m_files (the constructor will fill it with
      * the contents of the pathname) */
     auto it = m_files.emplace(path_wo_root, 
-                              std::make_unique<nvml::file>(m_daxfs_mount_point, pathname, 0 ,file::type::temporary,false));
+                              std::make_unique<nvml::file>(m_daxfs_mount_point, pathname, 0 ,file::type::temporary,false, 
+                                                           &m_usage.m_bytes, m_splice_reads));
+    m_usage.m_files = m_files.size();
 
     stbuf.st_ino = new_inode();
     auto& file_ptr = (*(it.first)).second;
     auto nvml_f_ptr = dynamic_cast<nvml::file * >(file_ptr.get());
     nvml_f_ptr->save_attributes(stbuf);
     file = std::shared_ptr<backend::file> (file_ptr);
+
+    lock.unlock();
+
+    /* the file can be used already: its pool subdir is only needed once data is 
+     * written, so don't keep the creator (and everyone waiting for m_files_mutex) 
+     * waiting for the DAX filesystem. Whoever gets there first sets it up */
+    std::weak_ptr<backend::file> weak_ptr = file;
+
+    defer([weak_ptr]() {
+        auto ptr = weak_ptr.lock();
+
+        if(ptr == nullptr) {
+            return;
+        }
+
+        try {
+            static_cast<nvml::file*>(ptr.get())->prepare_storage();
+        }
+        catch(const std::exception& e) {
+            LOGGER_WARN("Unable to prepare storage in advance: {}", e.what());
+        }
+    });
    
     return 0;
 }
@@ -360,13 +451,17 @@ int nvml_backend::do_create(const char* pathname, mode_t mode, std::shared_ptr <
 
 int nvml_backend::do_unlink(const char * pathname) {
     std::string path = pathname;
+    // declared before the locks so that, if this was the last reference, the
+    // file's pools are removed from the DAX filesystem once they are released
+    file_ptr victim;
     std::lock_guard<std::mutex> lock(m_files_mutex);
     std::lock_guard<std::mutex> lock_dir(m_dirs_mutex);
     // Remove the file
     auto file = m_files.find(path);
     if (file != m_files.end()) {
-        //const auto& file_ptr = file->second;
+        victim = file->second;
         m_files.erase(file);
+        m_usage.m_files = m_files.size();
     } 
     else { 
         LOGGER_DEBUG("do_unlink not found file {}",pathname); 
@@ -405,6 +500,7 @@ int nvml_backend::do_renamedir(std::string opath, std::string npath)
         dir->second.get()->save_attributes(stbuf);
         std::swap(m_dirs[npath], dir->second);
         m_dirs.erase(dir);
+        m_usage.m_dirs = m_dirs.size();
 
     }
 
@@ -416,6 +512,8 @@ int nvml_backend::do_rename(const char * oldpath, const char * newpath) {
     // Create the other file
     std::string opath = oldpath;
     std::string npath = newpath;
+    // a replaced file is destroyed once the locks are released (see do_unlink())
+    file_ptr victim;
   
     std::lock_guard<std::mutex> lock(m_files_mutex);
     std::lock_guard<std::mutex> lock_dir(m_dirs_mutex);
@@ -446,8 +544,9 @@ int nvml_backend::do_rename(const char * oldpath, const char * newpath) {
                     // Remove the file
         auto file = m_files.find(path);
         if (file != m_files.end()) {
-        const auto& file_ptr = file->second;
+        victim = file->second;
         m_files.erase(file);
+        m_usage.m_files = m_files.size();
         }
         std::string path_wo_root_slash = path.substr(0,path.rfind('/')+1);
         if (path_wo_root_slash.size() == 0 or path_wo_root_slash.back() != '/')    path_wo_root_slash.push_back('/');
@@ -475,6 +574,7 @@ int nvml_backend::do_rename(const char * oldpath, const char * newpath) {
     // remove old file
 
     m_files.erase(file); // Check: pointer should not be deleted...
+    m_usage.m_files = m_files.size();
     
     // Now we should update directory
 
@@ -512,6 +612,7 @@ int nvml_backend::do_mkdir(const char * pathname, mode_t mode) {
 
 
         auto it = m_dirs.emplace(path_wo_root, std::make_unique<nvml::dir>(path_wo_root, new_inode(), m_root_dir.string() + path_wo_root,dir::type::temporary,false));
+        m_usage.m_dirs = m_dirs.size();
 
         struct stat stbuf;
         it.first->second.get()->stat(stbuf);
@@ -562,6 +663,7 @@ int nvml_backend::do_rmdir(const char * pathname) {
         }
 
         m_dirs.erase(dir);  
+        m_usage.m_dirs = m_dirs.size();
 
         path_wo_root.pop_back();
         auto parent_path = path_wo_root.substr(0,path_wo_root.rfind('/')+1);
@@ -651,29 +753,6 @@ backend::iterator nvml_backend::find(const char* path) {
     return m_files.find(path);
 }
 
-std::list <std::string> nvml_backend::find_s(const std::string path) const {
-    std::string result;
-
-    std::list <std::string> l_files;
-    std::lock_guard<std::mutex> lock(m_dirs_mutex);
-
-    // Only the root path is send with /. We add the slash at the end if not.
-    std::string tmp_path = path;
-    std::size_t slash = tmp_path.rfind("/");
-    if (slash != tmp_path.length()-1) 
-        tmp_path.push_back('/');
-
-    auto d_it = m_dirs.find(tmp_path);
-    LOGGER_DEBUG("FIND_S {}",tmp_path);
-    if (d_it != m_dirs.end()) {
-        // Search the path and insert it on the dir structure
-        // TODO: The dir structure will have a list with pointers to the nvml::file so we reduce one indirection.
-        d_it->second.get()->list_files(l_files);  // Store the substr
-    }
-
-    return l_files;
-}
-
 void nvml_backend::do_change_type(const char * path, backend::file::type  type){
 	auto file = m_files.find(remove_root(path));
 	if ( file != m_files.end() ){
@@ -61,7 +61,8 @@ class nvml_backend : public efsng::backend {
     static constexpr const char* s_name = "NVRAM-NVML";
 
 public:
-    nvml_backend(uint64_t capacity, bfs::path daxfs_mount, bfs::path root_dir, int64_t segment_size);
+    nvml_backend(uint64_t capacity, bfs::path daxfs_mount, bfs::path root_dir, int64_t segment_size, 
+                 bool splice_reads = false, size_t transfer_size = 0);
     ~nvml_backend();
 
     std::string name() const override;
@@ -99,6 +100,9 @@ private:
     bfs::path m_daxfs_mount_point;
     bfs::path m_root_dir;
 
+    /* serve reads by splicing from pool files (passed on to each file) */
+    bool m_splice_reads;
+
     mutable std::mutex                    m_files_mutex;
     
     std::unordered_map<std::string, file_ptr> m_files;
@@ -106,10 +110,9 @@ private:
     mutable std::mutex m_dirs_mutex;
     std::unordered_map<std::string, dir_ptr> m_dirs;
     
+    /* next inode number to hand out (the root dir gets 1, i.e. FUSE_ROOT_ID) */
     mutable std::atomic<ino_t> i_inode;
 
-    std::list <std::string> find_s(const std::string path) const;
-
     // Utils
     std::string remove_root (std::string path) const;
     int do_renamedir(std::string opath, std::string npath);
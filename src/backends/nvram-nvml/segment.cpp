@@ -35,6 +35,9 @@
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/uuid_generators.hpp>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <libpmem.h>
 
 #include <logger.h>
@@ -63,31 +66,103 @@ namespace efsng {
 namespace nvml {
 
 size_t segment::s_segment_size = segment::default_segment_size;
+size_t segment::s_alignment = NVML_TRANSFER_SIZE;
+bool segment::s_auto_flush = false;
+std::atomic<size_t> pool::s_open_fds(0);
+
+/* descriptors kept open for splicing are capped to half of RLIMIT_NOFILE, so that 
+ * large staged datasets (one pool per segment) don't starve the rest of the process */
+static size_t max_pool_fds() {
+
+    struct rlimit rl;
+
+    if(::getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY) {
+        return 4096;
+    }
+
+    return rl.rlim_cur / 2;
+}
 
 // we need a definition of the constant because std::min/max rely on references
 // (see: http://stackoverflow.com/questions/16957458/static-const-in-c-class-undefined-reference)
 
-pool::pool(const bfs::path& subdir)
+pool::pool(const bfs::path& subdir, std::atomic<uint64_t>* allocated)
     : m_subdir(subdir),
       m_path(),
       m_data(NULL),
-      m_is_pmem(0) {}
+      m_is_pmem(0),
+      m_fd(-1),
+      m_allocated(allocated) {}
 
 pool::~pool() {
 //    std::cerr << "Died! (" << m_data << ")\n";
+    release();
+}
+
+/* unmap the pool and remove its file so that its space goes back to the DAX filesystem */
+void pool::release() {
 
-    // release the mapped region
     if(m_data != NULL) {
         pmem_unmap(m_data, m_length);
-        bfs::path pool_path;
-        pool_path = ::generate_pool_path(m_subdir);
-        if(bfs::exists(pool_path)){
-            if(::unlink(pool_path.c_str()) != 0){
-                throw std::runtime_error(
-                    logger::build_message("Error removing pool file: ", pool_path, " (", strerror(errno), ")"));
-            }
+        m_data = NULL;
+
+        if(m_allocated != NULL) {
+            *m_allocated -= m_length;
         }
 
+        // nothing sensible can be done if this fails (we may be in a destructor): 
+        // the file will be removed along with the pool subdir anyway
+        if(!m_path.empty()) {
+            ::unlink(m_path.c_str());
+            m_path.clear();
+        }
+    }
+
+    close_fd();
+}
+
+/* return a read-only descriptor for the pool file, opening it on first use. Returns -1 
+ * if the pool has no file or if too many pool descriptors are open (callers should then 
+ * fall back to reading from the mapping) */
+int pool::fd() {
+
+    int fd = m_fd.load();
+
+    if(fd != -1 || m_data == NULL || m_path.empty()) {
+        return fd;
+    }
+
+    static const size_t max_fds = max_pool_fds();
+
+    if(++s_open_fds > max_fds) {
+        --s_open_fds;
+        return -1;
+    }
+
+    if((fd = ::open(m_path.c_str(), O_RDONLY)) == -1) {
+        --s_open_fds;
+        return -1;
+    }
+
+    // another reader may have beaten us to it
+    int expected = -1;
+
+    if(!m_fd.compare_exchange_strong(expected, fd)) {
+        ::close(fd);
+        --s_open_fds;
+        return expected;
+    }
+
+    return fd;
+}
+
+void pool::close_fd() {
+
+    int fd = m_fd.exchange(-1);
+
+    if(fd != -1) {
+        ::close(fd);
+        --s_open_fds;
     }
 }
 
@@ -124,22 +199,32 @@ void pool::allocate(size_t size) {
         throw std::runtime_error("File segment of different size than requested");
     }
 
+    /* pmem_map_file() doesn't keep the file open: a descriptor to splice data 
+     * from is opened on demand (see fd()) */
+    close_fd(); // left over from a truncated segment
+
     m_path = pool_path;
     m_data = pool_addr;
     m_length = pool_length;
     m_is_pmem = is_pmem;
+
+    if(m_allocated != NULL) {
+        *m_allocated += m_length;
+    }
 }
 
-segment::segment(const bfs::path& subdir, off_t offset, size_t size, bool is_gap)
+segment::segment(const bfs::path& subdir, off_t offset, size_t size, bool is_gap, 
+                 std::atomic<uint64_t>* allocated)
     : m_offset(offset), 
       m_size(size),
       m_is_gap(is_gap),
-      m_pool(subdir) {
+      m_subdir(subdir),
+      m_pool(std::make_shared<pool>(subdir, allocated)) {
 
     m_bytes = 0; // will be set by fill_from()
 
     if(!is_gap) {
-        m_pool.allocate(size);
+        m_pool->allocate(size);
     }
 }
 
@@ -151,7 +236,46 @@ void segment::allocate(off_t offset, size_t size) {
     m_offset = offset;
     m_size = size;
     m_is_gap = false;
-    m_pool.allocate(size);
+
+    if(is_shared()) {
+        m_pool = std::make_shared<pool>(m_subdir, m_pool->m_allocated);
+    }
+
+    m_pool->allocate(size);
+}
+
+/* make the segment refer to the same storage as another segment of the same 
+ * size (copy-on-write: the first one to modify its data calls unshare()) */
+void segment::share(const std::shared_ptr<pool>& pool) {
+
+    assert(pool->m_data != NULL && pool->m_length == m_size);
+
+    m_pool = pool;
+    m_is_gap = false;
+}
+
+/* give the segment a private copy of its data if it is shared with other segments */
+void segment::unshare() {
+
+    if(m_is_gap || !is_shared()) {
+        return;
+    }
+
+    auto pptr = std::make_shared<pool>(m_subdir, m_pool->m_allocated);
+    pptr->allocate(m_size);
+
+    if(pptr->m_is_pmem) {
+        pmem_memcpy_persist(pptr->m_data, m_pool->m_data, m_size);
+    }
+    else {
+        memcpy(pptr->m_data, m_pool->m_data, m_size);
+    }
+
+    m_pool = pptr;
+}
+
+bool segment::is_shared() const {
+    return m_pool.use_count() > 1;
 }
 
 void segment::sync_all() {
@@ -159,11 +283,11 @@ void segment::sync_all() {
 }
 
 bool segment::is_pmem() const {
-    return m_pool.m_is_pmem;
+    return m_pool->m_is_pmem;
 }
 
 data_ptr_t segment::data() const {
-    return m_pool.m_data;
+    return m_pool->m_data;
 }
 
 void segment::zero_fill(off_t offset, size_t size) {
@@ -172,18 +296,20 @@ void segment::zero_fill(off_t offset, size_t size) {
         return;
     }
 
+    unshare();
+
     assert(offset + size <= m_size);
 
-    if(m_pool.m_is_pmem) {
-        pmem_memset_persist((void*) ((uintptr_t) m_pool.m_data + offset), 0, size);
+    if(m_pool->m_is_pmem) {
+        pmem_memset_persist((void*) ((uintptr_t) m_pool->m_data + offset), 0, size);
     }
     else {
-        memset((void*) ((uintptr_t) m_pool.m_data + offset), 0, size);
+        memset((void*) ((uintptr_t) m_pool->m_data + offset), 0, size);
     }
 }
 
 size_t segment::fill_from(const posix::file& fdesc) {
-    m_bytes = m_pool.m_is_pmem ? copy_data_to_pmem(fdesc) : copy_data_to_non_pmem(fdesc);
+    m_bytes = m_pool->m_is_pmem ? copy_data_to_pmem(fdesc) : copy_data_to_non_pmem(fdesc);
 
     // fill the rest of the allocated segment with zeros so that reads beyond EOF work as expected
     zero_fill(m_bytes, m_size - m_bytes);
@@ -193,7 +319,7 @@ size_t segment::fill_from(const posix::file& fdesc) {
 
 ssize_t segment::copy_data_to_pmem(const posix::file& fdesc){
 
-    char* addr = (char*) m_pool.m_data;
+    char* addr = (char*) m_pool->m_data;
     char* buffer = (char*) malloc(NVML_TRANSFER_SIZE*sizeof(*buffer));
 
     if(buffer == NULL){
@@ -229,7 +355,7 @@ ssize_t segment::copy_data_to_pmem(const posix::file& fdesc){
 
 ssize_t segment::copy_data_to_non_pmem(const posix::file& fdesc){
 
-    char* addr = (char*) m_pool.m_data;
+    char* addr = (char*) m_pool->m_data;
     char* buffer = (char*) malloc(NVML_TRANSFER_SIZE*sizeof(*buffer));
 
     if(buffer == NULL){
@@ -269,11 +395,11 @@ ssize_t segment::copy_data_to_non_pmem(const posix::file& fdesc){
 std::ostream& operator<<(std::ostream& os, const efsng::nvml::segment& mp) {
     os << "segment {" << "\n"
        << "  m_is_gap: " << mp.m_is_gap << "\n"
-       << "  m_data: " << mp.m_pool.m_data << "\n"
+       << "  m_data: " << mp.m_pool->m_data << "\n"
        << "  m_offset: " << mp.m_offset << "\n"
        << "  m_size: " << mp.m_size << "\n"
        << "  m_bytes: " << mp.m_bytes << "\n"
-       << "  m_is_pmem: " << mp.m_pool.m_is_pmem << "\n"
+       << "  m_is_pmem: " << mp.m_pool->m_is_pmem << "\n"
        << "};";
 
     return os;
@@ -46,15 +46,24 @@ namespace nvml {
 static const uint64_t NVML_TRANSFER_SIZE = 0x1000; // 4KiB
 
 struct pool {
-    pool(const bfs::path& subdir);
+    pool(const bfs::path& subdir, std::atomic<uint64_t>* allocated = nullptr);
     ~pool();
     void allocate(size_t size);
+    void release();
+    int fd();
 
     bfs::path                   m_subdir;   /*!< Subdir to store file segments */
     bfs::path                   m_path;     /*!< Segment's 'filesystem name' */
     data_ptr_t                  m_data;     /*!< Mapped data */
     size_t                      m_length;
     int                         m_is_pmem;  /*!< NVML-required flag */
+    std::atomic<int>            m_fd;       /*!< Read-only descriptor for splicing data (-1 if not open) */
+    std::atomic<uint64_t>*      m_allocated; /*!< Backend-wide counter of mapped bytes (may be NULL) */
+
+    static std::atomic<size_t>  s_open_fds; /*!< Pool descriptors currently open (process-wide) */
+
+private:
+    void close_fd();
 };
 
 /* descriptor for an in-NVM mmap()-ed file region */
@@ -62,21 +71,28 @@ struct segment {
 
     constexpr static const size_t default_segment_size = 128*1024*1024;
     static size_t s_segment_size; // = 512*1024*1024; // 512MiB
+    static size_t s_alignment; /*!< Segments grow in multiples of this (a power of 2 matching the FUSE transfer size) */
+    static bool s_auto_flush; /*!< CPU caches are flushed on power failure (eADR): pmem needs no explicit flushes */
 
 
     off_t                       m_offset;   /*!< Base offset within file */
     size_t                      m_size;     /*!< Mapped size */
     bool                        m_is_gap;   /*!< Segment is a zero-filled gap */
-    struct pool                 m_pool;     /*!< Pool descriptor for the segment */
+    bfs::path                   m_subdir;   /*!< Subdir where new pools for the segment are created */
+    std::shared_ptr<pool>       m_pool;     /*!< Pool descriptor for the segment (may be shared, see share()) */
 
     size_t                      m_bytes;    /*!< Used size */ /* TODO : Reducir para el truncate */
 
-    segment(const bfs::path& subdir, off_t offset, size_t size, bool is_gap);
+    segment(const bfs::path& subdir, off_t offset, size_t size, bool is_gap, 
+            std::atomic<uint64_t>* allocated = nullptr);
     ~segment();
 
     static void sync_all();
 
     void allocate(off_t offset, size_t size);
+    void share(const std::shared_ptr<pool>& pool);
+    void unshare();
+    bool is_shared() const;
     bool is_pmem() const;
     data_ptr_t data() const;
 
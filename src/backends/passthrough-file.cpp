@@ -0,0 +1,240 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstring>
+
+#include <logger.h>
+#include <passthrough-file.h>
+
+namespace efsng {
+namespace passthrough {
+
+int file::open(const bfs::path& origin, int flags, backend::file_ptr& file) {
+
+    int fd = ::open(origin.c_str(), flags & ~(O_CREAT | O_EXCL));
+
+    if(fd == -1) {
+        return -errno;
+    }
+
+    struct stat stbuf;
+
+    int error = 0;
+
+    if(fstat(fd, &stbuf) == -1) {
+        error = errno;
+    }
+    else if(!S_ISREG(stbuf.st_mode)) {
+        error = S_ISDIR(stbuf.st_mode) ? EISDIR : EINVAL;
+    }
+
+    if(error != 0) {
+        ::close(fd);
+        return -error;
+    }
+
+    file.reset(new passthrough::file(fd, origin));
+    return 0;
+}
+
+file::file(int fd, const bfs::path& origin)
+    : backend::file(),
+      m_fd(fd),
+      m_origin(origin),
+      m_backing_id(0) { }
+
+file::~file() {
+    if(::close(m_fd) == -1) {
+        LOGGER_WARN("Error closing {}: {}", m_origin.string(), strerror(errno));
+    }
+}
+
+void file::stat(struct stat& buf) const {
+    if(fstat(m_fd, &buf) == -1) {
+        memset(&buf, 0, sizeof(buf));
+    }
+}
+
+ssize_t file::get_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+
+    /* callers of get_data() free() the buffer */
+    void* mem = malloc(std::max(size, (size_t) 1));
+
+    if(mem == NULL) {
+        return -ENOMEM;
+    }
+
+    ssize_t n = pread(m_fd, mem, size, offset);
+
+    if(n == -1) {
+        int error = errno;
+        free(mem);
+        return -error;
+    }
+
+    fuse_buffer->buf[0].mem = mem;
+    fuse_buffer->buf[0].size = n;
+
+    return n;
+}
+
+ssize_t file::map_data(off_t offset, size_t size, backend::data_view_ptr& view, cursor* cur) {
+
+    (void) cur;
+
+    struct stat stbuf;
+
+    if(fstat(m_fd, &stbuf) == -1) {
+        return -errno;
+    }
+
+    view.reset(new backend::data_view());
+
+    if(offset >= stbuf.st_size) {
+        return 0;
+    }
+
+    /* let libfuse splice the data from the original file (it falls back to 
+     * reading it if splicing is not possible) */
+    size_t n = std::min(size, (size_t) (stbuf.st_size - offset));
+    view->add_fd(m_fd, offset, n);
+
+    return n;
+}
+
+ssize_t file::put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur) {
+
+    (void) cur;
+
+    struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+
+    dst.buf[0].flags = (fuse_buf_flags) (FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+    dst.buf[0].fd = m_fd;
+    dst.buf[0].pos = offset;
+
+    ssize_t rv = fuse_buf_copy(&dst, fuse_buffer, (fuse_buf_copy_flags) 0);
+
+    if(rv >= 0 && hints().consistency() == file_hints::consistency_level::strict && fdatasync(m_fd) == -1) {
+        return -errno;
+    }
+
+    return rv;
+}
+
+ssize_t file::append_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) {
+    return put_data(offset, size, fuse_buffer);
+}
+
+ssize_t file::allocate(off_t offset, size_t size, bool keep_size) {
+
+    if(::fallocate(m_fd, keep_size ? FALLOC_FL_KEEP_SIZE : 0, offset, size) == -1) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+ssize_t file::punch_hole(off_t offset, size_t size) {
+
+    if(::fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size) == -1) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+int file::sync(bool data_only) {
+
+#ifdef HAVE_FDATASYNC
+    int rv = data_only ? ::fdatasync(m_fd) : ::fsync(m_fd);
+#else
+    (void) data_only;
+    int rv = ::fsync(m_fd);
+#endif
+
+    if(rv == -1) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+ssize_t file::zero_range(off_t offset, size_t size, bool keep_size) {
+
+    if(::fallocate(m_fd, FALLOC_FL_ZERO_RANGE | (keep_size ? FALLOC_FL_KEEP_SIZE : 0), offset, size) == -1) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+int file::truncate(off_t offset) {
+
+    if(ftruncate(m_fd, offset) == -1) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+void file::save_attributes(struct stat& stbuf) {
+
+    struct timespec times[2] = { stbuf.st_atim, stbuf.st_mtim };
+
+    if(futimens(m_fd, times) == -1) {
+        LOGGER_WARN("Error updating the timestamps of {}: {}", m_origin.string(), strerror(errno));
+    }
+}
+
+int file::unload(const std::string dump_path) {
+
+    (void) dump_path;
+
+    if(fdatasync(m_fd) == -1) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+} // namespace passthrough
+} // namespace efsng
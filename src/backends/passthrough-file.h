@@ -0,0 +1,95 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#ifndef __PASSTHROUGH_FILE_H__
+#define __PASSTHROUGH_FILE_H__
+
+#include <boost/filesystem.hpp>
+#include "backend-base.h"
+
+namespace bfs = boost::filesystem;
+
+namespace efsng {
+namespace passthrough {
+
+/* An open file in the underlying filesystem that was never staged into a backend 
+ * (passthrough tier). Each open() gets its own instance holding a descriptor to 
+ * the original file: reads are served by splicing from it and writes go straight 
+ * to it, so the daemon never keeps a copy of the data. When the kernel supports 
+ * FUSE passthrough, the low-level front end hands the descriptor to the kernel 
+ * (see backing_id()) and reads and writes don't even reach the daemon */
+class file : public backend::file {
+
+public:
+    /* open 'origin' with 'flags' (O_CREAT and O_EXCL are ignored). Returns 0 or -errno */
+    static int open(const bfs::path& origin, int flags, backend::file_ptr& file);
+
+    ~file();
+
+    int fd() const { return m_fd; }
+    const bfs::path& origin() const { return m_origin; }
+
+    /* identifier of the descriptor registered with the kernel (0 if none) */
+    int backing_id() const { return m_backing_id; }
+    void set_backing_id(int id) { m_backing_id = id; }
+
+    void stat(struct stat& buf) const override;
+    ssize_t get_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) override;
+    ssize_t map_data(off_t offset, size_t size, backend::data_view_ptr& view, cursor* cur = nullptr) override;
+    ssize_t put_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer, cursor* cur = nullptr) override;
+    ssize_t append_data(off_t offset, size_t size, struct fuse_bufvec* fuse_buffer) override;
+    ssize_t allocate(off_t offset, size_t size, bool keep_size = false) override;
+    ssize_t punch_hole(off_t offset, size_t size) override;
+    ssize_t zero_range(off_t offset, size_t size, bool keep_size) override;
+    int sync(bool data_only) override;
+    /* no storage is used other than the original file's */
+    uint64_t resident_bytes() const override { return 0; }
+    int truncate(off_t offset) override;
+    void save_attributes(struct stat& stbuf) override;
+    /* the data already lives in the underlying filesystem: only sync it */
+    int unload(const std::string dump_path) override;
+    void change_type(backend::file::type type) override { (void) type; }
+
+private:
+    file(int fd, const bfs::path& origin);
+
+    const int       m_fd;           /*!< Descriptor for the original file */
+    const bfs::path m_origin;       /*!< Path to the original file */
+    int             m_backing_id;   /*!< Kernel passthrough backing id (0 if none) */
+}; // class file
+
+} // namespace passthrough
+} // namespace efsng
+
+#endif /* __PASSTHROUGH_FILE_H__ */
@@ -0,0 +1,107 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#ifndef __RANGE_SET_H__
+#define __RANGE_SET_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <sys/types.h>
+
+namespace efsng {
+
+/*! A set of byte ranges [start, end) (e.g. the parts of a file written since it 
+ * was last synced). Overlapping and adjacent ranges are merged as they are added, 
+ * so a file written sequentially is described by a single range no matter how 
+ * many writes it took.
+ *
+ * Not thread-safe: callers serialize access.
+ */
+class range_set {
+
+public:
+    using const_iterator = std::map<off_t, off_t>::const_iterator;
+
+    const_iterator begin() const { return m_ranges.begin(); }
+    const_iterator end() const { return m_ranges.end(); }
+    size_t size() const { return m_ranges.size(); }
+    bool empty() const { return m_ranges.empty(); }
+    void clear() { m_ranges.clear(); }
+    void swap(range_set& other) { m_ranges.swap(other.m_ranges); }
+
+    /*! Add [start, end) to the set */
+    void add(off_t start, off_t end) {
+
+        if(start >= end) {
+            return;
+        }
+
+        // first range starting after 'start': the one before it may overlap (or touch) ours
+        auto it = m_ranges.upper_bound(start);
+
+        if(it != m_ranges.begin()) {
+            auto prev = std::prev(it);
+
+            if(prev->second >= start) {
+                start = prev->first;
+                end = std::max(end, prev->second);
+                it = prev;
+            }
+        }
+
+        // absorb any range that starts within (or right after) ours
+        while(it != m_ranges.end() && it->first <= end) {
+            end = std::max(end, it->second);
+            it = m_ranges.erase(it);
+        }
+
+        m_ranges.emplace_hint(it, start, end);
+    }
+
+    /*! Add all the ranges in 'other' to the set */
+    void merge(const range_set& other) {
+        for(const auto& r : other) {
+            add(r.first, r.second);
+        }
+    }
+
+private:
+    std::map<off_t, off_t> m_ranges; /*!< start -> end */
+}; // class range_set
+
+} // namespace efsng
+
+#endif /* __RANGE_SET_H__ */
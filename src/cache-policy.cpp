@@ -0,0 +1,218 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "parsers.h"
+#include "cache-policy.h"
+
+namespace efsng {
+
+cache_policy::cache_policy()
+    : m_keep_cache(false),
+      m_direct_io(false),
+      m_attr_timeout(0.0),
+      m_entry_timeout(1.0),
+      m_warm_cache(false),
+      m_warm_rate(256*1024*1024) { }
+
+cache_policy::cache_policy(const config::kv_list& opts, const cache_policy& base)
+    : cache_policy(base) {
+
+    for(const auto& kv : opts) {
+        if(kv.first == "keep-cache") {
+            m_keep_cache = bool_parser(kv.first, kv.second);
+        }
+        else if(kv.first == "direct-io") {
+            m_direct_io = bool_parser(kv.first, kv.second);
+        }
+        else if(kv.first == "attr-timeout") {
+            m_attr_timeout = seconds_parser(kv.first, kv.second);
+        }
+        else if(kv.first == "entry-timeout") {
+            m_entry_timeout = seconds_parser(kv.first, kv.second);
+        }
+        else if(kv.first == "warm-cache") {
+            m_warm_cache = bool_parser(kv.first, kv.second);
+        }
+        else if(kv.first == "warm-rate") {
+            m_warm_rate = size64_parser(kv.first, kv.second);
+
+            if(m_warm_rate == 0) {
+                throw std::invalid_argument("Option 'warm-rate' must be greater than zero");
+            }
+        }
+    }
+
+    /* pushed pages would be dropped as soon as the file is opened otherwise */
+    if(m_warm_cache) {
+        m_keep_cache = true;
+    }
+
+    if(m_keep_cache && m_direct_io) {
+        throw std::invalid_argument(m_warm_cache ? 
+                "Options 'warm-cache' and 'direct-io' are mutually exclusive" :
+                "Options 'keep-cache' and 'direct-io' are mutually exclusive");
+    }
+}
+
+bool cache_policy::defined_in(const config::kv_list& opts) {
+    return opts.count("keep-cache") != 0 || opts.count("direct-io") != 0 ||
+           opts.count("attr-timeout") != 0 || opts.count("entry-timeout") != 0 ||
+           opts.count("warm-cache") != 0 || opts.count("warm-rate") != 0;
+}
+
+void cache_policy::apply(struct fuse_file_info* file_info) const {
+    file_info->keep_cache = m_keep_cache;
+    file_info->direct_io = m_direct_io;
+}
+
+int warm_page_cache(const backend::file_ptr& file, ino_t ino, uint64_t rate, 
+                    const store_fn& store, uint64_t& total) {
+
+    using clock = std::chrono::steady_clock;
+
+    const size_t chunk_size = std::min(rate, (uint64_t) 1 << 20);
+    const auto start = clock::now();
+    struct stat stbuf;
+
+    total = 0;
+    file->stat(stbuf);
+
+    for(off_t offset = 0; offset < stbuf.st_size; ) {
+        backend::data_view_ptr view;
+
+        /* backends may return either 0 or the number of bytes mapped: 
+         * only the size of the view tells how much data there is */
+        ssize_t rv = file->map_data(offset, chunk_size, view);
+
+        if(rv < 0) {
+            return (int) rv;
+        }
+
+        size_t n = view->size();
+
+        if(n == 0) {
+            break;
+        }
+
+        int err = store(ino, offset, view->bufvec());
+
+        /* the reply to the lookup may not have been processed yet */
+        for(int retries = 0; err == -ENOENT && offset == 0 && retries < 10; ++retries) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            err = store(ino, offset, view->bufvec());
+        }
+
+        if(err != 0) {
+            return err;
+        }
+
+        offset += n;
+        total += n;
+
+        /* stay under the configured rate */
+        std::this_thread::sleep_until(start + 
+                std::chrono::duration_cast<clock::duration>(
+                    std::chrono::duration<double>((double) total / rate)));
+    }
+
+    return 0;
+}
+
+cache_policy_table::cache_policy_table()
+    : m_no_prefixes(true) { }
+
+void cache_policy_table::set_backend(const backend* ptr, const cache_policy& policy) {
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    m_backends[ptr] = policy;
+}
+
+void cache_policy_table::set_prefix(const std::string& prefix, const cache_policy& policy) {
+
+    std::string key = prefix;
+
+    /* prefixes are stored without a trailing slash */
+    while(key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    m_prefixes[key] = policy;
+    m_no_prefixes = false;
+}
+
+cache_policy cache_policy_table::lookup(const char* pathname, const backend* ptr) const {
+
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+
+    if(!m_no_prefixes) {
+
+        std::string key = pathname;
+
+        while(key.size() > 1 && key.back() == '/') {
+            key.pop_back();
+        }
+
+        while(true) {
+            auto it = m_prefixes.find(key);
+
+            if(it != m_prefixes.end()) {
+                return it->second;
+            }
+
+            auto pos = key.rfind('/');
+
+            if(pos == std::string::npos || key == "/") {
+                break;
+            }
+
+            key.resize(pos == 0 ? 1 : pos);
+        }
+    }
+
+    auto it = m_backends.find(ptr);
+
+    if(it != m_backends.end()) {
+        return it->second;
+    }
+
+    return m_default;
+}
+
+} // namespace efsng
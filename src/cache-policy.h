@@ -0,0 +1,121 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __CACHE_POLICY_H__
+#define __CACHE_POLICY_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "settings.h"
+#include "backends.h"
+
+namespace efsng {
+
+/*! How the kernel is allowed to cache the data and metadata of a set of files. Policies can be
+ * given per backend (applying to everything it serves) and per resource, with the following 
+ * options, any of which can be omitted to inherit the value of the enclosing policy:
+ *
+ *   keep-cache:    keep the kernel page cache across opens (immutable inputs)
+ *   direct-io:     bypass the kernel page cache (huge streaming files)
+ *   attr-timeout:  seconds the kernel may cache attributes for
+ *   entry-timeout: seconds the kernel may cache name lookups for
+ *   warm-cache:    push the contents of each file into the page cache once the kernel 
+ *                  first looks it up, so that first reads don't reach us (hot read-only 
+ *                  inputs). Implies keep-cache. Only honored by the low-level front end
+ *   warm-rate:     bytes per second pushed by warm-cache for each file (e.g. "256MiB")
+ */
+struct cache_policy {
+
+    /*! Default policy: page cache dropped on open, attributes revalidated on each access */
+    cache_policy();
+
+    /*! Build a policy from the options in 'opts', inheriting anything not set from 'base' 
+     * (throws std::invalid_argument if an option is malformed) */
+    cache_policy(const config::kv_list& opts, const cache_policy& base);
+
+    /*! Check whether 'opts' sets any caching option */
+    static bool defined_in(const config::kv_list& opts);
+
+    /*! Set the caching flags of a file being opened according to this policy */
+    void apply(struct fuse_file_info* file_info) const;
+
+    bool    m_keep_cache;       /*!< Keep cached pages across opens */
+    bool    m_direct_io;        /*!< Bypass the page cache */
+    double  m_attr_timeout;     /*!< Attribute caching timeout (seconds) */
+    double  m_entry_timeout;    /*!< Name lookup caching timeout (seconds) */
+    bool    m_warm_cache;       /*!< Push file contents into the page cache on lookup */
+    uint64_t m_warm_rate;       /*!< Bytes per second pushed when warming (per file) */
+}; // struct cache_policy
+
+/*! Pushes the data in a bufvec into the kernel page cache of an inode, at a given offset */
+using store_fn = std::function<int(ino_t, off_t, struct fuse_bufvec*)>;
+
+/*! Push the contents of 'file' into the kernel page cache (as inode 'ino') through 'store', 
+ * at no more than 'rate' bytes per second. Returns 0 or -errno, and the number of bytes 
+ * pushed in 'total' */
+int warm_page_cache(const backend::file_ptr& file, ino_t ino, uint64_t rate, 
+                    const store_fn& store, uint64_t& total);
+
+/*! This class finds the caching policy for a path: the one defined for its longest matching 
+ * resource prefix or, if none, the one defined for the backend that serves it. As with the
+ * router, prefixes are found by probing a hash table with each of the path's ancestors */
+class cache_policy_table {
+
+public:
+    cache_policy_table();
+
+    /*! Set the policy for paths served by 'ptr' that no resource policy covers */
+    void set_backend(const backend* ptr, const cache_policy& policy);
+
+    /*! Set the policy for 'prefix' (and everything below it) */
+    void set_prefix(const std::string& prefix, const cache_policy& policy);
+
+    /*! Find the policy for 'pathname', which is served by 'ptr' */
+    cache_policy lookup(const char* pathname, const backend* ptr) const;
+
+private:
+    mutable boost::shared_mutex                         m_mutex;
+    std::atomic<bool>                                   m_no_prefixes; /*!< No resource policies defined */
+    cache_policy                                        m_default;     /*!< Policy for backends without one */
+    std::unordered_map<const backend*, cache_policy>    m_backends;    /*!< Backend -> policy */
+    std::unordered_map<std::string, cache_policy>       m_prefixes;    /*!< Prefix -> policy */
+}; // class cache_policy_table
+
+} // namespace efsng
+
+#endif /* __CACHE_POLICY_H__ */
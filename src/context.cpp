@@ -35,14 +35,23 @@
 #include <config.h>
 #endif /* HAVE_CONFIG_H */
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <efs-ioctl.h>
+
 #include "logger.h"
+#include "parsers.h"
 #include "context.h"
+#include "backends/passthrough-file.h"
 
 namespace efsng {
 
 context::context(const config::settings& user_args) 
     : m_user_args(std::make_unique<config::settings>(user_args)),
-      m_forced_shutdown(false) { }
+      m_forced_shutdown(false),
+      m_kernel_passthrough(false) { }
 
 void context::initialize() {
 
@@ -115,6 +124,11 @@ void context::initialize() {
     LOGGER_INFO("==============================================");
 
     LOGGER_INFO("");
+    LOGGER_INFO("* FUSE transfer size: {} bytes", m_user_args->m_transfer_size);
+
+    /* paths missing from root-dir may appear there behind our back, anything 
+     * else can only appear through us (which invalidates the table) */
+    m_negatives.set_lifetime(m_user_args->m_passthrough ? (double) m_user_args->m_negative_timeout : -1.0);
     LOGGER_INFO("* Deploying storage backend handlers...");
 
     /* 4. setup storage backends */
@@ -124,10 +138,19 @@ void context::initialize() {
         const auto& opts = kv.second;
 
         try {
-            auto backend_ptr = backend::create_from_options(opts);
+            auto backend_ptr = backend::create_from_options(opts, m_user_args->m_transfer_size);
+            cache_policy policy(opts.m_extra_options, cache_policy());
 
             LOGGER_INFO("    Backend {} (type: {})", id, backend_ptr->name());  
             LOGGER_INFO("      [ capacity: {} bytes ]", backend_ptr->capacity());
+            LOGGER_INFO("      [ caching: keep-cache={}, direct-io={}, attr-timeout={}s, entry-timeout={}s ]", 
+                        policy.m_keep_cache, policy.m_direct_io, policy.m_attr_timeout, policy.m_entry_timeout);
+
+            m_cache_policies.set_backend(backend_ptr.get(), policy);
+
+            backend_ptr->set_executor([this](std::function<void()> task) {
+                m_thread_pool.submit_and_forget(std::move(task));
+            });
 
             m_backends.emplace(id, std::move(backend_ptr));
         }
@@ -142,9 +165,51 @@ void context::initialize() {
         throw std::runtime_error(""); // we don't really care about the message
     }
     
+    /* 5. set up the routing of paths to backends: the backend defined with 
+     * 'prefix: /' (or the first one, if none) serves anything not claimed by
+     * the prefixes of other backends */
+    backend* default_backend = m_backends.begin()->second.get();
+    std::map<std::string, backend*> prefixes;
+
+    for(const auto& kv : m_backends) {
+
+        if(m_user_args->m_backend_opts.count(kv.first) == 0) {
+            continue;
+        }
+
+        const auto& extra_opts = m_user_args->m_backend_opts.at(kv.first).m_extra_options;
+        const auto& it = extra_opts.find("prefix");
+
+        if(it == extra_opts.end()) {
+            continue;
+        }
+
+        std::string prefix = it->second;
+
+        if(prefix.empty() || prefix.front() != '/') {
+            prefix.insert(0, "/");
+        }
+
+        if(prefix == "/") {
+            default_backend = kv.second.get();
+        }
+        else {
+            prefixes.emplace(prefix, kv.second.get());
+        }
+    }
+
+    m_router.set_default(default_backend);
+
+    // std::map guarantees that parents are routed before their children
+    for(const auto& kv : prefixes) {
+        LOGGER_INFO("    Routing {} to backend {}", kv.first, kv.second->name());
+        add_route(kv.first, kv.second, true);
+    }
+
     LOGGER_INFO("* Importing resources...");
-    /* 5. Import any files or directories defined by the user */
+    /* 6. Import any files or directories defined by the user */
     std::vector<pool::task_future<efsng::error_code>> return_values;
+    std::vector<std::pair<std::string, backend*>> sealed_prefixes;
 
     /* Load any input files requested by the user to the selected backends */
     for(const auto& kv: m_user_args->m_resources) {
@@ -156,6 +221,30 @@ void context::initialize() {
             LOGGER_WARN("Invalid backend '{}' for input resource '{}'. Ignored.", target, pathname.string());
             continue;
         }
+
+        /* resources may override the caching policy of their backend */
+        if(cache_policy::defined_in(kv)) {
+            try {
+                cache_policy backend_policy(m_user_args->m_backend_opts.at(target).m_extra_options, cache_policy());
+                m_cache_policies.set_prefix(mount_path(pathname), cache_policy(kv, backend_policy));
+            }
+            catch(const std::exception& e) {
+                LOGGER_WARN("Invalid caching policy for input resource '{}': {}. Ignored.", pathname.string(), e.what());
+                continue;
+            }
+        }
+
+        /* resources that won't be modified can be sealed (see the user.efs.sealed hint) */
+        if(kv.count("sealed") != 0) {
+            try {
+                if(bool_parser("sealed", kv.at("sealed"))) {
+                    sealed_prefixes.emplace_back(mount_path(pathname), m_backends.at(target).get());
+                }
+            }
+            catch(const std::exception& e) {
+                LOGGER_WARN("Invalid option for input resource '{}': {}. Ignored.", pathname.string(), e.what());
+            }
+        }
         
         return_values.emplace_back(
             m_thread_pool.submit_and_track(
@@ -171,6 +260,9 @@ void context::initialize() {
                         if(rv != efsng::error_code::success) {
                             LOGGER_ERROR("Error importing {} into '{}': {}", pathname, target, rv);
                         }
+                        else {
+                            route_resource(pathname, backend_ptr.get());
+                        }
                         return rv;
                     }
             )
@@ -184,7 +276,21 @@ void context::initialize() {
         }
     }
 
-    /* 6. initialize API listener */
+    // (directories are imported recursively: seal everything below them)
+    for(const auto& kv : sealed_prefixes) {
+        const std::string& prefix = kv.first;
+
+        for(auto it = kv.second->begin(); it != kv.second->end(); ++it) {
+            const std::string& path = it->first;
+
+            if(path.compare(0, prefix.size(), prefix) == 0 && 
+               (path.size() == prefix.size() || path[prefix.size()] == '/' || prefix == "/")) {
+                it->second->set_hint("user.efs.sealed", "true", 4, 0);
+            }
+        }
+    }
+
+    /* 7. initialize API listener */
     LOGGER_INFO("* Starting API listener...");
 
     if(bfs::exists(m_user_args->m_api_sockfile)) {
@@ -245,10 +351,10 @@ void context::teardown() {
         }
     }
 */
-    const auto & kv = m_backends.begin();
-    const auto& backend_ptr = kv->second;
- //   std::shared_ptr <efsng::backend::file> ptr;
-    backend_ptr->unload(m_user_args->m_results_dir, m_user_args->m_mount_dir);
+    for(const auto& kv : m_backends) {
+        const auto& backend_ptr = kv.second;
+        backend_ptr->unload(m_user_args->m_results_dir, m_user_args->m_mount_dir);
+    }
 	
 
 
@@ -344,6 +450,12 @@ response_ptr context::api_handler(request_ptr user_req) {
                     auto& backend_ptr = m_backends.at(target);
                     m_tracker.set(tid, error_code::task_in_progress);
                     auto ec = backend_ptr->load(pathname, backend::file::type::persistent);
+
+                    if(ec == error_code::success) {
+                        route_resource(pathname, backend_ptr.get());
+                        invalidate(mount_path(pathname));
+                    }
+
                     m_tracker.set(tid, ec);
                 }
                 break;
@@ -357,6 +469,11 @@ response_ptr context::api_handler(request_ptr user_req) {
                     auto& backend_ptr = m_backends.at(target);
                     m_tracker.set(tid, error_code::task_in_progress);
                     auto ec = backend_ptr->unload(pathname, m_user_args->m_mount_dir);
+
+                    if(ec == error_code::success) {
+                        invalidate(mount_path(pathname));
+                    }
+
                     m_tracker.set(tid, ec);
                 }
                 break;
@@ -371,6 +488,340 @@ response_ptr context::api_handler(request_ptr user_req) {
     return std::make_shared<api::response>(api::response_type::accepted, tid, error_code::success);
 }
 
+/* route 'prefix' to 'ptr', creating any directories needed to reach it */
+void context::add_route(const std::string& prefix, backend* ptr, bool is_dir) {
+
+    m_router.add_prefix(prefix, ptr);
+
+    // inodes already known to the kernel below the prefix are now served by 'ptr'
+    m_inodes.reroute(prefix, [&](const std::string& pathname) {
+        return m_router.resolve(pathname.c_str());
+    });
+
+    // the target backend needs the whole chain of directories leading to 
+    // the prefix, and each ancestor must also exist in the backend serving
+    // it so that the kernel can walk down to the prefix
+    bfs::path partial("/");
+    bfs::path target(prefix);
+
+    for(auto it = ++target.begin(); it != target.end(); ++it) {
+
+        partial /= *it;
+
+        const std::string pathname = partial.string();
+        const bool is_leaf = (pathname == target.string());
+        struct stat stbuf;
+
+        if(is_leaf && !is_dir) {
+            break;
+        }
+
+        if(ptr->do_stat(pathname.c_str(), stbuf) != 0) {
+            ptr->do_mkdir(pathname.c_str(), 0755);
+        }
+
+        auto owner = m_router.resolve(partial.parent_path().string().c_str());
+
+        if(owner != ptr && owner->do_stat(pathname.c_str(), stbuf) != 0) {
+            owner->do_mkdir(pathname.c_str(), 0755);
+        }
+    }
+}
+
+/* make sure that a resource loaded into 'ptr' is served by it */
+void context::route_resource(const bfs::path& pathname, backend* ptr) {
+
+    auto prefix = mount_path(pathname);
+
+    if(m_router.resolve(prefix.c_str()) != ptr) {
+        add_route(prefix, ptr, bfs::is_directory(pathname));
+    }
+}
+
+/* translate a path in the underlying filesystem to a path in the mount point 
+ * (same convention used by the backends when loading files) */
+std::string context::mount_path(const bfs::path& pathname) const {
+
+    std::string root = m_user_args->m_root_dir.string();
+    std::string path = pathname.string();
+
+    while(root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+    if(path.compare(0, root.size(), root) == 0) {
+        if(path.size() == root.size()) {
+            return "/";
+        }
+
+        if(path[root.size()] == '/') {
+            return path.substr(root.size());
+        }
+    }
+
+    return "/" + pathname.filename().string();
+}
+
+/* collect the entries of 'dirpath' that the backend 'ptr' serving it knows nothing 
+ * about, i.e. symbolic links, prefixes routed to other backends and, if the passthrough
+ * tier is enabled, unstaged entries in the underlying filesystem. Front ends list 
+ * them after the backend's own entries, at offsets from backend::dir::s_max_offset
+ * on, so they are sorted (and deduplicated) to keep those offsets stable */
+void context::extra_entries(const std::string& dirpath, backend* ptr, std::vector<std::string>& names) const {
+
+    std::list<std::string> extra;
+    m_symlinks.list(dirpath, extra);
+
+    std::list<std::string> routed;
+    m_router.children(dirpath, routed);
+
+    for(const auto& name : routed) {
+        std::string child = dirpath + (dirpath == "/" ? "" : "/") + name;
+        struct stat stbuf;
+
+        if(ptr->do_stat(child.c_str(), stbuf) != 0) {
+            extra.push_back(name);
+        }
+    }
+
+    if(m_user_args->m_passthrough) {
+        boost::system::error_code ec;
+        bfs::directory_iterator it(m_user_args->m_root_dir.string() + dirpath, ec), end;
+
+        for(; !ec && it != end; it.increment(ec)) {
+            std::string name = it->path().filename().string();
+            std::string child = dirpath + (dirpath == "/" ? "" : "/") + name;
+            struct stat stbuf;
+
+            if(ptr->do_stat(child.c_str(), stbuf) != 0) {
+                extra.push_back(name);
+            }
+        }
+    }
+
+    names.assign(extra.begin(), extra.end());
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+/* passthrough tier: paths not found in the backend serving them may be served from 
+ * the underlying filesystem. Fill 'stbuf' with the attributes of 'pathname' there 
+ * (with an inode number that can't clash with those issued by backends or with 
+ * that of any other unstaged file). Returns 0 or -errno (-ENOENT if the tier is 
+ * disabled) */
+int context::passthrough_stat(const std::string& pathname, struct stat& stbuf) const {
+
+    if(!m_user_args->m_passthrough) {
+        return -ENOENT;
+    }
+
+    std::string origin = m_user_args->m_root_dir.string() + pathname;
+
+    if(::stat(origin.c_str(), &stbuf) == -1) {
+        return -errno;
+    }
+
+    stbuf.st_ino = m_router.passthrough_inode(stbuf.st_dev, stbuf.st_ino);
+
+    if(stbuf.st_ino == 0) {
+        LOGGER_ERROR("Out of inode numbers for unstaged files ({})", pathname);
+        return -EOVERFLOW;
+    }
+
+    return 0;
+}
+
+/* open the unstaged file 'pathname' in the underlying filesystem (see passthrough::file). 
+ * Returns 0 or -errno (-ENOENT if the tier is disabled) */
+int context::passthrough_open(const std::string& pathname, int flags, backend::file_ptr& file) const {
+
+    if(!m_user_args->m_passthrough) {
+        return -ENOENT;
+    }
+
+    LOGGER_DEBUG("Opening unstaged file {} in passthrough mode", pathname);
+
+    return passthrough::file::open(m_user_args->m_root_dir.string() + pathname, flags, file);
+}
+
+/* drop anything the kernel (or the negative lookup table) may have cached about 
+ * 'pathname' (a path in the mount point) so that changes made through the API 
+ * become visible immediately */
+void context::invalidate(const std::string& pathname) {
+
+    m_negatives.invalidate();
+
+    if(m_invalidate) {
+        LOGGER_DEBUG("Invalidating kernel caches for {}", pathname);
+        m_invalidate(pathname);
+    }
+}
+
+/* if the caching policy for 'pathname' asks for it, push the contents of 'file' into 
+ * the kernel page cache (as inode 'ino') in the background, at the configured rate. 
+ * This must be called once the kernel knows about 'ino' (e.g. after a lookup) and 
+ * only does anything the first time it's called for each file */
+void context::warm_cache(const std::string& pathname, ino_t ino, const backend::file_ptr& file) {
+
+    if(!m_store) {
+        return;
+    }
+
+    auto policy = m_cache_policies.lookup(pathname.c_str(), m_router.resolve(pathname.c_str()));
+
+    if(!policy.m_warm_cache || !file->begin_warmup()) {
+        return;
+    }
+
+    m_thread_pool.submit_and_forget(
+        [=]() {
+            uint64_t total = 0;
+            int rv = warm_page_cache(file, ino, policy.m_warm_rate, m_store, total);
+
+            if(rv != 0) {
+                LOGGER_WARN("Kernel cache warm-up of {} stopped after {} bytes: {}", pathname, total, strerror(-rv));
+            }
+            else {
+                LOGGER_DEBUG("Pushed {} bytes of {} into the kernel page cache", total, pathname);
+            }
+        });
+}
+
+/* fill 'buf' with the aggregated capacity and usage of all registered backends. 
+ * Backends keep their usage counters up to date as they go, so this is O(#backends) 
+ * and never touches the namespace. There is no fixed inode limit: the number of 
+ * free inodes reported is the number of free blocks */
+void context::statfs(struct statvfs& buf) const {
+
+    uint64_t capacity = 0;
+    uint64_t used = 0;
+    uint64_t nodes = 0;
+
+    for(const auto& kv : m_backends) {
+        const auto& usage = kv.second->get_usage();
+
+        capacity += kv.second->capacity();
+        used += usage.m_bytes;
+        nodes += usage.m_files + usage.m_dirs;
+    }
+
+    std::memset(&buf, 0, sizeof(buf));
+
+    buf.f_bsize = FUSE_BLOCK_SIZE;
+    buf.f_frsize = FUSE_BLOCK_SIZE;
+    buf.f_blocks = capacity / FUSE_BLOCK_SIZE;
+    buf.f_bfree = (capacity - std::min(used, capacity)) / FUSE_BLOCK_SIZE;
+    buf.f_bavail = buf.f_bfree;
+    buf.f_ffree = buf.f_bfree;
+    buf.f_favail = buf.f_bfree;
+    buf.f_files = nodes + buf.f_ffree;
+    buf.f_namemax = NAME_MAX;
+}
+
+/* serve the control operations in efs-ioctl.h for the open file 'file' found at 'pathname'. 
+ * 'data' is the argument buffer (of _IOC_SIZE(cmd) bytes). Returns 0 or -errno */
+int context::file_ioctl(const std::string& pathname, const backend::file_ptr& file, unsigned int cmd, void* data) {
+
+    LOGGER_DEBUG("ioctl(\"{}\", {:#x})", pathname, cmd);
+
+    switch(cmd) {
+        case EFS_IOC_PIN:
+        case EFS_IOC_UNPIN:
+            return file->pin(cmd == EFS_IOC_PIN);
+
+        case EFS_IOC_FLUSH:
+        {
+            // already on its way
+            if(!file->begin_flush()) {
+                return 0;
+            }
+
+            bfs::path target = m_user_args->m_root_dir.string() + pathname;
+
+            m_thread_pool.submit_and_forget(
+                [=]() {
+                    int error = 0;
+
+                    try {
+                        bfs::create_directories(target.parent_path());
+
+                        // (temporary files refuse to be unloaded with -1, i.e. -EPERM)
+                        int rv = file->unload(target.string());
+                        error = rv < 0 ? -rv : 0;
+                    }
+                    catch(const std::exception& e) {
+                        LOGGER_ERROR("Error flushing {} to '{}': {}", pathname, target.string(), e.what());
+                        error = EIO;
+                    }
+
+                    LOGGER_DEBUG("flush(\"{}\") to '{}': {}", pathname, target.string(), strerror(error));
+                    file->end_flush(error);
+                });
+
+            return 0;
+        }
+
+        case EFS_IOC_GET_STATS:
+        {
+            struct efs_file_stats* stats = static_cast<struct efs_file_stats*>(data);
+            struct stat stbuf;
+            int error;
+
+            file->stat(stbuf);
+
+            std::memset(stats, 0, sizeof(*stats));
+            stats->efs_reads = file->stats().m_reads;
+            stats->efs_writes = file->stats().m_writes;
+            stats->efs_bytes_read = file->stats().m_bytes_read;
+            stats->efs_bytes_written = file->stats().m_bytes_written;
+            stats->efs_size = stbuf.st_size;
+            stats->efs_resident = file->resident_bytes();
+            stats->efs_flags = (file->is_pinned() ? EFS_FILE_PINNED : 0) | 
+                               (file->is_sealed() ? EFS_FILE_SEALED : 0);
+
+            switch(file->get_flush_state(&error)) {
+                case backend::file::flush_state::none:
+                    stats->efs_flush_state = EFS_FLUSH_NONE;
+                    break;
+                case backend::file::flush_state::pending:
+                    stats->efs_flush_state = EFS_FLUSH_PENDING;
+                    break;
+                case backend::file::flush_state::done:
+                    stats->efs_flush_state = EFS_FLUSH_DONE;
+                    break;
+                case backend::file::flush_state::failed:
+                    stats->efs_flush_state = EFS_FLUSH_FAILED;
+                    stats->efs_flush_error = error;
+                    break;
+            }
+
+            return 0;
+        }
+
+        case EFS_IOC_SET_ACCESS:
+        {
+            // indexed by EFS_ACCESS_*
+            static const char* const patterns[] = { "normal", "sequential", "random", "strided" };
+            uint32_t pattern = *static_cast<uint32_t*>(data);
+
+            if(pattern >= sizeof(patterns) / sizeof(patterns[0])) {
+                return -EINVAL;
+            }
+
+            return file->set_hint("user.efs.access", patterns[pattern], strlen(patterns[pattern]), 0);
+        }
+
+        case EFS_IOC_SEAL:
+            return file->set_hint("user.efs.sealed", "true", 4, 0);
+
+        case EFS_IOC_UNSEAL:
+            return file->set_hint("user.efs.sealed", "false", 5, 0);
+
+        default:
+            return -ENOTTY;
+    }
+}
+
 void context::trigger_shutdown(void) {
     m_forced_shutdown = true;
     kill(getpid(), SIGTERM);
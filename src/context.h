@@ -34,10 +34,18 @@
 #ifndef __EFS_CONTEXT_H__
 #define __EFS_CONTEXT_H__
 
+#include <sys/statvfs.h>
+
 #include "settings.h"
 #include "backends.h"
 #include "api.h"
 #include "thread-pool.h"
+#include "router.h"
+#include "cache-policy.h"
+#include "metadata/handles.h"
+#include "metadata/inodes.h"
+#include "metadata/symlinks.h"
+#include "metadata/negatives.h"
 
 namespace efsng {
 
@@ -49,6 +57,7 @@ using backend_ptr = std::unique_ptr<backend>;
 using request_ptr = std::shared_ptr<api::request>;
 using response_ptr = std::shared_ptr<api::response>;
 using request_tracker = api::tracker<api::task_id, api::progress>;
+using invalidate_fn = std::function<void(const std::string&)>;
 
 /*! This class is used to keep the internal state of the filesystem while it's running */
 struct context {
@@ -58,13 +67,32 @@ struct context {
     void teardown(void);
     void trigger_shutdown(void);
     response_ptr api_handler(request_ptr request);
+    void add_route(const std::string& prefix, backend* ptr, bool is_dir);
+    void route_resource(const bfs::path& pathname, backend* ptr);
+    std::string mount_path(const bfs::path& pathname) const;
+    void extra_entries(const std::string& dirpath, backend* ptr, std::vector<std::string>& names) const;
+    void invalidate(const std::string& pathname);
+    void warm_cache(const std::string& pathname, ino_t ino, const backend::file_ptr& file);
+    void statfs(struct statvfs& buf) const;
+    int file_ioctl(const std::string& pathname, const backend::file_ptr& file, unsigned int cmd, void* data);
+    int passthrough_stat(const std::string& pathname, struct stat& stbuf) const;
+    int passthrough_open(const std::string& pathname, int flags, backend::file_ptr& file) const;
 
     settings_ptr                        m_user_args;        /*!< Configuration options passed by the user */
     api_listener_ptr                    m_api_listener;     /*!< API listener */
     std::map<std::string, backend_ptr>  m_backends;         /*!< Registered backends */
-    pool                                m_thread_pool;      /*!< Thread pool for API requests */
+    router                              m_router;           /*!< Mapping of mount subtrees to backends */
+    cache_policy_table                  m_cache_policies;   /*!< Kernel caching policies for mount subtrees */
+    invalidate_fn                       m_invalidate;       /*!< Drops kernel caches for a path (set by the front end) */
+    store_fn                            m_store;            /*!< Pushes data into the kernel page cache (set by the front end) */
+    pool                                m_thread_pool;      /*!< Thread pool for API requests and file flushes */
     request_tracker                     m_tracker;          /*!< Container for tracking API requests */
     std::atomic<bool>                   m_forced_shutdown;  /*!< Flag to notify forced shutdowns */
+    handle_table                        m_handles;          /*!< Open file handles (stored in fi->fh) */
+    inode_table                         m_inodes;           /*!< Inodes known to the kernel (low-level front end) */
+    symlink_table                       m_symlinks;         /*!< Symbolic links created in the filesystem */
+    negative_table                      m_negatives;        /*!< Paths recently found not to exist */
+    std::atomic<bool>                   m_kernel_passthrough; /*!< Kernel FUSE passthrough enabled (low-level front end) */
 }; // struct context
 
 } // namespace efsng
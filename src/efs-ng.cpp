@@ -64,6 +64,8 @@ extern "C" {
 #include <string>
 #include <sstream>
 #include <functional>
+#include <algorithm>
+#include <list>
 
 /* internal includes */
 #include "settings.h"
@@ -76,12 +78,12 @@ extern "C" {
 
 #include "logger.h"
 #include "fuse-mount-helper.h"
+#include "fuse-lowlevel.h"
 #include "errors.h"
 #include "context.h"
 #include "efs-ng.h"
 
 efsng::config::settings m_user_opts;
-std::map <std::string, std::string> fastlink;
 /**********************************************************************************************************************/
 /*   Filesytem operations
  *
@@ -102,6 +104,13 @@ std::map <std::string, std::string> fastlink;
 struct stat cache;
 int count = 0;
 unsigned long long steps = 1;
+
+/** Get the open file record for the handle stored in file_info->fh (nullptr if the handle is stale) */
+static inline efsng::File* get_file_record(struct fuse_file_info* file_info) {
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+    return efsng_ctx->m_handles.get(file_info->fh);
+}
+
 /** Get file attributes. similar to stat() */
 #if FUSE_USE_VERSION < 30
 static int efsng_getattr(const char* pathname, struct stat* stbuf){
@@ -113,27 +122,59 @@ static int efsng_getattr(const char* pathname, struct stat* stbuf, struct fuse_f
     LOGGER_TRACE("stat:{}:{}:{}", 
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
-    return backend_ptr->do_stat(path, *stbuf);  
+
+    /* probing for missing paths is common (e.g. loaders, import paths) */
+    if(efsng_ctx->m_negatives.contains(pathname)) {
+        return -ENOENT;
+    }
+
+    auto generation = efsng_ctx->m_negatives.generation();
+
+    if(efsng_ctx->m_symlinks.stat(pathname, *stbuf)) {
+        return 0;
+    }
+
+    std::size_t index;
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname, &index);
+    int rv = backend_ptr->do_stat(pathname, *stbuf);
+
+    /* unstaged files may still be served from the underlying filesystem */
+    if(rv == -ENOENT) {
+        rv = efsng_ctx->passthrough_stat(pathname, *stbuf);
+
+        if(rv == -ENOENT) {
+            efsng_ctx->m_negatives.add(pathname, generation);
+        }
+
+        return rv;
+    }
+
+    /* inodes must be unique across backends */
+    stbuf->st_ino = efsng::router::global_inode(index, stbuf->st_ino);
+
+    return rv;
 }
 
 /** Read the target of a symbolic link */
 static int efsng_readlink(const char* pathname, char* buf, size_t bufsiz){
-    return -EOPNOTSUPP;
 
-    auto old_credentials = efsng::assume_user_credentials();
-    int res = readlink(pathname, buf, bufsiz - 1);
-    efsng::restore_credentials(old_credentials);
+    LOGGER_DEBUG("readlink(\"{}\")", pathname);
 
-    if(res == -1){
-        return -errno;
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+    std::string target;
+
+    if(!efsng_ctx->m_symlinks.find(pathname, target)) {
+        auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
+        struct stat stbuf;
+        return backend_ptr->do_stat(pathname, stbuf) == 0 ? -EINVAL : -ENOENT;
     }
 
-    /* the buffer needs to be filled with a null-terminated string */
-    buf[res] = '\0';
+    /* the buffer needs to be filled with a null-terminated string 
+     * (the target is truncated if it does not fit) */
+    size_t n = std::min(target.size(), bufsiz - 1);
+    memcpy(buf, target.data(), n);
+    buf[n] = '\0';
 
     return 0;
 }
@@ -158,9 +199,11 @@ static int efsng_mknod(const char* pathname, mode_t mode, dev_t dev){
 static int efsng_mkdir(const char* pathname, mode_t mode){
 
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
-    return backend_ptr->do_mkdir(pathname, mode);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
+    int rv = backend_ptr->do_mkdir(pathname, mode);
+
+    efsng_ctx->m_negatives.invalidate();
+    return rv;
 }
 
 /** Remove a file */
@@ -170,29 +213,42 @@ static int efsng_unlink(const char* pathname){
     LOGGER_TRACE("unlink:{}:{}:{}", 
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;
-    fastlink.erase(pathname);
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
-    return backend_ptr->do_unlink(path);
+
+    if(efsng_ctx->m_symlinks.remove(pathname)) {
+        return 0;
+    }
+
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
+    return backend_ptr->do_unlink(pathname);
 }
 
 /** Remove a directory */
 static int efsng_rmdir(const char* pathname){
 
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;
-    return backend_ptr->do_rmdir(path);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
+    return backend_ptr->do_rmdir(pathname);
 }
 
 /** Create a symbolic link */
-static int efsng_symlink(const char* oldpath, const char* newpath){
+static int efsng_symlink(const char* target, const char* linkpath){
+
+    LOGGER_DEBUG("symlink(\"{}\",\"{}\")", target, linkpath);
+
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+    auto backend_ptr = efsng_ctx->m_router.resolve(linkpath);
+    struct stat stbuf;
+
+    if(backend_ptr->do_stat(linkpath, stbuf) == 0) {
+        return -EEXIST;
+    }
+
+    if(!efsng_ctx->m_symlinks.add(linkpath, target, fuse_get_context()->uid, fuse_get_context()->gid)) {
+        return -EEXIST;
+    }
 
-    //return -EOPNOTSUPP;
-    fastlink[oldpath] = newpath;
+    efsng_ctx->m_negatives.invalidate();
     return 0;
 }
 
@@ -206,10 +262,23 @@ static int efsng_rename(const char* oldpath, const char* newpath, unsigned int f
     LOGGER_DEBUG("rename(\"{}\",\"{}\")", oldpath, newpath);
 
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
 
-    return backend_ptr->do_rename(oldpath,newpath);
+    if(efsng_ctx->m_symlinks.rename(oldpath, newpath)) {
+        efsng_ctx->m_negatives.invalidate();
+        return 0;
+    }
+
+    auto backend_ptr = efsng_ctx->m_router.resolve(oldpath);
+
+    /* files cannot be moved between backends */
+    if(efsng_ctx->m_router.resolve(newpath) != backend_ptr) {
+        return -EXDEV;
+    }
+
+    int rv = backend_ptr->do_rename(oldpath,newpath);
+
+    efsng_ctx->m_negatives.invalidate();
+    return rv;
 }
 
 /** Create a hard link to a file */
@@ -239,8 +308,7 @@ static int efsng_chmod(const char* pathname, mode_t mode, struct fuse_file_info*
     LOGGER_DEBUG("chmod(\"{}\" {} )", pathname, mode );
 
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
    
     return backend_ptr->do_chmod(pathname, mode);
 }
@@ -255,8 +323,7 @@ static int efsng_chown(const char* pathname, uid_t owner, gid_t group, struct fu
     LOGGER_DEBUG("chown(\"{}\" {} )", pathname, owner, group );
  
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
     return backend_ptr->do_chown(pathname, owner, group);
     
     return 0;
@@ -274,8 +341,7 @@ static int efsng_truncate(const char* pathname, off_t length, struct fuse_file_i
     if ((long)length < 0) return -EINVAL;
 #if FUSE_USE_VERSION < 30
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second;
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
     auto ptr = backend_ptr->find(pathname);
 
     if (ptr == backend_ptr->end()) {
@@ -283,21 +349,22 @@ static int efsng_truncate(const char* pathname, off_t length, struct fuse_file_i
     }
     auto p_file = ptr->second.get();
     
-    p_file->truncate(length);
+    res = p_file->truncate(length);
 #else
     if(file_info != NULL){
-        auto file_record = (efsng::File*) file_info->fh;
+        auto file_record = get_file_record(file_info);
+
+        if(file_record == nullptr) {
+            return -EBADF;
+        }
+
         auto p_file =  file_record->get_ptr();
-        p_file->truncate(length);
+        res = p_file->truncate(length);
         }
     
 #endif
 
-    if(res == -1){
-        return -errno;
-    }
-
-    return 0;
+    return res;
 }
 
 /** 
@@ -313,25 +380,29 @@ static int efsng_truncate(const char* pathname, off_t length, struct fuse_file_i
  */
 static int efsng_open(const char* pathname, struct fuse_file_info* file_info){
 
-#ifdef __TEST_DIRECT_IO__
-    file_info->direct_io = 1;
-#endif // __TEST_DIRECT_IO__
-    
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
     
     LOGGER_DEBUG ("OPEN {}", pathname);
     LOGGER_TRACE("open:{}:{}:{}", 
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
 
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;
-    auto ret = backend_ptr->find(path);
+    auto ret = backend_ptr->find(pathname);
+    std::shared_ptr<efsng::backend::file> ptr;
 
-    if (ret == backend_ptr->end()) return -ENOENT;
+    if(ret != backend_ptr->end()) {
+        ptr = ret->second;
+    }
+    else {
+        /* unstaged files are read and written in place (passthrough tier) */
+        int rv = efsng_ctx->passthrough_open(pathname, file_info->flags, ptr);
+
+        if(rv != 0) {
+            return rv;
+        }
+    }
 
-    std::shared_ptr<efsng::backend::file> ptr (ret->second);
     int flags = 0;
 
     if(file_info->flags & O_RDONLY){
@@ -350,13 +421,16 @@ static int efsng_open(const char* pathname, struct fuse_file_info* file_info){
     struct stat st;
     ptr->stat(st);
 
-    // XXX this means that each "open()" creates a File record 
-    // XXX WARNING: records ARE NOT protected by a mutex yet
-    auto file_record = new efsng::File(st.st_ino, 42, flags);
-    file_record->set_ptr(ptr);
-    file_info->fh = (uint64_t) file_record;
+    uint64_t fh = efsng_ctx->m_handles.open(st.st_ino, 42, flags, ptr);
+
+    if(fh == 0) {
+        return -ENFILE;
+    }
+
+    file_info->fh = fh;
 
-//    file_info->direct_io = 1;
+    /* let the kernel know how it may cache the file's contents */
+    efsng_ctx->m_cache_policies.lookup(pathname, backend_ptr).apply(file_info);
 
     return 0;
 }
@@ -373,17 +447,29 @@ static int efsng_read(const char* pathname, char* buf, size_t count, off_t offse
 
     (void) pathname;
 
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
 
-    int fd = file_record->get_fd();
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
 
-    int res = pread(fd, buf, count, offset);
+    auto file_ptr = file_record->get_ptr();
+    efsng::backend::data_view_ptr view;
 
-    if(res == -1){
-        return -errno;
+    ssize_t rv = file_ptr->map_data(offset, count, view, file_record->get_cursor());
+
+    if(rv < 0) {
+        return rv;
     }
 
-    return res;
+    /* regions backed by file descriptors (e.g. unstaged files) are pread() */
+    rv = view->copy_to(buf, count);
+
+    if(rv >= 0) {
+        file_ptr->record_read(rv);
+    }
+
+    return rv;
 }
 
 /** 
@@ -394,34 +480,36 @@ static int efsng_read(const char* pathname, char* buf, size_t count, off_t offse
  */
 static int efsng_write(const char* pathname, const char* buf, size_t count, off_t offset, 
                        struct fuse_file_info* file_info){
-return 0;
+
     (void) pathname;
 
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
 
-    int fd = file_record->get_fd();
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
 
-    int res = pwrite(fd, buf, count, offset);
+    auto file_ptr = file_record->get_ptr();
 
-    if(res == -1){
-        return -errno;
+    struct fuse_bufvec src = FUSE_BUFVEC_INIT(count);
+    src.buf[0].mem = (void*) buf;
+
+    ssize_t rv = file_ptr->put_data(offset, count, &src, file_record->get_cursor());
+
+    if(rv >= 0) {
+        file_ptr->record_write(rv);
     }
 
-    return res;
+    return rv;
 }
 
 /** Get filesystem statistics */
 static int efsng_statfs(const char* pathname, struct statvfs* buf){
+    (void) pathname;
 
-    auto old_credentials = efsng::assume_user_credentials();
-
-    int res = statvfs(pathname, buf);
-
-    efsng::restore_credentials(old_credentials);
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
 
-    if(res == -1){
-        return -errno;
-    }
+    efsng_ctx->statfs(*buf);
 
     return 0;
 }
@@ -452,7 +540,12 @@ static int efsng_flush(const char* pathname, struct fuse_file_info* file_info){
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
 
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
 
 //     int fd = file_record->get_fd();
 //     if (fd != 42) {
@@ -490,7 +583,7 @@ static int efsng_release(const char* pathname, struct fuse_file_info* file_info)
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
 
-    auto file_record = (efsng::File*) file_info->fh;
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
 
 //    int fd = file_record->get_fd();
 //    if (fd != 42) {
@@ -501,7 +594,7 @@ static int efsng_release(const char* pathname, struct fuse_file_info* file_info)
 //
 //    }
    
-    delete file_record;
+    efsng_ctx->m_handles.release(file_info->fh);
     return 0;
 }
 
@@ -511,82 +604,98 @@ static int efsng_release(const char* pathname, struct fuse_file_info* file_info)
  * If the datasync parameter is non-zero, then only the user data should be flushed, not the meta data.
  */
 static int efsng_fsync(const char* pathname, int is_datasync, struct fuse_file_info* file_info){
-    (void) file_info;
     (void) pathname;
-    (void) is_datasync;
 
     LOGGER_TRACE("fsync:{}:{}:{}", 
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
 
-    // Flush is not necessary, we do not have a cache.
+    auto file_record = get_file_record(file_info);
 
-    return 0;
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
+    // data written to a backend may still be sitting in CPU caches or in the page cache
+    return file_record->get_ptr()->sync(is_datasync != 0);
 }
-// TODO: Do we need to implement extended attributes in the backend?
 #ifdef HAVE_SETXATTR
+/* Extended attributes are only supported for the "user.efs." namespace, which 
+ * allows applications to pass performance hints about a file to its backend 
+ * (see backends/file-hints.h). They are not stored in the underlying filesystem. */
+
+/** Find the backend file for pathname (nullptr if it's not a regular file) */
+static std::shared_ptr<efsng::backend::file> find_file(const char* pathname) {
+
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
+    auto it = backend_ptr->find(pathname);
+
+    if(it == backend_ptr->end()) {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
 /** Set extended attributes */
 static int efsng_setxattr(const char* pathname, const char* name, const char* value, size_t size, int flags){
-    return -EOPNOTSUPP;
-    auto old_credentials = efsng::assume_user_credentials();
 
-    int res = lsetxattr(pathname, name, value, size, flags);
+    LOGGER_DEBUG("setxattr(\"{}\", \"{}\", {})", pathname, name, size);
 
-    efsng::restore_credentials(old_credentials);
+    if(!efsng::file_hints::is_hint(name)) {
+        return -EOPNOTSUPP;
+    }
 
-    if(res == -1){
-        return -errno;
+    auto file_ptr = find_file(pathname);
+
+    if(file_ptr == nullptr) {
+        return -EOPNOTSUPP;
     }
 
-    return 0;
+    return file_ptr->set_hint(name, value, size, flags);
 }
 
 /** Get extended attributes */
 static int efsng_getxattr(const char* pathname, const char* name, char* value, size_t size){
-    return -EOPNOTSUPP;
-    auto old_credentials = efsng::assume_user_credentials();
 
-    int res = lgetxattr(pathname, name, value, size);
+    LOGGER_DEBUG("getxattr(\"{}\", \"{}\", {})", pathname, name, size);
 
-    efsng::restore_credentials(old_credentials);
+    auto file_ptr = find_file(pathname);
 
-    if(res == -1){
-        return -errno;
+    if(file_ptr == nullptr) {
+        return -ENODATA;
     }
 
-    return 0;
+    return file_ptr->get_hint(name, value, size);
 }
 
 /** List extended attributes */
 static int efsng_listxattr(const char* pathname, char* listbuf, size_t size){
-    return -EOPNOTSUPP;
-    auto old_credentials = efsng::assume_user_credentials();
 
-    int res = llistxattr(pathname, listbuf, size);
+    LOGGER_DEBUG("listxattr(\"{}\", {})", pathname, size);
 
-    efsng::restore_credentials(old_credentials);
+    auto file_ptr = find_file(pathname);
 
-    if(res == -1){
-        return -errno;
+    if(file_ptr == nullptr) {
+        return 0;
     }
 
-    return 0;
+    return file_ptr->list_hints(listbuf, size);
 }
 
 /** Remove extended attributes */
 static int efsng_removexattr(const char* pathname, const char* name){
-    return 0;
-    auto old_credentials = efsng::assume_user_credentials();
 
-    int res = lremovexattr(pathname, name);
+    LOGGER_DEBUG("removexattr(\"{}\", \"{}\")", pathname, name);
 
-    efsng::restore_credentials(old_credentials);
+    auto file_ptr = find_file(pathname);
 
-    if(res == -1){
-        return -errno;
+    if(file_ptr == nullptr) {
+        return -ENODATA;
     }
 
-    return 0;
+    return file_ptr->remove_hint(name);
 }
 #endif /* HAVE_SETXATTR */
 
@@ -605,14 +714,48 @@ static int efsng_opendir(const char* pathname, struct fuse_file_info* file_info)
             pathname);
 
    /* efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second;
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
   */
   //  struct stat stbuf;
    // backend_ptr->do_stat(pathname,stbuf);
     return 0;
 }
 
+/* state for forwarding the entries listed by a backend to FUSE's filler */
+struct readdir_state {
+    void* m_buf;
+    fuse_fill_dir_t m_filler;
+    std::size_t m_index;    /* index of the backend in the router */
+    bool m_full;            /* has the filler run out of space? */
+};
+
+/* forward an entry listed by a backend, translating its inode number */
+#if FUSE_USE_VERSION < 30
+static int forward_entry(void* buf, const char* name, const struct stat* stbuf, off_t off) {
+#else
+static int forward_entry(void* buf, const char* name, const struct stat* stbuf, off_t off, 
+                         enum fuse_fill_dir_flags flags) {
+#endif
+
+    auto state = (readdir_state*) buf;
+    struct stat st;
+
+    if(stbuf != NULL && state->m_index != 0) {
+        st = *stbuf;
+        st.st_ino = efsng::router::global_inode(state->m_index, st.st_ino);
+        stbuf = &st;
+    }
+
+#if FUSE_USE_VERSION < 30
+    int rv = state->m_filler(state->m_buf, name, stbuf, off);
+#else
+    int rv = state->m_filler(state->m_buf, name, stbuf, off, flags);
+#endif
+
+    state->m_full = (rv != 0);
+    return rv;
+}
+
 /** 
  * Read directory
  *
@@ -641,11 +784,58 @@ static int efsng_readdir(const char* pathname, void* buf, fuse_fill_dir_t filler
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
 
+#if FUSE_USE_VERSION >= 30
+    (void) flags;
+#endif
+
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;
-    return backend_ptr->do_readdir(path, buf, filler, offset, file_info);
+    std::size_t index;
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname, &index);
+    const off_t max_offset = efsng::backend::dir::s_max_offset;
+
+    // entries known to the backend come first, each with its own offset
+    if(offset < max_offset) {
+        readdir_state state = { buf, filler, index, false };
+        int rv = backend_ptr->do_readdir(pathname, &state, forward_entry, offset, file_info);
+        struct stat stbuf;
+
+        // directories that were never staged only have "." and ".." plus 
+        // whatever the passthrough tier finds in the underlying filesystem
+        if(rv == -ENOENT && efsng_ctx->passthrough_stat(pathname, stbuf) == 0 && S_ISDIR(stbuf.st_mode)) {
+            const char* dots[] = { ".", ".." };
+
+            for(off_t off = offset + 1; off <= 2; ++off) {
+#if FUSE_USE_VERSION < 30
+                if(filler(buf, dots[off - 1], NULL, off) != 0) {
+#else
+                if(filler(buf, dots[off - 1], NULL, off, (fuse_fill_dir_flags) 0) != 0) {
+#endif
+                    return 0;
+                }
+            }
+        }
+        else if(rv != 0 || state.m_full) {
+            return rv;
+        }
+    }
+
+    // then symbolic links and entries routed to other backends
+    std::vector<std::string> entries;
+    efsng_ctx->extra_entries(pathname, backend_ptr, entries);
+
+    std::size_t first = (offset < max_offset ? 0 : offset - max_offset + 1);
+
+    for(std::size_t i = first; i < entries.size(); ++i) {
+#if FUSE_USE_VERSION < 30
+        if(filler(buf, entries[i].c_str(), NULL, max_offset + i) != 0) {
+#else
+        if(filler(buf, entries[i].c_str(), NULL, max_offset + i, (fuse_fill_dir_flags) 0) != 0) {
+#endif
+            break;
+        }
+    }
+
+    return 0;
 
 }
 
@@ -697,32 +887,59 @@ static void* efsng_init(struct fuse_conn_info *conn) {
 static void* efsng_init(struct fuse_conn_info *conn, struct fuse_config* cfg) {
 #endif
 
-    (void) conn;
+    if(m_user_opts.m_max_readahead != 0) {
+        conn->max_readahead = m_user_opts.m_max_readahead;
+    }
 
 #if FUSE_USE_VERSION >= 30
 
-#ifdef __TEST_WRITEBACK_CACHE__
-    if(conn->capable & FUSE_CAP_WRITEBACK_CACHE) {
-        conn->want |= FUSE_CAP_WRITEBACK_CACHE;
-    } 
-    else {
-        std::cerr << "WARNING: Writeback cache not supported\n";
+    if(m_user_opts.m_writeback_cache) {
+        if(conn->capable & FUSE_CAP_WRITEBACK_CACHE) {
+            conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+        } 
+        else {
+            std::cerr << "WARNING: Writeback cache not supported\n";
+        }
     }
-#endif // __TEST_WRITEBACK_CACHE__
 
     conn->want |= FUSE_CAP_SPLICE_READ;
     conn->want |= FUSE_CAP_SPLICE_WRITE;
     conn->want |= FUSE_CAP_SPLICE_MOVE;
 
+    efsng::negotiate_io_uring(conn, m_user_opts);
+
     cfg->use_ino = 1;
+
+    /* let the kernel remember missing names for a while */
+    cfg->negative_timeout = m_user_opts.m_negative_timeout;
 #endif
 
 
+    /* backends align their storage to the size finally agreed on */
+    m_user_opts.m_transfer_size = efsng::negotiate_transfer_size(conn, m_user_opts.m_transfer_size);
+
     auto efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
     if (efsng_ctx == NULL){
         efsng_ctx = new efsng::context(m_user_opts); 
     }
 
+#if FUSE_USE_VERSION >= 30
+    /* let the API notify the kernel when it loads or unloads a path (the
+     * high-level API only tracks inodes, so parent entries are left to 
+     * expire on their own) */
+    struct fuse* fuse = fuse_get_context()->fuse;
+
+    efsng_ctx->m_invalidate = [fuse](const std::string& pathname) {
+        fuse_invalidate_path(fuse, pathname.c_str());
+
+        auto parent_path = bfs::path(pathname).parent_path();
+
+        if(!parent_path.empty()) {
+            fuse_invalidate_path(fuse, parent_path.c_str());
+        }
+    };
+#endif
+
     try {
         efsng_ctx->initialize();
     } 
@@ -775,14 +992,21 @@ static int efsng_access(const char* pathname, int mode){
 
     /* Search the backends */
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
+
+    if(efsng_ctx->m_negatives.contains(pathname)) {
+        return -ENOENT;
+    }
+
+    auto generation = efsng_ctx->m_negatives.generation();
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
     struct stat stbuf;
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;
-    auto err = backend_ptr->do_stat(path,stbuf);
-    if (err != 0) return -ENOENT;
+    auto err = backend_ptr->do_stat(pathname,stbuf);
+    if (err != 0 && efsng_ctx->passthrough_stat(pathname, stbuf) != 0) {
+        efsng_ctx->m_negatives.add(pathname, generation);
+        return -ENOENT;
+    }
     
-    return err;
+    return 0;
 }
 
 /** 
@@ -795,10 +1019,6 @@ static int efsng_access(const char* pathname, int mode){
  */
 static int efsng_create(const char* pathname, mode_t mode, struct fuse_file_info* file_info){
 
-#ifdef __TEST_DIRECT_IO__
-    file_info->direct_io = 1;
-#endif // __TEST_DIRECT_IO__
-
     LOGGER_DEBUG("create called \"{}:{}\" ", pathname, file_info->flags);
     LOGGER_TRACE("create:{}:{}:{}", 
             fuse_get_context()->pid, syscall(__NR_gettid), 
@@ -807,10 +1027,11 @@ static int efsng_create(const char* pathname, mode_t mode, struct fuse_file_info
     /* Search the backends */
 
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
     std::shared_ptr <efsng::backend::file> ptr;
     auto ret = backend_ptr->do_create(pathname, mode, ptr);
+
+    efsng_ctx->m_negatives.invalidate();
     struct stat st;
     
     ptr->stat(st);
@@ -830,10 +1051,15 @@ static int efsng_create(const char* pathname, mode_t mode, struct fuse_file_info
 
     file_info->flags = flags;
 
-    auto file_record = new efsng::File(st.st_ino, 42, file_info->flags);
-    // TODO : We should have a mutex ? to set boot
-    file_record->set_ptr(ptr);
-    file_info->fh = (uint64_t) file_record;
+    uint64_t fh = efsng_ctx->m_handles.open(st.st_ino, 42, file_info->flags, ptr);
+
+    if(fh == 0) {
+        return -ENFILE;
+    }
+
+    file_info->fh = fh;
+
+    efsng_ctx->m_cache_policies.lookup(pathname, backend_ptr).apply(file_info);
 
     return ret;
 }
@@ -856,12 +1082,16 @@ static int efsng_ftruncate(const char* pathname, off_t length, struct fuse_file_
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname);
 
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
     if (file_info->flags & O_RDONLY) return -EINVAL;
     auto ptr = file_record->get_ptr();
-    ptr->truncate(length);
 
-    return 0;
+    return ptr->truncate(length);
 }
 
 /**
@@ -874,15 +1104,21 @@ static int efsng_ftruncate(const char* pathname, off_t length, struct fuse_file_
  */
 static int efsng_fgetattr(const char* pathname, struct stat* stbuf, struct fuse_file_info* file_info){
 
-    (void) pathname;
+    LOGGER_DEBUG("fstat(\"{}\")", pathname);
 
-   // efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+    std::size_t index;
+    efsng_ctx->m_router.resolve(pathname, &index);
 
-    LOGGER_DEBUG("fstat(\"{}\")", pathname);
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
 
-    auto file_record = (efsng::File*) file_info->fh;
     auto ptr = file_record->get_ptr();
     ptr->stat(*stbuf);
+    stbuf->st_ino = efsng::router::global_inode(index, stbuf->st_ino);
     return 0;
 
 }
@@ -916,7 +1152,12 @@ static int efsng_lock(const char* pathname, struct fuse_file_info* file_info, in
     (void) pathname;
     return -EOPNOTSUPP;
 
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
 
     int fd = file_record->get_inode();
 
@@ -945,10 +1186,8 @@ static int efsng_utimens(const char* pathname, const struct timespec tv[2], stru
 
     /* Search the backends */
     efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
-    const auto & kv = efsng_ctx->m_backends.begin();
-    const auto& backend_ptr = kv->second; 
-    const char* path = fastlink.count(pathname) >0 ? fastlink[pathname].c_str() : pathname;   
-    auto ptr = backend_ptr->find(path);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname);
+    auto ptr = backend_ptr->find(pathname);
    
     if (ptr == backend_ptr->end()) {     
         return -ENOENT;
@@ -990,14 +1229,22 @@ static int efsng_bmap(const char* pathname, size_t blocksize, uint64_t* idx){
 static int efsng_ioctl(const char* pathname, int cmd, void* arg, struct fuse_file_info* file_info, unsigned int flags,
                        void* data){
 
-    (void) pathname;
-    (void) cmd;
     (void) arg;
-    (void) file_info;
-    (void) flags;
-    (void) data;
 
-    return -EOPNOTSUPP;
+    /* only the control operations in efs-ioctl.h are supported, and only on files */
+    if(flags & FUSE_IOCTL_DIR) {
+        return -ENOTTY;
+    }
+
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
+    efsng::context* efsng_ctx = (efsng::context*) fuse_get_context()->private_data;
+
+    return efsng_ctx->file_ioctl(pathname, file_record->get_ptr(), cmd, data);
 }
 
 /** 
@@ -1040,7 +1287,12 @@ static int efsng_write_buf(const char* pathname, struct fuse_bufvec* buf, off_t
     auto t0 = std::chrono::steady_clock::now();
 #endif
 
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
     auto file_ptr = file_record->get_ptr();
     //pid_t pid = 0;
 
@@ -1051,7 +1303,11 @@ static int efsng_write_buf(const char* pathname, struct fuse_bufvec* buf, off_t
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname, offset, size);
 
-    ssize_t rv = file_ptr->put_data(offset, size, buf);
+    ssize_t rv = file_ptr->put_data(offset, size, buf, file_record->get_cursor());
+
+    if(rv >= 0) {
+        file_ptr->record_write(rv);
+    }
 
 #ifdef __EFS_TIMING__
     auto t1 = std::chrono::steady_clock::now();
@@ -1078,29 +1334,35 @@ static int efsng_write_buf(const char* pathname, struct fuse_bufvec* buf, off_t
 static int efsng_read_buf(const char* pathname, struct fuse_bufvec** bufp, size_t size, off_t offset, 
                           struct fuse_file_info* file_info){
 
-    auto file_record = (efsng::File*) file_info->fh;
-    auto file_ptr = file_record->get_ptr();
-
-    struct fuse_bufvec* dst;
-
-    dst = (struct fuse_bufvec*) malloc(sizeof(struct fuse_bufvec));
+    auto file_record = get_file_record(file_info);
 
-    if(dst == NULL){
-        return -ENOMEM;
+    if(file_record == nullptr) {
+        return -EBADF;
     }
 
+    auto file_ptr = file_record->get_ptr();
+
     LOGGER_DEBUG("read(\"{}\", {}, {})", pathname, offset, size);
     LOGGER_TRACE("read:{}:{}:{}:{}:{}", 
             fuse_get_context()->pid, syscall(__NR_gettid), 
             pathname, offset, size);
 
-    *dst = FUSE_BUFVEC_INIT(size);
+    efsng::backend::data_view_ptr view;
 
-    ssize_t rv = file_ptr->get_data(offset, size, dst);
+    ssize_t rv = file_ptr->map_data(offset, size, view, file_record->get_cursor());
 
-    *bufp = dst;
+    if(rv < 0) {
+        return rv;
+    }
 
-    return rv;
+    file_ptr->record_read(view->size());
+
+    /* libfuse free()s every memory buffer in the bufvec once the reply is sent,
+     * so we can't return views into the backend mappings here as the low-level
+     * front end does (see efsng_ll_read()). Nor can we pass on descriptors to 
+     * splice from, since the view (and hence whatever keeps the descriptors 
+     * open) is gone by then: release() hands us a copy */
+    return view->release(bufp);
 }
 
 /**
@@ -1122,7 +1384,12 @@ static int efsng_flock(const char* pathname, struct fuse_file_info* file_info, i
 
     (void) pathname;
     return -EOPNOTSUPP;
-    auto file_record = (efsng::File*) file_info->fh;
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
+
 
     int fd = file_record->get_fd();
 
@@ -1147,23 +1414,53 @@ static int efsng_fallocate(const char* pathname, int mode, off_t offset, off_t l
                            struct fuse_file_info* file_info){
 
     (void) pathname;
-      if(mode != 0){
-        return -EOPNOTSUPP;
-    }
     
-    LOGGER_DEBUG("allocate(\"{}\", {}, {})", pathname, offset, length);
+    LOGGER_DEBUG("fallocate(\"{}\", {:#x}, {}, {})", pathname, mode, offset, length);
+
+    auto file_record = get_file_record(file_info);
+
+    if(file_record == nullptr) {
+        return -EBADF;
+    }
 
-    auto file_record = (efsng::File*) file_info->fh;
     auto file_ptr = file_record->get_ptr();
-    ssize_t rv = file_ptr->allocate(offset, length);
-    
-    return rv;
-    
-    /* only posix_fallocate is supported at the moment */
-  
+    /* posix_fallocate(), FALLOC_FL_KEEP_SIZE, FALLOC_FL_PUNCH_HOLE and FALLOC_FL_ZERO_RANGE 
+     * are supported, anything else is rejected by the backend with -EOPNOTSUPP */
+    return file_ptr->fallocate(mode, offset, length);
 }
 #endif /* HAVE_POSIX_FALLOCATE */
 
+#if FUSE_USE_VERSION >= 30 && FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4)
+/**
+ * Copy a range of data from one file to another
+ *
+ * Backends may share the underlying storage between both files rather than copying data, 
+ * so that duplicating a file doesn't require moving it through the kernel twice.
+ */
+static ssize_t efsng_copy_file_range(const char* path_in, struct fuse_file_info* fi_in, off_t offset_in, 
+                                     const char* path_out, struct fuse_file_info* fi_out, off_t offset_out, 
+                                     size_t size, int flags) {
+
+    (void) path_in;
+    (void) path_out;
+
+    LOGGER_DEBUG("copy_file_range(\"{}\", {}, \"{}\", {}, {})", path_in, offset_in, path_out, offset_out, size);
+
+    if(flags != 0) {
+        return -EINVAL;
+    }
+
+    auto record_in = get_file_record(fi_in);
+    auto record_out = get_file_record(fi_out);
+
+    if(record_in == nullptr || record_out == nullptr) {
+        return -EBADF;
+    }
+
+    return record_out->get_ptr()->copy_range(*record_in->get_ptr(), offset_in, offset_out, size);
+}
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4) */
+
 /**********************************************************************************************************************/
 /*  main point of entry                                                                                               */
 /**********************************************************************************************************************/
@@ -1252,17 +1549,20 @@ int main (int argc, char *argv[]){
 #ifdef HAVE_POSIX_FALLOCATE
     efsng_ops.fallocate = efsng_fallocate;
 #endif /* HAVE_POSIX_FALLOCATE */
+
+#if FUSE_USE_VERSION >= 30 && FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4)
+    efsng_ops.copy_file_range = efsng_copy_file_range;
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4) */
     
     /* 3. set the umask */
     umask(0);
 
     /* 4. start the FUSE filesystem */
-//    int res = efsng::fuse_custom_mounter(m_user_opts, &efsng_ops);
+#if FUSE_USE_VERSION >= 30
+    if(m_user_opts.m_lowlevel) {
+        return efsng::fuse_lowlevel_mounter(m_user_opts);
+    }
+#endif
 
-    int res = fuse_main(m_user_opts.m_fuse_argc, 
-                        const_cast<char **>(m_user_opts.m_fuse_argv), 
-                        &efsng_ops, 
-                        NULL);
-    
-    return res;
+    return efsng::fuse_custom_mounter(m_user_opts, &efsng_ops);
 }
@@ -0,0 +1,168 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include <functional>
+#include <limits>
+#include <new>
+#include <thread>
+
+#include "epoch.h"
+
+namespace efsng {
+
+epoch_manager::epoch_manager()
+    : m_epoch(s_idle + 1),
+      m_num_retired(0) {
+
+    for(auto& s : m_slots) {
+        s.m_epoch = s_idle;
+    }
+}
+
+epoch_manager& epoch_manager::global() {
+
+    alignas(epoch_manager) static char storage[sizeof(epoch_manager)];
+    static epoch_manager* manager = new (storage) epoch_manager();
+
+    return *manager;
+}
+
+epoch_manager::guard epoch_manager::enter() {
+
+    // threads stick to the last slot they used, so that readers normally 
+    // find theirs free and don't touch each other's cache lines
+    static thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    for(size_t i = 0; ; ++i) {
+
+        size_t index = (hint + i) % s_num_slots;
+        slot& s = m_slots[index];
+        uint64_t expected = s_idle;
+
+        // (if a writer advances the epoch in between, we just announce an older 
+        // one than needed, which only delays reclamation)
+        if(s.m_epoch.load(std::memory_order_relaxed) == s_idle &&
+           s.m_epoch.compare_exchange_strong(expected, m_epoch.load())) {
+            hint = index;
+            return guard(this, index);
+        }
+
+        // every slot is taken: wait for some reader to leave
+        if(i != 0 && i % s_num_slots == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void epoch_manager::leave(size_t index) {
+
+    m_slots[index].m_epoch.store(s_idle, std::memory_order_release);
+
+    // the last reader of an old epoch releases what was retired meanwhile
+    if(m_num_retired.load(std::memory_order_relaxed) != 0) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+
+        if(lock.owns_lock()) {
+            release_expired(lock);
+        }
+    }
+}
+
+void epoch_manager::retire(std::shared_ptr<const void> ptr) {
+
+    // readers that enter after this point can't reach 'ptr' anymore: only 
+    // those in this epoch (or older ones) may still be using it
+    uint64_t epoch = m_epoch.fetch_add(1);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_retired.emplace_back(epoch, std::move(ptr));
+    m_num_retired = m_retired.size();
+
+    release_expired(lock);
+}
+
+void epoch_manager::reclaim() {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    release_expired(lock);
+}
+
+// precondition:
+// - lock owns m_mutex (which may be released before returning)
+void epoch_manager::release_expired(std::unique_lock<std::mutex>& lock) {
+
+    if(m_retired.empty()) {
+        return;
+    }
+
+    uint64_t oldest = oldest_active_epoch();
+    std::vector<std::shared_ptr<const void>> expired;
+
+    auto it = m_retired.begin();
+
+    for(auto jt = m_retired.begin(); jt != m_retired.end(); ++jt) {
+        if(jt->first < oldest) {
+            expired.push_back(std::move(jt->second));
+        }
+        else {
+            *it++ = std::move(*jt);
+        }
+    }
+
+    m_retired.erase(it, m_retired.end());
+    m_num_retired = m_retired.size();
+
+    lock.unlock();
+
+    // releasing objects may take a while (e.g. segments unmap their storage)
+    expired.clear();
+}
+
+uint64_t epoch_manager::oldest_active_epoch() const {
+
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+
+    for(const auto& s : m_slots) {
+        uint64_t epoch = s.m_epoch.load();
+
+        if(epoch != s_idle && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    return oldest;
+}
+
+} // namespace efsng
@@ -0,0 +1,159 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace efsng {
+
+/*! Epoch-based reclamation for structures that are read without taking any 
+ * locks (e.g. the segment map of a file).
+ *
+ * Writers still serialize among themselves, but rather than modifying what 
+ * readers may be looking at, they publish a new version of it and retire() 
+ * the old one. Readers enter() the current epoch before loading the published 
+ * version and leave it once they are done with it: retired objects are only 
+ * released when every reader that could have seen them has left.
+ *
+ * epoch_manager::guard g = epoch_manager::global().enter();\n
+ * const auto* v = published.load();\n
+ * // *v stays alive until g is destroyed
+ *
+ * Each reader only writes to a slot (i.e. a cache line) of its own, so readers 
+ * don't bounce a shared counter or mutex between them. The published pointer 
+ * must be loaded with the default (sequentially consistent) memory ordering.
+ */
+class epoch_manager {
+
+public:
+    /*! A reader inside an epoch: leaves it when destroyed (or released), which 
+     * need not happen in the thread that entered it */
+    class guard {
+
+    public:
+        guard()
+            : m_manager(nullptr),
+              m_slot(0) { }
+
+        guard(guard&& other)
+            : m_manager(other.m_manager),
+              m_slot(other.m_slot) {
+            other.m_manager = nullptr;
+        }
+
+        guard& operator=(guard&& other) {
+            if(this != &other) {
+                release();
+                m_manager = other.m_manager;
+                m_slot = other.m_slot;
+                other.m_manager = nullptr;
+            }
+            return *this;
+        }
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+        ~guard() {
+            release();
+        }
+
+        void release() {
+            if(m_manager != nullptr) {
+                m_manager->leave(m_slot);
+                m_manager = nullptr;
+            }
+        }
+
+    private:
+        friend class epoch_manager;
+
+        guard(epoch_manager* manager, size_t slot)
+            : m_manager(manager),
+              m_slot(slot) { }
+
+        epoch_manager*  m_manager;
+        size_t          m_slot;
+    };
+
+    epoch_manager();
+
+    /*! Process-wide manager (never destroyed, so that objects can still be 
+     * retired while static objects are being torn down) */
+    static epoch_manager& global();
+
+    /*! Enter the current epoch */
+    guard enter();
+
+    /*! Release 'ptr' once no reader that may have loaded it remains (it must 
+     * have been unpublished already) */
+    void retire(std::shared_ptr<const void> ptr);
+
+    /*! Release whatever retired objects are no longer reachable by any reader */
+    void reclaim();
+
+    /*! Number of retired objects not released yet */
+    size_t pending() const {
+        return m_num_retired.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t s_num_slots = 128;
+    static const uint64_t s_idle = 0;
+
+    struct alignas(64) slot {
+        std::atomic<uint64_t> m_epoch; /*!< Epoch entered by the reader in the slot (s_idle if none) */
+    };
+
+    void leave(size_t slot);
+    void release_expired(std::unique_lock<std::mutex>& lock);
+    uint64_t oldest_active_epoch() const;
+
+    alignas(64) std::atomic<uint64_t> m_epoch; /*!< Current epoch (only advanced by writers) */
+    slot m_slots[s_num_slots];
+
+    std::mutex m_mutex; /*!< Protects m_retired */
+    std::vector<std::pair<uint64_t, std::shared_ptr<const void>>> m_retired; /*!< Objects retired and the epoch they were retired in */
+    std::atomic<size_t> m_num_retired;
+};
+
+} // namespace efsng
+
+#endif /* __EPOCH_H__ */
@@ -0,0 +1,1515 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+/* C includes */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <fuse.h>
+
+#if FUSE_USE_VERSION >= 30
+#include <fuse_lowlevel.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* C++ includes */
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <iostream>
+
+/* internal includes */
+#include <metadata/files.h>
+#include <metadata/inodes.h>
+#include <backends/passthrough-file.h>
+#include "logger.h"
+#include "context.h"
+#include "fuse-lowlevel.h"
+#include "fuse-mount-helper.h"
+
+/**********************************************************************************************************************/
+/*   Low-level filesystem operations
+ *
+ * These work on the inode numbers issued by the backends rather than on full paths: the kernel resolves paths
+ * component by component through lookup(), and we keep an inode table (efsng::inode_table) that maps each inode 
+ * handed out to its current path and, for regular files, to the backend::file holding its data. Operations on an 
+ * inode that has already been looked up are thus served without walking the backend's path maps again.
+ *
+ * Replies are sent with fuse_reply_*() instead of being returned: errors are passed as positive errno values.
+ **********************************************************************************************************************/
+
+/* open directory: its entries are fetched from the backend a page at a time by readdir(), 
+ * using the offsets it hands out, followed by the entries it knows nothing about */
+struct dir_handle {
+    std::string m_pathname;
+    efsng::backend* m_backend;          /* backend serving the directory */
+    std::vector<std::string> m_extra;   /* symbolic links and prefixes routed elsewhere */
+};
+
+/* an entry listed by a backend, waiting to be added to a readdir() reply */
+struct dir_entry {
+    std::string m_name;
+    struct stat m_stat;
+    bool m_has_stat;
+    off_t m_offset;
+};
+
+/* collects the entries listed by a backend that fit in a readdir() reply */
+struct dir_page {
+    fuse_req_t m_req;
+    bool m_plus;
+    size_t m_size;      /* space left in the reply */
+    bool m_full;
+    std::vector<dir_entry> m_entries;
+};
+
+static efsng::context* get_context(fuse_req_t req) {
+    return (efsng::context*) fuse_req_userdata(req);
+}
+
+/* fetch the open file record for the handle in file_info->fh (nullptr if stale) */
+static efsng::File* get_file_record(fuse_req_t req, struct fuse_file_info* file_info) {
+    return get_context(req)->m_handles.get(file_info->fh);
+}
+
+/* fetch the path, file pointer and backend of 'ino' (the backend is cached in the inode 
+ * table at lookup, so paths only need to be routed again for new names) */
+static bool find_inode(efsng::context* efsng_ctx, fuse_ino_t ino, std::string& pathname, 
+                       std::shared_ptr<efsng::backend::file>& ptr, efsng::backend*& backend_ptr) {
+
+    if(!efsng_ctx->m_inodes.find(ino, pathname, ptr, backend_ptr)) {
+        return false;
+    }
+
+    if(backend_ptr == nullptr) {
+        backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str());
+    }
+
+    return true;
+}
+
+static bool find_inode(efsng::context* efsng_ctx, fuse_ino_t ino, std::string& pathname, 
+                       efsng::backend*& backend_ptr) {
+    std::shared_ptr<efsng::backend::file> ptr;
+    return find_inode(efsng_ctx, ino, pathname, ptr, backend_ptr);
+}
+
+static std::string build_path(const std::string& parent, const char* name) {
+    if(parent == "/") {
+        return parent + name;
+    }
+    return parent + "/" + name;
+}
+
+static int flags_at_open(int fi_flags) {
+
+    int flags = 0;
+
+    /* O_RDONLY is 0, so the access mode must be compared rather than tested */
+    switch(fi_flags & O_ACCMODE) {
+        case O_RDONLY:
+            flags |= O_RDONLY;
+            break;
+        case O_WRONLY:
+            flags |= O_WRONLY;
+            break;
+        case O_RDWR:
+            flags |= O_RDWR;
+            break;
+    }
+
+    return flags;
+}
+
+/* fill 'e' with the attributes of 'pathname' and register it in the inode table */
+static int make_entry(efsng::context* efsng_ctx, const std::string& pathname, struct fuse_entry_param* e) {
+
+    std::shared_ptr<efsng::backend::file> ptr;
+    std::size_t index;
+
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str(), &index);
+
+    memset(e, 0, sizeof(*e));
+
+    /* symbolic links have no backend::file */
+    if(!efsng_ctx->m_symlinks.stat(pathname, e->attr)) {
+
+        auto it = backend_ptr->find(pathname.c_str());
+
+        if(it != backend_ptr->end()) {
+            ptr = it->second;
+            ptr->stat(e->attr);
+        }
+        else {
+            int rv = backend_ptr->do_stat(pathname.c_str(), e->attr);
+
+            /* unstaged files may still be served from the underlying filesystem 
+             * (their inode numbers are already unique) */
+            if(rv == -ENOENT) {
+                rv = efsng_ctx->passthrough_stat(pathname, e->attr);
+
+                if(rv != 0) {
+                    return rv;
+                }
+
+                index = 0;
+            }
+            else if(rv != 0) {
+                return rv;
+            }
+        }
+
+        /* inodes must be unique across backends */
+        e->attr.st_ino = efsng::router::global_inode(index, e->attr.st_ino);
+    }
+
+    /* how long the kernel may cache the name and attributes */
+    auto policy = efsng_ctx->m_cache_policies.lookup(pathname.c_str(), backend_ptr);
+
+    e->ino = e->attr.st_ino;
+    e->attr_timeout = policy.m_attr_timeout;
+    e->entry_timeout = policy.m_entry_timeout;
+
+    efsng_ctx->m_inodes.add(e->ino, pathname, ptr, backend_ptr);
+
+    return 0;
+}
+
+/* fetch the current attributes for 'ino' */
+static int stat_inode(efsng::context* efsng_ctx, fuse_ino_t ino, struct stat& stbuf) {
+
+    std::string pathname;
+    std::shared_ptr<efsng::backend::file> ptr;
+    efsng::backend* backend_ptr;
+
+    if(!find_inode(efsng_ctx, ino, pathname, ptr, backend_ptr)) {
+        return -ENOENT;
+    }
+
+    if(ptr) {
+        ptr->stat(stbuf);
+    }
+    else if(!efsng_ctx->m_symlinks.stat(pathname, stbuf)) {
+        int rv = backend_ptr->do_stat(pathname.c_str(), stbuf);
+
+        if(rv == -ENOENT) {
+            rv = efsng_ctx->passthrough_stat(pathname, stbuf);
+        }
+
+        if(rv != 0) {
+            return rv;
+        }
+    }
+
+    stbuf.st_ino = ino;
+    return 0;
+}
+
+/* fetch how long the kernel may cache the attributes of 'ino' */
+static double attr_timeout(efsng::context* efsng_ctx, fuse_ino_t ino) {
+
+    std::string pathname;
+    efsng::backend* backend_ptr;
+
+    if(!find_inode(efsng_ctx, ino, pathname, backend_ptr)) {
+        return 0.0;
+    }
+
+    return efsng_ctx->m_cache_policies.lookup(pathname.c_str(), backend_ptr).m_attr_timeout;
+}
+
+/* drop anything the kernel has cached for 'pathname' and the inodes below it, as 
+ * well as its entry in the parent directory (so that loaded files show up) */
+static void invalidate_path(struct fuse_session* se, efsng::context* efsng_ctx, const std::string& pathname) {
+
+    std::vector<ino_t> inodes;
+    efsng_ctx->m_inodes.subtree(pathname, inodes);
+
+    for(const auto& ino : inodes) {
+        fuse_lowlevel_notify_inval_inode(se, ino, 0, 0);
+    }
+
+    if(pathname == "/") {
+        return;
+    }
+
+    auto pos = pathname.rfind('/');
+    auto parent_path = (pos == 0 ? std::string("/") : pathname.substr(0, pos));
+    auto name = pathname.substr(pos + 1);
+    ino_t parent;
+
+    if(efsng_ctx->m_inodes.find_path(parent_path, parent)) {
+        fuse_lowlevel_notify_inval_entry(se, parent, name.c_str(), name.size());
+        fuse_lowlevel_notify_inval_inode(se, parent, 0, 0);
+    }
+}
+
+/* size of the reply record needed for an entry */
+static size_t direntry_size(fuse_req_t req, bool plus, const char* name) {
+
+    if(plus) {
+        struct fuse_entry_param e;
+        memset(&e, 0, sizeof(e));
+        return fuse_add_direntry_plus(req, NULL, 0, name, &e, 0);
+    }
+
+    return fuse_add_direntry(req, NULL, 0, name, NULL, 0);
+}
+
+/* collect the entries produced by a backend's do_readdir() while they fit in the reply. 
+ * Nothing else is done here since the backend is holding its locks */
+static int collect_entry(void* buf, const char* name, const struct stat* stbuf, off_t off, 
+                         enum fuse_fill_dir_flags flags) {
+    (void) flags;
+
+    auto page = (dir_page*) buf;
+    size_t entsize = direntry_size(page->m_req, page->m_plus, name);
+
+    if(entsize > page->m_size) {
+        page->m_full = true;
+        return 1;
+    }
+
+    page->m_size -= entsize;
+    page->m_entries.push_back({name, {}, stbuf != NULL, off});
+
+    if(stbuf != NULL) {
+        page->m_entries.back().m_stat = *stbuf;
+    }
+
+    return 0;
+}
+
+/* add an entry to a readdir() reply: for readdirplus, entries other than "." and ".." 
+ * carry their attributes and count as a lookup, as if lookup() had been called.
+ * Inode numbers in 'stbuf' must already be unique across backends */
+static size_t add_entry(efsng::context* efsng_ctx, fuse_req_t req, bool plus, char* buf, size_t size,
+                        const std::string& dirpath, const std::string& name, struct stat* stbuf, off_t off) {
+
+    const bool is_dot = (name == "." || name == "..");
+    const auto child = build_path(dirpath, name.c_str());
+
+    if(!plus) {
+        struct stat st;
+
+        if(stbuf == NULL) {
+            memset(&st, 0, sizeof(st));
+            stbuf = &st;
+        }
+
+        return fuse_add_direntry(req, buf, size, name.c_str(), stbuf, off);
+    }
+
+    struct fuse_entry_param e;
+    memset(&e, 0, sizeof(e));
+
+    if(is_dot || make_entry(efsng_ctx, child, &e) != 0) {
+        /* a zero inode tells the kernel not to cache anything for the entry */
+        e.ino = 0;
+
+        if(stbuf != NULL) {
+            e.attr.st_ino = stbuf->st_ino;
+            e.attr.st_mode = stbuf->st_mode;
+        }
+    }
+
+    return fuse_add_direntry_plus(req, buf, size, name.c_str(), &e, off);
+}
+
+static void efsng_ll_init(void* userdata, struct fuse_conn_info* conn) {
+
+    auto efsng_ctx = (efsng::context*) userdata;
+    const auto& user_args = efsng_ctx->m_user_args;
+
+    if(user_args->m_writeback_cache) {
+        if(conn->capable & FUSE_CAP_WRITEBACK_CACHE) {
+            conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+        } 
+        else {
+            std::cerr << "WARNING: Writeback cache not supported\n";
+        }
+    }
+
+    if(user_args->m_max_readahead != 0) {
+        conn->max_readahead = user_args->m_max_readahead;
+    }
+
+    /* backends align their storage to the size finally agreed on */
+    user_args->m_transfer_size = efsng::negotiate_transfer_size(conn, user_args->m_transfer_size);
+
+    conn->want |= FUSE_CAP_SPLICE_READ;
+    conn->want |= FUSE_CAP_SPLICE_WRITE;
+    conn->want |= FUSE_CAP_SPLICE_MOVE;
+
+    efsng::negotiate_io_uring(conn, *user_args);
+
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 17)
+    /* let the kernel read and write unstaged files directly (the kernel
+     * refuses passthrough files while writes are being cached) */
+    if(user_args->m_passthrough && !(conn->want & FUSE_CAP_WRITEBACK_CACHE)) {
+        if(conn->capable & FUSE_CAP_PASSTHROUGH) {
+            conn->want |= FUSE_CAP_PASSTHROUGH;
+            efsng_ctx->m_kernel_passthrough = true;
+        }
+        else {
+            std::cerr << "WARNING: FUSE passthrough not supported, unstaged files will be spliced\n";
+        }
+    }
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 17) */
+
+    try {
+        efsng_ctx->initialize();
+    } 
+    catch(const std::exception& e) {
+        if(efsng::logger::get_global_logger() != nullptr) {
+            LOGGER_ERROR(e.what());
+        }
+        else {
+            std::cerr << e.what() << "\n";
+        }
+
+        // WARNING! trigger_shutdown() does not stop execution!
+        efsng_ctx->trigger_shutdown();
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void efsng_ll_destroy(void* userdata) {
+
+    auto efsng_ctx = (efsng::context*) userdata;
+
+    // this will block until all pending tasks have finished
+    efsng_ctx->teardown();
+}
+
+/** Look up a directory entry by name and get its attributes */
+static void efsng_ll_lookup(fuse_req_t req, fuse_ino_t parent, const char* name) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto pathname = build_path(parent_path, name);
+
+    LOGGER_DEBUG("lookup(\"{}\")", pathname);
+
+    struct fuse_entry_param e;
+    int rv = -ENOENT;
+
+    /* probing for missing names is common (e.g. loaders, import paths) */
+    if(!efsng_ctx->m_negatives.contains(pathname)) {
+        auto generation = efsng_ctx->m_negatives.generation();
+
+        if((rv = make_entry(efsng_ctx, pathname, &e)) == -ENOENT) {
+            efsng_ctx->m_negatives.add(pathname, generation);
+        }
+    }
+
+    if(rv == -ENOENT) {
+        /* let the kernel remember that the name doesn't exist (a zero inode) */
+        if(efsng_ctx->m_user_args->m_negative_timeout != 0) {
+            memset(&e, 0, sizeof(e));
+            e.entry_timeout = efsng_ctx->m_user_args->m_negative_timeout;
+            fuse_reply_entry(req, &e);
+            return;
+        }
+    }
+
+    if(rv != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    fuse_reply_entry(req, &e);
+
+    /* now that the kernel knows about the inode, its page cache can be 
+     * filled in if the caching policy asks for it */
+    std::shared_ptr<efsng::backend::file> ptr;
+
+    if(efsng_ctx->m_inodes.find(e.ino, pathname, ptr) && ptr) {
+        efsng_ctx->warm_cache(pathname, e.ino, ptr);
+    }
+}
+
+/** Forget about an inode */
+static void efsng_ll_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup) {
+    get_context(req)->m_inodes.forget(ino, nlookup);
+    fuse_reply_none(req);
+}
+
+/** Forget about multiple inodes */
+static void efsng_ll_forget_multi(fuse_req_t req, size_t count, struct fuse_forget_data* forgets) {
+
+    auto efsng_ctx = get_context(req);
+
+    for(size_t i=0; i<count; ++i) {
+        efsng_ctx->m_inodes.forget(forgets[i].ino, forgets[i].nlookup);
+    }
+
+    fuse_reply_none(req);
+}
+
+/** Get file attributes */
+static void efsng_ll_getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* file_info) {
+
+    auto efsng_ctx = get_context(req);
+    struct stat stbuf;
+
+    efsng::File* file_record;
+
+    if(file_info != NULL && (file_record = get_file_record(req, file_info)) != nullptr) {
+        file_record->get_ptr()->stat(stbuf);
+        stbuf.st_ino = ino;
+        fuse_reply_attr(req, &stbuf, attr_timeout(efsng_ctx, ino));
+        return;
+    }
+
+    int rv = stat_inode(efsng_ctx, ino, stbuf);
+
+    if(rv != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    fuse_reply_attr(req, &stbuf, attr_timeout(efsng_ctx, ino));
+}
+
+/** Set file attributes: covers chmod, chown, truncate and utimens */
+static void efsng_ll_setattr(fuse_req_t req, fuse_ino_t ino, struct stat* attr, int to_set, 
+                             struct fuse_file_info* file_info) {
+
+    auto efsng_ctx = get_context(req);
+
+    std::string pathname;
+    std::shared_ptr<efsng::backend::file> ptr;
+    efsng::backend* backend_ptr;
+
+    if(!find_inode(efsng_ctx, ino, pathname, ptr, backend_ptr)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    efsng::File* file_record;
+
+    if(file_info != NULL && (file_record = get_file_record(req, file_info)) != nullptr) {
+        ptr = file_record->get_ptr();
+    }
+
+    struct stat stbuf;
+
+    /* the size and times of unstaged files are changed in the underlying filesystem, 
+     * their mode and owner can't be changed (the kernel has already checked that the 
+     * caller may do so, see 'default_permissions' in fuse_lowlevel_mounter()) */
+    if(!ptr && backend_ptr->do_stat(pathname.c_str(), stbuf) == -ENOENT &&
+       !efsng_ctx->m_symlinks.stat(pathname, stbuf)) {
+        int rv = efsng_ctx->passthrough_open(pathname, (to_set & FUSE_SET_ATTR_SIZE) ? O_WRONLY : O_RDONLY, ptr);
+
+        if(rv == 0 && (to_set & (FUSE_SET_ATTR_MODE | FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID))) {
+            rv = -EPERM;
+        }
+
+        if(rv != 0) {
+            fuse_reply_err(req, -rv);
+            return;
+        }
+    }
+
+    LOGGER_DEBUG("setattr(\"{}\", {})", pathname, to_set);
+
+    int rv = 0;
+
+    if(to_set & FUSE_SET_ATTR_MODE) {
+        rv = backend_ptr->do_chmod(pathname.c_str(), attr->st_mode);
+    }
+
+    if(rv == 0 && (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID))) {
+        rv = stat_inode(efsng_ctx, ino, stbuf);
+
+        if(rv == 0) {
+            uid_t uid = (to_set & FUSE_SET_ATTR_UID) ? attr->st_uid : stbuf.st_uid;
+            gid_t gid = (to_set & FUSE_SET_ATTR_GID) ? attr->st_gid : stbuf.st_gid;
+            rv = backend_ptr->do_chown(pathname.c_str(), uid, gid);
+        }
+    }
+
+    if(rv == 0 && (to_set & FUSE_SET_ATTR_SIZE)) {
+        if(!ptr) {
+            rv = -EISDIR;
+        }
+        else if(attr->st_size < 0) {
+            rv = -EINVAL;
+        }
+        else {
+            rv = ptr->truncate(attr->st_size);
+        }
+    }
+
+    if(rv == 0 && (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME)) && ptr) {
+        ptr->stat(stbuf);
+
+        if(to_set & FUSE_SET_ATTR_ATIME) {
+            stbuf.st_atime = (to_set & FUSE_SET_ATTR_ATIME_NOW) ? time(NULL) : attr->st_atime;
+        }
+
+        if(to_set & FUSE_SET_ATTR_MTIME) {
+            stbuf.st_mtime = (to_set & FUSE_SET_ATTR_MTIME_NOW) ? time(NULL) : attr->st_mtime;
+        }
+
+        ptr->save_attributes(stbuf);
+    }
+
+    if(rv != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    if(ptr) {
+        ptr->stat(stbuf);
+    }
+    else if((rv = backend_ptr->do_stat(pathname.c_str(), stbuf)) != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    stbuf.st_ino = ino;
+    fuse_reply_attr(req, &stbuf, efsng_ctx->m_cache_policies.lookup(pathname.c_str(), backend_ptr).m_attr_timeout);
+}
+
+/** Create a directory */
+static void efsng_ll_mkdir(fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto pathname = build_path(parent_path, name);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str());
+
+    if(backend_ptr->do_mkdir(pathname.c_str(), mode) != 0) {
+        fuse_reply_err(req, EEXIST);
+        return;
+    }
+
+    efsng_ctx->m_negatives.invalidate();
+
+    struct fuse_entry_param e;
+    int rv = make_entry(efsng_ctx, pathname, &e);
+
+    if(rv != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    fuse_reply_entry(req, &e);
+}
+
+/** Read the target of a symbolic link */
+static void efsng_ll_readlink(fuse_req_t req, fuse_ino_t ino) {
+
+    auto efsng_ctx = get_context(req);
+    std::string pathname;
+    std::string target;
+
+    if(!efsng_ctx->m_inodes.find(ino, pathname)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    if(!efsng_ctx->m_symlinks.find(pathname, target)) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    fuse_reply_readlink(req, target.c_str());
+}
+
+/** Create a symbolic link */
+static void efsng_ll_symlink(fuse_req_t req, const char* target, fuse_ino_t parent, const char* name) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto pathname = build_path(parent_path, name);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str());
+    const struct fuse_ctx* fctx = fuse_req_ctx(req);
+    struct stat stbuf;
+
+    if(backend_ptr->do_stat(pathname.c_str(), stbuf) == 0 ||
+       !efsng_ctx->m_symlinks.add(pathname, target, fctx->uid, fctx->gid)) {
+        fuse_reply_err(req, EEXIST);
+        return;
+    }
+
+    efsng_ctx->m_negatives.invalidate();
+
+    struct fuse_entry_param e;
+    int rv = make_entry(efsng_ctx, pathname, &e);
+
+    if(rv != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    fuse_reply_entry(req, &e);
+}
+
+/** Remove a file */
+static void efsng_ll_unlink(fuse_req_t req, fuse_ino_t parent, const char* name) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto pathname = build_path(parent_path, name);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str());
+
+    LOGGER_DEBUG("unlink(\"{}\")", pathname);
+
+    if(efsng_ctx->m_symlinks.remove(pathname)) {
+        fuse_reply_err(req, 0);
+        return;
+    }
+
+    fuse_reply_err(req, -backend_ptr->do_unlink(pathname.c_str()));
+}
+
+/** Remove a directory */
+static void efsng_ll_rmdir(fuse_req_t req, fuse_ino_t parent, const char* name) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto pathname = build_path(parent_path, name);
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str());
+
+    fuse_reply_err(req, -backend_ptr->do_rmdir(pathname.c_str()));
+}
+
+/** Rename a file */
+static void efsng_ll_rename(fuse_req_t req, fuse_ino_t parent, const char* name, 
+                            fuse_ino_t newparent, const char* newname, unsigned int flags) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+    std::string newparent_path;
+    struct stat stbuf;
+
+    if(flags != 0) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path) || 
+       !efsng_ctx->m_inodes.find(newparent, newparent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto oldpath = build_path(parent_path, name);
+    auto newpath = build_path(newparent_path, newname);
+    auto backend_ptr = efsng_ctx->m_router.resolve(oldpath.c_str());
+
+    LOGGER_DEBUG("rename(\"{}\",\"{}\")", oldpath, newpath);
+
+    /* files cannot be moved between backends */
+    if(efsng_ctx->m_router.resolve(newpath.c_str()) != backend_ptr && 
+       !efsng_ctx->m_symlinks.stat(oldpath, stbuf)) {
+        fuse_reply_err(req, EXDEV);
+        return;
+    }
+
+    int rv = efsng_ctx->m_symlinks.rename(oldpath, newpath) ? 
+                0 : backend_ptr->do_rename(oldpath.c_str(), newpath.c_str());
+
+    if(rv == 0) {
+        efsng_ctx->m_inodes.rename(oldpath, newpath);
+        efsng_ctx->m_inodes.reroute(newpath, [&](const std::string& pathname) {
+            return efsng_ctx->m_router.resolve(pathname.c_str());
+        });
+        efsng_ctx->m_negatives.invalidate();
+    }
+
+    fuse_reply_err(req, -rv);
+}
+
+/** Open a file */
+static void efsng_ll_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* file_info) {
+
+    auto efsng_ctx = get_context(req);
+    std::string pathname;
+    std::shared_ptr<efsng::backend::file> ptr;
+    efsng::backend* backend_ptr;
+
+    if(!find_inode(efsng_ctx, ino, pathname, ptr, backend_ptr)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    LOGGER_DEBUG ("OPEN {}", pathname);
+
+    /* directories and unstaged files have no backend::file: the latter 
+     * are read and written in place (passthrough tier) */
+    if(!ptr) {
+        int rv = efsng_ctx->passthrough_open(pathname, file_info->flags, ptr);
+
+        /* only report EISDIR if the inode is really a directory: otherwise 
+         * the file may have vanished from the underlying filesystem */
+        if(rv == -ENOENT) {
+            struct stat stbuf;
+
+            if(backend_ptr->do_stat(pathname.c_str(), stbuf) == 0 && S_ISDIR(stbuf.st_mode)) {
+                rv = -EISDIR;
+            }
+        }
+
+        if(rv != 0) {
+            fuse_reply_err(req, -rv);
+            return;
+        }
+    }
+
+    efsng_ctx->m_cache_policies.lookup(pathname.c_str(), backend_ptr).apply(file_info);
+
+    uint64_t fh = efsng_ctx->m_handles.open(ino, 42, flags_at_open(file_info->flags), ptr);
+
+    if(fh == 0) {
+        fuse_reply_err(req, ENFILE);
+        return;
+    }
+
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 17)
+    auto pt_file = std::dynamic_pointer_cast<efsng::passthrough::file>(ptr);
+
+    /* hand the file to the kernel so that reads and writes bypass us 
+     * altogether (if it refuses, we splice the data ourselves). This comes 
+     * last: nothing may fail once the kernel holds a backing id for it */
+    if(pt_file && efsng_ctx->m_kernel_passthrough && !file_info->direct_io) {
+        int backing_id = fuse_passthrough_open(req, pt_file->fd());
+
+        if(backing_id > 0) {
+            pt_file->set_backing_id(backing_id);
+            file_info->backing_id = backing_id;
+        }
+        else {
+            LOGGER_DEBUG("Kernel passthrough refused for {}: {}", pathname, strerror(-backing_id));
+        }
+    }
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 17) */
+
+    file_info->fh = fh;
+    fuse_reply_open(req, file_info);
+}
+
+/** Create and open a file */
+static void efsng_ll_create(fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, 
+                            struct fuse_file_info* file_info) {
+
+    auto efsng_ctx = get_context(req);
+    std::string parent_path;
+
+    if(!efsng_ctx->m_inodes.find(parent, parent_path)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    auto pathname = build_path(parent_path, name);
+    std::size_t index;
+    auto backend_ptr = efsng_ctx->m_router.resolve(pathname.c_str(), &index);
+
+    LOGGER_DEBUG("create called \"{}:{}\" ", pathname, file_info->flags);
+
+    std::shared_ptr<efsng::backend::file> ptr;
+    int rv = backend_ptr->do_create(pathname.c_str(), mode, ptr);
+
+    if(rv != 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    efsng_ctx->m_negatives.invalidate();
+
+    struct fuse_entry_param e;
+    memset(&e, 0, sizeof(e));
+
+    ptr->stat(e.attr);
+    e.attr.st_ino = efsng::router::global_inode(index, e.attr.st_ino);
+    auto policy = efsng_ctx->m_cache_policies.lookup(pathname.c_str(), backend_ptr);
+
+    e.ino = e.attr.st_ino;
+    e.attr_timeout = policy.m_attr_timeout;
+    e.entry_timeout = policy.m_entry_timeout;
+
+    /* open the handle first so that the lookup count of the new inode is only 
+     * increased if the reply to the kernel is a successful one */
+    uint64_t fh = efsng_ctx->m_handles.open(e.ino, 42, flags_at_open(file_info->flags), ptr);
+
+    if(fh == 0) {
+        fuse_reply_err(req, ENFILE);
+        return;
+    }
+
+    efsng_ctx->m_inodes.add(e.ino, pathname, ptr, backend_ptr);
+
+    policy.apply(file_info);
+    file_info->fh = fh;
+    fuse_reply_create(req, &e, file_info);
+}
+
+/** Read data from an open file */
+static void efsng_ll_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, 
+                          struct fuse_file_info* file_info) {
+
+    (void) ino;
+
+    auto file_record = get_file_record(req, file_info);
+
+    if(file_record == nullptr) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    auto file_ptr = file_record->get_ptr();
+
+    efsng::backend::data_view_ptr view;
+
+    ssize_t rv = file_ptr->map_data(offset, size, view, file_record->get_cursor());
+
+    if(rv < 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    file_ptr->record_read(view->size());
+
+    /* the view may point straight into the backend's mappings, which stay 
+     * pinned until it goes out of scope (i.e. after the reply has been sent). 
+     * Pages are never moved though, since they don't belong to us */
+    fuse_reply_data(req, view->bufvec(), (fuse_buf_copy_flags) 0);
+}
+
+/** Write the contents of a buffer to an open file */
+static void efsng_ll_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec* buf, off_t offset, 
+                               struct fuse_file_info* file_info) {
+
+    (void) ino;
+
+#ifdef __TEST_NOOP_CALLBACK__
+    fuse_reply_write(req, fuse_buf_size(buf));
+    return;
+#endif // __TEST_NOOP_CALLBACK__
+
+    auto file_record = get_file_record(req, file_info);
+
+    if(file_record == nullptr) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    auto file_ptr = file_record->get_ptr();
+
+    size_t size = fuse_buf_size(buf);
+
+    LOGGER_DEBUG("write({}, {}, {})", ino, offset, size);
+
+    ssize_t rv = file_ptr->put_data(offset, size, buf, file_record->get_cursor());
+
+    if(rv < 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    file_ptr->record_write(rv);
+
+    fuse_reply_write(req, rv);
+}
+
+/** Possibly flush cached data */
+static void efsng_ll_flush(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* file_info) {
+    (void) ino;
+    (void) file_info;
+
+    fuse_reply_err(req, 0);
+}
+
+/** Release an open file */
+static void efsng_ll_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* file_info) {
+    (void) ino;
+
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 17)
+    auto file_record = get_file_record(req, file_info);
+
+    if(file_record != nullptr) {
+        auto pt_file = std::dynamic_pointer_cast<efsng::passthrough::file>(file_record->get_ptr());
+
+        if(pt_file && pt_file->backing_id() > 0) {
+            fuse_passthrough_close(req, pt_file->backing_id());
+        }
+    }
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 17) */
+
+    get_context(req)->m_handles.release(file_info->fh);
+
+    fuse_reply_err(req, 0);
+}
+
+/** Synchronize file contents */
+static void efsng_ll_fsync(fuse_req_t req, fuse_ino_t ino, int is_datasync, struct fuse_file_info* file_info) {
+    (void) ino;
+
+    auto file_record = get_file_record(req, file_info);
+
+    if(file_record == nullptr) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    // data written to a backend may still be sitting in CPU caches or in the page cache
+    fuse_reply_err(req, -file_record->get_ptr()->sync(is_datasync != 0));
+}
+
+/** Open a directory and take a snapshot of its contents */
+static void efsng_ll_opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* file_info) {
+
+    auto efsng_ctx = get_context(req);
+    std::string pathname;
+    efsng::backend* backend_ptr;
+
+    if(!find_inode(efsng_ctx, ino, pathname, backend_ptr)) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    struct stat stbuf;
+
+    if(!efsng_ctx->m_symlinks.stat(pathname, stbuf) && backend_ptr->do_stat(pathname.c_str(), stbuf) != 0 &&
+       efsng_ctx->passthrough_stat(pathname, stbuf) != 0) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    if(!S_ISDIR(stbuf.st_mode)) {
+        fuse_reply_err(req, ENOTDIR);
+        return;
+    }
+
+    auto handle = new dir_handle;
+    handle->m_pathname = pathname;
+    handle->m_backend = backend_ptr;
+    efsng_ctx->extra_entries(pathname, backend_ptr, handle->m_extra);
+
+    file_info->fh = (uint64_t) handle;
+    fuse_reply_open(req, file_info);
+}
+
+/* fill a readdir() reply with the entries of a directory placed after 'offset' */
+static void list_directory(fuse_req_t req, size_t size, off_t offset, struct fuse_file_info* file_info, bool plus) {
+
+    auto efsng_ctx = get_context(req);
+    auto handle = (dir_handle*) file_info->fh;
+    const auto& pathname = handle->m_pathname;
+    const off_t max_offset = efsng::backend::dir::s_max_offset;
+
+    std::vector<char> buf(size);
+    size_t pos = 0;
+
+    // entries known to the backend come first, each with its own offset
+    if(offset < max_offset) {
+        dir_page page = { req, plus, size, false, {} };
+
+        auto backend_ptr = handle->m_backend;
+        int rv = backend_ptr->do_readdir(pathname.c_str(), &page, collect_entry, offset, file_info);
+        struct stat stbuf;
+
+        // directories that were never staged only have "." and ".." plus 
+        // whatever the passthrough tier finds in the underlying filesystem
+        if(rv == -ENOENT && efsng_ctx->passthrough_stat(pathname, stbuf) == 0 && S_ISDIR(stbuf.st_mode)) {
+            const char* dots[] = { ".", ".." };
+            rv = 0;
+
+            for(off_t off = offset + 1; off <= 2; ++off) {
+                if(direntry_size(req, plus, dots[off - 1]) > size - pos) {
+                    fuse_reply_buf(req, buf.data(), pos);
+                    return;
+                }
+
+                pos += add_entry(efsng_ctx, req, plus, buf.data() + pos, size - pos, pathname, dots[off - 1], 
+                                 NULL, off);
+            }
+        }
+
+        if(rv != 0) {
+            fuse_reply_err(req, -rv);
+            return;
+        }
+
+        for(auto& entry : page.m_entries) {
+            /* inodes must be unique across backends (symbolic links already are) */
+            if(entry.m_has_stat && !S_ISLNK(entry.m_stat.st_mode)) {
+                std::size_t index;
+                efsng_ctx->m_router.resolve(build_path(pathname, entry.m_name.c_str()).c_str(), &index);
+                entry.m_stat.st_ino = efsng::router::global_inode(index, entry.m_stat.st_ino);
+            }
+
+            pos += add_entry(efsng_ctx, req, plus, buf.data() + pos, size - pos, pathname, entry.m_name, 
+                             entry.m_has_stat ? &entry.m_stat : NULL, entry.m_offset);
+        }
+
+        if(page.m_full) {
+            fuse_reply_buf(req, buf.data(), pos);
+            return;
+        }
+    }
+
+    // then symbolic links and entries routed to other backends
+    std::size_t first = (offset < max_offset ? 0 : offset - max_offset + 1);
+
+    for(std::size_t i = first; i < handle->m_extra.size(); ++i) {
+        const auto& name = handle->m_extra[i];
+
+        if(direntry_size(req, plus, name.c_str()) > size - pos) {
+            break;
+        }
+
+        struct stat stbuf;
+        auto child = build_path(pathname, name.c_str());
+
+        if(!efsng_ctx->m_symlinks.stat(child, stbuf)) {
+            std::size_t index;
+            auto child_backend = efsng_ctx->m_router.resolve(child.c_str(), &index);
+
+            if(child_backend->do_stat(child.c_str(), stbuf) == 0) {
+                stbuf.st_ino = efsng::router::global_inode(index, stbuf.st_ino);
+            }
+            else if(efsng_ctx->passthrough_stat(child, stbuf) != 0) {
+                continue;
+            }
+        }
+
+        pos += add_entry(efsng_ctx, req, plus, buf.data() + pos, size - pos, pathname, name, 
+                         &stbuf, max_offset + i);
+    }
+
+    fuse_reply_buf(req, buf.data(), pos);
+}
+
+/** Read a directory */
+static void efsng_ll_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, 
+                             struct fuse_file_info* file_info) {
+    (void) ino;
+
+    list_directory(req, size, offset, file_info, false);
+}
+
+/** Read a directory, including the attributes of its entries */
+static void efsng_ll_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, 
+                                 struct fuse_file_info* file_info) {
+    (void) ino;
+
+    list_directory(req, size, offset, file_info, true);
+}
+
+/** Release a directory */
+static void efsng_ll_releasedir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* file_info) {
+    (void) ino;
+
+    delete (dir_handle*) file_info->fh;
+    fuse_reply_err(req, 0);
+}
+
+/** Synchronize directory contents */
+static void efsng_ll_fsyncdir(fuse_req_t req, fuse_ino_t ino, int is_datasync, struct fuse_file_info* file_info) {
+    (void) ino;
+    (void) is_datasync;
+    (void) file_info;
+
+    fuse_reply_err(req, 0);
+}
+
+/** Get filesystem statistics */
+static void efsng_ll_statfs(fuse_req_t req, fuse_ino_t ino) {
+    (void) ino;
+
+    struct statvfs stbuf;
+    get_context(req)->statfs(stbuf);
+
+    fuse_reply_statfs(req, &stbuf);
+}
+
+/** Check file access permissions */
+static void efsng_ll_access(fuse_req_t req, fuse_ino_t ino, int mask) {
+    (void) mask;
+
+    struct stat stbuf;
+    int rv = stat_inode(get_context(req), ino, stbuf);
+
+    fuse_reply_err(req, rv != 0 ? ENOENT : 0);
+}
+
+/** Control operations on open files (see efs-ioctl.h) */
+static void efsng_ll_ioctl(fuse_req_t req, fuse_ino_t ino, int cmd, void* arg, struct fuse_file_info* file_info, 
+                           unsigned flags, const void* in_buf, size_t in_bufsz, size_t out_bufsz) {
+
+    (void) arg;
+
+    if(flags & FUSE_IOCTL_DIR) {
+        fuse_reply_err(req, ENOTTY);
+        return;
+    }
+
+    auto efsng_ctx = get_context(req);
+    auto file_record = get_file_record(req, file_info);
+    std::string pathname;
+    std::shared_ptr<efsng::backend::file> ptr;
+
+    if(file_record == nullptr || !efsng_ctx->m_inodes.find(ino, pathname, ptr)) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    /* the kernel sizes both buffers according to _IOC_SIZE(cmd) */
+    std::vector<char> buffer(std::max(in_bufsz, out_bufsz));
+
+    if(in_bufsz != 0) {
+        memcpy(buffer.data(), in_buf, in_bufsz);
+    }
+
+    int rv = efsng_ctx->file_ioctl(pathname, file_record->get_ptr(), cmd, buffer.data());
+
+    if(rv < 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    fuse_reply_ioctl(req, 0, out_bufsz != 0 ? buffer.data() : NULL, out_bufsz);
+}
+
+#ifdef HAVE_SETXATTR
+/* only "user.efs.*" attributes are supported: they carry performance hints for 
+ * the backend and are not stored anywhere else (see backends/file-hints.h) */
+static std::shared_ptr<efsng::backend::file> find_file(fuse_req_t req, fuse_ino_t ino) {
+
+    std::string pathname;
+    std::shared_ptr<efsng::backend::file> ptr;
+
+    if(!get_context(req)->m_inodes.find(ino, pathname, ptr)) {
+        return nullptr;
+    }
+
+    return ptr;
+}
+
+/* reply with either the attribute size or its contents, depending on what was asked for */
+static void reply_xattr(fuse_req_t req, const char* buffer, size_t size, ssize_t rv) {
+
+    if(rv < 0) {
+        fuse_reply_err(req, -rv);
+    }
+    else if(size == 0) {
+        fuse_reply_xattr(req, rv);
+    }
+    else {
+        fuse_reply_buf(req, buffer, rv);
+    }
+}
+
+/** Set an extended attribute */
+static void efsng_ll_setxattr(fuse_req_t req, fuse_ino_t ino, const char* name, const char* value, 
+                              size_t size, int flags) {
+
+    LOGGER_DEBUG("setxattr({}, \"{}\", {})", ino, name, size);
+
+    auto ptr = find_file(req, ino);
+
+    if(!efsng::file_hints::is_hint(name) || ptr == nullptr) {
+        fuse_reply_err(req, EOPNOTSUPP);
+        return;
+    }
+
+    fuse_reply_err(req, -ptr->set_hint(name, value, size, flags));
+}
+
+/** Get an extended attribute */
+static void efsng_ll_getxattr(fuse_req_t req, fuse_ino_t ino, const char* name, size_t size) {
+
+    LOGGER_DEBUG("getxattr({}, \"{}\", {})", ino, name, size);
+
+    auto ptr = find_file(req, ino);
+
+    if(ptr == nullptr) {
+        fuse_reply_err(req, ENODATA);
+        return;
+    }
+
+    std::vector<char> buffer(size);
+    reply_xattr(req, buffer.data(), size, ptr->get_hint(name, buffer.data(), size));
+}
+
+/** List extended attributes */
+static void efsng_ll_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size) {
+
+    LOGGER_DEBUG("listxattr({}, {})", ino, size);
+
+    auto ptr = find_file(req, ino);
+
+    if(ptr == nullptr) {
+        reply_xattr(req, NULL, size, 0);
+        return;
+    }
+
+    std::vector<char> buffer(size);
+    reply_xattr(req, buffer.data(), size, ptr->list_hints(buffer.data(), size));
+}
+
+/** Remove an extended attribute */
+static void efsng_ll_removexattr(fuse_req_t req, fuse_ino_t ino, const char* name) {
+
+    LOGGER_DEBUG("removexattr({}, \"{}\")", ino, name);
+
+    auto ptr = find_file(req, ino);
+
+    if(ptr == nullptr) {
+        fuse_reply_err(req, ENODATA);
+        return;
+    }
+
+    fuse_reply_err(req, -ptr->remove_hint(name));
+}
+#endif /* HAVE_SETXATTR */
+
+#ifdef HAVE_POSIX_FALLOCATE
+/** Allocate space for an open file */
+static void efsng_ll_fallocate(fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length, 
+                               struct fuse_file_info* file_info) {
+    (void) ino;
+
+    auto file_record = get_file_record(req, file_info);
+
+    if(file_record == nullptr) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    auto file_ptr = file_record->get_ptr();
+    ssize_t rv = file_ptr->fallocate(mode, offset, length);
+
+    fuse_reply_err(req, rv < 0 ? -rv : 0);
+}
+#endif /* HAVE_POSIX_FALLOCATE */
+
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4)
+/** Copy a range of data from one file to another */
+static void efsng_ll_copy_file_range(fuse_req_t req, fuse_ino_t ino_in, off_t offset_in, struct fuse_file_info* fi_in, 
+                                     fuse_ino_t ino_out, off_t offset_out, struct fuse_file_info* fi_out, 
+                                     size_t size, int flags) {
+
+    (void) ino_in;
+    (void) ino_out;
+
+    LOGGER_DEBUG("copy_file_range({}, {}, {}, {}, {})", ino_in, offset_in, ino_out, offset_out, size);
+
+    if(flags != 0) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    auto record_in = get_file_record(req, fi_in);
+    auto record_out = get_file_record(req, fi_out);
+
+    if(record_in == nullptr || record_out == nullptr) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    ssize_t rv = record_out->get_ptr()->copy_range(*record_in->get_ptr(), offset_in, offset_out, size);
+
+    if(rv < 0) {
+        fuse_reply_err(req, -rv);
+        return;
+    }
+
+    fuse_reply_write(req, rv);
+}
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4) */
+
+namespace efsng {
+
+int fuse_lowlevel_mounter(const config::settings& user_opts) {
+
+    struct fuse_lowlevel_ops efsng_ll_ops;
+    memset(&efsng_ll_ops, 0, sizeof(efsng_ll_ops));
+
+    efsng_ll_ops.init = efsng_ll_init;
+    efsng_ll_ops.destroy = efsng_ll_destroy;
+    efsng_ll_ops.lookup = efsng_ll_lookup;
+    efsng_ll_ops.forget = efsng_ll_forget;
+    efsng_ll_ops.forget_multi = efsng_ll_forget_multi;
+    efsng_ll_ops.getattr = efsng_ll_getattr;
+    efsng_ll_ops.setattr = efsng_ll_setattr;
+    efsng_ll_ops.readlink = efsng_ll_readlink;
+    efsng_ll_ops.mkdir = efsng_ll_mkdir;
+    efsng_ll_ops.symlink = efsng_ll_symlink;
+    efsng_ll_ops.unlink = efsng_ll_unlink;
+    efsng_ll_ops.rmdir = efsng_ll_rmdir;
+    efsng_ll_ops.rename = efsng_ll_rename;
+    efsng_ll_ops.open = efsng_ll_open;
+    efsng_ll_ops.create = efsng_ll_create;
+    efsng_ll_ops.read = efsng_ll_read;
+    efsng_ll_ops.write_buf = efsng_ll_write_buf;
+    efsng_ll_ops.flush = efsng_ll_flush;
+    efsng_ll_ops.release = efsng_ll_release;
+    efsng_ll_ops.fsync = efsng_ll_fsync;
+    efsng_ll_ops.opendir = efsng_ll_opendir;
+    efsng_ll_ops.readdir = efsng_ll_readdir;
+    efsng_ll_ops.readdirplus = efsng_ll_readdirplus;
+    efsng_ll_ops.releasedir = efsng_ll_releasedir;
+    efsng_ll_ops.fsyncdir = efsng_ll_fsyncdir;
+    efsng_ll_ops.statfs = efsng_ll_statfs;
+    efsng_ll_ops.access = efsng_ll_access;
+    efsng_ll_ops.ioctl = efsng_ll_ioctl;
+
+#ifdef HAVE_SETXATTR
+    efsng_ll_ops.setxattr = efsng_ll_setxattr;
+    efsng_ll_ops.getxattr = efsng_ll_getxattr;
+    efsng_ll_ops.listxattr = efsng_ll_listxattr;
+    efsng_ll_ops.removexattr = efsng_ll_removexattr;
+#endif /* HAVE_SETXATTR */
+
+#ifdef HAVE_POSIX_FALLOCATE
+    efsng_ll_ops.fallocate = efsng_ll_fallocate;
+#endif /* HAVE_POSIX_FALLOCATE */
+
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4)
+    efsng_ll_ops.copy_file_range = efsng_ll_copy_file_range;
+#endif /* FUSE_VERSION >= FUSE_MAKE_VERSION(3, 4) */
+
+    struct fuse_args args = FUSE_ARGS_INIT(user_opts.m_fuse_argc, const_cast<char**>(user_opts.m_fuse_argv));
+    struct fuse_cmdline_opts opts;
+    int res = 1;
+
+    if(fuse_parse_cmdline(&args, &opts) != 0) {
+        return 1;
+    }
+
+    /* unstaged files are opened (and truncated) with our own credentials: 
+     * have the kernel check the caller's against their mode beforehand */
+    if(user_opts.m_passthrough && fuse_opt_add_arg(&args, "-odefault_permissions") != 0) {
+        free(opts.mountpoint);
+        fuse_opt_free_args(&args);
+        return 1;
+    }
+
+    request_io_uring(&args, user_opts);
+
+    /* the context is initialized by efsng_ll_init() and torn down by efsng_ll_destroy() */
+    auto efsng_ctx = new efsng::context(user_opts);
+
+    struct fuse_session* se = fuse_session_new(&args, &efsng_ll_ops, sizeof(efsng_ll_ops), efsng_ctx);
+
+    if(se == NULL) {
+        goto err_free_args;
+    }
+
+    /* let the API notify the kernel when it loads or unloads a path */
+    efsng_ctx->m_invalidate = [se, efsng_ctx](const std::string& pathname) {
+        invalidate_path(se, efsng_ctx, pathname);
+    };
+
+    /* and fill in the page cache of files with the 'warm-cache' policy */
+    efsng_ctx->m_store = [se](ino_t ino, off_t offset, struct fuse_bufvec* bufv) {
+        return fuse_lowlevel_notify_store(se, ino, offset, bufv, (fuse_buf_copy_flags) 0);
+    };
+
+    if(fuse_set_signal_handlers(se) != 0) {
+        goto err_destroy_session;
+    }
+
+    if(fuse_session_mount(se, opts.mountpoint) != 0) {
+        goto err_remove_handlers;
+    }
+
+    fuse_daemonize(opts.foreground);
+
+    if(opts.singlethread) {
+        res = fuse_session_loop(se);
+    }
+    else {
+        res = fuse_session_engine(se, user_opts, opts.clone_fd);
+    }
+
+    fuse_session_unmount(se);
+
+err_remove_handlers:
+    fuse_remove_signal_handlers(se);
+err_destroy_session:
+    fuse_session_destroy(se);
+err_free_args:
+    delete efsng_ctx;
+    free(opts.mountpoint);
+    fuse_opt_free_args(&args);
+
+    return res == 0 ? 0 : 1;
+}
+
+} // namespace efsng
+
+#endif /* FUSE_USE_VERSION >= 30 */
@@ -1,35 +1,7 @@
-/*************************************************************************
- * (C) Copyright 2016-2017 Barcelona Supercomputing Center               *
- *                         Centro Nacional de Supercomputacion           *
- *                                                                       *
- * This file is part of the Echo Filesystem NG.                          *
- *                                                                       *
- * See AUTHORS file in the top level directory for information           *
- * regarding developers and contributors.                                *
- *                                                                       *
- * This library is free software; you can redistribute it and/or         *
- * modify it under the terms of the GNU Lesser General Public            *
- * License as published by the Free Software Foundation; either          *
- * version 3 of the License, or (at your option) any later version.      *
- *                                                                       *
- * The Echo Filesystem NG is distributed in the hope that it will        *
- * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
- * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
- * PURPOSE.  See the GNU Lesser General Public License for more          *
- * details.                                                              *
- *                                                                       *
- * You should have received a copy of the GNU Lesser General Public      *
- * License along with Echo Filesystem NG; if not, write to the Free      *
- * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
- *                                                                       *
- *************************************************************************/
-
- /*
-* This software was developed as part of the
-* EC H2020 funded project NEXTGenIO (Project ID: 671951)
-* www.nextgenio.eu
-*/ 
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
 
 #include <fuse.h>
 #if FUSE_USE_VERSION < 30
@@ -37,75 +9,347 @@
 #include <fuse_lowlevel.h>
 #endif
 #include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "utils.h"
 #include "context.h"
+#include "affinity.h"
 #include "fuse-mount-helper.h"
 
 namespace efsng {
 
-int fuse_custom_mounter(const config::settings& user_opts, const struct fuse_operations* ops) {
-    
-	struct fuse *fuse;
-	char *mountpoint;
-	int multithreaded;
-	int res;
-	
-    /* create a context object to maintain the internal state of the filesystem 
-     * so that we can later pass it around to the filesystem operations */
-    //auto efsng_ctx = std::make_unique<efsng::context>(user_opts);
-#if FUSE_USE_VERSION < 30
-	fuse = fuse_setup(user_opts.m_fuse_argc, 
-	                  const_cast<char**>(user_opts.m_fuse_argv), 
-	                  ops, 
-	                  sizeof(*ops), 
-	                  &mountpoint,
-				      &multithreaded, 
-                      NULL);
-//				      (void*) efsng_ctx.get());
+#if FUSE_USE_VERSION >= 30
+
+namespace {
+
+/* libfuse reads whole requests into the buffer passed to fuse_session_receive_buf() 
+ * without checking its size, but it doesn't export the size it expects. Use one that 
+ * fits the largest requests of any of the libfuse builds supported by configure (12MiB + header) */
+const size_t s_request_buffer_size = (16 << 20) + 0x1000;
+
+struct session_engine;
+
+struct worker {
+    session_engine*         m_engine;
+    unsigned                m_id;
+    cpu_list                m_cpus;     /*!< CPUs the worker is pinned to (empty if not pinned) */
+    pthread_t               m_thread;
+    bool                    m_started;
+    struct fuse_buf         m_buf;      /*!< Preallocated request buffer */
+};
+
+struct session_engine {
+    struct fuse_session*    m_session;
+    std::vector<worker>     m_workers;
+    sem_t                   m_finished;     /*!< Posted by each worker when it exits its loop */
+    std::atomic<int>        m_error;        /*!< Last error seen by a worker (if any) */
+};
+
+void* worker_loop(void* data) {
+
+    auto w = static_cast<worker*>(data);
+    auto se = w->m_engine->m_session;
+
+    if(!w->m_cpus.empty() && !pin_current_thread(w->m_cpus)) {
+        std::cerr << "WARNING: Unable to pin FUSE worker " << w->m_id << " (" << strerror(errno) << ")\n";
+    }
+
+    /* allocate the buffer from the worker itself so that, once pinned, 
+     * its pages are first touched (and thus placed) on the worker's node */
+    void* mem = NULL;
+
+    if(posix_memalign(&mem, sysconf(_SC_PAGESIZE), s_request_buffer_size) == 0) {
+        w->m_buf.mem = mem;
+        w->m_buf.size = s_request_buffer_size;
+    }
+    else {
+        /* libfuse will allocate one of its own */
+        std::cerr << "WARNING: Unable to allocate request buffer for FUSE worker " << w->m_id << "\n";
+    }
+
+    /* workers are only cancelled while waiting for requests, never while processing them */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    while(!fuse_session_exited(se)) {
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        int res = fuse_session_receive_buf(se, &w->m_buf);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+        if(res == -EINTR) {
+            continue;
+        }
+
+        if(res <= 0) {
+            if(res < 0) {
+                w->m_engine->m_error = res;
+                fuse_session_exit(se);
+            }
+            break;
+        }
+
+        fuse_session_process_buf(se, &w->m_buf);
+    }
+
+    sem_post(&w->m_engine->m_finished);
+
+    return NULL;
+}
+
+} // anonymous namespace
+
+int fuse_session_engine(struct fuse_session* se, const config::settings& user_opts, bool clone_fd) {
+
+    clone_fd = clone_fd || user_opts.m_clone_fd;
+
+    bool own_workers = user_opts.m_fuse_workers != 0;
+
+#ifdef EFSNG_IO_URING
+    /* the rings are set up and served by libfuse's loop, one thread per CPU */
+    if(user_opts.m_io_uring && own_workers) {
+        std::cerr << "WARNING: Ignoring 'fuse-workers': libfuse serves the io_uring rings itself\n";
+        own_workers = false;
+    }
+#endif /* EFSNG_IO_URING */
+
+    /* no workers of our own: let libfuse grow and shrink its pool of threads */
+    if(!own_workers) {
+
+        if(user_opts.m_pin_workers != "none") {
+            std::cerr << "WARNING: Ignoring 'pin-workers': it requires 'fuse-workers' to be set\n";
+        }
+
+#if FUSE_USE_VERSION < 32
+        return fuse_session_loop_mt(se, clone_fd);
 #else
-	struct fuse_args args = {user_opts.m_fuse_argc, const_cast<char**>(user_opts.m_fuse_argv), 0};
-	fuse = fuse_new(&args, 
-	                  ops, 
-	                  sizeof(*ops), 
-                      NULL);
-//				      (void*) efsng_ctx.get());
-	if (fuse == NULL) return 1;
-	fuse_mount (fuse, user_opts.m_mount_dir.string().c_str());
-	multithreaded = true;
-	struct fuse_session *se = fuse_get_session(fuse);
-	if (fuse_set_signal_handlers(se) != 0) {
-		res = 1;
-		return 1;
-	}
+        struct fuse_loop_config config;
+        config.clone_fd = clone_fd;
+        config.max_idle_threads = user_opts.m_max_idle_threads;
+        return fuse_session_loop_mt(se, &config);
 #endif
-	if(fuse == NULL) {
-		return 1;
     }
-	
-    if(multithreaded) {
-#if FUSE_USE_VERSION < 30
-		res = fuse_loop_mt(fuse);
+
+    if(clone_fd) {
+        /* libfuse doesn't export the per-channel receive/reply functions needed to 
+         * serve a cloned /dev/fuse descriptor from our own threads */
+        std::cerr << "WARNING: Ignoring 'clone-fd': it is only supported when 'fuse-workers' is 0\n";
+    }
+
+    session_engine engine;
+    engine.m_session = se;
+    engine.m_error = 0;
+
+    if(sem_init(&engine.m_finished, 0, 0) != 0) {
+        return -1;
+    }
+
+    auto plan = plan_worker_cpus(user_opts.m_pin_workers, user_opts.m_fuse_workers, 
+                                 allowed_cpus(), numa_nodes());
+
+    engine.m_workers.resize(user_opts.m_fuse_workers);
+
+    unsigned running = 0;
+
+    for(unsigned i = 0; i < engine.m_workers.size(); ++i) {
+        auto& w = engine.m_workers[i];
+
+        w.m_engine = &engine;
+        w.m_id = i;
+        w.m_cpus = plan[i];
+        w.m_started = false;
+        std::memset(&w.m_buf, 0, sizeof(w.m_buf));
+
+        if(pthread_create(&w.m_thread, NULL, worker_loop, &w) != 0) {
+            std::cerr << "WARNING: Unable to start FUSE worker " << i << " (" << strerror(errno) << ")\n";
+            continue;
+        }
+
+        w.m_started = true;
+        ++running;
+    }
+
+    if(running != 0) {
+        /* wait until the session is exited (e.g. from a signal handler) or a worker stops */
+        while(!fuse_session_exited(se)) {
+            if(sem_wait(&engine.m_finished) == 0) {
+                break;
+            }
+        }
+    }
+
+    /* any remaining workers are blocked waiting for requests that will never arrive */
+    for(auto& w : engine.m_workers) {
+        if(w.m_started) {
+            pthread_cancel(w.m_thread);
+        }
+    }
+
+    for(auto& w : engine.m_workers) {
+        if(w.m_started) {
+            pthread_join(w.m_thread, NULL);
+        }
+
+        free(w.m_buf.mem);
+    }
+
+    sem_destroy(&engine.m_finished);
+
+    if(running == 0) {
+        return -1;
+    }
+
+    return engine.m_error < 0 ? -1 : 0;
+}
+
+bool request_io_uring(struct fuse_args* args, const config::settings& user_opts) {
+
+    if(!user_opts.m_io_uring) {
+        return false;
+    }
+
+#ifdef EFSNG_IO_URING
+    if(fuse_opt_add_arg(args, "-oio_uring") != 0) {
+        return false;
+    }
+
+    if(user_opts.m_io_uring_queue_depth != 0) {
+        std::string depth = "-oio_uring_q_depth=" + std::to_string(user_opts.m_io_uring_queue_depth);
+
+        if(fuse_opt_add_arg(args, depth.c_str()) != 0) {
+            return false;
+        }
+    }
+
+    return true;
 #else
-        fuse_daemonize(!user_opts.m_daemonize);
-		res = fuse_loop_mt(fuse, 1);
-#endif
+    (void) args;
+    std::cerr << "WARNING: Ignoring 'io-uring': echofs was built without io_uring support (--enable-io-uring)\n";
+    return false;
+#endif /* EFSNG_IO_URING */
+}
+
+void negotiate_io_uring(struct fuse_conn_info* conn, const config::settings& user_opts) {
+
+#ifdef EFSNG_IO_URING
+    if(!user_opts.m_io_uring) {
+        return;
     }
-	else {
-		res = fuse_loop(fuse);
+
+    if(fuse_get_feature_flag(conn, FUSE_CAP_OVER_IO_URING)) {
+        fuse_set_feature_flag(conn, FUSE_CAP_OVER_IO_URING);
+    }
+    else {
+        std::cerr << "WARNING: FUSE over io_uring not supported by the kernel (is fuse.enable_uring set?), "
+                     "requests will be read from /dev/fuse\n";
+    }
+#else
+    (void) conn;
+    (void) user_opts;
+#endif /* EFSNG_IO_URING */
+}
+
+#endif /* FUSE_USE_VERSION >= 30 */
+
+uint32_t negotiate_transfer_size(struct fuse_conn_info* conn, uint32_t wanted) {
+
+    const uint32_t page_size = sysconf(_SC_PAGESIZE);
+    uint32_t size = wanted;
+
+    /* no preference: take as much as libfuse can handle */
+    if(size == 0 || (conn->max_write != 0 && size > conn->max_write)) {
+        size = conn->max_write;
     }
+
+    size = std::max(size - size % page_size, page_size);
+
+    conn->max_write = size;
+
+    return size;
+}
+
+int fuse_custom_mounter(const config::settings& user_opts, const struct fuse_operations* ops) {
+
+	int res = 1;
+
 #if FUSE_USE_VERSION < 30
+	char *mountpoint;
+	int multithreaded;
+
+	struct fuse* fuse = fuse_setup(user_opts.m_fuse_argc, 
+	                               const_cast<char**>(user_opts.m_fuse_argv), 
+	                               ops, 
+	                               sizeof(*ops), 
+	                               &mountpoint,
+	                               &multithreaded, 
+	                               NULL);
+
+	if(fuse == NULL) {
+		return 1;
+	}
+
+	res = multithreaded ? fuse_loop_mt(fuse) : fuse_loop(fuse);
+
 	fuse_teardown(fuse, mountpoint);
 #else
+	struct fuse_args args = FUSE_ARGS_INIT(user_opts.m_fuse_argc, const_cast<char**>(user_opts.m_fuse_argv));
+	struct fuse_cmdline_opts opts;
+	struct fuse* fuse;
+	struct fuse_session* se;
+
+	if(fuse_parse_cmdline(&args, &opts) != 0) {
+		return 1;
+	}
+
+	request_io_uring(&args, user_opts);
+
+	/* the context is created by efsng_init() once the filesystem is mounted */
+	fuse = fuse_new(&args, ops, sizeof(*ops), NULL);
+
+	if(fuse == NULL) {
+		goto err_free_args;
+	}
+
+	if(fuse_mount(fuse, opts.mountpoint) != 0) {
+		goto err_destroy;
+	}
+
+	se = fuse_get_session(fuse);
+
+	if(fuse_set_signal_handlers(se) != 0) {
+		goto err_unmount;
+	}
+
+	fuse_daemonize(opts.foreground);
+
+	if(opts.singlethread) {
+		res = fuse_loop(fuse);
+	}
+	else {
+		res = fuse_session_engine(se, user_opts, opts.clone_fd);
+	}
+
 	fuse_remove_signal_handlers(se);
+
+err_unmount:
 	fuse_unmount(fuse);
+err_destroy:
 	fuse_destroy(fuse);
+err_free_args:
+	free(opts.mountpoint);
 	fuse_opt_free_args(&args);
 #endif
-	if (res == -1) {
-		return 1;
-	}
 
-	return 0;
+	return res == 0 ? 0 : 1;
 }
 
 } //namespace efsng
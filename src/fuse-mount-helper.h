@@ -3,11 +3,41 @@
 #define __FUSE_MOUNT_HELPER__
 
 #include <fuse.h>
+#if FUSE_USE_VERSION >= 30
+#include <fuse_lowlevel.h>
+#endif
 
 #include "efs-ng.h"
 
 namespace efsng {
 
+#if FUSE_USE_VERSION >= 30
+/* serve the requests for 'se' until it is exited or unmounted: with 'fuse-workers' set, 
+ * a fixed set of workers (pinned according to 'pin-workers' and each with its own 
+ * preallocated request buffer) is used. Otherwise, libfuse's own multi-threaded loop 
+ * is run with the 'clone-fd' and 'max-idle-threads' settings ('clone_fd' is set 
+ * if it was also requested on the command line with '-o clone_fd') */
+int fuse_session_engine(struct fuse_session* se, const config::settings& user_opts, bool clone_fd = false);
+
+/* if 'io-uring' is set, add to 'args' the options that make the session created from them 
+ * receive requests through io_uring (one ring per CPU, served by libfuse's own threads) 
+ * rather than /dev/fuse. Returns false if the transport was not requested or this build 
+ * can't provide it */
+bool request_io_uring(struct fuse_args* args, const config::settings& user_opts);
+
+/* called from init(): check that the kernel agreed to use io_uring if it was requested 
+ * (otherwise requests keep arriving through /dev/fuse) */
+void negotiate_io_uring(struct fuse_conn_info* conn, const config::settings& user_opts);
+#endif
+
+/* agree with the kernel on the maximum size of read/write requests: 'wanted' is capped to 
+ * what libfuse can receive (the value of conn->max_write when init() is called, which is 
+ * also used if 'wanted' is 0) and rounded 
+ * down to whole pages. The kernel derives the maximum number of pages per request (and 
+ * thus the size of reads) from the max_write finally set. Returns the size agreed on */
+uint32_t negotiate_transfer_size(struct fuse_conn_info* conn, uint32_t wanted);
+
+/* mount the filesystem using the path-based FUSE API and serve requests until it is unmounted */
 int fuse_custom_mounter(const config::settings& user_opts, const struct fuse_operations* op);
 
 } // namespace efsng
@@ -64,6 +64,11 @@ std::shared_ptr <backend::file> File::get_ptr (){
 
 void File::set_ptr (std::shared_ptr <backend::file> pt){
 	ptr = pt;
+	cursor = (ptr != nullptr ? ptr->new_cursor() : nullptr);
+}
+
+backend::file::cursor* File::get_cursor (){
+	return cursor.get();
 }
 
 } // namespace efsng
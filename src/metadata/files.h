@@ -54,6 +54,7 @@ public:
 
     void set_ptr (std::shared_ptr <backend::file> ptr);
     std::shared_ptr <backend::file> get_ptr ();
+    backend::file::cursor* get_cursor ();
 private:
     /* file's inode */
     ino_t inode;
@@ -66,6 +67,8 @@ private:
     /* file's size */
     off_t size;
     std::shared_ptr <backend::file> ptr;
+    /* where the last data lookup through this record ended (if supported) */
+    backend::file::cursor_ptr cursor;
 };
 
 } // namespace efsng
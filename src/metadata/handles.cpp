@@ -0,0 +1,170 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include "handles.h"
+
+namespace efsng{
+
+const std::size_t handle_table::s_slab_size;
+const std::size_t handle_table::s_max_slabs;
+
+handle_table::handle_table() 
+    : m_num_slabs(0),
+      m_free_head(0),
+      m_count(0) {
+
+    for(auto& slab : m_slabs) {
+        slab.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+handle_table::~handle_table() {
+
+    for(std::size_t i = 0; i < m_num_slabs; ++i) {
+        slot* slab = m_slabs[i].load(std::memory_order_relaxed);
+
+        for(std::size_t j = 0; j < s_slab_size; ++j) {
+            if(slab[j].m_generation.load(std::memory_order_relaxed) & 1) {
+                slab[j].record()->~File();
+            }
+        }
+
+        delete[] slab;
+    }
+}
+
+uint64_t handle_table::open(ino_t inode, int fd, mode_t mode, std::shared_ptr<backend::file> ptr) {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if(m_free_head == 0) {
+
+        if(m_num_slabs == s_max_slabs) {
+            return 0;
+        }
+
+        slot* slab = new slot[s_slab_size];
+        uint32_t base = m_num_slabs * s_slab_size;
+
+        // chain the new slots into the free list
+        for(std::size_t j = 0; j < s_slab_size; ++j) {
+            slab[j].m_next_free = (j + 1 < s_slab_size) ? base + j + 2 : 0;
+        }
+
+        m_slabs[m_num_slabs++].store(slab, std::memory_order_release);
+        m_free_head = base + 1;
+    }
+
+    uint32_t index = m_free_head - 1;
+    slot& s = m_slabs[index / s_slab_size].load(std::memory_order_relaxed)[index % s_slab_size];
+
+    m_free_head = s.m_next_free;
+    lock.unlock();
+
+    File* record = new (&s.m_storage) File(inode, fd, mode);
+    record->set_ptr(ptr);
+
+    uint32_t generation = s.m_generation.load(std::memory_order_relaxed) + 1;
+    s.m_generation.store(generation, std::memory_order_release);
+
+    ++m_count;
+
+    return ((uint64_t) generation << 32) | (index + 1);
+}
+
+handle_table::slot* handle_table::find_slot(uint64_t handle) const {
+
+    uint32_t index = (uint32_t) handle;
+    uint32_t generation = (uint32_t) (handle >> 32);
+
+    if(index == 0 || (generation & 1) == 0) {
+        return nullptr;
+    }
+
+    --index;
+
+    if(index / s_slab_size >= s_max_slabs) {
+        return nullptr;
+    }
+
+    slot* slab = m_slabs[index / s_slab_size].load(std::memory_order_acquire);
+
+    if(slab == nullptr) {
+        return nullptr;
+    }
+
+    slot* s = &slab[index % s_slab_size];
+
+    if(s->m_generation.load(std::memory_order_acquire) != generation) {
+        return nullptr;
+    }
+
+    return s;
+}
+
+File* handle_table::get(uint64_t handle) const {
+
+    slot* s = find_slot(handle);
+
+    return s != nullptr ? s->record() : nullptr;
+}
+
+bool handle_table::release(uint64_t handle) {
+
+    slot* s = find_slot(handle);
+
+    if(s == nullptr) {
+        return false;
+    }
+
+    // the kernel sends exactly one release per handle, and only once all 
+    // other operations on it have completed, so no one can be using the record
+    s->record()->~File();
+    s->m_generation.fetch_add(1, std::memory_order_release);
+
+    --m_count;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t index = (uint32_t) handle;
+    s->m_next_free = m_free_head;
+    m_free_head = index;
+
+    return true;
+}
+
+std::size_t handle_table::size() const {
+    return m_count.load(std::memory_order_relaxed);
+}
+
+} // namespace efsng
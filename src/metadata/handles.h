@@ -0,0 +1,101 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __HANDLES_H__
+#define __HANDLES_H__
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include "files.h"
+
+namespace efsng{
+
+/* hands out the open file handles stored in fi->fh. Records live in slabs 
+ * of preallocated slots that are never freed or moved while the table exists,
+ * so that looking up a handle takes no locks. Each handle also carries the 
+ * generation of its slot, so that stale handles (i.e. already released) are 
+ * detected instead of silently referring to a recycled record */
+class handle_table{
+
+public:
+    handle_table();
+    ~handle_table();
+
+    /* create a File record for 'ptr' and return its handle (0 if the table is full) */
+    uint64_t open(ino_t inode, int fd, mode_t mode, std::shared_ptr<backend::file> ptr);
+
+    /* fetch the File record for 'handle' (nullptr if the handle is not valid) */
+    File* get(uint64_t handle) const;
+
+    /* destroy the File record for 'handle' */
+    bool release(uint64_t handle);
+
+    std::size_t size() const;
+
+private:
+    /* slots per slab, and maximum number of slabs (i.e. up to 1M open files) */
+    static const std::size_t s_slab_size = 1024;
+    static const std::size_t s_max_slabs = 1024;
+
+    struct slot {
+        slot() : m_generation(0), m_next_free(0) { }
+
+        /* odd while the slot holds a record, even otherwise */
+        std::atomic<uint32_t> m_generation;
+        /* index + 1 of the next free slot (0 ends the list) */
+        uint32_t m_next_free;
+        /* storage for the File record */
+        std::aligned_storage<sizeof(File), alignof(File)>::type m_storage;
+
+        File* record() { 
+            return reinterpret_cast<File*>(&m_storage);
+        }
+    };
+
+    slot* find_slot(uint64_t handle) const;
+
+    mutable std::mutex m_mutex;                 /*!< Protects the free list and slab creation */
+    std::atomic<slot*> m_slabs[s_max_slabs];    /*!< Slabs allocated so far */
+    std::size_t m_num_slabs;                    /*!< Number of slabs allocated */
+    uint32_t m_free_head;                       /*!< index + 1 of the first free slot (0 if none) */
+    std::atomic<std::size_t> m_count;           /*!< Number of open handles */
+};
+
+} // namespace efsng
+
+#endif /* __HANDLES_H__ */
@@ -0,0 +1,227 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include <iterator>
+#include "inodes.h"
+
+namespace efsng{
+
+namespace {
+
+/* call 'fun' with the iterator of every entry of 'paths' for 'pathname' or for a 
+ * path below it. They make up two ranges, since other paths may sort in between 
+ * (e.g. "/dir-x" goes after "/dir" but before "/dir/x") */
+template <typename Map, typename Function>
+void for_each_below(Map& paths, const std::string& pathname, Function&& fun) {
+
+    if(pathname == "/") {
+        for(auto it = paths.begin(); it != paths.end(); ++it) {
+            fun(it);
+        }
+        return;
+    }
+
+    auto range = paths.equal_range(pathname);
+
+    for(auto it = range.first; it != range.second; ++it) {
+        fun(it);
+    }
+
+    /* '0' is the character right after '/' */
+    auto last = paths.lower_bound(pathname + "0");
+
+    for(auto it = paths.lower_bound(pathname + "/"); it != last; ++it) {
+        fun(it);
+    }
+}
+
+} // anonymous namespace
+
+const ino_t inode_table::root_inode;
+
+inode_table::inode_table() {
+    /* the root is never forgotten by the kernel, pin it */
+    auto path = m_paths.emplace("/", root_inode);
+    auto it = m_inodes.emplace(root_inode, entry(path, nullptr, nullptr));
+    it.first->second.m_nlookup = 1;
+}
+
+void inode_table::add(ino_t inode, const std::string& pathname, std::shared_ptr<backend::file> ptr, 
+                      backend* owner) {
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    auto it = m_inodes.find(inode);
+
+    if(it == m_inodes.end()) {
+        auto path = m_paths.emplace(pathname, inode);
+        it = m_inodes.emplace(inode, entry(path, ptr, owner)).first;
+    }
+    else {
+        /* the inode may have been looked up through a different name */
+        set_path(it->second, inode, pathname);
+        it->second.m_ptr = ptr;
+        it->second.m_owner = owner;
+    }
+
+    ++it->second.m_nlookup;
+}
+
+bool inode_table::find(ino_t inode, std::string& pathname, std::shared_ptr<backend::file>& ptr, 
+                       backend*& owner) const {
+
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+
+    auto it = m_inodes.find(inode);
+
+    if(it == m_inodes.end()) {
+        return false;
+    }
+
+    pathname = it->second.pathname();
+    ptr = it->second.m_ptr;
+    owner = it->second.m_owner;
+    return true;
+}
+
+bool inode_table::find(ino_t inode, std::string& pathname, std::shared_ptr<backend::file>& ptr) const {
+    backend* owner;
+    return find(inode, pathname, ptr, owner);
+}
+
+bool inode_table::find(ino_t inode, std::string& pathname, backend*& owner) const {
+    std::shared_ptr<backend::file> ptr;
+    return find(inode, pathname, ptr, owner);
+}
+
+bool inode_table::find(ino_t inode, std::string& pathname) const {
+    std::shared_ptr<backend::file> ptr;
+    return find(inode, pathname, ptr);
+}
+
+bool inode_table::find_path(const std::string& pathname, ino_t& inode) const {
+
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+
+    auto range = m_paths.equal_range(pathname);
+
+    if(range.first == range.second) {
+        return false;
+    }
+
+    /* entries with the same path are kept in the order they were added */
+    inode = std::prev(range.second)->second;
+    return true;
+}
+
+void inode_table::subtree(const std::string& pathname, std::vector<ino_t>& inodes) const {
+
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+
+    for_each_below(m_paths, pathname, [&](path_map::const_iterator it) {
+        inodes.push_back(it->second);
+    });
+}
+
+void inode_table::forget(ino_t inode, uint64_t nlookup) {
+
+    if(inode == root_inode) {
+        return;
+    }
+
+    /* if the table holds the last reference to the file, let it go once 
+     * the lock is released (i.e. this must be declared before the lock) */
+    std::shared_ptr<backend::file> released;
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    auto it = m_inodes.find(inode);
+
+    if(it == m_inodes.end()) {
+        return;
+    }
+
+    if(it->second.m_nlookup <= nlookup) {
+        released = std::move(it->second.m_ptr);
+        m_paths.erase(it->second.m_path);
+        m_inodes.erase(it);
+        return;
+    }
+
+    it->second.m_nlookup -= nlookup;
+}
+
+void inode_table::rename(const std::string& oldpath, const std::string& newpath) {
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    /* (renaming entries moves them around the index: collect them first) */
+    std::vector<path_map::iterator> renamed;
+
+    for_each_below(m_paths, oldpath, [&](path_map::iterator it) {
+        renamed.push_back(it);
+    });
+
+    for(const auto& it : renamed) {
+        ino_t inode = it->second;
+        set_path(m_inodes.at(inode), inode, newpath + it->first.substr(oldpath.size()));
+    }
+}
+
+void inode_table::reroute(const std::string& pathname, const resolver& resolve) {
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    for_each_below(m_paths, pathname, [&](path_map::iterator it) {
+        m_inodes.at(it->second).m_owner = resolve(it->first);
+    });
+}
+
+std::size_t inode_table::size() const {
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    return m_inodes.size();
+}
+
+/* move 'e' (the entry for 'inode') to 'pathname' in the path index */
+void inode_table::set_path(entry& e, ino_t inode, const std::string& pathname) {
+
+    if(e.pathname() == pathname) {
+        return;
+    }
+
+    auto path = m_paths.emplace(pathname, inode);
+    m_paths.erase(e.m_path);
+    e.m_path = path;
+}
+
+} // namespace efsng
@@ -0,0 +1,129 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __INODES_H__
+#define __INODES_H__
+
+#include <sys/types.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/shared_mutex.hpp>
+#include "../backends/backend-base.h"
+
+namespace efsng{
+
+/* maps the inode numbers handed out to the kernel by the low-level front end 
+ * to the path, the backend serving it and (for regular files) the backend::file 
+ * that they refer to, so that operations on an already looked up inode do not 
+ * need to resolve a path again. Paths are also indexed (sorted, so that the 
+ * paths below a directory are contiguous): operations on a path or a subtree 
+ * only touch the inodes involved, rather than every inode the kernel knows */
+class inode_table{
+
+public:
+    /* finds the backend currently serving a path (i.e. router::resolve()) */
+    typedef std::function<backend*(const std::string&)> resolver;
+
+    /* the inode number reserved by FUSE for the filesystem root */
+    static const ino_t root_inode = 1;
+
+    inode_table();
+
+    /* register a lookup of 'inode' (served by 'owner') by the kernel, adding it if needed */
+    void add(ino_t inode, const std::string& pathname, std::shared_ptr<backend::file> ptr, 
+             backend* owner = nullptr);
+
+    /* fetch the path, file pointer and backend associated to 'inode' */
+    bool find(ino_t inode, std::string& pathname, std::shared_ptr<backend::file>& ptr, 
+              backend*& owner) const;
+    bool find(ino_t inode, std::string& pathname, std::shared_ptr<backend::file>& ptr) const;
+    bool find(ino_t inode, std::string& pathname, backend*& owner) const;
+    bool find(ino_t inode, std::string& pathname) const;
+
+    /* fetch the inode currently associated to 'pathname' (the one looked up last 
+     * if several are, e.g. a file that was unlinked while open and then recreated) */
+    bool find_path(const std::string& pathname, ino_t& inode) const;
+
+    /* collect the inodes of 'pathname' and of everything below it */
+    void subtree(const std::string& pathname, std::vector<ino_t>& inodes) const;
+
+    /* drop 'nlookup' references to 'inode', releasing it when none remain (its 
+     * backend::file, if this was the last reference, is destroyed after the 
+     * table is unlocked: e.g. nvml files remove their pools then) */
+    void forget(ino_t inode, uint64_t nlookup);
+
+    /* update the paths of all inodes affected by a rename */
+    void rename(const std::string& oldpath, const std::string& newpath);
+
+    /* refresh the backend of 'pathname' and of everything below it (e.g. after 
+     * a new route is added or a subtree is renamed across routes) */
+    void reroute(const std::string& pathname, const resolver& resolve);
+
+    std::size_t size() const;
+
+private:
+    /* path -> inode (several inodes may share a path for a while, see find_path()) */
+    typedef std::multimap<std::string, ino_t> path_map;
+
+    struct entry {
+        entry(path_map::iterator path, std::shared_ptr<backend::file> ptr, backend* owner)
+            : m_path(path),
+              m_ptr(ptr),
+              m_owner(owner),
+              m_nlookup(0) { }
+
+        const std::string& pathname() const { return m_path->first; }
+
+        /* current path of the inode (updated by renames) */
+        path_map::iterator m_path;
+        /* pointer to the file's data (null for directories) */
+        std::shared_ptr<backend::file> m_ptr;
+        /* backend serving the inode's path (resolved at lookup) */
+        backend* m_owner;
+        /* number of outstanding kernel lookups */
+        uint64_t m_nlookup;
+    };
+
+    void set_path(entry& e, ino_t inode, const std::string& pathname);
+
+    mutable boost::shared_mutex m_mutex;
+    std::unordered_map<ino_t, entry> m_inodes;
+    path_map m_paths;
+};
+
+} // namespace efsng
+
+#endif /* __INODES_H__ */
@@ -0,0 +1,114 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include "negatives.h"
+
+namespace efsng{
+
+const std::size_t negative_table::s_num_shards;
+const std::size_t negative_table::s_default_capacity;
+
+negative_table::negative_table(std::size_t capacity)
+    : m_shard_capacity(std::max(capacity / s_num_shards, (std::size_t) 1)),
+      m_generation(0),
+      m_enabled(true),
+      m_lifetime(0) { }
+
+negative_table::shard& negative_table::get_shard(const std::string& pathname) {
+    return m_shards[std::hash<std::string>()(pathname) % s_num_shards];
+}
+
+const negative_table::shard& negative_table::get_shard(const std::string& pathname) const {
+    return m_shards[std::hash<std::string>()(pathname) % s_num_shards];
+}
+
+void negative_table::set_lifetime(double seconds) {
+
+    m_enabled = (seconds != 0);
+    m_lifetime = (seconds > 0 ? 
+            std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds)).count() : 0);
+
+    invalidate();
+}
+
+bool negative_table::is_valid(const entry& e, clock::time_point now) const {
+    return e.m_generation == m_generation.load() && 
+           (m_lifetime.load() == 0 || now < e.m_expires);
+}
+
+bool negative_table::contains(const std::string& pathname) const {
+
+    if(!m_enabled.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    const auto& sh = get_shard(pathname);
+    boost::shared_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    auto it = sh.m_entries.find(pathname);
+
+    return it != sh.m_entries.end() && is_valid(it->second, clock::now());
+}
+
+void negative_table::add(const std::string& pathname, uint64_t generation) {
+
+    /* the path may have appeared while it was being looked up */
+    if(!m_enabled.load(std::memory_order_relaxed) || generation != m_generation.load()) {
+        return;
+    }
+
+    const auto now = clock::now();
+    const entry e = { generation, now + clock::duration(m_lifetime.load()) };
+
+    auto& sh = get_shard(pathname);
+    boost::unique_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    /* make room by dropping stale entries first, and everything else if that's not enough */
+    if(sh.m_entries.size() >= m_shard_capacity) {
+        for(auto it = sh.m_entries.begin(); it != sh.m_entries.end(); ) {
+            it = is_valid(it->second, now) ? std::next(it) : sh.m_entries.erase(it);
+        }
+
+        if(sh.m_entries.size() >= m_shard_capacity) {
+            sh.m_entries.clear();
+        }
+    }
+
+    sh.m_entries[pathname] = e;
+}
+
+} // namespace efsng
@@ -0,0 +1,107 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+#ifndef __NEGATIVES_H__
+#define __NEGATIVES_H__
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace efsng{
+
+/* remembers paths that were recently looked up and found not to exist, so that 
+ * probing workloads (dynamic loaders, interpreters walking their import paths, 
+ * compilers searching include directories...) are answered with a hash probe
+ * instead of a trip through the backends. Entries are tagged with the generation 
+ * current when their lookup started: anything that may make a path appear (e.g.
+ * create, mkdir, rename, symlink or a load through the API) bumps the generation, 
+ * which invalidates all entries at once. Entries may also be given a lifetime 
+ * for paths that can appear behind our back (i.e. in the passthrough tier) */
+class negative_table{
+
+    static const std::size_t s_num_shards = 16;
+    static const std::size_t s_default_capacity = 64 * 1024;
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    negative_table(std::size_t capacity = s_default_capacity);
+
+    /* make entries expire 'seconds' after being added (0 disables the table, 
+     * a negative value makes them last until the next invalidation) */
+    void set_lifetime(double seconds);
+
+    /* generation to pass to add() (must be fetched before the lookup starts) */
+    uint64_t generation() const { return m_generation.load(); }
+
+    /* check whether 'pathname' is known not to exist */
+    bool contains(const std::string& pathname) const;
+
+    /* record that a lookup of 'pathname' started at 'generation' failed */
+    void add(const std::string& pathname, uint64_t generation);
+
+    /* forget all entries (call after making a path appear) */
+    void invalidate() { ++m_generation; }
+
+private:
+    struct entry {
+        uint64_t m_generation;
+        clock::time_point m_expires;
+    };
+
+    struct shard {
+        mutable boost::shared_mutex m_mutex;
+        std::unordered_map<std::string, entry> m_entries;
+    };
+
+    bool is_valid(const entry& e, clock::time_point now) const;
+
+    shard& get_shard(const std::string& pathname);
+    const shard& get_shard(const std::string& pathname) const;
+
+    std::array<shard, s_num_shards> m_shards;
+    const std::size_t m_shard_capacity;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<bool> m_enabled;
+    std::atomic<clock::duration::rep> m_lifetime; /* in clock ticks (0 if entries don't expire) */
+};
+
+} // namespace efsng
+
+#endif /* __NEGATIVES_H__ */
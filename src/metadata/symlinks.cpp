@@ -0,0 +1,205 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include "symlinks.h"
+
+namespace efsng{
+
+const std::size_t symlink_table::s_num_shards;
+const ino_t symlink_table::s_first_inode;
+
+symlink_table::symlink_table()
+    : m_count(0),
+      m_next_inode(s_first_inode) { }
+
+symlink_table::shard& symlink_table::get_shard(const std::string& linkpath) {
+    return m_shards[std::hash<std::string>()(linkpath) % s_num_shards];
+}
+
+const symlink_table::shard& symlink_table::get_shard(const std::string& linkpath) const {
+    return m_shards[std::hash<std::string>()(linkpath) % s_num_shards];
+}
+
+bool symlink_table::add(const std::string& linkpath, const std::string& target, uid_t uid, gid_t gid) {
+
+    link lnk;
+    lnk.m_target = target;
+
+    memset(&lnk.m_attributes, 0, sizeof(lnk.m_attributes));
+    lnk.m_attributes.st_ino = m_next_inode++;
+    lnk.m_attributes.st_mode = S_IFLNK | 0777;
+    lnk.m_attributes.st_nlink = 1;
+    lnk.m_attributes.st_uid = uid;
+    lnk.m_attributes.st_gid = gid;
+    lnk.m_attributes.st_size = target.size();
+    lnk.m_attributes.st_atime = lnk.m_attributes.st_mtime = lnk.m_attributes.st_ctime = time(NULL);
+
+    auto& sh = get_shard(linkpath);
+    boost::unique_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    if(!sh.m_links.emplace(linkpath, lnk).second) {
+        return false;
+    }
+
+    ++m_count;
+    return true;
+}
+
+bool symlink_table::find(const std::string& linkpath, std::string& target) const {
+
+    if(empty()) {
+        return false;
+    }
+
+    const auto& sh = get_shard(linkpath);
+    boost::shared_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    auto it = sh.m_links.find(linkpath);
+
+    if(it == sh.m_links.end()) {
+        return false;
+    }
+
+    target = it->second.m_target;
+    return true;
+}
+
+bool symlink_table::stat(const std::string& linkpath, struct stat& stbuf) const {
+
+    if(empty()) {
+        return false;
+    }
+
+    const auto& sh = get_shard(linkpath);
+    boost::shared_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    auto it = sh.m_links.find(linkpath);
+
+    if(it == sh.m_links.end()) {
+        return false;
+    }
+
+    stbuf = it->second.m_attributes;
+    return true;
+}
+
+bool symlink_table::remove(const std::string& linkpath) {
+
+    if(empty()) {
+        return false;
+    }
+
+    auto& sh = get_shard(linkpath);
+    boost::unique_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    if(sh.m_links.erase(linkpath) == 0) {
+        return false;
+    }
+
+    --m_count;
+    return true;
+}
+
+bool symlink_table::rename(const std::string& oldpath, const std::string& newpath) {
+
+    if(empty()) {
+        return false;
+    }
+
+    link lnk;
+
+    {
+        auto& sh = get_shard(oldpath);
+        boost::unique_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+        auto it = sh.m_links.find(oldpath);
+
+        if(it == sh.m_links.end()) {
+            return false;
+        }
+
+        lnk = std::move(it->second);
+        sh.m_links.erase(it);
+    }
+
+    lnk.m_attributes.st_ctime = time(NULL);
+
+    auto& sh = get_shard(newpath);
+    boost::unique_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+    auto rv = sh.m_links.emplace(newpath, lnk);
+
+    if(!rv.second) {
+        /* a link with the new name is replaced */
+        rv.first->second = lnk;
+        --m_count;
+    }
+
+    return true;
+}
+
+void symlink_table::list(const std::string& dirpath, std::list<std::string>& names) const {
+
+    if(empty()) {
+        return;
+    }
+
+    std::string prefix = dirpath;
+
+    if(prefix.empty() || prefix.back() != '/') {
+        prefix.push_back('/');
+    }
+
+    for(const auto& sh : m_shards) {
+        boost::shared_lock<boost::shared_mutex> lock(sh.m_mutex);
+
+        for(const auto& kv : sh.m_links) {
+            const auto& linkpath = kv.first;
+
+            if(linkpath.size() > prefix.size() && 
+               linkpath.compare(0, prefix.size(), prefix) == 0 &&
+               linkpath.find('/', prefix.size()) == std::string::npos) {
+                names.emplace_back(linkpath.substr(prefix.size()));
+            }
+        }
+    }
+}
+
+bool symlink_table::empty() const {
+    return m_count.load(std::memory_order_relaxed) == 0;
+}
+
+} // namespace efsng
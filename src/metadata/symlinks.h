@@ -0,0 +1,103 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __SYMLINKS_H__
+#define __SYMLINKS_H__
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <array>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace efsng{
+
+/* keeps the symbolic links created inside the filesystem. Links are spread
+ * over several independently locked shards so that concurrent operations on 
+ * different links do not contend, and a (relaxed) atomic counter allows the 
+ * hot path to skip the table entirely while no links exist */
+class symlink_table{
+
+    static const std::size_t s_num_shards = 16;
+
+    /* inode numbers for links are taken from a range that backends never reach */
+    static const ino_t s_first_inode = (ino_t) 1 << 48;
+
+public:
+    symlink_table();
+
+    /* create 'linkpath' pointing to 'target'; returns false if it already exists */
+    bool add(const std::string& linkpath, const std::string& target, uid_t uid, gid_t gid);
+
+    /* fetch the target of 'linkpath'; returns false if it is not a link */
+    bool find(const std::string& linkpath, std::string& target) const;
+
+    /* fetch the attributes of 'linkpath'; returns false if it is not a link */
+    bool stat(const std::string& linkpath, struct stat& stbuf) const;
+
+    /* remove 'linkpath'; returns false if it is not a link */
+    bool remove(const std::string& linkpath);
+
+    /* move 'oldpath' to 'newpath', replacing any link there; returns false if 'oldpath' is not a link */
+    bool rename(const std::string& oldpath, const std::string& newpath);
+
+    /* append to 'names' the links that live directly under 'dirpath' */
+    void list(const std::string& dirpath, std::list<std::string>& names) const;
+
+    bool empty() const;
+
+private:
+    struct link {
+        std::string m_target;
+        struct stat m_attributes;
+    };
+
+    struct shard {
+        mutable boost::shared_mutex m_mutex;
+        std::unordered_map<std::string, link> m_links;
+    };
+
+    shard& get_shard(const std::string& linkpath);
+    const shard& get_shard(const std::string& linkpath) const;
+
+    std::array<shard, s_num_shards> m_shards;
+    std::atomic<std::size_t> m_count;
+    std::atomic<ino_t> m_next_inode;
+};
+
+} // namespace efsng
+
+#endif /* __SYMLINKS_H__ */
@@ -0,0 +1,180 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#include <cstring>
+#include "router.h"
+
+namespace efsng {
+
+const int router::s_index_shift;
+
+router::router()
+    : m_single(true),
+      m_backends(1, nullptr) { }
+
+void router::set_default(backend* ptr) {
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    m_backends[0] = ptr;
+    m_prefixes["/"] = 0;
+}
+
+void router::add_prefix(const std::string& prefix, backend* ptr) {
+
+    std::string key = prefix;
+
+    /* prefixes are stored without a trailing slash */
+    while(key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+
+    m_prefixes[key] = index_of(ptr);
+    m_single = (m_prefixes.size() == 1);
+}
+
+std::size_t router::index_of(backend* ptr) {
+
+    for(std::size_t i = 0; i < m_backends.size(); ++i) {
+        if(m_backends[i] == ptr) {
+            return i;
+        }
+    }
+
+    m_backends.push_back(ptr);
+    return m_backends.size() - 1;
+}
+
+backend* router::resolve(const char* pathname, std::size_t* index) const {
+
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+
+    if(m_single) {
+        if(index != nullptr) {
+            *index = 0;
+        }
+        return m_backends[0];
+    }
+
+    std::string key = pathname;
+
+    while(key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+
+    while(true) {
+        auto it = m_prefixes.find(key);
+
+        if(it != m_prefixes.end()) {
+            if(index != nullptr) {
+                *index = it->second;
+            }
+            return m_backends[it->second];
+        }
+
+        auto pos = key.rfind('/');
+
+        if(pos == std::string::npos || key == "/") {
+            break;
+        }
+
+        key.resize(pos == 0 ? 1 : pos);
+    }
+
+    if(index != nullptr) {
+        *index = 0;
+    }
+    return m_backends[0];
+}
+
+ino_t router::passthrough_inode(dev_t dev, ino_t inode) const {
+
+    const auto id = std::make_pair(dev, inode);
+
+    {
+        boost::shared_lock<boost::shared_mutex> lock(m_passthrough_mutex);
+        auto it = m_passthrough_inodes.find(id);
+
+        if(it != m_passthrough_inodes.end()) {
+            return it->second;
+        }
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(m_passthrough_mutex);
+    auto it = m_passthrough_inodes.find(id);
+
+    if(it != m_passthrough_inodes.end()) {
+        return it->second;
+    }
+
+    // sequence numbers start at 1 and must fit below the index bits
+    const std::size_t next = m_passthrough_inodes.size() + 1;
+
+    if(next >= ((std::size_t) 1 << s_index_shift)) {
+        return 0;
+    }
+
+    ino_t ino = global_inode(s_passthrough_index, next);
+    m_passthrough_inodes.emplace(id, ino);
+
+    return ino;
+}
+
+void router::children(const std::string& dirpath, std::list<std::string>& names) const {
+
+    if(m_single) {
+        return;
+    }
+
+    std::string prefix = dirpath;
+
+    if(prefix.empty() || prefix.back() != '/') {
+        prefix.push_back('/');
+    }
+
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+
+    for(const auto& kv : m_prefixes) {
+        const auto& key = kv.first;
+
+        if(key.size() > prefix.size() && 
+           key.compare(0, prefix.size(), prefix) == 0 &&
+           key.find('/', prefix.size()) == std::string::npos) {
+            names.emplace_back(key.substr(prefix.size()));
+        }
+    }
+}
+
+} // namespace efsng
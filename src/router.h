@@ -0,0 +1,109 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+#ifndef __ROUTER_H__
+#define __ROUTER_H__
+
+#include <sys/types.h>
+#include <atomic>
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "backends.h"
+
+namespace efsng {
+
+/*! This class maps subtrees of the mount point to the backends that serve them. A path 
+ * is served by the backend registered for its longest matching prefix, which is found 
+ * by probing a hash table with each of the path's ancestors (i.e. O(depth) lookups). 
+ * While only the default backend is registered, lookups return it straight away */
+class router {
+
+    /* inode numbers reported for the Nth registered backend carry N in these bits
+     * so that inodes from different backends never clash */
+    static const int s_index_shift = 40;
+    static const std::size_t s_passthrough_index = ((std::size_t) 1 << (64 - s_index_shift)) - 1;
+
+public:
+    router();
+
+    /*! Set the backend serving any path not covered by other prefixes */
+    void set_default(backend* ptr);
+
+    /*! Route 'prefix' (and everything below it) to backend 'ptr' */
+    void add_prefix(const std::string& prefix, backend* ptr);
+
+    /*! Find the backend serving 'pathname' (and its index if 'index' is not null) */
+    backend* resolve(const char* pathname, std::size_t* index = nullptr) const;
+
+    /*! Append to 'names' the routed prefixes found directly under 'dirpath' */
+    void children(const std::string& dirpath, std::list<std::string>& names) const;
+
+    /*! Translate an inode number issued by the backend with index 'index' */
+    static ino_t global_inode(std::size_t index, ino_t inode) {
+        return index == 0 ? inode : (((ino_t) index << s_index_shift) | inode);
+    }
+
+    /*! Inode number for the unstaged file (dev, inode) of the underlying filesystem 
+     * (passthrough tier). Numbers carry an index that is never given to a backend 
+     * and are issued in sequence and remembered, so that different files (e.g. on 
+     * different filesystems below root-dir) never share one. Returns 0 if they 
+     * have run out */
+    ino_t passthrough_inode(dev_t dev, ino_t inode) const;
+
+private:
+    std::size_t index_of(backend* ptr);
+
+    struct file_id_hash {
+        std::size_t operator()(const std::pair<dev_t, ino_t>& id) const {
+            return std::hash<ino_t>()(id.second) ^ (std::hash<dev_t>()(id.first) << 1);
+        }
+    };
+
+    mutable boost::shared_mutex                 m_mutex;
+    std::atomic<bool>                           m_single;   /*!< Only the default backend is routed */
+    std::vector<backend*>                       m_backends; /*!< Routed backends (index 0 is the default) */
+    std::unordered_map<std::string, std::size_t> m_prefixes; /*!< Prefix -> index in m_backends */
+
+    mutable boost::shared_mutex                 m_passthrough_mutex;
+    mutable std::unordered_map<std::pair<dev_t, ino_t>, ino_t, file_id_hash> 
+                                                m_passthrough_inodes; /*!< (st_dev, st_ino) -> inode issued */
+}; // class router
+
+} // namespace efsng
+
+#endif /* __ROUTER_H__ */
@@ -55,6 +55,16 @@ static const std::string results_dir("results-dir");
 static const std::string log_file("log-file");
 static const std::string workers("workers");
 static const std::string transfer_size("transfer-size");
+static const std::string writeback_cache("writeback-cache");
+static const std::string max_readahead("max-readahead");
+static const std::string fuse_workers("fuse-workers");
+static const std::string max_idle_threads("max-idle-threads");
+static const std::string clone_fd("clone-fd");
+static const std::string pin_workers("pin-workers");
+static const std::string passthrough("passthrough");
+static const std::string negative_timeout("negative-timeout");
+static const std::string io_uring("io-uring");
+static const std::string io_uring_queue_depth("io-uring-queue-depth");
 
 // option names for 'backends' section
 static const std::string id("id");
@@ -80,12 +90,22 @@ const file_schema config_schema = declare_file({
         keywords::global_settings, 
         true,
         declare_group({   
-            declare_option<bfs::path>(keywords::root_dir,      true,            path_parser), 
-            declare_option<bfs::path>(keywords::mount_dir,     true,            path_parser),
-            declare_option<bfs::path>(keywords::results_dir,   false,           path_parser),
-            declare_option<bfs::path>(keywords::log_file,      false,           path_parser),
-            declare_option<uint32_t> (keywords::workers,       false, 8,        number_parser),
-            declare_option<uint32_t> (keywords::transfer_size, false, 128*1024, size_parser)
+            declare_option<bfs::path>  (keywords::root_dir,         true,            path_parser), 
+            declare_option<bfs::path>  (keywords::mount_dir,        true,            path_parser),
+            declare_option<bfs::path>  (keywords::results_dir,      false,           path_parser),
+            declare_option<bfs::path>  (keywords::log_file,         false,           path_parser),
+            declare_option<uint32_t>   (keywords::workers,          false, 8,        number_parser),
+            declare_option<uint32_t>   (keywords::transfer_size,    false, 128*1024, size_parser),
+            declare_option<bool>       (keywords::writeback_cache,  false, false,    bool_parser),
+            declare_option<uint32_t>   (keywords::max_readahead,    false, 0,        size_parser),
+            declare_option<uint32_t>   (keywords::fuse_workers,     false, 0,        number_parser),
+            declare_option<uint32_t>   (keywords::max_idle_threads, false, 10,       number_parser),
+            declare_option<bool>       (keywords::clone_fd,         false, false,    bool_parser),
+            declare_option<std::string>(keywords::pin_workers,      false, std::string("none"), pinning_parser),
+            declare_option<bool>       (keywords::passthrough,      false, false,    bool_parser),
+            declare_option<uint32_t>   (keywords::negative_timeout, false, 0,        number_parser),
+            declare_option<bool>       (keywords::io_uring,         false, false,    bool_parser),
+            declare_option<uint32_t>   (keywords::io_uring_queue_depth, false, 0,    number_parser)
         })
     ),
     declare_section(
@@ -105,6 +125,7 @@ const file_schema config_schema = declare_file({
             declare_option<std::string>(keywords::path,    true),
             declare_option<std::string>(keywords::backend, true),
             declare_option<std::string>(keywords::flags,   true),
+            declare_option<std::string>(file_options::match_any, false)
         })
     ),
 });
@@ -57,6 +57,10 @@ uint32_t number_parser(const std::string& name, const std::string& value) {
 }
 
 uint32_t size_parser(const std::string& name, const std::string& value) {
+    return size64_parser(name, value);
+}
+
+uint64_t size64_parser(const std::string& name, const std::string& value) {
 
     const uint64_t B_FACTOR = 1;
     const uint64_t KB_FACTOR = 1e3;
@@ -117,9 +121,13 @@ uint32_t size_parser(const std::string& name, const std::string& value) {
         throw std::invalid_argument("Value '" + value + "' provided in setting '" + name + "' is not a number");
     }
 
-    double parsed_value = std::stod(number_str);
+    double parsed_value = std::round(std::stod(number_str) * factor);
+
+    if(parsed_value >= 18446744073709551616.0) { // 2^64
+        throw std::invalid_argument("Value '" + value + "' provided in setting '" + name + "' is too large");
+    }
 
-    return std::round(parsed_value*factor);
+    return parsed_value;
 }
 
 bfs::path path_parser(const std::string& name, const std::string& value) {
@@ -134,3 +142,43 @@ bfs::path path_parser(const std::string& name, const std::string& value) {
 
     return path;
 }
+
+bool bool_parser(const std::string& name, const std::string& value) {
+
+    if(value == "true" || value == "yes" || value == "on" || value == "1") {
+        return true;
+    }
+
+    if(value == "false" || value == "no" || value == "off" || value == "0") {
+        return false;
+    }
+
+    throw std::invalid_argument("Value provided for setting '" + name + "' is not a boolean");
+}
+
+double seconds_parser(const std::string& name, const std::string& value) {
+
+    double optval = 0.0;
+    std::size_t pos = 0;
+
+    try {
+        optval = std::stod(value, &pos);
+    } catch(...) {
+        throw std::invalid_argument("Value provided for setting '" + name + "' is not a number");
+    }
+
+    if(pos != value.size() || optval < 0.0) {
+        throw std::invalid_argument("Value provided for setting '" + name + "' must be a non-negative number of seconds");
+    }
+
+    return optval;
+}
+
+std::string pinning_parser(const std::string& name, const std::string& value) {
+
+    if(value == "none" || value == "cpu" || value == "node") {
+        return value;
+    }
+
+    throw std::invalid_argument("Value provided for setting '" + name + "' must be one of 'none', 'cpu' or 'node'");
+}
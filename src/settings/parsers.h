@@ -42,6 +42,10 @@ namespace bfs = boost::filesystem;
 
 uint32_t number_parser(const std::string& name, const std::string& value);
 uint32_t size_parser(const std::string& name, const std::string& value);
+uint64_t size64_parser(const std::string& name, const std::string& value);
 bfs::path path_parser(const std::string& name, const std::string& value);
+bool bool_parser(const std::string& name, const std::string& value);
+double seconds_parser(const std::string& name, const std::string& value);
+std::string pinning_parser(const std::string& name, const std::string& value);
 
 #endif /* __PARSERS_H__ */
@@ -62,6 +62,7 @@ settings::settings()
     : m_exec_name("none"),
       m_daemonize(false),
       m_debug(false),
+      m_lowlevel(false),
       m_root_dir("none"),
       m_mount_dir("none"),
       m_results_dir("none"),
@@ -69,6 +70,16 @@ settings::settings()
       m_log_file("none"),
       m_workers(0),
       m_transfer_size(0),
+      m_writeback_cache(false),
+      m_max_readahead(0),
+      m_fuse_workers(0),
+      m_max_idle_threads(0),
+      m_clone_fd(false),
+      m_pin_workers("none"),
+      m_passthrough(false),
+      m_negative_timeout(0),
+      m_io_uring(false),
+      m_io_uring_queue_depth(0),
       m_api_sockfile(defaults::api_sockfile),
       m_fuse_argc(0),
       m_fuse_argv() { 
@@ -78,6 +89,7 @@ settings::settings(const settings& other)
     : m_exec_name(other.m_exec_name),
       m_daemonize(other.m_daemonize),
       m_debug(other.m_debug),
+      m_lowlevel(other.m_lowlevel),
       m_root_dir(other.m_root_dir),
       m_mount_dir(other.m_mount_dir),
       m_results_dir(other.m_results_dir),
@@ -85,6 +97,16 @@ settings::settings(const settings& other)
       m_log_file(other.m_log_file),
       m_workers(other.m_workers),
       m_transfer_size(other.m_transfer_size),
+      m_writeback_cache(other.m_writeback_cache),
+      m_max_readahead(other.m_max_readahead),
+      m_fuse_workers(other.m_fuse_workers),
+      m_max_idle_threads(other.m_max_idle_threads),
+      m_clone_fd(other.m_clone_fd),
+      m_pin_workers(other.m_pin_workers),
+      m_passthrough(other.m_passthrough),
+      m_negative_timeout(other.m_negative_timeout),
+      m_io_uring(other.m_io_uring),
+      m_io_uring_queue_depth(other.m_io_uring_queue_depth),
       m_api_sockfile(other.m_api_sockfile),
       m_backend_opts(other.m_backend_opts),
       m_resources(other.m_resources),
@@ -120,6 +142,12 @@ settings& settings::operator=(settings&& other) {
         m_log_file = std::move(other.m_log_file);
         m_workers = std::move(other.m_workers);
         m_transfer_size = std::move(other.m_transfer_size);
+        m_max_readahead = std::move(other.m_max_readahead);
+        m_fuse_workers = std::move(other.m_fuse_workers);
+        m_max_idle_threads = std::move(other.m_max_idle_threads);
+        m_pin_workers = std::move(other.m_pin_workers);
+        m_negative_timeout = std::move(other.m_negative_timeout);
+        m_io_uring_queue_depth = std::move(other.m_io_uring_queue_depth);
         m_api_sockfile = std::move(other.m_api_sockfile);
         m_backend_opts = std::move(other.m_backend_opts);
         m_resources = std::move(other.m_resources);
@@ -129,6 +157,16 @@ settings& settings::operator=(settings&& other) {
         other.m_daemonize = false;
         m_debug = other.m_debug;
         other.m_debug = false;
+        m_lowlevel = other.m_lowlevel;
+        other.m_lowlevel = false;
+        m_writeback_cache = other.m_writeback_cache;
+        other.m_writeback_cache = false;
+        m_clone_fd = other.m_clone_fd;
+        other.m_clone_fd = false;
+        m_passthrough = other.m_passthrough;
+        other.m_passthrough = false;
+        m_io_uring = other.m_io_uring;
+        other.m_io_uring = false;
         m_fuse_argc = other.m_fuse_argc;
         other.m_fuse_argc = 0;
 
@@ -153,6 +191,7 @@ void settings::reset() {
     m_exec_name = "none";
     m_daemonize = false;
     m_debug = false;
+    m_lowlevel = false;
     m_root_dir = "none";
     m_mount_dir = "none";
     m_results_dir = "none";
@@ -160,6 +199,16 @@ void settings::reset() {
     m_log_file = "none";
     m_workers = 0;
     m_transfer_size = 0;
+    m_writeback_cache = false;
+    m_max_readahead = 0;
+    m_fuse_workers = 0;
+    m_max_idle_threads = 0;
+    m_clone_fd = false;
+    m_pin_workers = "none";
+    m_passthrough = false;
+    m_negative_timeout = 0;
+    m_io_uring = false;
+    m_io_uring_queue_depth = 0;
     m_fuse_argc = 0;
 
     for(int i=0; i<s_max_fuse_args; ++i){
@@ -228,6 +277,7 @@ void settings::from_cmdline(int argc, char* argv[]){
         {"fuse-debug",          0, 0, 'D'}, /* FUSE debug mode */
         {"fuse-single-thread",  0, 0, 'S'}, /* FUSE debug mode */
         {"fuse-help",           0, 0, 'H'}, /* fuse_mount usage */
+        {"lowlevel",            0, 0, 'L'}, /* inode-based low-level FUSE front end */
         {"version",             0, 0, 'V'}, /* version information */
         {0, 0, 0, 0}
     };
@@ -306,6 +356,12 @@ void settings::from_cmdline(int argc, char* argv[]){
                 cmdline::fuse_usage(exec_name);
                 exit(EXIT_SUCCESS);
                 break;
+            case 'L':
+#if FUSE_USE_VERSION < 30
+                throw std::invalid_argument("The low-level front end requires FUSE 3");
+#endif
+                m_lowlevel = true;
+                break;
             case 'V':
                 std::cout << exec_name.c_str() << " version " << VERSION << "\n"
                           << "Copyright (C) 2016 Barcelona Supercomputing Center (BSC-CNS)\n" 
@@ -387,11 +443,16 @@ void settings::from_cmdline(int argc, char* argv[]){
      * - use_ino: needed to allow files to retain their original inode numbers.
      * - attr_timeout=0: set cache timeout for names to 0s
      */
-    push_arg("-o");
 #if FUSE_USE_VERSION < 30
+    push_arg("-o");
     push_arg("nonempty,attr_timeout=0,big_writes");
 #else
-    push_arg("attr_timeout=0");
+    /* attr_timeout is a high-level option: the low-level front end sets 
+     * its timeouts in each reply */
+    if(!m_lowlevel) {
+        push_arg("-o");
+        push_arg("attr_timeout=0");
+    }
 #endif
 
     /* if there are still extra unparsed arguments, pass them onto FUSE */
@@ -439,12 +500,22 @@ void settings::load_from_yaml_file(const bfs::path& config_file) {
         }
     }
     
-    // 'workers' and 'transfer-size' don't have a command line option, 
+    // 'workers', 'transfer-size', the kernel caching options and the FUSE session options don't have a command line option, 
     // no need to check if they have been already set
     // Also, we have set a default value for them so they HAVE TO be 
     // in parsed_global_settings
     m_workers = parsed_global_settings.get_as<uint32_t>(keywords::workers);
     m_transfer_size = parsed_global_settings.get_as<uint32_t>(keywords::transfer_size);
+    m_writeback_cache = parsed_global_settings.get_as<bool>(keywords::writeback_cache);
+    m_max_readahead = parsed_global_settings.get_as<uint32_t>(keywords::max_readahead);
+    m_fuse_workers = parsed_global_settings.get_as<uint32_t>(keywords::fuse_workers);
+    m_max_idle_threads = parsed_global_settings.get_as<uint32_t>(keywords::max_idle_threads);
+    m_clone_fd = parsed_global_settings.get_as<bool>(keywords::clone_fd);
+    m_pin_workers = parsed_global_settings.get_as<std::string>(keywords::pin_workers);
+    m_passthrough = parsed_global_settings.get_as<bool>(keywords::passthrough);
+    m_negative_timeout = parsed_global_settings.get_as<uint32_t>(keywords::negative_timeout);
+    m_io_uring = parsed_global_settings.get_as<bool>(keywords::io_uring);
+    m_io_uring_queue_depth = parsed_global_settings.get_as<uint32_t>(keywords::io_uring_queue_depth);
 
     // 2. initialize m_backend_opts with the parsed information
     // about any configured backends
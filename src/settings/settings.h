@@ -66,6 +66,7 @@ struct settings {
     std::string                     m_exec_name;                    /*!< Program name */
     bool                            m_daemonize;                    /*!< Run echofs as a daemon? */
     bool                            m_debug;                        /*!< Run echofs in debug mode? */
+    bool                            m_lowlevel;                     /*!< Use the inode-based low-level FUSE API? */
     bfs::path                       m_root_dir;                     /*!< Path to underlying filesystem's root dir */
     bfs::path                       m_mount_dir;                    /*!< Path to echofs' mount point */
     bfs::path                       m_results_dir;                  /*!< Path to echofs' mount point */
@@ -73,6 +74,16 @@ struct settings {
     bfs::path                       m_log_file;                     /*!< Path to log file (if any) */
     uint32_t                        m_workers;                      /*!< Number of workers in charge of importing/exporting resources */
     uint32_t                        m_transfer_size;                /*!< Transfer size */
+    bool                            m_writeback_cache;              /*!< Ask the kernel to cache writes? */
+    uint32_t                        m_max_readahead;                /*!< Maximum kernel readahead (0 = kernel default) */
+    uint32_t                        m_fuse_workers;                 /*!< Number of workers serving FUSE requests (0 = libfuse's own loop) */
+    uint32_t                        m_max_idle_threads;             /*!< Maximum idle threads kept by libfuse's loop */
+    bool                            m_clone_fd;                     /*!< Give each libfuse worker its own /dev/fuse descriptor? */
+    std::string                     m_pin_workers;                  /*!< Pin FUSE workers to CPUs ("cpu"), NUMA nodes ("node") or not at all ("none") */
+    bool                            m_passthrough;                  /*!< Serve unstaged files in root_dir directly from it? */
+    uint32_t                        m_negative_timeout;             /*!< Seconds the kernel may remember missing paths for */
+    bool                            m_io_uring;                     /*!< Receive FUSE requests through io_uring rings instead of /dev/fuse? */
+    uint32_t                        m_io_uring_queue_depth;         /*!< Entries per io_uring ring (0 = libfuse's default) */
     bfs::path                       m_api_sockfile;                 /*!< Path to socket for API communication */
     std::unordered_map<std::string, backend_options> m_backend_opts; /*!< User configuration options passed to any backends */
     std::list<kv_list>              m_resources;                    /*!< Resources that need to be imported/exported */
@@ -0,0 +1,196 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/*
+ * Compare the ways of copying a write (or a read reply) into its destination:
+ *
+ *  - memcpy:       what non-pmem segments used to do (through fuse_buf_copy());
+ *  - nodrain:      pmem_memcpy_nodrain(), what pmem segments used to do;
+ *  - temporal:     copy_memory() with regular stores (plus flushes on pmem);
+ *  - non-temporal: copy_memory() with streaming stores;
+ *  - auto:         copy_memory() choosing by size and kind of memory, i.e. what
+ *                  put_data() and get_data() do now.
+ *
+ * Copies go to consecutive offsets of a 64MiB destination, as sequential
+ * writes to a file would. Anonymous memory is always measured, and so is a pool
+ * file if a DAX filesystem is given (as 'pmem' if libpmem detects it as such,
+ * and as 'dax' if the platform doesn't need CPU caches flushed). Sizes range
+ * from a page to the largest FUSE requests enabled by the patches in contrib/.
+ *
+ * usage: bench-copy-engine [DAXFS_DIR] [ITERATIONS]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <libpmem.h>
+
+#include <copy-engine.h>
+
+using efsng::copy_memory;
+using efsng::copy_mode;
+using efsng::memory_kind;
+
+namespace {
+
+const size_t KiB = 1024;
+const size_t MiB = 1024 * KiB;
+
+const size_t transfer_sizes[] = {
+    4*KiB, 16*KiB, 64*KiB, 256*KiB, 1*MiB, 4*MiB, 12*MiB
+};
+
+const size_t arena_size = 64*MiB;
+
+const char* kind_name(memory_kind kind) {
+    switch(kind) {
+        case memory_kind::pmem: return "pmem";
+        case memory_kind::dax:  return "dax";
+        default:                return "dram";
+    }
+}
+
+/* MiB/s achieved by 'fun' copying 'size' bytes to consecutive offsets of 'arena' */
+template <typename Function>
+double bandwidth(char* arena, size_t size, unsigned iterations, Function&& fun) {
+
+    size_t offset = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(unsigned i = 0; i < iterations; ++i) {
+        if(offset + size > arena_size) {
+            offset = 0;
+        }
+
+        fun(arena + offset);
+        offset += size;
+    }
+
+    pmem_drain();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double) size * iterations / MiB / elapsed.count();
+}
+
+void run(char* arena, memory_kind kind, unsigned iterations) {
+
+    std::vector<char> src(transfer_sizes[sizeof(transfer_sizes) / sizeof(transfer_sizes[0]) - 1], 'x');
+
+    printf("# destination: %s, kernel: %s\n", kind_name(kind), efsng::copy_kernel());
+    printf("%10s %12s %12s %12s %12s %12s %8s\n", "size (KiB)", "memcpy", "nodrain",
+           "temporal", "non-temp", "auto", "(MiB/s)");
+
+    for(size_t size : transfer_sizes) {
+
+        // keep the number of bytes copied roughly constant
+        unsigned n = std::max(1u, (unsigned) (iterations * (4*KiB) / size));
+
+        double memcpy_bw = bandwidth(arena, size, n, [&](char* dst) {
+            memcpy(dst, src.data(), size);
+        });
+
+        double nodrain_bw = bandwidth(arena, size, n, [&](char* dst) {
+            pmem_memcpy_nodrain(dst, src.data(), size);
+        });
+
+        double temporal_bw = bandwidth(arena, size, n, [&](char* dst) {
+            copy_memory(dst, src.data(), size, kind, copy_mode::temporal);
+        });
+
+        double nt_bw = bandwidth(arena, size, n, [&](char* dst) {
+            copy_memory(dst, src.data(), size, kind, copy_mode::non_temporal);
+        });
+
+        double auto_bw = bandwidth(arena, size, n, [&](char* dst) {
+            copy_memory(dst, src.data(), size, kind);
+        });
+
+        printf("%10zu %12.1f %12.1f %12.1f %12.1f %12.1f %8s\n", size / KiB, memcpy_bw, nodrain_bw,
+               temporal_bw, nt_bw, auto_bw,
+               efsng::copy_strategy(size, kind) == copy_mode::temporal ? "temp" : "non-temp");
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    unsigned iterations = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+
+    void* arena = NULL;
+
+    if(posix_memalign(&arena, 4096, arena_size) != 0) {
+        perror("posix_memalign");
+        return EXIT_FAILURE;
+    }
+
+    // fault the pages in before measuring anything
+    memset(arena, 0, arena_size);
+    run((char*) arena, memory_kind::dram, iterations);
+    free(arena);
+
+    if(argc < 2) {
+        return EXIT_SUCCESS;
+    }
+
+    std::string pool_path = std::string(argv[1]) + "/bench-copy-engine.pool";
+
+    size_t pool_length;
+    int is_pmem;
+    void* pool_addr = pmem_map_file(pool_path.c_str(), arena_size, PMEM_FILE_CREATE,
+                                    0600, &pool_length, &is_pmem);
+
+    if(pool_addr == NULL) {
+        perror("pmem_map_file");
+        return EXIT_FAILURE;
+    }
+
+    pmem_memset_persist(pool_addr, 0, pool_length);
+
+    memory_kind kind = !is_pmem ? memory_kind::dram :
+                       pmem_has_auto_flush() == 1 ? memory_kind::dax : memory_kind::pmem;
+
+    printf("\n# pool: %s (is_pmem: %d)\n", pool_path.c_str(), is_pmem);
+    run((char*) pool_addr, kind, iterations);
+
+    pmem_unmap(pool_addr, pool_length);
+    unlink(pool_path.c_str());
+
+    return EXIT_SUCCESS;
+}
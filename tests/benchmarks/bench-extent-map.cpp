@@ -0,0 +1,164 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+/*
+ * Compare the segment map used by the nvml backends (efsng::extent_map)
+ * against the mdds::flat_segment_tree it replaced, for the operations a file
+ * goes through while it is written: segments are appended one at a time (the
+ * tree has to be rebuilt before it can be searched again) and every request
+ * looks up the segment that holds its offset. A few gaps are then allocated
+ * in the middle of the file to show the cost of non-append updates.
+ *
+ * usage: bench-extent-map [SEGMENTS] [LOOKUPS]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+#include <sys/types.h>
+
+#include <mdds/flat_segment_tree.hpp>
+#include <extent-map.h>
+
+namespace {
+
+using value_type = std::shared_ptr<int>;
+using segment_tree = mdds::flat_segment_tree<off_t, value_type>;
+using segment_map = efsng::extent_map<value_type>;
+
+const off_t segment_size = 1 << 20;
+
+template <typename Function>
+double elapsed_ms(Function&& fun) {
+
+    auto start = std::chrono::steady_clock::now();
+    fun();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    size_t nsegments = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t nlookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 10000000;
+    size_t ninserts = std::min(nsegments, (size_t) 1000);
+
+    if(nsegments == 0) {
+        fprintf(stderr, "usage: %s [SEGMENTS] [LOOKUPS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<value_type> values;
+
+    for(size_t i = 0; i < nsegments + 2 * ninserts; ++i) {
+        values.emplace_back(std::make_shared<int>(i));
+    }
+
+    // same offsets for both: sequential ones (as read by a streaming reader) and random ones
+    std::mt19937_64 rng(42);
+    std::vector<off_t> offsets(nlookups);
+
+    for(size_t i = 0; i < nlookups; ++i) {
+        offsets[i] = (i % 2 == 0) ? (off_t) ((i / 2) * 4096 % (nsegments * segment_size)) :
+                                    (off_t) (rng() % (nsegments * segment_size));
+    }
+
+    std::vector<off_t> holes(ninserts);
+
+    for(size_t i = 0; i < ninserts; ++i) {
+        holes[i] = (rng() % nsegments) * segment_size + segment_size / 4;
+    }
+
+    segment_tree tree(0, std::numeric_limits<off_t>::max(), value_type());
+    segment_map map;
+    size_t found_tree = 0, found_map = 0;
+
+    double tree_append = elapsed_ms([&] {
+        for(size_t i = 0; i < nsegments; ++i) {
+            tree.insert_back(i * segment_size, (i + 1) * segment_size, values[i]);
+            tree.build_tree();
+        }
+    });
+
+    double map_append = elapsed_ms([&] {
+        for(size_t i = 0; i < nsegments; ++i) {
+            map.assign(i * segment_size, (i + 1) * segment_size, values[i]);
+        }
+    });
+
+    double tree_lookup = elapsed_ms([&] {
+        for(const auto off : offsets) {
+            value_type v;
+            tree.search_tree(off, v);
+            found_tree += (v != nullptr);
+        }
+    });
+
+    double map_lookup = elapsed_ms([&] {
+        for(const auto off : offsets) {
+            found_map += (map.find(off) != map.end());
+        }
+    });
+
+    double tree_insert = elapsed_ms([&] {
+        for(size_t i = 0; i < ninserts; ++i) {
+            tree.insert_front(holes[i], holes[i] + 4096, values[nsegments + i]);
+            tree.build_tree();
+        }
+    });
+
+    double map_insert = elapsed_ms([&] {
+        for(size_t i = 0; i < ninserts; ++i) {
+            map.assign(holes[i], holes[i] + 4096, values[nsegments + i]);
+        }
+    });
+
+    if(found_tree != found_map) {
+        fprintf(stderr, "lookups disagree: %zu vs %zu\n", found_tree, found_map);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-24s %18s %12s\n", "", "flat_segment_tree", "extent_map");
+    printf("%-24s %18.2f %12.2f  (ms, %zu segments)\n", "append", tree_append, map_append, nsegments);
+    printf("%-24s %18.2f %12.2f  (ms, %zu lookups)\n", "lookup", tree_lookup, map_lookup, nlookups);
+    printf("%-24s %18.2f %12.2f  (ms, %zu splits)\n", "insert in the middle", tree_insert, map_insert, ninserts);
+
+    return EXIT_SUCCESS;
+}
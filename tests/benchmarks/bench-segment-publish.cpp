@@ -0,0 +1,149 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+/*
+ * Measure what publishing the segment map of an nvml file costs writers (see 
+ * nvml::file::publish_segments()): after every change, the map that readers 
+ * walk is replaced with a copy of the writers' one. A full copy of the 
+ * extent_map (what was published before) is compared against an 
+ * extent_snapshot derived from the previous one, for files that grow one 
+ * segment at a time and for updates in the middle of a file (e.g. gaps being 
+ * allocated) once it has SEGMENTS segments.
+ *
+ * usage: bench-segment-publish [SEGMENTS] [UPDATES]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include <sys/types.h>
+
+#include <extent-map.h>
+
+namespace {
+
+using value_type = std::shared_ptr<int>;
+using segment_map = efsng::extent_map<value_type>;
+using segment_snapshot = efsng::extent_snapshot<value_type>;
+
+const off_t segment_size = 1 << 20;
+
+template <typename Function>
+double elapsed_ms(Function&& fun) {
+
+    auto start = std::chrono::steady_clock::now();
+    fun();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+/* apply 'change' to 'map' 'count' times, publishing it after each one */
+template <typename Change>
+void run(size_t count, segment_map& map, Change&& change, double& copy_ms, double& snapshot_ms) {
+
+    segment_map copy_map = map;
+    std::unique_ptr<segment_map> copy(new segment_map(map));
+
+    copy_ms = elapsed_ms([&] {
+        for(size_t i = 0; i < count; ++i) {
+            change(copy_map, i);
+            copy.reset(new segment_map(copy_map));
+        }
+    });
+
+    std::unique_ptr<segment_snapshot> snapshot(new segment_snapshot(map));
+    map.forget_changes();
+
+    snapshot_ms = elapsed_ms([&] {
+        for(size_t i = 0; i < count; ++i) {
+            change(map, i);
+            snapshot.reset(new segment_snapshot(map, *snapshot, map.changed_range()));
+            map.forget_changes();
+        }
+    });
+
+    if(copy->size() != snapshot->size()) {
+        fprintf(stderr, "copies disagree: %zu vs %zu extents\n", copy->size(), snapshot->size());
+        exit(EXIT_FAILURE);
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    size_t nsegments = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t nupdates = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+
+    if(nsegments == 0) {
+        fprintf(stderr, "usage: %s [SEGMENTS] [UPDATES]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<value_type> values;
+
+    for(size_t i = 0; i < nsegments + nupdates; ++i) {
+        values.emplace_back(std::make_shared<int>(i));
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<off_t> holes(nupdates);
+
+    for(size_t i = 0; i < nupdates; ++i) {
+        holes[i] = (rng() % nsegments) * segment_size + segment_size / 4;
+    }
+
+    segment_map map;
+    double copy_append, snapshot_append, copy_update, snapshot_update;
+
+    run(nsegments, map, [&](segment_map& m, size_t i) {
+        m.assign(i * segment_size, (i + 1) * segment_size, values[i]);
+    }, copy_append, snapshot_append);
+
+    run(nupdates, map, [&](segment_map& m, size_t i) {
+        m.assign(holes[i], holes[i] + 4096, values[nsegments + i]);
+    }, copy_update, snapshot_update);
+
+    printf("%-24s %12s %12s\n", "", "full copy", "snapshot");
+    printf("%-24s %12.3f %12.3f  (us per publish, %zu segments)\n", "append", 
+           copy_append * 1000 / nsegments, snapshot_append * 1000 / nsegments, nsegments);
+    printf("%-24s %12.3f %12.3f  (us per publish, %zu splits)\n", "update in the middle", 
+           copy_update * 1000 / nupdates, snapshot_update * 1000 / nupdates, nupdates);
+
+    return EXIT_SUCCESS;
+}
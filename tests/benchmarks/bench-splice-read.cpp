@@ -0,0 +1,208 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+/*
+ * Compare the two ways of serving a read from an NVRAM-NVML segment:
+ *
+ *  - memcpy: the data is copied from the pmem mapping into a private buffer
+ *            which is then written to the FUSE device (i.e. what get_data() 
+ *            does for the "mmap" read mode);
+ *  - splice: the data is spliced from the pool file descriptor into the FUSE 
+ *            device without going through userspace (i.e. the "splice" read
+ *            mode).
+ *
+ * Since we can't talk to /dev/fuse directly, a pipe drained into /dev/null 
+ * stands in for it. Request sizes match those enabled by the bufsize patches 
+ * in contrib/ (128KiB to 12MiB).
+ *
+ * usage: bench-splice-read DAXFS_DIR [ITERATIONS]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libpmem.h>
+
+namespace {
+
+const size_t KiB = 1024;
+const size_t MiB = 1024 * KiB;
+
+const size_t request_sizes[] = {
+    128*KiB, 256*KiB, 512*KiB, 1*MiB, 2*MiB, 4*MiB, 8*MiB, 12*MiB
+};
+
+const size_t pool_size = 16*MiB;
+
+/* move 'size' bytes out of the pipe so that it can be refilled */
+bool drain(int pipe_out, int sink, size_t size) {
+
+    while(size != 0) {
+        ssize_t n = splice(pipe_out, NULL, sink, NULL, size, SPLICE_F_MOVE);
+
+        if(n <= 0) {
+            return false;
+        }
+
+        size -= n;
+    }
+
+    return true;
+}
+
+bool memcpy_read(void* pool_addr, size_t size, int pipe_fds[2], size_t pipe_size, int sink) {
+
+    void* buffer = NULL;
+
+    if(posix_memalign(&buffer, 512, size) != 0) {
+        return false;
+    }
+
+    memcpy(buffer, pool_addr, size);
+
+    for(size_t off = 0; off < size; ) {
+        ssize_t n = write(pipe_fds[1], (char*) buffer + off, std::min(pipe_size, size - off));
+
+        if(n <= 0 || !drain(pipe_fds[0], sink, n)) {
+            free(buffer);
+            return false;
+        }
+
+        off += n;
+    }
+
+    free(buffer);
+    return true;
+}
+
+bool splice_read(int pool_fd, size_t size, int pipe_fds[2], size_t pipe_size, int sink) {
+
+    loff_t pos = 0;
+
+    for(size_t off = 0; off < size; ) {
+        ssize_t n = splice(pool_fd, &pos, pipe_fds[1], NULL, std::min(pipe_size, size - off), SPLICE_F_MOVE);
+
+        if(n <= 0 || !drain(pipe_fds[0], sink, n)) {
+            return false;
+        }
+
+        off += n;
+    }
+
+    return true;
+}
+
+template <typename Function>
+double bandwidth(size_t size, unsigned iterations, Function&& fun) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(unsigned i = 0; i < iterations; ++i) {
+        if(!fun()) {
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double) size * iterations / MiB / elapsed.count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s DAXFS_DIR [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::string pool_path = std::string(argv[1]) + "/bench-splice-read.pool";
+    unsigned iterations = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+
+    size_t pool_length;
+    int is_pmem;
+    void* pool_addr = pmem_map_file(pool_path.c_str(), pool_size, PMEM_FILE_CREATE, 
+                                    0600, &pool_length, &is_pmem);
+
+    if(pool_addr == NULL) {
+        perror("pmem_map_file");
+        return EXIT_FAILURE;
+    }
+
+    pmem_memset_persist(pool_addr, 0xef, pool_length);
+
+    int pool_fd = open(pool_path.c_str(), O_RDONLY);
+    int sink = open("/dev/null", O_WRONLY);
+    int pipe_fds[2];
+
+    if(pool_fd == -1 || sink == -1 || pipe(pipe_fds) == -1) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+
+    /* libfuse uses the largest pipe it can get for splicing */
+    fcntl(pipe_fds[1], F_SETPIPE_SZ, 1*MiB);
+    size_t pipe_size = fcntl(pipe_fds[1], F_GETPIPE_SZ);
+
+    printf("# pool: %s (is_pmem: %d), pipe size: %zu KiB, iterations: %u\n", 
+            pool_path.c_str(), is_pmem, pipe_size / KiB, iterations);
+    printf("%12s %16s %16s %10s\n", "size (KiB)", "memcpy (MiB/s)", "splice (MiB/s)", "speedup");
+
+    for(size_t size : request_sizes) {
+
+        double memcpy_bw = bandwidth(size, iterations, [&]() { 
+            return memcpy_read(pool_addr, size, pipe_fds, pipe_size, sink); 
+        });
+
+        double splice_bw = bandwidth(size, iterations, [&]() { 
+            return splice_read(pool_fd, size, pipe_fds, pipe_size, sink); 
+        });
+
+        printf("%12zu %16.1f %16.1f %9.2fx\n", size / KiB, memcpy_bw, splice_bw, splice_bw / memcpy_bw);
+    }
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    close(sink);
+    close(pool_fd);
+    pmem_unmap(pool_addr, pool_length);
+    unlink(pool_path.c_str());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+/*
+ * Sweep over request sizes against a mounted echofs to check the effect of 
+ * the 'transfer-size' setting: a file is written sequentially and then read 
+ * back with each request size, using O_DIRECT so that the kernel forwards 
+ * each request to echofs instead of serving it from (or merging it in) the 
+ * page cache. Requests larger than the negotiated transfer size are split 
+ * by the kernel, which should show up as a bandwidth plateau.
+ *
+ * usage: bench-transfer-size MOUNT_DIR [FILE_SIZE_MiB] [ITERATIONS]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t KiB = 1024;
+const size_t MiB = 1024 * KiB;
+
+const size_t request_sizes[] = {
+    4*KiB, 16*KiB, 64*KiB, 128*KiB, 256*KiB, 512*KiB, 1*MiB, 2*MiB, 4*MiB, 8*MiB
+};
+
+/* transfer 'file_size' bytes with 'size'-byte requests */
+bool sweep(int fd, void* buffer, size_t size, size_t file_size, bool write_data) {
+
+    for(size_t off = 0; off < file_size; off += size) {
+        ssize_t n = write_data ? pwrite(fd, buffer, size, off) : pread(fd, buffer, size, off);
+
+        if(n != (ssize_t) size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename Function>
+double bandwidth(size_t file_size, unsigned iterations, Function&& fun) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(unsigned i = 0; i < iterations; ++i) {
+        if(!fun()) {
+            perror("transfer");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double) file_size * iterations / MiB / elapsed.count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s MOUNT_DIR [FILE_SIZE_MiB] [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::string path = std::string(argv[1]) + "/bench-transfer-size.dat";
+    size_t file_size = (argc > 2 ? strtoul(argv[2], NULL, 10) : 256) * MiB;
+    unsigned iterations = argc > 3 ? strtoul(argv[3], NULL, 10) : 4;
+
+    const size_t max_size = request_sizes[sizeof(request_sizes)/sizeof(request_sizes[0]) - 1];
+
+    if(file_size < max_size || file_size % max_size != 0) {
+        fprintf(stderr, "FILE_SIZE must be a multiple of %zu MiB\n", max_size / MiB);
+        return EXIT_FAILURE;
+    }
+
+    void* buffer = NULL;
+
+    if(posix_memalign(&buffer, 4*KiB, max_size) != 0) {
+        perror("posix_memalign");
+        return EXIT_FAILURE;
+    }
+
+    memset(buffer, 0xef, max_size);
+
+    int fd = open(path.c_str(), O_CREAT | O_RDWR | O_DIRECT, 0600);
+
+    if(fd == -1) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+
+    printf("# file: %s (%zu MiB), iterations: %u\n", path.c_str(), file_size / MiB, iterations);
+    printf("%12s %16s %16s\n", "size (KiB)", "write (MiB/s)", "read (MiB/s)");
+
+    for(size_t size : request_sizes) {
+
+        double write_bw = bandwidth(file_size, iterations, [&]() { 
+            return sweep(fd, buffer, size, file_size, true); 
+        });
+
+        double read_bw = bandwidth(file_size, iterations, [&]() { 
+            return sweep(fd, buffer, size, file_size, false); 
+        });
+
+        printf("%12zu %16.1f %16.1f\n", size / KiB, write_bw, read_bw);
+    }
+
+    close(fd);
+    unlink(path.c_str());
+    free(buffer);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+
+
+/*
+ * Measure time-to-first-byte for staged inputs, to check the effect of the 
+ * 'warm-cache' caching policy. Each file is first looked up (stat), which is 
+ * what triggers the warm-up, then after DELAY seconds it is opened and its 
+ * first 4KiB are read (time to first byte) followed by the rest of the file 
+ * (time to last byte) with READ_SIZE requests. Run it once against resources 
+ * with 'warm-cache' and once against the same resources without it (e.g. 
+ * after remounting) to compare. Reads go through the page cache on purpose.
+ *
+ * usage: bench-ttfb [-d DELAY] [-r READ_SIZE_KiB] FILE...
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+const size_t KiB = 1024;
+const size_t MiB = 1024 * KiB;
+
+using clock_type = std::chrono::steady_clock;
+
+double usecs_since(clock_type::time_point start) {
+    return std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+}
+
+struct result {
+    double m_first_byte;    /* usecs */
+    double m_last_byte;     /* usecs */
+    size_t m_size;
+};
+
+bool measure(const char* path, std::vector<char>& buffer, result& res) {
+
+    auto start = clock_type::now();
+
+    int fd = open(path, O_RDONLY);
+
+    if(fd == -1) {
+        return false;
+    }
+
+    ssize_t n = pread(fd, buffer.data(), 4*KiB, 0);
+
+    if(n == -1) {
+        close(fd);
+        return false;
+    }
+
+    res.m_first_byte = usecs_since(start);
+    res.m_size = n;
+
+    while(n > 0) {
+        n = pread(fd, buffer.data(), buffer.size(), res.m_size);
+
+        if(n == -1) {
+            close(fd);
+            return false;
+        }
+
+        res.m_size += n;
+    }
+
+    res.m_last_byte = usecs_since(start);
+
+    close(fd);
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    double delay = 0;
+    size_t read_size = 1*MiB;
+    int opt;
+
+    while((opt = getopt(argc, argv, "d:r:")) != -1) {
+        switch(opt) {
+            case 'd':
+                delay = strtod(optarg, NULL);
+                break;
+            case 'r':
+                read_size = strtoul(optarg, NULL, 10) * KiB;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+
+    if(optind >= argc || read_size == 0) {
+        fprintf(stderr, "usage: %s [-d DELAY] [-r READ_SIZE_KiB] FILE...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* look up every file first: this is what starts the warm-up */
+    for(int i = optind; i < argc; ++i) {
+        struct stat stbuf;
+
+        if(stat(argv[i], &stbuf) == -1) {
+            perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+
+    std::vector<char> buffer(std::max(read_size, 4*KiB));
+    double total_first = 0, total_last = 0;
+    size_t total_size = 0;
+
+    printf("# delay: %.1f s, read size: %zu KiB\n", delay, read_size / KiB);
+    printf("%-40s %12s %16s %16s %14s\n", "file", "size (MiB)", "first byte (us)", "last byte (us)", "read (MiB/s)");
+
+    for(int i = optind; i < argc; ++i) {
+        result res;
+
+        if(!measure(argv[i], buffer, res)) {
+            perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        printf("%-40s %12.1f %16.1f %16.1f %14.1f\n", argv[i], (double) res.m_size / MiB, 
+               res.m_first_byte, res.m_last_byte, (double) res.m_size / MiB / (res.m_last_byte / 1e6));
+
+        total_first += res.m_first_byte;
+        total_last += res.m_last_byte;
+        total_size += res.m_size;
+    }
+
+    int count = argc - optind;
+
+    printf("%-40s %12.1f %16.1f %16.1f %14.1f\n", "(average)", (double) total_size / MiB / count, 
+           total_first / count, total_last / count, (double) total_size / MiB / (total_last / 1e6));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include "catch.hpp"
+#include "affinity.h"
+
+SCENARIO("cpu lists can be parsed", "[affinity]") {
+
+    GIVEN("a sysfs-style cpu list") {
+
+        efsng::cpu_list cpus;
+
+        WHEN("it contains single cpus and ranges") {
+
+            REQUIRE(efsng::parse_cpu_list("0-3,8,10-11\n", cpus));
+
+            THEN("all the cpus are listed in order") {
+                REQUIRE(cpus == efsng::cpu_list({0, 1, 2, 3, 8, 10, 11}));
+            }
+        }
+
+        WHEN("it is malformed") {
+            THEN("it is rejected") {
+                REQUIRE(!efsng::parse_cpu_list("0-", cpus));
+                REQUIRE(!efsng::parse_cpu_list("3-1", cpus));
+                REQUIRE(!efsng::parse_cpu_list("a", cpus));
+            }
+        }
+    }
+}
+
+SCENARIO("workers are spread among cpus and nodes", "[affinity]") {
+
+    GIVEN("a machine with two nodes where only some cpus are allowed") {
+
+        efsng::cpu_list allowed = {0, 1, 4, 5, 6};
+        std::vector<efsng::cpu_list> nodes = {{0, 1, 2, 3}, {4, 5, 6, 7}};
+
+        WHEN("workers are not pinned") {
+
+            auto plan = efsng::plan_worker_cpus("none", 3, allowed, nodes);
+
+            THEN("no worker gets any cpus") {
+                REQUIRE(plan.size() == 3);
+
+                for(const auto& cpus : plan) {
+                    REQUIRE(cpus.empty());
+                }
+            }
+        }
+
+        WHEN("workers are pinned to cpus") {
+
+            auto plan = efsng::plan_worker_cpus("cpu", 6, allowed, nodes);
+
+            THEN("each worker gets one allowed cpu in a round-robin fashion") {
+                REQUIRE(plan.size() == 6);
+                REQUIRE(plan[0] == efsng::cpu_list({0}));
+                REQUIRE(plan[2] == efsng::cpu_list({4}));
+                REQUIRE(plan[4] == efsng::cpu_list({6}));
+                REQUIRE(plan[5] == efsng::cpu_list({0}));
+            }
+        }
+
+        WHEN("workers are pinned to nodes") {
+
+            auto plan = efsng::plan_worker_cpus("node", 3, allowed, nodes);
+
+            THEN("each worker gets the allowed cpus of a node in a round-robin fashion") {
+                REQUIRE(plan[0] == efsng::cpu_list({0, 1}));
+                REQUIRE(plan[1] == efsng::cpu_list({4, 5, 6}));
+                REQUIRE(plan[2] == efsng::cpu_list({0, 1}));
+            }
+        }
+
+        WHEN("no node information is available") {
+
+            auto plan = efsng::plan_worker_cpus("node", 2, allowed, {});
+
+            THEN("workers may run on any allowed cpu") {
+                REQUIRE(plan[0] == allowed);
+                REQUIRE(plan[1] == allowed);
+            }
+        }
+    }
+}
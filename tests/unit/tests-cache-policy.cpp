@@ -0,0 +1,192 @@
+#include "catch.hpp"
+
+#include <cache-policy.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using cache_policy = efsng::cache_policy;
+using cache_policy_table = efsng::cache_policy_table;
+
+namespace {
+
+/* an in-memory file whose map_data() returns 0 on success, as nvml::file does */
+struct memory_file : public efsng::backend::file {
+
+    explicit memory_file(size_t size) : m_data(size) {
+        for(size_t i = 0; i < size; ++i) {
+            m_data[i] = (char) (i % 251);
+        }
+    }
+
+    void stat(struct stat& buf) const override {
+        memset(&buf, 0, sizeof(buf));
+        buf.st_size = m_data.size();
+    }
+
+    ssize_t map_data(off_t offset, size_t size, efsng::backend::data_view_ptr& view, cursor* cur) override {
+        (void) cur;
+        view.reset(new efsng::backend::data_view());
+
+        if(offset < (off_t) m_data.size()) {
+            view->add(&m_data[offset], std::min(size, m_data.size() - offset));
+        }
+        return 0;
+    }
+
+    ssize_t get_data(off_t, size_t, struct fuse_bufvec*) override { return -ENOTSUP; }
+    ssize_t put_data(off_t, size_t, struct fuse_bufvec*, cursor*) override { return -ENOTSUP; }
+    ssize_t append_data(off_t, size_t, struct fuse_bufvec*) override { return -ENOTSUP; }
+    ssize_t allocate(off_t, size_t, bool) override { return -ENOTSUP; }
+    int truncate(off_t) override { return 0; }
+    void save_attributes(struct stat&) override { }
+    int unload(const std::string) override { return 0; }
+    void change_type(file::type) override { }
+
+    std::vector<char> m_data;
+};
+
+}
+
+SCENARIO("cache policies", "[cache_policy]"){
+
+    GIVEN("a policy built from user options") {
+        cache_policy base;
+
+        WHEN("no options are given") {
+            cache_policy p({}, base);
+
+            THEN("everything is inherited") {
+                REQUIRE(p.m_keep_cache == base.m_keep_cache);
+                REQUIRE(p.m_direct_io == base.m_direct_io);
+                REQUIRE(p.m_attr_timeout == base.m_attr_timeout);
+                REQUIRE(p.m_entry_timeout == base.m_entry_timeout);
+            }
+        }
+
+        WHEN("some options are given") {
+            cache_policy p({{"keep-cache", "yes"}, {"attr-timeout", "2.5"}, {"prefix", "/in"}}, base);
+
+            THEN("only those are overridden") {
+                REQUIRE(p.m_keep_cache);
+                REQUIRE(!p.m_direct_io);
+                REQUIRE(p.m_attr_timeout == 2.5);
+                REQUIRE(p.m_entry_timeout == base.m_entry_timeout);
+            }
+        }
+
+        WHEN("cache warming is requested") {
+            cache_policy p({{"warm-cache", "true"}, {"warm-rate", "64MiB"}}, base);
+
+            THEN("pages are also kept across opens") {
+                REQUIRE(p.m_warm_cache);
+                REQUIRE(p.m_keep_cache);
+                REQUIRE(p.m_warm_rate == 64*1024*1024);
+                REQUIRE(cache_policy::defined_in({{"warm-cache", "true"}}));
+            }
+        }
+
+        WHEN("options are malformed or contradictory") {
+            THEN("the policy is rejected") {
+                REQUIRE_THROWS_AS(cache_policy({{"direct-io", "maybe"}}, base), const std::invalid_argument&);
+                REQUIRE_THROWS_AS(cache_policy({{"entry-timeout", "-1"}}, base), const std::invalid_argument&);
+                REQUIRE_THROWS_AS(cache_policy({{"entry-timeout", "1s"}}, base), const std::invalid_argument&);
+                REQUIRE_THROWS_AS(cache_policy({{"keep-cache", "true"}, {"direct-io", "true"}}, base), 
+                                  const std::invalid_argument&);
+                REQUIRE_THROWS_AS(cache_policy({{"warm-cache", "true"}, {"direct-io", "true"}}, base), 
+                                  const std::invalid_argument&);
+                REQUIRE_THROWS_AS(cache_policy({{"warm-rate", "0"}}, base), const std::invalid_argument&);
+            }
+        }
+
+        WHEN("the warming rate doesn't fit in 32 bits") {
+            cache_policy p({{"warm-rate", "8GiB"}}, base);
+
+            THEN("it is kept as is") {
+                REQUIRE(p.m_warm_rate == (uint64_t) 8 << 30);
+            }
+        }
+    }
+
+    GIVEN("a file to push into the page cache") {
+        const size_t size = (3 << 20) + 12345;
+        auto file = std::make_shared<memory_file>(size);
+        std::vector<char> cached(size, 0);
+        std::vector<off_t> offsets;
+        uint64_t total = 0;
+
+        efsng::store_fn store = [&](ino_t ino, off_t offset, struct fuse_bufvec* bufv) {
+            REQUIRE(ino == 42);
+            offsets.push_back(offset);
+
+            for(size_t i = 0; i < bufv->count; ++i) {
+                memcpy(&cached[offset], bufv->buf[i].mem, bufv->buf[i].size);
+                offset += bufv->buf[i].size;
+            }
+            return 0;
+        };
+
+        WHEN("it is warmed") {
+            int rv = efsng::warm_page_cache(file, 42, (uint64_t) 8 << 30, store, total);
+
+            THEN("all of its contents are pushed, one chunk at a time") {
+                REQUIRE(rv == 0);
+                REQUIRE(total == size);
+                REQUIRE(offsets.size() == 4);
+                REQUIRE(offsets.back() == 3 << 20);
+                REQUIRE(cached == file->m_data);
+            }
+        }
+
+        WHEN("the kernel refuses the data") {
+            efsng::store_fn failing = [&](ino_t, off_t offset, struct fuse_bufvec*) {
+                offsets.push_back(offset);
+                return offset == 0 ? 0 : -ENOSPC;
+            };
+
+            int rv = efsng::warm_page_cache(file, 42, (uint64_t) 8 << 30, failing, total);
+
+            THEN("warming stops with its error") {
+                REQUIRE(rv == -ENOSPC);
+                REQUIRE(total == 1 << 20);
+                REQUIRE(offsets.size() == 2);
+            }
+        }
+    }
+
+    GIVEN("a table with backend and prefix policies") {
+        cache_policy_table t;
+        auto def = reinterpret_cast<efsng::backend*>(0x1000);
+        auto other = reinterpret_cast<efsng::backend*>(0x2000);
+
+        cache_policy streaming({{"direct-io", "true"}}, cache_policy());
+        cache_policy inputs({{"keep-cache", "true"}, {"attr-timeout", "60"}}, cache_policy());
+
+        t.set_backend(other, streaming);
+
+        WHEN("no prefixes are registered") {
+            THEN("paths get the policy of their backend") {
+                REQUIRE(t.lookup("/a/b", other).m_direct_io);
+                REQUIRE(!t.lookup("/a/b", def).m_direct_io);
+            }
+        }
+
+        WHEN("a prefix is registered") {
+            t.set_prefix("/inputs/", inputs);
+
+            THEN("paths below it get its policy regardless of the backend") {
+                REQUIRE(t.lookup("/inputs", other).m_keep_cache);
+                REQUIRE(t.lookup("/inputs/x/y", def).m_attr_timeout == 60.0);
+                REQUIRE(!t.lookup("/inputs/x/y", other).m_direct_io);
+            }
+
+            THEN("other paths still get the policy of their backend") {
+                REQUIRE(!t.lookup("/inputsx", def).m_keep_cache);
+                REQUIRE(t.lookup("/outputs", other).m_direct_io);
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#include "catch.hpp"
+
+#include <copy-engine.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using efsng::copy_memory;
+using efsng::copy_mode;
+using efsng::memory_kind;
+
+SCENARIO("copy engine", "[copy_engine]"){
+
+    GIVEN("buffers of every size around the cache line and chunk boundaries") {
+
+        const size_t sizes[] = { 0, 1, 63, 64, 65, 127, 200, 4095, 4096, 4097, 100000, 5*1024*1024 + 3 };
+        const size_t offsets[] = { 0, 1, 17, 63 };
+        const memory_kind kinds[] = { memory_kind::pmem, memory_kind::dax, memory_kind::dram };
+        const copy_mode modes[] = { copy_mode::temporal, copy_mode::non_temporal };
+
+        std::vector<char> src(5*1024*1024 + 256);
+        std::vector<char> dst(src.size());
+
+        srand(42);
+
+        for(auto& c : src) {
+            c = (char) rand();
+        }
+
+        WHEN("data is copied in every mode") {
+            bool ok = true;
+
+            for(auto kind : kinds) {
+                for(auto mode : modes) {
+                    for(auto size : sizes) {
+                        for(auto off : offsets) {
+                            memset(dst.data(), 0, dst.size());
+                            copy_memory(dst.data() + off, src.data() + (63 - off), size, kind, mode);
+
+                            // nothing is written out of bounds
+                            ok = ok && memcmp(dst.data() + off, src.data() + (63 - off), size) == 0 &&
+                                       (off == 0 || dst[off - 1] == 0) && 
+                                       dst[off + size] == 0;
+                        }
+                    }
+                }
+            }
+
+            THEN("the destination matches the source") {
+                REQUIRE(ok);
+            }
+        }
+    }
+
+    GIVEN("the default strategy") {
+        THEN("small copies go through the caches and large ones bypass them") {
+            REQUIRE(efsng::copy_strategy(4096, memory_kind::dram) == copy_mode::temporal);
+            REQUIRE(efsng::copy_strategy(4096, memory_kind::pmem) == copy_mode::temporal);
+            REQUIRE(efsng::copy_strategy(12*1024*1024, memory_kind::dram) == copy_mode::non_temporal);
+            REQUIRE(efsng::copy_strategy(12*1024*1024, memory_kind::dax) == copy_mode::non_temporal);
+            REQUIRE(efsng::copy_strategy(128*1024, memory_kind::pmem) == copy_mode::non_temporal);
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include "catch.hpp"
+
+#include <epoch.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using efsng::epoch_manager;
+
+namespace {
+
+/* sets a flag when released */
+struct tracked {
+    tracked(std::atomic<int>* released, int value = 0) 
+        : m_released(released), 
+          m_value(value) { }
+
+    ~tracked() { 
+        m_value = -1;
+        ++*m_released;
+    }
+
+    std::atomic<int>*   m_released;
+    std::atomic<int>    m_value;
+};
+
+}
+
+SCENARIO("epoch-based reclamation", "[epoch_manager]"){
+
+    GIVEN("an epoch manager") {
+        epoch_manager mgr;
+        std::atomic<int> released(0);
+
+        WHEN("an object is retired while no reader is inside an epoch") {
+            mgr.retire(std::make_shared<tracked>(&released));
+
+            THEN("it is released right away") {
+                REQUIRE(released == 1);
+                REQUIRE(mgr.pending() == 0);
+            }
+        }
+
+        WHEN("an object is retired while a reader is inside an epoch") {
+            auto g = mgr.enter();
+            mgr.retire(std::make_shared<tracked>(&released));
+
+            THEN("it is kept until the reader leaves") {
+                REQUIRE(released == 0);
+                REQUIRE(mgr.pending() == 1);
+
+                g.release();
+
+                REQUIRE(released == 1);
+                REQUIRE(mgr.pending() == 0);
+            }
+        }
+
+        WHEN("a reader enters after an object was retired") {
+            auto g0 = mgr.enter();
+            mgr.retire(std::make_shared<tracked>(&released));
+            auto g1 = mgr.enter();
+
+            THEN("it doesn't keep the object alive") {
+                g0.release();
+
+                REQUIRE(released == 1);
+            }
+        }
+
+        WHEN("a guard is moved") {
+            auto g0 = mgr.enter();
+            mgr.retire(std::make_shared<tracked>(&released));
+
+            epoch_manager::guard g1;
+            g1 = std::move(g0);
+
+            THEN("the epoch is left only once the new guard goes") {
+                g0.release();
+                REQUIRE(released == 0);
+
+                g1.release();
+                REQUIRE(released == 1);
+            }
+        }
+
+        WHEN("readers load objects concurrently published and retired by a writer") {
+            const int versions = 2000;
+            std::atomic<tracked*> published(new tracked(&released, 0));
+            std::atomic<bool> done(false);
+            std::atomic<bool> ok(true);
+            std::vector<std::thread> readers;
+
+            for(int i = 0; i < 4; ++i) {
+                readers.emplace_back([&] {
+                    while(!done) {
+                        auto g = mgr.enter();
+                        tracked* t = published.load();
+
+                        for(int j = 0; j < 16; ++j) {
+                            if(t->m_value < 0) {
+                                ok = false;
+                            }
+                        }
+                    }
+                });
+            }
+
+            for(int i = 1; i <= versions; ++i) {
+                tracked* old = published.exchange(new tracked(&released, i));
+                mgr.retire(std::shared_ptr<const void>(old));
+            }
+
+            done = true;
+
+            for(auto& t : readers) {
+                t.join();
+            }
+
+            mgr.reclaim();
+
+            THEN("no reader sees a released object and every old one is released") {
+                REQUIRE(ok);
+                REQUIRE(released == versions);
+                REQUIRE(mgr.pending() == 0);
+            }
+
+            delete published.load();
+        }
+    }
+}
@@ -0,0 +1,284 @@
+#include "catch.hpp"
+
+#include <extent-map.h>
+
+#include <cstdlib>
+#include <vector>
+
+using extent_map = efsng::extent_map<int>;
+using extent_snapshot = efsng::extent_snapshot<int, 4>;
+
+namespace {
+
+/* check 'map' against a flat array with the value of each offset (0 = unmapped) */
+bool matches(const extent_map& map, const std::vector<int>& values) {
+
+    for(off_t off = 0; off < (off_t) values.size(); ++off) {
+        if(map.lookup(off) != values[off]) {
+            return false;
+        }
+    }
+
+    // and extents must be sorted and not overlap
+    off_t prev_end = 0;
+
+    for(const auto& e : map) {
+        if(e.m_start < prev_end || e.m_start >= e.m_end) {
+            return false;
+        }
+
+        prev_end = e.m_end;
+    }
+
+    return map.lookup(values.size()) == 0;
+}
+
+/* check that 'snapshot' holds the same extents as 'map' and finds the same offsets */
+bool matches(const extent_snapshot& snapshot, const extent_map& map, off_t max_offset) {
+
+    if(snapshot.size() != map.size()) {
+        return false;
+    }
+
+    for(size_t i = 0; i < map.size(); ++i) {
+        if(snapshot[i].m_start != map[i].m_start || snapshot[i].m_end != map[i].m_end || 
+           snapshot[i].m_value != map[i].m_value) {
+            return false;
+        }
+    }
+
+    for(off_t off = 0; off <= max_offset; ++off) {
+        if(snapshot.index_of(off) != map.index_of(off)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void fill(std::vector<int>& values, off_t start, off_t end, int value) {
+    for(off_t off = start; off < end; ++off) {
+        values[off] = value;
+    }
+}
+
+}
+
+SCENARIO("extent maps", "[extent_map]"){
+
+    GIVEN("an empty extent map") {
+        extent_map map;
+
+        THEN("nothing is mapped") {
+            REQUIRE(map.empty());
+            REQUIRE(map.find(0) == map.end());
+            REQUIRE(map.end_offset() == 0);
+        }
+
+        WHEN("extents are appended") {
+            map.assign(0, 10, 1);
+            map.assign(10, 20, 2);
+            map.assign(30, 40, 3);
+
+            THEN("offsets are found in the right extent") {
+                REQUIRE(map.size() == 3);
+                REQUIRE(map.lookup(0) == 1);
+                REQUIRE(map.lookup(9) == 1);
+                REQUIRE(map.lookup(10) == 2);
+                REQUIRE(map.find(25) == map.end());
+                REQUIRE(map.lookup(39) == 3);
+                REQUIRE(map.find(40) == map.end());
+                REQUIRE(map.end_offset() == 40);
+            }
+
+            AND_WHEN("a range in the middle of an extent is reassigned") {
+                map.assign(12, 15, 4);
+
+                THEN("the extent is split around it") {
+                    REQUIRE(map.size() == 5);
+                    REQUIRE(map.lookup(11) == 2);
+                    REQUIRE(map.lookup(12) == 4);
+                    REQUIRE(map.lookup(14) == 4);
+                    REQUIRE(map.lookup(15) == 2);
+                    REQUIRE(map.find(15)->m_start == 15);
+                    REQUIRE(map.find(15)->m_end == 20);
+                }
+            }
+
+            AND_WHEN("a range spanning several extents is erased") {
+                map.erase(5, 35);
+
+                THEN("only the parts outside of it remain") {
+                    REQUIRE(map.size() == 2);
+                    REQUIRE(map.lookup(4) == 1);
+                    REQUIRE(map.find(5) == map.end());
+                    REQUIRE(map.find(34) == map.end());
+                    REQUIRE(map.lookup(35) == 3);
+                }
+            }
+        }
+
+        WHEN("many extents of the same size are appended") {
+            const off_t size = 4096;
+
+            map.assign(0, 100, 1);
+
+            for(int i = 0; i < 1000; ++i) {
+                map.assign(100 + i * size, 100 + (i + 1) * size, i + 2);
+            }
+
+            THEN("every offset is found") {
+                bool found = true;
+
+                for(int i = 0; i < 1000; ++i) {
+                    found = found && map.lookup(100 + i * size) == i + 2 &&
+                                     map.lookup(100 + (i + 1) * size - 1) == i + 2;
+                }
+
+                REQUIRE(found);
+                REQUIRE(map.lookup(99) == 1);
+                REQUIRE(map.find(100 + 1000 * size) == map.end());
+            }
+
+            AND_WHEN("one of them is split") {
+                map.assign(100 + 500 * size + 10, 100 + 500 * size + 20, -1);
+
+                THEN("offsets before and after it are still found") {
+                    REQUIRE(map.lookup(100 + 499 * size) == 501);
+                    REQUIRE(map.lookup(100 + 500 * size + 15) == -1);
+                    REQUIRE(map.lookup(100 + 500 * size + 20) == 502);
+                    REQUIRE(map.lookup(100 + 501 * size) == 503);
+                    REQUIRE(map.lookup(100 + 999 * size) == 1001);
+                }
+            }
+        }
+
+        WHEN("random ranges are assigned and erased") {
+            std::vector<int> values(512, 0);
+            bool ok = true;
+
+            srand(42);
+
+            for(int i = 1; i <= 2000 && ok; ++i) {
+                off_t start = rand() % values.size();
+                off_t end = std::min(start + 1 + rand() % 64, (off_t) values.size());
+
+                if(rand() % 4 == 0) {
+                    map.erase(start, end);
+                    fill(values, start, end, 0);
+                }
+                else {
+                    map.assign(start, end, i);
+                    fill(values, start, end, i);
+                }
+
+                ok = matches(map, values);
+            }
+
+            THEN("the map always agrees with a flat array") {
+                REQUIRE(ok);
+            }
+        }
+    }
+}
+
+SCENARIO("extent map snapshots", "[extent_map]"){
+
+    GIVEN("an extent map and a snapshot of it") {
+        extent_map map;
+
+        for(int i = 0; i < 10; ++i) {
+            map.assign(i * 10, (i + 1) * 10, i + 1);
+        }
+
+        extent_snapshot snapshot(map);
+        map.forget_changes();
+
+        THEN("the snapshot holds the same extents") {
+            REQUIRE(matches(snapshot, map, 120));
+            REQUIRE(snapshot.index_of(100) == snapshot.size());
+        }
+
+        WHEN("nothing changes") {
+            extent_snapshot next(map, snapshot, map.changed_range());
+
+            THEN("the snapshot is the same") {
+                REQUIRE(matches(next, map, 120));
+            }
+        }
+
+        WHEN("the map is modified and a new snapshot is derived") {
+            map.assign(15, 25, -1);
+            map.assign(100, 110, 11);
+
+            extent_snapshot next(map, snapshot, map.changed_range());
+
+            THEN("the new snapshot sees the changes and the old one doesn't") {
+                REQUIRE(matches(next, map, 120));
+                REQUIRE(next[next.index_of(20)].m_value == -1);
+                REQUIRE(next.index_of(105) == next.size() - 1);
+                REQUIRE(snapshot[snapshot.index_of(20)].m_value == 3);
+                REQUIRE(snapshot.index_of(105) == snapshot.size());
+            }
+        }
+    }
+
+    GIVEN("an extent map that is snapshotted after every change") {
+        extent_map map;
+        extent_snapshot snapshot;
+
+        WHEN("random ranges are assigned and erased") {
+            const off_t max_offset = 512;
+            bool ok = true;
+
+            srand(42);
+
+            for(int i = 1; i <= 2000 && ok; ++i) {
+                off_t start = rand() % max_offset;
+                off_t end = std::min(start + 1 + rand() % 64, max_offset);
+
+                // mostly small ranges, so that extents pile up
+                if(rand() % 2 == 0) {
+                    end = std::min(start + 1 + rand() % 4, max_offset);
+                }
+
+                if(rand() % 8 == 0) {
+                    map.erase(start, end);
+                }
+                else if(rand() % 8 == 0) {
+                    map.assign(map.end_offset(), map.end_offset() + 1 + rand() % 4, i);
+                }
+                else {
+                    map.assign(start, end, i);
+                }
+
+                // publish only now and then, so that changes accumulate
+                if(rand() % 3 == 0) {
+                    snapshot = extent_snapshot(map, snapshot, map.changed_range());
+                    map.forget_changes();
+                    ok = matches(snapshot, map, map.end_offset() + 1);
+                }
+            }
+
+            THEN("the snapshots always agree with the map") {
+                REQUIRE(ok);
+            }
+        }
+
+        WHEN("the map is cleared") {
+            for(int i = 0; i < 20; ++i) {
+                map.assign(i * 10, (i + 1) * 10, i + 1);
+            }
+
+            snapshot = extent_snapshot(map, snapshot, map.changed_range());
+            map.forget_changes();
+            map.clear();
+            snapshot = extent_snapshot(map, snapshot, map.changed_range());
+
+            THEN("so is the snapshot") {
+                REQUIRE(snapshot.empty());
+                REQUIRE(snapshot.index_of(0) == 0);
+            }
+        }
+    }
+}
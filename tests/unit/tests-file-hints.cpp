@@ -0,0 +1,102 @@
+#include "catch.hpp"
+
+#include <file-hints.h>
+
+#include <sys/xattr.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+using file_hints = efsng::file_hints;
+
+namespace {
+
+int set(file_hints& h, const char* name, const std::string& value, int flags = 0) {
+    return h.set(name, value.data(), value.size(), flags);
+}
+
+std::string get(const file_hints& h, const char* name) {
+    char buffer[256];
+    ssize_t n = h.get(name, buffer, sizeof(buffer));
+    return n < 0 ? "" : std::string(buffer, n);
+}
+
+}
+
+SCENARIO("file hints", "[file_hints]"){
+
+    GIVEN("a file without hints") {
+        file_hints h;
+
+        THEN("defaults are returned and no attributes are listed") {
+            REQUIRE(h.expected_size() == 0);
+            REQUIRE(h.access() == file_hints::access_pattern::normal);
+            REQUIRE(h.consistency() == file_hints::consistency_level::relaxed);
+            REQUIRE(h.tier().empty());
+            REQUIRE(h.list(NULL, 0) == 0);
+            REQUIRE(h.get("user.efs.access", NULL, 0) == -ENODATA);
+        }
+
+        WHEN("valid hints are set") {
+            REQUIRE(set(h, "user.efs.expected_size", "64G") == 0);
+            REQUIRE(set(h, "user.efs.access", "sequential") == 0);
+            REQUIRE(set(h, "user.efs.tier", "nvram") == 0);
+
+            THEN("they can be read back") {
+                REQUIRE(h.expected_size() == (uint64_t) 64 << 30);
+                REQUIRE(h.access() == file_hints::access_pattern::sequential);
+                REQUIRE(h.tier() == "nvram");
+                REQUIRE(get(h, "user.efs.expected_size") == std::to_string((uint64_t) 64 << 30));
+                REQUIRE(get(h, "user.efs.access") == "sequential");
+            }
+
+            THEN("they are listed") {
+                std::string names("user.efs.expected_size\0user.efs.access\0user.efs.tier\0", 53);
+                char buffer[256];
+
+                REQUIRE(h.list(NULL, 0) == (ssize_t) names.size());
+                REQUIRE(h.list(buffer, 10) == -ERANGE);
+                REQUIRE(h.list(buffer, sizeof(buffer)) == (ssize_t) names.size());
+                REQUIRE(std::string(buffer, names.size()) == names);
+            }
+
+            THEN("creation and replacement flags are honored") {
+                REQUIRE(set(h, "user.efs.access", "random", XATTR_CREATE) == -EEXIST);
+                REQUIRE(set(h, "user.efs.consistency", "strict", XATTR_REPLACE) == -ENODATA);
+                REQUIRE(set(h, "user.efs.access", "random", XATTR_REPLACE) == 0);
+                REQUIRE(h.access() == file_hints::access_pattern::random);
+            }
+
+            THEN("removing them restores the defaults") {
+                REQUIRE(h.remove("user.efs.access") == 0);
+                REQUIRE(h.remove("user.efs.access") == -ENODATA);
+                REQUIRE(h.access() == file_hints::access_pattern::normal);
+            }
+        }
+
+        WHEN("the file is sealed") {
+            REQUIRE(set(h, "user.efs.sealed", "true") == 0);
+
+            THEN("unsealing it leaves the hint set to false") {
+                REQUIRE(h.sealed());
+                REQUIRE(h.unseal());
+                REQUIRE(!h.sealed());
+                REQUIRE(!h.unseal());
+                REQUIRE(get(h, "user.efs.sealed") == "false");
+            }
+        }
+
+        WHEN("invalid hints are set") {
+            THEN("they are rejected") {
+                REQUIRE(set(h, "user.efs.expected_size", "lots") == -EINVAL);
+                REQUIRE(set(h, "user.efs.expected_size", "1P") == -EINVAL);
+                REQUIRE(set(h, "user.efs.access", "backwards") == -EINVAL);
+                REQUIRE(set(h, "user.efs.tier", "") == -EINVAL);
+                REQUIRE(set(h, "user.efs.sealed", "maybe") == -EINVAL);
+                REQUIRE(set(h, "user.efs.color", "blue") == -EOPNOTSUPP);
+                REQUIRE(set(h, "user.mime_type", "text/plain") == -EOPNOTSUPP);
+                REQUIRE(h.list(NULL, 0) == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#include "catch.hpp"
+
+#include <metadata/handles.h>
+
+#include <fcntl.h>
+
+#include <set>
+#include <vector>
+
+using handle_table = efsng::handle_table;
+
+SCENARIO("handle table operations", "[handle_table]"){
+
+    GIVEN("an empty handle table") {
+        handle_table handles;
+
+        WHEN("nothing has been opened") {
+            THEN("no handle is valid") {
+                REQUIRE(handles.size() == 0);
+                REQUIRE(handles.get(0) == nullptr);
+                REQUIRE(handles.get(1) == nullptr);
+                REQUIRE(handles.get(((uint64_t) 1 << 32) | 1) == nullptr);
+                REQUIRE(!handles.release(((uint64_t) 1 << 32) | 1));
+            }
+        }
+
+        WHEN("a file is opened") {
+            uint64_t fh = handles.open(42, 7, O_RDWR, nullptr);
+
+            THEN("its record can be fetched through the handle") {
+                REQUIRE(fh != 0);
+                REQUIRE(handles.size() == 1);
+
+                auto record = handles.get(fh);
+                REQUIRE(record != nullptr);
+                REQUIRE(record->get_inode() == 42);
+                REQUIRE(record->get_fd() == 7);
+                REQUIRE(record->get_mode() == O_RDWR);
+                REQUIRE(record->get_cursor() == nullptr);
+            }
+
+            THEN("the handle becomes stale once released") {
+                REQUIRE(handles.release(fh));
+                REQUIRE(handles.size() == 0);
+                REQUIRE(handles.get(fh) == nullptr);
+                REQUIRE(!handles.release(fh));
+            }
+
+            THEN("a recycled slot does not validate the old handle") {
+                REQUIRE(handles.release(fh));
+
+                uint64_t fh2 = handles.open(43, 8, O_RDONLY, nullptr);
+
+                REQUIRE(fh2 != fh);
+                REQUIRE(handles.get(fh) == nullptr);
+                REQUIRE(handles.get(fh2)->get_inode() == 43);
+            }
+        }
+
+        WHEN("more files than fit in a slab are opened") {
+            std::vector<uint64_t> fhs;
+
+            for(ino_t i = 0; i < 3000; ++i) {
+                fhs.push_back(handles.open(i, 0, O_RDONLY, nullptr));
+            }
+
+            THEN("all handles are unique and valid") {
+                REQUIRE(std::set<uint64_t>(fhs.begin(), fhs.end()).size() == fhs.size());
+                REQUIRE(handles.size() == 3000);
+
+                for(ino_t i = 0; i < 3000; ++i) {
+                    REQUIRE(handles.get(fhs[i])->get_inode() == i);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,237 @@
+#include "catch.hpp"
+
+#include <metadata/inodes.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using inode_table = efsng::inode_table;
+
+namespace {
+
+/* a file that checks, when it is destroyed, whether the table that held it 
+ * can be used meanwhile by another thread (i.e. whether it is unlocked). The 
+ * thread is left to the caller to join: it finishes once the table is unlocked */
+struct probe_file : public efsng::backend::file {
+
+    probe_file(const inode_table& inodes, std::thread& other, bool& unlocked)
+        : m_inodes(inodes),
+          m_other(other),
+          m_unlocked(unlocked) { }
+
+    ~probe_file() {
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        const inode_table& inodes = m_inodes;
+
+        m_other = std::thread([&inodes, done] { inodes.size(); *done = true; });
+
+        for(int i = 0; i < 200 && !*done; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        m_unlocked = *done;
+    }
+
+    void stat(struct stat&) const override { }
+    ssize_t get_data(off_t, size_t, struct fuse_bufvec*) override { return -ENOTSUP; }
+    ssize_t put_data(off_t, size_t, struct fuse_bufvec*, cursor*) override { return -ENOTSUP; }
+    ssize_t append_data(off_t, size_t, struct fuse_bufvec*) override { return -ENOTSUP; }
+    ssize_t allocate(off_t, size_t, bool) override { return -ENOTSUP; }
+    int truncate(off_t) override { return 0; }
+    void save_attributes(struct stat&) override { }
+    int unload(const std::string) override { return 0; }
+    void change_type(file::type) override { }
+
+    const inode_table& m_inodes;
+    std::thread& m_other;
+    bool& m_unlocked;
+};
+
+}
+
+SCENARIO("inode table bookkeeping", "[inode_table]"){
+
+    GIVEN("an empty inode table") {
+        inode_table inodes;
+        std::string pathname;
+
+        WHEN("it is created") {
+            THEN("only the root inode is known") {
+                REQUIRE(inodes.size() == 1);
+                REQUIRE(inodes.find(inode_table::root_inode, pathname));
+                REQUIRE(pathname == "/");
+                REQUIRE(!inodes.find(2, pathname));
+            }
+        }
+
+        WHEN("an inode is looked up several times") {
+            inodes.add(2, "/a", nullptr);
+            inodes.add(2, "/a", nullptr);
+
+            THEN("it is only released once all lookups are forgotten") {
+                inodes.forget(2, 1);
+                REQUIRE(inodes.find(2, pathname));
+                REQUIRE(pathname == "/a");
+
+                inodes.forget(2, 1);
+                REQUIRE(!inodes.find(2, pathname));
+            }
+        }
+
+        WHEN("the root inode is forgotten") {
+            inodes.forget(inode_table::root_inode, 1);
+
+            THEN("it is kept") {
+                REQUIRE(inodes.find(inode_table::root_inode, pathname));
+            }
+        }
+
+        WHEN("a directory is renamed") {
+            inodes.add(2, "/dir", nullptr);
+            inodes.add(3, "/dir/file", nullptr);
+            inodes.add(4, "/dirfile", nullptr);
+
+            inodes.rename("/dir", "/new");
+
+            THEN("the paths of the directory and its descendants are updated") {
+                REQUIRE(inodes.find(2, pathname));
+                REQUIRE(pathname == "/new");
+                REQUIRE(inodes.find(3, pathname));
+                REQUIRE(pathname == "/new/file");
+                REQUIRE(inodes.find(4, pathname));
+                REQUIRE(pathname == "/dirfile");
+            }
+
+            THEN("the index follows the new paths") {
+                ino_t inode = 0;
+                REQUIRE(inodes.find_path("/new/file", inode));
+                REQUIRE(inode == 3);
+                REQUIRE(!inodes.find_path("/dir/file", inode));
+            }
+        }
+
+        WHEN("a directory with siblings sorting between it and its children is renamed") {
+            inodes.add(2, "/dir", nullptr);
+            inodes.add(3, "/dir-x", nullptr);
+            inodes.add(4, "/dir.d/file", nullptr);
+            inodes.add(5, "/dir/a/b", nullptr);
+            inodes.add(6, "/dir0", nullptr);
+
+            inodes.rename("/dir", "/new");
+
+            THEN("only the directory and its descendants are renamed") {
+                REQUIRE(inodes.find(2, pathname));
+                REQUIRE(pathname == "/new");
+                REQUIRE(inodes.find(3, pathname));
+                REQUIRE(pathname == "/dir-x");
+                REQUIRE(inodes.find(4, pathname));
+                REQUIRE(pathname == "/dir.d/file");
+                REQUIRE(inodes.find(5, pathname));
+                REQUIRE(pathname == "/new/a/b");
+                REQUIRE(inodes.find(6, pathname));
+                REQUIRE(pathname == "/dir0");
+            }
+        }
+
+        WHEN("a path is looked up again after being unlinked while in use") {
+            inodes.add(2, "/file", nullptr);
+            inodes.add(3, "/file", nullptr);
+
+            THEN("the path maps to the newest inode") {
+                ino_t inode = 0;
+                REQUIRE(inodes.find_path("/file", inode));
+                REQUIRE(inode == 3);
+            }
+
+            AND_WHEN("the newest inode is forgotten") {
+                inodes.forget(3, 1);
+
+                THEN("the path maps to the older one") {
+                    ino_t inode = 0;
+                    REQUIRE(inodes.find_path("/file", inode));
+                    REQUIRE(inode == 2);
+                }
+            }
+        }
+
+        WHEN("the last reference to a file is dropped by a forget") {
+            std::thread other;
+            bool unlocked = false;
+
+            inodes.add(2, "/file", std::make_shared<probe_file>(inodes, other, unlocked));
+            inodes.forget(2, 1);
+            other.join();
+
+            THEN("the file is destroyed once the table is unlocked") {
+                REQUIRE(unlocked);
+                REQUIRE(!inodes.find(2, pathname));
+            }
+        }
+
+        WHEN("inodes are looked up with the backend serving them") {
+            // backends are only compared, never used
+            auto nvml = reinterpret_cast<efsng::backend*>(0x10);
+            auto dram = reinterpret_cast<efsng::backend*>(0x20);
+            efsng::backend* owner = nullptr;
+
+            inodes.add(2, "/dir", nullptr, nvml);
+            inodes.add(3, "/dir/file", nullptr, nvml);
+            inodes.add(4, "/dirfile", nullptr, nvml);
+
+            THEN("the backend is returned along with the path") {
+                REQUIRE(inodes.find(3, pathname, owner));
+                REQUIRE(pathname == "/dir/file");
+                REQUIRE(owner == nvml);
+            }
+
+            AND_WHEN("a subtree is rerouted") {
+                inodes.reroute("/dir", [&](const std::string& path) {
+                    return path == "/dir/file" ? dram : nvml;
+                });
+
+                THEN("only the inodes below it are updated") {
+                    REQUIRE(inodes.find(2, pathname, owner));
+                    REQUIRE(owner == nvml);
+                    REQUIRE(inodes.find(3, pathname, owner));
+                    REQUIRE(owner == dram);
+                    REQUIRE(inodes.find(4, pathname, owner));
+                    REQUIRE(owner == nvml);
+                }
+            }
+        }
+
+        WHEN("the inodes under a path are collected") {
+            inodes.add(2, "/dir", nullptr);
+            inodes.add(3, "/dir/file", nullptr);
+            inodes.add(4, "/dirfile", nullptr);
+
+            std::vector<ino_t> found;
+            inodes.subtree("/dir", found);
+            std::sort(found.begin(), found.end());
+
+            THEN("only the path and its descendants are returned") {
+                REQUIRE(found == std::vector<ino_t>({2, 3}));
+            }
+
+            THEN("everything is below the root") {
+                std::vector<ino_t> all;
+                inodes.subtree("/", all);
+                std::sort(all.begin(), all.end());
+                REQUIRE(all == std::vector<ino_t>({inode_table::root_inode, 2, 3, 4}));
+            }
+
+            THEN("paths can be mapped back to their inodes") {
+                ino_t inode = 0;
+                REQUIRE(inodes.find_path("/dir/file", inode));
+                REQUIRE(inode == 3);
+                REQUIRE(!inodes.find_path("/dir/other", inode));
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "catch.hpp"
+
+#include <metadata/negatives.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using negative_table = efsng::negative_table;
+
+SCENARIO("negative lookup table", "[negative_table]"){
+
+    GIVEN("an empty negative table") {
+        negative_table negatives;
+
+        WHEN("nothing has been added") {
+            THEN("no path is known to be missing") {
+                REQUIRE(!negatives.contains("/a"));
+            }
+        }
+
+        WHEN("a failed lookup is recorded") {
+            negatives.add("/a", negatives.generation());
+
+            THEN("the path is known to be missing") {
+                REQUIRE(negatives.contains("/a"));
+                REQUIRE(!negatives.contains("/b"));
+            }
+
+            AND_WHEN("the table is invalidated") {
+                negatives.invalidate();
+
+                THEN("the entry is no longer valid") {
+                    REQUIRE(!negatives.contains("/a"));
+                }
+            }
+        }
+
+        WHEN("a path appears while it is being looked up") {
+            auto generation = negatives.generation();
+            negatives.invalidate();
+            negatives.add("/a", generation);
+
+            THEN("the failed lookup is not recorded") {
+                REQUIRE(!negatives.contains("/a"));
+            }
+        }
+
+        WHEN("entries are given a lifetime") {
+            negatives.set_lifetime(0.05);
+            negatives.add("/a", negatives.generation());
+
+            THEN("they expire") {
+                REQUIRE(negatives.contains("/a"));
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                REQUIRE(!negatives.contains("/a"));
+            }
+        }
+
+        WHEN("the table is disabled") {
+            negatives.set_lifetime(0);
+            negatives.add("/a", negatives.generation());
+
+            THEN("nothing is recorded") {
+                REQUIRE(!negatives.contains("/a"));
+            }
+        }
+    }
+
+    GIVEN("a full negative table") {
+        negative_table negatives(16);
+
+        for(int i = 0; i < 1000; ++i) {
+            negatives.add("/file" + std::to_string(i), negatives.generation());
+        }
+
+        THEN("the most recent failed lookup is still recorded") {
+            REQUIRE(negatives.contains("/file999"));
+        }
+    }
+}
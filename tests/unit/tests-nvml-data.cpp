@@ -0,0 +1,261 @@
+/*************************************************************************
+ * (C) Copyright 2016 Barcelona Supercomputing Center                    *
+ *                    Centro Nacional de Supercomputacion                *
+ *                                                                       *
+ * This file is part of the Echo Filesystem NG.                          *
+ *                                                                       *
+ * See AUTHORS file in the top level directory for information           *
+ * regarding developers and contributors.                                *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the GNU Lesser General Public            *
+ * License as published by the Free Software Foundation; either          *
+ * version 3 of the License, or (at your option) any later version.      *
+ *                                                                       *
+ * The Echo Filesystem NG is distributed in the hope that it will        *
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied         *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR               *
+ * PURPOSE.  See the GNU Lesser General Public License for more          *
+ * details.                                                              *
+ *                                                                       *
+ * You should have received a copy of the GNU Lesser General Public      *
+ * License along with Echo Filesystem NG; if not, write to the Free      *
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.    *
+ *                                                                       *
+ *************************************************************************/
+
+ /*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/ 
+
+#include "catch.hpp"
+
+#include <efs-common.h>
+#include <backends/nvram-nvml/file.h>
+#include <backends/nvram-nvml/segment.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+using efsng::nvml::segment;
+
+namespace {
+
+/* an nvml file backed by pools in a scratch directory (removed along with it) */
+struct scratch_file {
+
+    /* storage is only shared between files accounted in the same 'allocated' */
+    scratch_file(const std::string& name, ino_t inode, std::atomic<uint64_t>* allocated)
+        : m_base(boost::filesystem::temp_directory_path() / 
+                 boost::filesystem::unique_path("efsng-tests-%%%%-%%%%")) {
+
+        boost::filesystem::create_directories(m_base);
+
+        m_file.reset(new efsng::nvml::file(m_base, "/" + name, inode, efsng::backend::file::type::temporary, 
+                                           /*populate=*/false, allocated));
+
+        struct stat stbuf;
+        memset(&stbuf, 0, sizeof(stbuf));
+        m_file->save_attributes(stbuf);
+    }
+
+    ~scratch_file() {
+        m_file.reset();
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(m_base, ec);
+    }
+
+    boost::filesystem::path m_base;
+    std::unique_ptr<efsng::nvml::file> m_file;
+};
+
+char pattern(off_t offset, int seed) {
+    return (char) ((offset * 7 + seed) % 251 + 1);
+}
+
+/* write 'size' bytes of pattern 'seed' at 'offset' (and in 'expected' too) */
+bool write(efsng::nvml::file& f, off_t offset, size_t size, int seed, std::vector<char>& expected) {
+
+    std::vector<char> data(size);
+
+    for(size_t i = 0; i < size; ++i) {
+        data[i] = pattern(offset + i, seed);
+    }
+
+    if(expected.size() < offset + size) {
+        expected.resize(offset + size, 0);
+    }
+
+    memcpy(&expected[offset], data.data(), size);
+
+    struct fuse_bufvec src = FUSE_BUFVEC_INIT(size);
+    src.buf[0].mem = data.data();
+
+    return f.put_data(offset, size, &src) == (ssize_t) size;
+}
+
+/* whether the contents of 'f' are those in 'expected' */
+bool matches(efsng::nvml::file& f, const std::vector<char>& expected) {
+
+    efsng::backend::data_view_ptr view;
+
+    if(f.map_data(0, expected.size(), view) < 0 || view->size() != expected.size()) {
+        return false;
+    }
+
+    std::vector<char> data(expected.size());
+    struct fuse_bufvec dst = FUSE_BUFVEC_INIT(data.size());
+    dst.buf[0].mem = data.data();
+
+    fuse_buf_copy(&dst, view->bufvec(), (fuse_buf_copy_flags) 0);
+
+    return data == expected;
+}
+
+}
+
+SCENARIO("nvml file data", "[nvml::file]"){
+
+    const size_t saved_segment_size = segment::s_segment_size;
+    segment::s_segment_size = 1 << 20;
+
+    GIVEN("a file spanning several segments") {
+        std::atomic<uint64_t> allocated(0);
+        scratch_file src("src", 2, &allocated);
+        std::vector<char> expected;
+
+        REQUIRE(write(*src.m_file, 0, 4 << 20, 1, expected));
+        REQUIRE(matches(*src.m_file, expected));
+
+        WHEN("a range in the middle is punched") {
+            const off_t start = (1 << 20) + 1000;
+            const size_t size = (2 << 20) + 5000;
+
+            REQUIRE(src.m_file->punch_hole(start, size) == 0);
+            memset(&expected[start], 0, size);
+
+            THEN("it reads back as zeroes and the rest of the file is kept") {
+                REQUIRE(matches(*src.m_file, expected));
+            }
+
+            AND_WHEN("part of the hole is written again") {
+                REQUIRE(write(*src.m_file, start + 100, 10000, 2, expected));
+
+                THEN("only that part has data") {
+                    REQUIRE(matches(*src.m_file, expected));
+                }
+            }
+        }
+
+        WHEN("a range is zeroed") {
+            const off_t start = 3000;
+            const size_t size = (1 << 20) + 3000;
+
+            REQUIRE(src.m_file->zero_range(start, size, /*keep_size=*/false) == 0);
+            memset(&expected[start], 0, size);
+
+            THEN("it reads back as zeroes and the rest of the file is kept") {
+                REQUIRE(matches(*src.m_file, expected));
+            }
+        }
+
+        WHEN("it is copied whole to another file") {
+            scratch_file dst("dst", 3, &allocated);
+            std::vector<char> copied = expected;
+            const uint64_t in_use = allocated;
+
+            REQUIRE(dst.m_file->copy_range(*src.m_file, 0, 0, 4 << 20) == (4 << 20));
+
+            THEN("the copy has the same contents") {
+                REQUIRE(matches(*dst.m_file, copied));
+            }
+
+            THEN("its storage is shared") {
+                REQUIRE(allocated == in_use);
+            }
+
+            AND_WHEN("either side is written") {
+                REQUIRE(write(*dst.m_file, (1 << 20) + 10, 5000, 3, copied));
+                REQUIRE(write(*src.m_file, (2 << 20) - 10, 5000, 4, expected));
+
+                THEN("the other side keeps its bytes") {
+                    REQUIRE(matches(*src.m_file, expected));
+                    REQUIRE(matches(*dst.m_file, copied));
+                }
+            }
+
+            AND_WHEN("a hole is punched in the source") {
+                REQUIRE(src.m_file->punch_hole(0, 2 << 20) == 0);
+                memset(&expected[0], 0, 2 << 20);
+
+                THEN("the copy keeps its bytes") {
+                    REQUIRE(matches(*src.m_file, expected));
+                    REQUIRE(matches(*dst.m_file, copied));
+                }
+            }
+        }
+
+        WHEN("an unaligned range is copied to another file") {
+            scratch_file dst("dst", 3, &allocated);
+            std::vector<char> copied;
+            const off_t src_offset = 1000;
+            const off_t dst_offset = 300;
+            const size_t size = (3 << 20) + 777;
+
+            REQUIRE(write(*dst.m_file, 0, dst_offset, 5, copied));
+            copied.resize(dst_offset + size);
+            memcpy(&copied[dst_offset], &expected[src_offset], size);
+
+            REQUIRE(dst.m_file->copy_range(*src.m_file, src_offset, dst_offset, size) == (ssize_t) size);
+
+            THEN("the copy has the same contents") {
+                REQUIRE(matches(*dst.m_file, copied));
+            }
+
+            AND_WHEN("either side is written") {
+                REQUIRE(write(*dst.m_file, dst_offset + (1 << 20), 5000, 3, copied));
+                REQUIRE(write(*src.m_file, src_offset + (2 << 20), 5000, 4, expected));
+
+                THEN("the other side keeps its bytes") {
+                    REQUIRE(matches(*src.m_file, expected));
+                    REQUIRE(matches(*dst.m_file, copied));
+                }
+            }
+        }
+
+        WHEN("it is sealed") {
+            REQUIRE(src.m_file->set_hint("user.efs.sealed", "true", 4, 0) == 0);
+
+            THEN("reads see the same data") {
+                REQUIRE(src.m_file->is_sealed());
+                REQUIRE(matches(*src.m_file, expected));
+            }
+
+            AND_WHEN("it is written") {
+                REQUIRE(write(*src.m_file, (3 << 20) - 100, 200, 6, expected));
+
+                THEN("it is unsealed and reads see the write") {
+                    REQUIRE(!src.m_file->is_sealed());
+                    REQUIRE(matches(*src.m_file, expected));
+                }
+            }
+        }
+
+        WHEN("it is synced after a write") {
+            REQUIRE(write(*src.m_file, 12345, 100000, 7, expected));
+
+            THEN("the sync succeeds and the data is kept") {
+                REQUIRE(src.m_file->sync(/*data_only=*/true) == 0);
+                REQUIRE(src.m_file->sync(/*data_only=*/false) == 0);
+                REQUIRE(matches(*src.m_file, expected));
+            }
+        }
+    }
+
+    segment::s_segment_size = saved_segment_size;
+}
@@ -0,0 +1,81 @@
+#include "catch.hpp"
+
+#include <backends/nvram-nvml/dir.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using entries = std::vector<std::pair<std::string, off_t>>;
+
+static entries list_after(const efsng::nvml::dir& d, off_t offset) {
+    entries result;
+    d.list_files(offset, [&](const std::string& name, off_t off) -> bool {
+        result.emplace_back(name, off);
+        return true;
+    });
+    return result;
+}
+
+SCENARIO("directory listings", "[nvml::dir]"){
+
+    GIVEN("a directory with some entries") {
+        efsng::nvml::dir d("/d", 1, "/", efsng::nvml::dir::type::temporary, false);
+
+        d.add_file("a");
+        d.add_file("b");
+        d.add_file("c");
+
+        WHEN("it is listed from the start") {
+            auto ls = list_after(d, 0);
+
+            THEN("entries come in order with increasing offsets past those of '.' and '..'") {
+                REQUIRE(ls.size() == 3);
+                REQUIRE(ls[0].first == "a");
+                REQUIRE(ls[0].second == efsng::backend::dir::s_first_offset);
+                REQUIRE(ls[1].second > ls[0].second);
+                REQUIRE(ls[2].second > ls[1].second);
+                REQUIRE(ls[2].second < efsng::backend::dir::s_max_offset);
+            }
+        }
+
+        WHEN("entries change while it is being listed") {
+            auto first = list_after(d, 0);
+            off_t resume = first[0].second;
+
+            d.remove_file("a");
+            d.remove_file("b");
+            d.add_file("d");
+            d.add_file("a");
+
+            auto rest = list_after(d, resume);
+
+            THEN("the listing resumes after the last entry returned") {
+                REQUIRE(rest.size() == 3);
+                REQUIRE(rest[0].first == "c");
+                REQUIRE(rest[1].first == "d");
+                REQUIRE(rest[2].first == "a");
+            }
+        }
+
+        WHEN("the callback stops the listing") {
+            std::size_t calls = 0;
+            d.list_files(0, [&](const std::string&, off_t) -> bool {
+                return ++calls < 2;
+            });
+
+            THEN("no more entries are passed") {
+                REQUIRE(calls == 2);
+            }
+        }
+
+        WHEN("an entry is added twice") {
+            d.add_file("a");
+
+            THEN("it is listed once") {
+                REQUIRE(list_after(d, 0).size() == 3);
+                REQUIRE(d.find("a"));
+            }
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include "catch.hpp"
+
+#include <range-set.h>
+
+#include <cstdlib>
+#include <vector>
+
+using range_set = efsng::range_set;
+
+namespace {
+
+/* check 'set' against a flat array of flags, one per offset */
+bool matches(const range_set& set, const std::vector<bool>& flags) {
+
+    std::vector<bool> found(flags.size(), false);
+    off_t prev_end = -1;
+
+    for(const auto& r : set) {
+        // ranges must be sorted, non-empty and neither overlap nor touch
+        if(r.first <= prev_end || r.first >= r.second || r.second > (off_t) flags.size()) {
+            return false;
+        }
+
+        for(off_t off = r.first; off < r.second; ++off) {
+            found[off] = true;
+        }
+
+        prev_end = r.second;
+    }
+
+    return found == flags;
+}
+
+}
+
+SCENARIO("range sets", "[range_set]"){
+
+    GIVEN("an empty range set") {
+        range_set set;
+
+        THEN("it has no ranges") {
+            REQUIRE(set.empty());
+        }
+
+        WHEN("contiguous ranges are added") {
+            for(off_t off = 0; off < 1000; off += 10) {
+                set.add(off, off + 10);
+            }
+
+            THEN("they are merged into one") {
+                REQUIRE(set.size() == 1);
+                REQUIRE(set.begin()->first == 0);
+                REQUIRE(set.begin()->second == 1000);
+            }
+        }
+
+        WHEN("a range covering several others is added") {
+            set.add(10, 20);
+            set.add(30, 40);
+            set.add(50, 60);
+            set.add(15, 55);
+
+            THEN("they are merged with it") {
+                REQUIRE(set.size() == 1);
+                REQUIRE(set.begin()->first == 10);
+                REQUIRE(set.begin()->second == 60);
+            }
+        }
+
+        WHEN("empty ranges are added") {
+            set.add(10, 10);
+            set.add(20, 5);
+
+            THEN("they are ignored") {
+                REQUIRE(set.empty());
+            }
+        }
+
+        WHEN("random ranges are added") {
+            std::vector<bool> flags(512, false);
+            bool ok = true;
+
+            srand(42);
+
+            for(int i = 0; i < 200 && ok; ++i) {
+                off_t start = rand() % flags.size();
+                off_t end = std::min(start + 1 + rand() % 16, (off_t) flags.size());
+
+                set.add(start, end);
+
+                for(off_t off = start; off < end; ++off) {
+                    flags[off] = true;
+                }
+
+                ok = matches(set, flags);
+            }
+
+            THEN("the set always agrees with a flat array") {
+                REQUIRE(ok);
+            }
+        }
+    }
+}
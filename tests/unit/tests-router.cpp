@@ -0,0 +1,90 @@
+#include "catch.hpp"
+
+#include <router.h>
+
+#include <list>
+#include <string>
+
+using router = efsng::router;
+
+SCENARIO("path routing", "[router]"){
+
+    GIVEN("a router with a default backend") {
+        router r;
+        auto def = reinterpret_cast<efsng::backend*>(0x1000);
+        auto other = reinterpret_cast<efsng::backend*>(0x2000);
+        std::size_t index;
+
+        r.set_default(def);
+
+        WHEN("no prefixes are registered") {
+            THEN("every path resolves to the default backend") {
+                REQUIRE(r.resolve("/") == def);
+                REQUIRE(r.resolve("/a/b/c", &index) == def);
+                REQUIRE(index == 0);
+            }
+        }
+
+        WHEN("a prefix is routed to another backend") {
+            r.add_prefix("/scratch/", other);
+
+            THEN("paths below it resolve to that backend") {
+                REQUIRE(r.resolve("/scratch", &index) == other);
+                REQUIRE(index == 1);
+                REQUIRE(r.resolve("/scratch/a/b") == other);
+            }
+
+            THEN("other paths still resolve to the default backend") {
+                REQUIRE(r.resolve("/scratchpad") == def);
+                REQUIRE(r.resolve("/data/scratch") == def);
+            }
+
+            THEN("the prefix shows up as a child of its parent") {
+                std::list<std::string> names;
+                r.children("/", names);
+                REQUIRE(names.size() == 1);
+                REQUIRE(names.front() == "scratch");
+            }
+
+            THEN("inodes from the routed backend do not clash") {
+                REQUIRE(router::global_inode(0, 42) == 42);
+                REQUIRE(router::global_inode(1, 42) != 42);
+            }
+
+            THEN("inodes of unstaged files do not clash either") {
+                REQUIRE(r.passthrough_inode(1, 42) != router::global_inode(0, 42));
+                REQUIRE(r.passthrough_inode(1, 42) != router::global_inode(1, 42));
+            }
+        }
+
+        WHEN("unstaged files are given inode numbers") {
+            const ino_t big = (ino_t) 1 << 45;
+
+            ino_t a = r.passthrough_inode(1, 42);
+            ino_t b = r.passthrough_inode(2, 42);
+            ino_t c = r.passthrough_inode(1, big | 42);
+
+            THEN("each file keeps its own number") {
+                REQUIRE(a != 0);
+                REQUIRE(r.passthrough_inode(1, 42) == a);
+                REQUIRE(r.passthrough_inode(1, big | 42) == c);
+            }
+
+            THEN("files on other filesystems or with large inode numbers don't share it") {
+                REQUIRE(a != b);
+                REQUIRE(a != c);
+                REQUIRE(b != c);
+            }
+        }
+
+        WHEN("nested prefixes are routed") {
+            r.add_prefix("/a", other);
+            r.add_prefix("/a/b", def);
+
+            THEN("the longest prefix wins") {
+                REQUIRE(r.resolve("/a/x") == other);
+                REQUIRE(r.resolve("/a/b/x") == def);
+            }
+        }
+    }
+}
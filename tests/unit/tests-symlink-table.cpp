@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <metadata/symlinks.h>
+
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+using symlink_table = efsng::symlink_table;
+
+SCENARIO("symlink table operations", "[symlink_table]"){
+
+    GIVEN("an empty symlink table") {
+        symlink_table links;
+        std::string target;
+        struct stat stbuf;
+
+        WHEN("nothing has been added") {
+            THEN("lookups fail") {
+                REQUIRE(links.empty());
+                REQUIRE(!links.find("/a", target));
+                REQUIRE(!links.stat("/a", stbuf));
+                REQUIRE(!links.remove("/a"));
+            }
+        }
+
+        WHEN("a link is added") {
+            REQUIRE(links.add("/dir/link", "../target", 0, 0));
+
+            THEN("it can be resolved and stat'ed") {
+                REQUIRE(!links.empty());
+                REQUIRE(links.find("/dir/link", target));
+                REQUIRE(target == "../target");
+                REQUIRE(links.stat("/dir/link", stbuf));
+                REQUIRE(S_ISLNK(stbuf.st_mode));
+                REQUIRE(stbuf.st_size == 9);
+            }
+
+            THEN("it cannot be added twice") {
+                REQUIRE(!links.add("/dir/link", "other", 0, 0));
+            }
+
+            THEN("it is listed only in its parent directory") {
+                std::list<std::string> names;
+                links.list("/dir", names);
+                REQUIRE(names.size() == 1);
+                REQUIRE(names.front() == "link");
+
+                names.clear();
+                links.list("/", names);
+                REQUIRE(names.empty());
+            }
+
+            THEN("it can be renamed and removed") {
+                REQUIRE(links.rename("/dir/link", "/link"));
+                REQUIRE(!links.find("/dir/link", target));
+                REQUIRE(links.find("/link", target));
+                REQUIRE(links.remove("/link"));
+                REQUIRE(links.empty());
+            }
+        }
+
+        WHEN("links are added concurrently") {
+            std::vector<std::thread> threads;
+
+            for(int i=0; i<8; ++i) {
+                threads.emplace_back([&links, i] {
+                    for(int j=0; j<100; ++j) {
+                        links.add("/l" + std::to_string(i*100 + j), "t", 0, 0);
+                    }
+                });
+            }
+
+            for(auto& t : threads) {
+                t.join();
+            }
+
+            THEN("all of them are present") {
+                std::list<std::string> names;
+                links.list("/", names);
+                REQUIRE(names.size() == 800);
+            }
+        }
+    }
+}